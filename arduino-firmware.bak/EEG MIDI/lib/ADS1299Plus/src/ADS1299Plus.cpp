@@ -10,14 +10,23 @@ static inline void ads_wait_ms(uint32_t ms) { delay(ms); }
 static inline void ads_wait_decode() { delayMicroseconds(3); }
 
 // ---- Constructor ----
-ADS1299Plus::ADS1299Plus(ADS1299_SafeSPI &spi, const Pins &pins)
-    : spi_(spi), pins_(pins) {}
+ADS1299Core::ADS1299Core(ADS1299_SafeSPI &spi, const Pins &pins, uint8_t expectedChannels, uint8_t numDevices)
+    : spi_(spi), pins_(pins), num_devices_(numDevices),
+      expected_channels_(expectedChannels), num_channels_(expectedChannels) {}
 
 // ---- Control de pines auxiliares ----
-void ADS1299Plus::pinStartHigh() { digitalWrite(pins_.start, HIGH); }
-void ADS1299Plus::pinStartLow() { digitalWrite(pins_.start, LOW); }
+void ADS1299Core::pinStartHigh()
+{
+  digitalWrite(pins_.start, HIGH);
+  converting_ = true;
+}
+void ADS1299Core::pinStartLow()
+{
+  digitalWrite(pins_.start, LOW);
+  converting_ = false;
+}
 
-void ADS1299Plus::pinResetPulse()
+void ADS1299Core::pinResetPulse()
 {
   digitalWrite(pins_.reset, LOW);
   ads_wait_us(10);
@@ -25,13 +34,13 @@ void ADS1299Plus::pinResetPulse()
   ads_wait_us(20);
 }
 
-void ADS1299Plus::pinPowerDown(bool activeLow)
+void ADS1299Core::pinPowerDown(bool activeLow)
 {
   digitalWrite(pins_.pwdn, activeLow ? LOW : HIGH);
 }
 
 // ---- Secuencia de arranque (11.1) ----
-bool ADS1299Plus::begin()
+bool ADS1299Core::begin()
 {
   // 1) Configurar pines
   pinMode(pins_.cs, OUTPUT);
@@ -65,6 +74,10 @@ bool ADS1299Plus::begin()
   if (!ADS_ID_DEV_IS_1299(id))
     return false;
 
+  // 7) Copia local del mapa de registros (una sola ráfaga RREG)
+  if (!syncShadow())
+    return false;
+
   // Ajustar número de canales
   switch (id & ADS_ID_NU_CH_MASK)
   {
@@ -78,72 +91,91 @@ bool ADS1299Plus::begin()
     num_channels_ = 8;
     break;
   default:
-    num_channels_ = 4;
-    break;
+    return false; // NU_CH = 11 reservado
   }
 
+  // El firmware se compiló para otro nº de canales: los frames no cuadrarían
+  if (num_channels_ != expected_channels_)
+    return false;
+
   return true;
 }
 
 // ---- Configuración por defecto ----
-bool ADS1299Plus::configureDefaults()
+// Imagen con los valores k*_Default y los canales detectados por begin();
+// se aplica y verifica en una ráfaga de escritura + una de lectura.
+bool ADS1299Core::configureDefaults()
 {
   cmdStop();
   cmdSDATAC();
 
-  if (!writeReg(ADS_REG_CONFIG1, kCFG1_Default))
-    return false;
-  if (!writeReg(ADS_REG_CONFIG2, kCFG2_Default))
-    return false;
-  if (!writeReg(ADS_REG_CONFIG3, kCFG3_Default))
-    return false;
-  if (!writeReg(ADS_REG_LOFF, kLOFF_Default))
+  // Lead-off sense en canales activos, inactivos apagados con entradas en corto
+  const uint8_t activeMask = ADS_ACTIVE_MASK(num_channels_);
+  const ADS1299_Profile img = ADS_PROFILE_IMAGE(
+      kCFG1_Default, kCFG2_Default, kCFG3_Default, kLOFF_Default,
+      kCH_Default(), num_channels_,
+      0x00, 0x00,                 // BIAS derivation: desactivada
+      activeMask, activeMask, 0x00,
+      kGPIO_Default, 0x00, kCFG4_Default);
+
+  return applyRegisterImage(img.reg);
+}
+
+// ---- Perfiles ----
+bool ADS1299Core::applyProfile(uint8_t profileId)
+{
+  if (profileId >= ADS_PROFILE_COUNT)
     return false;
+  uint8_t img[ADS1299_PROFILE_LEN];
+  memcpy_P(img, ADS1299_PROFILES[profileId].reg, sizeof(img));
+  return applyRegisterImage(img);
+}
 
-  // Configurar canales activos
-  for (uint8_t ch = 1; ch <= num_channels_; ++ch)
+bool ADS1299Core::imageMatches_(const uint8_t *img, const uint8_t *rb)
+{
+  for (uint8_t i = 0; i < ADS1299_PROFILE_LEN; ++i)
   {
-    if (!setChannel(ch, kCH_Default()))
+    uint8_t mask = ADS_PROFILE_VERIFY_MASK((uint8_t)(ADS1299_PROFILE_FIRST + i));
+    if ((img[i] ^ rb[i]) & mask)
       return false;
   }
+  return true;
+}
 
-  // Apagar canales inactivos
-  for (uint8_t ch = num_channels_ + 1; ch <= 8; ++ch)
-  {
-    if (!powerDownChannel(ch, true))
-      return false;
-  }
+bool ADS1299Core::applyRegisterImage(const uint8_t imgIn[ADS1299_PROFILE_LEN])
+{
+  // WREG/RREG se ignoran en RDATAC (9.5.3.10/11)
+  bool resume = rdatacActive_;
+  if (resume)
+    cmdSDATAC();
 
-  // BIAS derivation: desactivar
-  if (!writeReg(ADS_REG_BIAS_SENSP, 0x00))
-    return false;
-  if (!writeReg(ADS_REG_BIAS_SENSN, 0x00))
-    return false;
+  // El modo de CONFIG1 lo fija la topología, no el perfil: con varios
+  // dispositivos daisy-chain, con uno multiple readback
+  uint8_t img[ADS1299_PROFILE_LEN];
+  memcpy(img, imgIn, sizeof(img));
+  uint8_t &cfg1 = img[ADS_REG_CONFIG1 - ADS1299_PROFILE_FIRST];
+  cfg1 = (num_devices_ > 1) ? (uint8_t)(cfg1 & ~ADS_CFG1_MULTI_READBACK)
+                            : (uint8_t)(cfg1 | ADS_CFG1_MULTI_READBACK);
 
-  // Lead-off sense en canales activos
-  uint8_t activeMask = 0xFF;
-  if (num_channels_ < 8)
-  {
-    activeMask = (1 << num_channels_) - 1;
-  }
-  if (!enableLeadOffSenseP(activeMask))
-    return false;
-  if (!enableLeadOffSenseN(activeMask))
-    return false;
+  // Con CS y DIN compartidos el WREG llega a todos los dispositivos a la vez;
+  // la relectura solo ve el primero de la cadena (el que va a DOUT del MCU)
+  uint8_t rb[ADS1299_PROFILE_LEN];
+  bool ok = writeBurst_(ADS1299_PROFILE_FIRST, img, ADS1299_PROFILE_LEN) &&
+            readBurst_(ADS1299_PROFILE_FIRST, rb, ADS1299_PROFILE_LEN) &&
+            imageMatches_(img, rb);
 
-  if (!writeReg(ADS_REG_LOFF_FLIP, 0x00))
-    return false;
-  if (!writeReg(ADS_REG_GPIO, kGPIO_Default))
-    return false;
-  if (!writeReg(ADS_REG_MISC1, 0x00))
-    return false;
-  if (!writeReg(ADS_REG_CONFIG4, kCFG4_Default))
-    return false;
+  // La caché refleja lo que hay en el dispositivo; lo pendiente queda anulado
+  memcpy(&shadow_[ADS1299_PROFILE_FIRST], rb, ADS1299_PROFILE_LEN);
+  dirty_ = 0;
+  deferred_ = false;
+  shadowValid_ = true;
 
-  return true;
+  if (resume)
+    cmdRDATAC();
+  return ok;
 }
 
-void ADS1299Plus::end()
+void ADS1299Core::end()
 {
   cmdStop();
   cmdSDATAC();
@@ -151,14 +183,14 @@ void ADS1299Plus::end()
 }
 
 // ---- Comandos SPI ----
-void ADS1299Plus::cmdWakeup()
+void ADS1299Core::cmdWakeup()
 {
   spi_.select();
   spi_.xfer(ADS_CMD_WAKEUP);
   spi_.deselect();
   ads_wait_decode();
 }
-void ADS1299Plus::cmdStandby()
+void ADS1299Core::cmdStandby()
 {
   spi_.select();
   spi_.xfer(ADS_CMD_STANDBY);
@@ -166,29 +198,32 @@ void ADS1299Plus::cmdStandby()
   ads_wait_decode();
 }
 
-void ADS1299Plus::cmdReset()
+void ADS1299Core::cmdReset()
 {
   spi_.select();
   spi_.xfer(ADS_CMD_RESET);
   spi_.deselect();
+  converting_ = false;
   ads_wait_us(20);
 }
 
-void ADS1299Plus::cmdStart()
+void ADS1299Core::cmdStart()
 {
   spi_.select();
   spi_.xfer(ADS_CMD_START);
   spi_.deselect();
+  converting_ = true;
   ads_wait_decode();
 }
-void ADS1299Plus::cmdStop()
+void ADS1299Core::cmdStop()
 {
   spi_.select();
   spi_.xfer(ADS_CMD_STOP);
   spi_.deselect();
+  converting_ = false;
   ads_wait_decode();
 }
-void ADS1299Plus::cmdRDATAC()
+void ADS1299Core::cmdRDATAC()
 {
   spi_.select();
   spi_.xfer(ADS_CMD_RDATAC);
@@ -196,7 +231,7 @@ void ADS1299Plus::cmdRDATAC()
   rdatacActive_ = true;
   ads_wait_decode();
 }
-void ADS1299Plus::cmdSDATAC()
+void ADS1299Core::cmdSDATAC()
 {
   spi_.select();
   spi_.xfer(ADS_CMD_SDATAC);
@@ -204,336 +239,391 @@ void ADS1299Plus::cmdSDATAC()
   rdatacActive_ = false;
   ads_wait_decode();
 }
-void ADS1299Plus::cmdRDATA()
+void ADS1299Core::cmdRDATA()
 {
   spi_.select();
   spi_.xfer(ADS_CMD_RDATA);
   spi_.deselect();
+  ads_wait_decode();
 }
 
-// ---- Acceso a registros ----n
-bool ADS1299Plus::writeOne_(uint8_t addr, uint8_t val)
+// ---- Acceso a registros ----
+// Opcodes de WREG/RREG con tSDECODE tras cada byte (comando multibyte, 9.5.3);
+// los bytes de registro van en bloque.
+bool ADS1299Core::writeOne_(uint8_t addr, uint8_t val)
 {
-  spi_.select();
-  spi_.xfer(ADS_CMD_WREG | addr);
-  spi_.xfer(0x00); // write 1 reg
-  spi_.xfer(val);
-  spi_.deselect();
-  ads_wait_decode();
-  return true;
+  return writeBurst_(addr, &val, 1);
 }
 
-bool ADS1299Plus::readOne_(uint8_t addr, uint8_t &val)
+bool ADS1299Core::readOne_(uint8_t addr, uint8_t &val)
 {
-  spi_.select();
-  spi_.xfer(ADS_CMD_RREG | addr);
-  spi_.xfer(0x00); // read 1 reg
-  val = spi_.xfer(0x00);
-  spi_.deselect();
-  ads_wait_decode();
-  return true;
+  return readBurst_(addr, &val, 1);
 }
 
-bool ADS1299Plus::writeBurst_(uint8_t startAddr, const uint8_t *data, size_t n)
+bool ADS1299Core::writeBurst_(uint8_t startAddr, const uint8_t *data, size_t n)
 {
+  if (n == 0)
+    return false;
   spi_.select();
   spi_.xfer(ADS_CMD_WREG | startAddr);
+  spi_.waitDecode();
   spi_.xfer(n - 1);
-  for (size_t i = 0; i < n; ++i)
-  {
-    spi_.xfer(data[i]);
-  }
+  spi_.waitDecode();
+  spi_.xferBlock(data, nullptr, n);
   spi_.deselect();
   ads_wait_decode();
   return true;
 }
 
-bool ADS1299Plus::readBurst_(uint8_t startAddr, uint8_t *data, size_t n)
+bool ADS1299Core::readBurst_(uint8_t startAddr, uint8_t *data, size_t n)
 {
+  if (n == 0)
+    return false;
   spi_.select();
   spi_.xfer(ADS_CMD_RREG | startAddr);
+  spi_.waitDecode();
   spi_.xfer(n - 1);
-  for (size_t i = 0; i < n; ++i)
-  {
-    data[i] = spi_.xfer(0x00);
-  }
+  spi_.waitDecode();
+  spi_.readBlock(data, n);
   spi_.deselect();
   ads_wait_decode();
   return true;
 }
 
-bool ADS1299Plus::writeReg(uint8_t addr, uint8_t value) { return writeOne_(addr, value); }
-bool ADS1299Plus::readReg(uint8_t addr, uint8_t &value) { return readOne_(addr, value); }
+bool ADS1299Core::writeReg(uint8_t addr, uint8_t value) { return stage_(addr, value, true); }
+bool ADS1299Core::readReg(uint8_t addr, uint8_t &value)
+{
+  if (!readOne_(addr, value))
+    return false;
+  // Refrescar la caché salvo que haya un cambio pendiente en ese registro
+  if (addr < NUM_REGS && !(dirty_ & (1UL << addr)))
+    shadow_[addr] = value;
+  return true;
+}
 
-bool ADS1299Plus::writeRegs(uint8_t startAddr, const uint8_t *data, size_t n) { return writeBurst_(startAddr, data, n); }
-bool ADS1299Plus::readRegs(uint8_t startAddr, uint8_t *data, size_t n) { return readBurst_(startAddr, data, n); }
+bool ADS1299Core::writeRegs(uint8_t startAddr, const uint8_t *data, size_t n)
+{
+  if (n == 0 || startAddr + n > NUM_REGS)
+    return false;
+  for (size_t i = 0; i < n; ++i)
+  {
+    uint8_t addr = (uint8_t)(startAddr + i);
+    if (!writable_(addr))
+      continue;
+    shadow_[addr] = data[i];
+    dirty_ |= 1UL << addr;
+  }
+  return deferred_ ? true : commitRegs();
+}
 
-// ---- Helpers alto nivel ----
-bool ADS1299Plus::setDataRate(uint8_t dr3b)
+bool ADS1299Core::readRegs(uint8_t startAddr, uint8_t *data, size_t n)
 {
-  uint8_t cfg1;
-  if (!readReg(ADS_REG_CONFIG1, cfg1))
+  if (!readBurst_(startAddr, data, n))
     return false;
-  cfg1 = (cfg1 & 0xF8) | (dr3b & 0x07);
-  return writeReg(ADS_REG_CONFIG1, cfg1);
+  for (size_t i = 0; i < n && startAddr + i < NUM_REGS; ++i)
+  {
+    uint8_t addr = (uint8_t)(startAddr + i);
+    if (!(dirty_ & (1UL << addr)))
+      shadow_[addr] = data[i];
+  }
+  return true;
 }
 
-bool ADS1299Plus::setClockOut(bool enable)
+// ---- Caché de registros ----
+bool ADS1299Core::syncShadow()
 {
-  uint8_t cfg1;
-  if (!readReg(ADS_REG_CONFIG1, cfg1))
+  if (rdatacActive_)
+    return false; // RREG se ignora en RDATAC (9.5.3.10)
+  if (!readBurst_(ADS_REG_ID, shadow_, NUM_REGS))
     return false;
-  if (enable)
-    cfg1 |= ADS_CFG1_CLK_EN;
-  else
-    cfg1 &= ~ADS_CFG1_CLK_EN;
-  return writeReg(ADS_REG_CONFIG1, cfg1);
+  dirty_ = 0;
+  shadowValid_ = true;
+  return true;
 }
 
-bool ADS1299Plus::setDaisyEnable(bool enable)
+bool ADS1299Core::stage_(uint8_t addr, uint8_t val, bool force)
 {
-  uint8_t cfg1;
-  if (!readReg(ADS_REG_CONFIG1, cfg1))
+  if (!writable_(addr))
     return false;
-  if (enable)
-    cfg1 |= ADS_CFG1_DAISY_EN;
-  else
-    cfg1 &= ~ADS_CFG1_DAISY_EN;
-  return writeReg(ADS_REG_CONFIG1, cfg1);
+  // Sin cambios respecto a la caché: nada que escribir
+  if (!force && shadowValid_ && shadow_[addr] == val)
+    return true;
+  shadow_[addr] = val;
+  dirty_ |= 1UL << addr;
+  return deferred_ ? true : commitRegs();
 }
 
-bool ADS1299Plus::setChannel(uint8_t ch, uint8_t chsetByte)
+bool ADS1299Core::updateBits_(uint8_t addr, uint8_t mask, uint8_t bits)
 {
-  if (!validCh_(ch))
+  uint8_t cur;
+  if (shadowValid_ || (dirty_ & (1UL << addr)))
+    cur = shadow_[addr];
+  else if (!readReg(addr, cur)) // sin caché: RMW clásico
     return false;
-  return writeReg(chRegAddr_(ch), chsetByte);
+  return stage_(addr, (uint8_t)((cur & ~mask) | (bits & mask)), false);
+}
+
+// Huecos de hasta kCommitGap registros limpios se reescriben con su valor en
+// caché: un byte más sale más barato que otro WREG (2 opcodes + tSDECODE).
+static constexpr uint8_t kCommitGap = 2;
+
+bool ADS1299Core::commitRegs()
+{
+  deferred_ = false;
+  if (dirty_ == 0)
+    return true;
+
+  // WREG se ignora en RDATAC (9.5.3.11)
+  bool resume = rdatacActive_;
+  if (resume)
+    cmdSDATAC();
+
+  bool ok = true;
+  uint8_t addr = 0;
+  while (addr < NUM_REGS)
+  {
+    if (!(dirty_ & (1UL << addr)))
+    {
+      ++addr;
+      continue;
+    }
+    // Extender la ráfaga mientras haya registros sucios cerca y escribibles
+    uint8_t start = addr;
+    uint8_t end = addr; // último sucio incluido
+    for (uint8_t a = addr + 1; a < NUM_REGS && writable_(a) && a <= end + kCommitGap + 1; ++a)
+    {
+      if (dirty_ & (1UL << a))
+        end = a;
+    }
+    if (!writeBurst_(start, &shadow_[start], (size_t)(end - start + 1)))
+      ok = false;
+    for (uint8_t a = start; a <= end; ++a)
+      dirty_ &= ~(1UL << a);
+    addr = (uint8_t)(end + 1);
+  }
+
+  if (resume)
+    cmdRDATAC();
+  return ok;
+}
+
+// ---- Helpers alto nivel ----
+bool ADS1299Core::setDataRate(uint8_t dr3b)
+{
+  return updateBits_(ADS_REG_CONFIG1, 0x07, dr3b);
+}
+
+bool ADS1299Core::setClockOut(bool enable)
+{
+  return updateBits_(ADS_REG_CONFIG1, ADS_CFG1_CLK_EN, enable ? ADS_CFG1_CLK_EN : 0);
 }
 
-bool ADS1299Plus::powerDownChannel(uint8_t ch, bool pd)
+bool ADS1299Core::setDaisyEnable(bool enable)
+{
+  // DAISY_EN activo a nivel bajo (9.6.1.2): 0 = daisy-chain, 1 = multiple readback
+  return updateBits_(ADS_REG_CONFIG1, ADS_CFG1_MULTI_READBACK, enable ? 0 : ADS_CFG1_MULTI_READBACK);
+}
+
+bool ADS1299Core::setChannel(uint8_t ch, uint8_t chsetByte)
 {
   if (!validCh_(ch))
     return false;
-  uint8_t ch_val;
-  if (!readReg(chRegAddr_(ch), ch_val))
-    return false;
-  if (pd)
-    ch_val |= ADS_CH_PD;
-  else
-    ch_val &= ~ADS_CH_PD;
-  return writeReg(chRegAddr_(ch), ch_val);
+  return stage_(chRegAddr_(ch), chsetByte, false);
 }
 
-bool ADS1299Plus::setChannelGain(uint8_t ch, uint8_t gain3b)
+bool ADS1299Core::powerDownChannel(uint8_t ch, bool pd)
 {
   if (!validCh_(ch))
     return false;
-  uint8_t ch_val;
-  if (!readReg(chRegAddr_(ch), ch_val))
-    return false;
-  ch_val = (ch_val & 0x8F) | ((gain3b & 0x07) << 4);
-  return writeReg(chRegAddr_(ch), ch_val);
+  return updateBits_(chRegAddr_(ch), ADS_CH_PD, pd ? ADS_CH_PD : 0);
 }
 
-bool ADS1299Plus::setChannelMux(uint8_t ch, uint8_t mux3b)
+bool ADS1299Core::setChannelGain(uint8_t ch, uint8_t gain3b)
 {
   if (!validCh_(ch))
     return false;
-  uint8_t ch_val;
-  if (!readReg(chRegAddr_(ch), ch_val))
-    return false;
-  ch_val = (ch_val & 0xF8) | (mux3b & 0x07);
-  return writeReg(chRegAddr_(ch), ch_val);
+  return updateBits_(chRegAddr_(ch), 0x70, (uint8_t)((gain3b & 0x07) << 4));
 }
 
-bool ADS1299Plus::setSRB2(uint8_t ch, bool en)
+bool ADS1299Core::setChannelMux(uint8_t ch, uint8_t mux3b)
 {
   if (!validCh_(ch))
     return false;
-  uint8_t ch_val;
-  if (!readReg(chRegAddr_(ch), ch_val))
-    return false;
-  if (en)
-    ch_val |= ADS_CH_SRB2;
-  else
-    ch_val &= ~ADS_CH_SRB2;
-  return writeReg(chRegAddr_(ch), ch_val);
+  return updateBits_(chRegAddr_(ch), 0x07, mux3b);
 }
 
-bool ADS1299Plus::enableSRB1(bool en)
+bool ADS1299Core::setSRB2(uint8_t ch, bool en)
 {
-  uint8_t misc1;
-  if (!readReg(ADS_REG_MISC1, misc1))
+  if (!validCh_(ch))
     return false;
-  if (en)
-    misc1 |= ADS_MISC1_SRB1;
-  else
-    misc1 &= ~ADS_MISC1_SRB1;
-  return writeReg(ADS_REG_MISC1, misc1);
+  return updateBits_(chRegAddr_(ch), ADS_CH_SRB2, en ? ADS_CH_SRB2 : 0);
 }
 
-bool ADS1299Plus::useInternalRef(bool enBuf)
+bool ADS1299Core::enableSRB1(bool en)
 {
-  uint8_t cfg3;
-  if (!readReg(ADS_REG_CONFIG3, cfg3))
-    return false;
-  if (enBuf)
-    cfg3 |= ADS_CFG3_PD_REFBUF;
-  else
-    cfg3 &= ~ADS_CFG3_PD_REFBUF;
-  return writeReg(ADS_REG_CONFIG3, cfg3);
+  return updateBits_(ADS_REG_MISC1, ADS_MISC1_SRB1, en ? ADS_MISC1_SRB1 : 0);
 }
 
-bool ADS1299Plus::useBiasInternalRef(bool enInt)
+bool ADS1299Core::useInternalRef(bool enBuf)
 {
-  uint8_t cfg3;
-  if (!readReg(ADS_REG_CONFIG3, cfg3))
-    return false;
-  if (enInt)
-    cfg3 |= ADS_CFG3_BIASREF_INT;
-  else
-    cfg3 &= ~ADS_CFG3_BIASREF_INT;
-  return writeReg(ADS_REG_CONFIG3, cfg3);
+  return updateBits_(ADS_REG_CONFIG3, ADS_CFG3_PD_REFBUF, enBuf ? ADS_CFG3_PD_REFBUF : 0);
 }
 
-bool ADS1299Plus::enableBiasBuffer(bool en)
+bool ADS1299Core::useBiasInternalRef(bool enInt)
 {
-  uint8_t cfg3;
-  if (!readReg(ADS_REG_CONFIG3, cfg3))
-    return false;
-  if (en)
-    cfg3 |= ADS_CFG3_PD_BIAS;
-  else
-    cfg3 &= ~ADS_CFG3_PD_BIAS;
-  return writeReg(ADS_REG_CONFIG3, cfg3);
+  return updateBits_(ADS_REG_CONFIG3, ADS_CFG3_BIASREF_INT, enInt ? ADS_CFG3_BIASREF_INT : 0);
 }
 
-bool ADS1299Plus::routeBiasSense(bool en)
+bool ADS1299Core::enableBiasBuffer(bool en)
 {
-  uint8_t cfg3;
-  if (!readReg(ADS_REG_CONFIG3, cfg3))
-    return false;
-  if (en)
-    cfg3 |= ADS_CFG3_BIAS_LOFF_SENS;
-  else
-    cfg3 &= ~ADS_CFG3_BIAS_LOFF_SENS;
-  return writeReg(ADS_REG_CONFIG3, cfg3);
+  return updateBits_(ADS_REG_CONFIG3, ADS_CFG3_PD_BIAS, en ? ADS_CFG3_PD_BIAS : 0);
 }
 
-bool ADS1299Plus::enableBiasMeasure(bool en)
+bool ADS1299Core::routeBiasSense(bool en)
 {
-  uint8_t cfg3;
-  if (!readReg(ADS_REG_CONFIG3, cfg3))
-    return false;
-  if (en)
-    cfg3 |= ADS_CFG3_BIAS_MEAS;
-  else
-    cfg3 &= ~ADS_CFG3_BIAS_MEAS;
-  return writeReg(ADS_REG_CONFIG3, cfg3);
+  return updateBits_(ADS_REG_CONFIG3, ADS_CFG3_BIAS_LOFF_SENS, en ? ADS_CFG3_BIAS_LOFF_SENS : 0);
 }
 
-bool ADS1299Plus::configureLeadOff(uint8_t loffByte)
+bool ADS1299Core::enableBiasMeasure(bool en)
 {
-  return writeReg(ADS_REG_LOFF, loffByte);
+  return updateBits_(ADS_REG_CONFIG3, ADS_CFG3_BIAS_MEAS, en ? ADS_CFG3_BIAS_MEAS : 0);
 }
 
-bool ADS1299Plus::enableLeadOffSenseP(uint8_t chMask)
+bool ADS1299Core::configureLeadOff(uint8_t loffByte)
 {
-  return writeReg(ADS_REG_LOFF_SENSP, chMask);
+  return stage_(ADS_REG_LOFF, loffByte, false);
 }
 
-bool ADS1299Plus::enableLeadOffSenseN(uint8_t chMask)
+bool ADS1299Core::enableLeadOffSenseP(uint8_t chMask)
 {
-  return writeReg(ADS_REG_LOFF_SENSN, chMask);
+  return stage_(ADS_REG_LOFF_SENSP, chMask, false);
 }
 
-bool ADS1299Plus::setLeadOffFlip(uint8_t chMask)
+bool ADS1299Core::enableLeadOffSenseN(uint8_t chMask)
 {
-  return writeReg(ADS_REG_LOFF_FLIP, chMask);
+  return stage_(ADS_REG_LOFF_SENSN, chMask, false);
 }
 
-bool ADS1299Plus::setSingleShot(bool singleShot)
+bool ADS1299Core::setLeadOffFlip(uint8_t chMask)
 {
-  uint8_t cfg4;
-  if (!readReg(ADS_REG_CONFIG4, cfg4))
-    return false;
-  if (singleShot)
-    cfg4 |= ADS_CFG4_SINGLE_SHOT;
-  else
-    cfg4 &= ~ADS_CFG4_SINGLE_SHOT;
-  return writeReg(ADS_REG_CONFIG4, cfg4);
+  return stage_(ADS_REG_LOFF_FLIP, chMask, false);
 }
 
-bool ADS1299Plus::enableLoffComparators(bool en)
+bool ADS1299Core::setSingleShot(bool singleShot)
 {
-  uint8_t cfg4;
-  if (!readReg(ADS_REG_CONFIG4, cfg4))
-    return false;
-  if (en)
-    cfg4 &= ~ADS_CFG4_PD_LOFF_COMP;
-  else
-    cfg4 |= ADS_CFG4_PD_LOFF_COMP;
-  return writeReg(ADS_REG_CONFIG4, cfg4);
+  return updateBits_(ADS_REG_CONFIG4, ADS_CFG4_SINGLE_SHOT, singleShot ? ADS_CFG4_SINGLE_SHOT : 0);
 }
 
-bool ADS1299Plus::setBiasDeriveP(uint8_t chMask)
+bool ADS1299Core::enableLoffComparators(bool en)
 {
-  return writeReg(ADS_REG_BIAS_SENSP, chMask);
+  // PD_LOFF_COMP = 1 enciende los comparadores (9.6.1.17)
+  return updateBits_(ADS_REG_CONFIG4, ADS_CFG4_PD_LOFF_COMP, en ? ADS_CFG4_PD_LOFF_COMP : 0);
 }
 
-bool ADS1299Plus::setBiasDeriveN(uint8_t chMask)
+bool ADS1299Core::setBiasDeriveP(uint8_t chMask)
 {
-  return writeReg(ADS_REG_BIAS_SENSN, chMask);
+  return stage_(ADS_REG_BIAS_SENSP, chMask, false);
 }
 
-// ---- Lectura de frames ----
-bool ADS1299Plus::readFrameRDATAC(uint32_t &status24, int32_t chOut[NUM_CHANNELS])
+bool ADS1299Core::setBiasDeriveN(uint8_t chMask)
+{
+  return stage_(ADS_REG_BIAS_SENSN, chMask, false);
+}
+
+// ---- Recuperación de sincronía ----
+bool ADS1299Core::trackSync(bool ok)
 {
-  if (!rdatacActive_)
+  if (ok)
+  {
+    sync_run_ = 0;
+    return false;
+  }
+  if (++sync_run_ < sync_limit_)
     return false;
+  sync_run_ = 0;
+  return true;
+}
 
-  uint8_t rxBuf[3 + 3 * NUM_CHANNELS];
-  spi_.select();
-  for (int i = 0; i < (int)sizeof(rxBuf); ++i)
+bool ADS1299Core::shadowMatches_(const uint8_t *rb) const
+{
+  for (uint8_t addr = 0; addr < NUM_REGS; ++addr)
   {
-    rxBuf[i] = spi_.xfer(0x00);
+    if (dirty_ & (1UL << addr))
+      continue;
+    if ((rb[addr] ^ shadow_[addr]) & ADS_PROFILE_VERIFY_MASK(addr))
+      return false;
   }
-  spi_.deselect();
+  return true;
+}
 
-  // Desempaquetar status (primeros 3 bytes)
-  status24 = ((uint32_t)rxBuf[0] << 16) | ((uint32_t)rxBuf[1] << 8) | rxBuf[2];
+uint8_t ADS1299Core::recoverSync()
+{
+  sync_run_ = 0;
+  if (!shadowValid_)
+    return SYNC_FAILED;
+  const bool rdatac = rdatacActive_;
+  const bool start = converting_;
 
-  // Desempaquetar canales (3 bytes por canal)
-  for (int i = 0; i < NUM_CHANNELS; ++i)
+  // RREG se ignora en RDATAC (9.5.3.10); SDATAC no para la conversión
+  cmdSDATAC();
+  uint8_t rb[NUM_REGS];
+  for (uint8_t i = 0; i < 2; ++i)
   {
-    chOut[i] = unpack24(&rxBuf[3 + 3 * i]);
+    if (readBurst_(ADS_REG_ID, rb, NUM_REGS) && shadowMatches_(rb))
+    {
+      if (rdatac)
+        cmdRDATAC();
+      return SYNC_RESYNCED;
+    }
   }
 
-  return statusHasSync(status24);
+  // Registros corruptos: RESET (el chip vuelve a valores por defecto y en
+  // RDATAC, 9.5.3.4) y la caché, pendientes incluidos, de vuelta en una ráfaga
+  cmdReset();
+  cmdStop();
+  cmdSDATAC();
+  bool ok = writeBurst_(ADS1299_PROFILE_FIRST, &shadow_[ADS1299_PROFILE_FIRST], ADS1299_PROFILE_LEN);
+  dirty_ = 0;
+  ok = ok && readBurst_(ADS_REG_ID, rb, NUM_REGS) && shadowMatches_(rb);
+
+  if (rdatac)
+    cmdRDATAC();
+  if (start)
+    cmdStart();
+  return ok ? SYNC_RESTORED : SYNC_FAILED;
 }
 
-bool ADS1299Plus::readDataOnDemand(uint32_t &status24, int32_t chOut[NUM_CHANNELS])
+// ---- Lectura de frames ----
+bool ADS1299Core::readFrameBytes_(uint8_t *rx, uint8_t n, bool onDemand)
 {
-  cmdRDATA();
+  if (onDemand)
+    cmdRDATA();
 
-  uint8_t rxBuf[3 + 3 * NUM_CHANNELS];
   spi_.select();
-  for (int i = 0; i < (int)sizeof(rxBuf); ++i)
-  {
-    rxBuf[i] = spi_.xfer(0x00);
-  }
+  spi_.readBlock(rx, n);
   spi_.deselect();
+  return true;
+}
 
-  status24 = ((uint32_t)rxBuf[0] << 16) | ((uint32_t)rxBuf[1] << 8) | rxBuf[2];
+bool ADS1299Core::beginFrameBytes_(uint8_t *rx, uint8_t n)
+{
+  spi_.select();
+  spi_.startRead(rx, n);
+  return true;
+}
 
-  for (int i = 0; i < NUM_CHANNELS; ++i)
-  {
-    chOut[i] = unpack24(&rxBuf[3 + 3 * i]);
-  }
+bool ADS1299Core::frameBytesBusy_()
+{
+  return spi_.readBusy();
+}
 
-  return statusHasSync(status24);
+void ADS1299Core::endFrameBytes_()
+{
+  spi_.waitRead();
+  spi_.deselect();
 }
 
-bool ADS1299Plus::readDeviceID(uint8_t &id)
+bool ADS1299Core::readDeviceID(uint8_t &id)
 {
   return readReg(ADS_REG_ID, id);
 }
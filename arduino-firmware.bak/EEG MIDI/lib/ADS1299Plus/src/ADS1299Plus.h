@@ -12,19 +12,37 @@
 //
 // Esta cabecera solo declara la API y utilidades inline. La implementación
 // de SPI y temporizaciones vivirá en ADS1299_SafeSPI.* y ADS1299Plus.cpp
+//
+// Nº de canales: ADS1299Plus = ADS1299PlusT<ADS1299_NUM_CHANNELS, ADS1299_NUM_DEVICES>
+// (4 canales y 1 dispositivo por defecto; p.ej. -DADS1299_NUM_CHANNELS=8 en
+// build_flags para un ADS1299-8, -DADS1299_NUM_DEVICES=2..4 para daisy-chain).
+// ADS1299Core contiene todo lo que no depende del nº de canales (registros,
+// comandos, perfiles); ADS1299PlusT<N> añade la lectura de frames con el
+// desempaquetado desenrollado en compilación para exactamente N canales.
 
 #pragma once
 #include <Arduino.h>
 #include "ADS1299_Registers.h"
+#include "ADS1299_Profiles.h"
+
+#ifndef ADS1299_NUM_CHANNELS
+#define ADS1299_NUM_CHANNELS 4   // canales por dispositivo
+#endif
+#ifndef ADS1299_NUM_DEVICES
+#define ADS1299_NUM_DEVICES 1    // ADS1299 en daisy-chain (un solo CS y DRDY)
+#endif
 
 // Forward-declaration del wrapper SPI seguro que crearemos a continuación.
 class ADS1299_SafeSPI;
 
-class ADS1299Plus {
+class ADS1299Core {
 public:
   // ----- Constantes del dispositivo -----
-  static constexpr uint8_t  NUM_CHANNELS = 4;
-  static constexpr uint16_t BYTES_PER_FRAME_8CH = 3 /*status*/ + 3*NUM_CHANNELS;
+  // Registros CHnSET presentes en el mapa (9.6.1.6), con independencia de
+  // cuántos canales se adquieran
+  static constexpr uint8_t  NUM_CHSET_REGS = 8;
+  // Tamaño del mapa de registros (0x00 ID .. 0x17 CONFIG4)
+  static constexpr uint8_t  NUM_REGS = ADS_REG_CONFIG4 + 1;
 
   // ----- Estructura de pines para claridad -----
   struct Pins {
@@ -62,7 +80,10 @@ public:
 
 public:
   // ----- Construcción -----
-  ADS1299Plus(ADS1299_SafeSPI& spi, const Pins& pins);
+  // expectedChannels: canales por dispositivo con los que se compiló el
+  // firmware; begin() falla si el registro ID indica otro número (9.6.1.1,
+  // NU_CH). numDevices > 1: cadena daisy-chain (CONFIG1.DAISY_EN = 0).
+  ADS1299Core(ADS1299_SafeSPI& spi, const Pins& pins, uint8_t expectedChannels, uint8_t numDevices);
 
   // ----- Ciclo de vida -----
   // 11.1 Power-Up Sequencing + 9.4/9.5 (resets, delays, etc.)
@@ -77,6 +98,13 @@ public:
   // Para liberar pines/ISR si procede
   void end();
 
+  // ----- Perfiles de registros (ADS1299_Profiles.h) -----
+  // Escriben CONFIG1..CONFIG4 en una sola ráfaga, releen en otra y comparan
+  // con la imagen (ADS_PROFILE_VERIFY_MASK). Devuelven false si no coincide.
+  // Si RDATAC estaba activo se sale y se vuelve a entrar.
+  bool applyProfile(uint8_t profileId);                  // ADS_PROFILE_*
+  bool applyRegisterImage(const uint8_t img[ADS1299_PROFILE_LEN]);
+
   // ----- Comandos SPI (9.5.3.x) -----
   void cmdWakeup();     // 0x02
   void cmdStandby();    // 0x04
@@ -96,10 +124,24 @@ public:
   bool writeRegs(uint8_t startAddr, const uint8_t* data, size_t n);
   bool readRegs (uint8_t startAddr,       uint8_t* data, size_t n);
 
+  // ----- Caché de registros (shadow) -----
+  // begin() lee todo el mapa en una ráfaga; a partir de ahí los setters
+  // calculan el nuevo byte sobre la caché (sin RREG previo) y un setter que
+  // no cambia nada no genera tráfico SPI.
+  // Por defecto cada setter escribe al momento. Entre beginUpdate() y
+  // commitRegs() solo marcan registros sucios, y commitRegs() los escribe en
+  // ráfagas contiguas (p.ej. ganancia de los 8 canales = un solo WREG).
+  // Las escrituras salen de RDATAC (SDATAC) y vuelven a entrar si hacía falta.
+  bool syncShadow();                                   // RREG de todo el mapa
+  uint8_t shadowReg(uint8_t addr) const { return addr < NUM_REGS ? shadow_[addr] : 0; }
+  void beginUpdate() { deferred_ = true; }
+  bool commitRegs();
+  bool hasPendingRegs() const { return dirty_ != 0; }
+
   // Helpers de alto nivel para mapear 9.6:
   bool setDataRate(uint8_t dr3b);                      // CONFIG1.DR[2:0]
   bool setClockOut(bool enable);                       // CONFIG1.CLK_EN
-  bool setDaisyEnable(bool enable);                    // CONFIG1.DAISY_EN
+  bool setDaisyEnable(bool enable);                    // CONFIG1.DAISY_EN (enable => bit=0)
 
   bool setChannel(uint8_t ch, uint8_t chsetByte);      // CHnSET n=[1..8]
   bool powerDownChannel(uint8_t ch, bool pd);
@@ -122,19 +164,16 @@ public:
   bool enableLeadOffSenseN(uint8_t chMask);            // 9.6.1.10
   bool setLeadOffFlip(uint8_t chMask);                 // 9.6.1.11
   bool setSingleShot(bool singleShot);                 // CONFIG4.SINGLE_SHOT
-  bool enableLoffComparators(bool en);                 // CONFIG4.PD_LOFF_COMP (en=true => bit=0)
+  bool enableLoffComparators(bool en);                 // CONFIG4.PD_LOFF_COMP (en=true => bit=1)
 
   // BIAS derivation (no usado por defecto, pero expuesto):
   bool setBiasDeriveP(uint8_t chMask);                 // BIAS_SENSP
   bool setBiasDeriveN(uint8_t chMask);                 // BIAS_SENSN
 
   // ----- Adquisición -----
-  // Lee un frame completo en RDATAC: 24b STATUS + 4×24b canales.
-  // Devuelve false si el patrón de sync (1100) no coincide.
-  bool readFrameRDATAC(uint32_t& status24, int32_t chOut[NUM_CHANNELS]);
-
-  // Lee “on demand” tras RDATA (igual formato que RDATAC).
-  bool readDataOnDemand(uint32_t& status24, int32_t chOut[NUM_CHANNELS]);
+  // Canales indicados por el registro ID tras begin() (4/6/8)
+  uint8_t detectedChannels() const { return num_channels_; }
+  bool rdatacActive() const { return rdatacActive_; }
 
   // Decodificadores de STATUS (9.4.4.2)
   static inline bool statusHasSync(uint32_t s) {
@@ -144,6 +183,31 @@ public:
   static inline uint8_t statusLoffN(uint32_t s) { return ADS_STATUS_LOFFN(s); }
   static inline uint8_t statusGPIO (uint32_t s) { return ADS_STATUS_GPIO4_1(s); }
 
+  // ----- Recuperación de sincronía -----
+  // Un frame suelto sin el patrón 1100 es ruido en DOUT; varios seguidos, que
+  // la lectura perdió la alineación (bytes perdidos, brownout) o que el chip
+  // se reinició. trackSync() cuenta los frames malos seguidos (uno bueno
+  // reinicia la cuenta) y devuelve true al llegar a syncLossLimit(): toca
+  // recoverSync(). Esta hace el ciclo mínimo SDATAC → una ráfaga RREG de todo
+  // el mapa comparada con la caché (ADS_PROFILE_VERIFY_MASK) → RDATAC, sin
+  // begin() ni configureDefaults(). Solo si dos relecturas no coinciden (un
+  // bit erróneo en DOUT no basta) emite RESET, reescribe la caché, la
+  // verifica y vuelve a RDATAC/START como estaba. Con daisy-chain la
+  // relectura solo ve el primer dispositivo. La ISR no debe leer frames
+  // mientras tanto.
+  enum SyncRecovery : uint8_t {
+    SYNC_RESYNCED = 0,  // registros intactos: solo SDATAC/RDATAC
+    SYNC_RESTORED = 1,  // registros corruptos: RESET y caché reescrita
+    SYNC_FAILED   = 2,  // sin caché o la relectura sigue sin coincidir
+  };
+  bool trackSync(bool ok);
+  void setSyncLossLimit(uint8_t n) { sync_limit_ = n ? n : 1; }
+  uint8_t syncLossLimit() const { return sync_limit_; }
+  uint8_t syncLossRun() const { return sync_run_; }  // frames malos seguidos
+  uint8_t recoverSync();
+  // true entre cmdStart()/pinStartHigh() y cmdStop()/pinStartLow()/cmdReset()
+  bool converting() const { return converting_; }
+
   // ----- Utilidades -----
   // Convierte 3 bytes MSB-first en entero con signo (24 bits -> 32 bits)
   static inline int32_t unpack24(const uint8_t b[3]) {
@@ -162,6 +226,15 @@ public:
   void pinResetPulse();     // ≥2 tCLK (según 9.4.2/11.1 – lo implementamos en .cpp)
   void pinPowerDown(bool activeLow);
 
+protected:
+  // Lee n bytes crudos de frame (STATUS + canales) en un solo ciclo de CS.
+  // onDemand: emite antes RDATA (fuera de RDATAC).
+  bool readFrameBytes_(uint8_t* rx, uint8_t n, bool onDemand);
+  // Lectura de frame en dos fases (DMA): CS bajo + startRead / espera + CS alto
+  bool beginFrameBytes_(uint8_t* rx, uint8_t n);
+  bool frameBytesBusy_();
+  void endFrameBytes_();
+
 private:
   // Helpers internos
   bool writeOne_(uint8_t addr, uint8_t val);
@@ -170,8 +243,22 @@ private:
   bool writeBurst_(uint8_t startAddr, const uint8_t* data, size_t n);
   bool readBurst_ (uint8_t startAddr,       uint8_t* data, size_t n);
 
-  // Comprobación y normalización de índices [1..8]
-  static inline bool validCh_(uint8_t ch) { return ch>=1 && ch<=NUM_CHANNELS; }
+  // Compara la imagen con una relectura (tras applyRegisterImage)
+  static bool imageMatches_(const uint8_t* img, const uint8_t* rb);
+  // Compara una relectura de todo el mapa con la caché (sin los sucios)
+  bool shadowMatches_(const uint8_t* rb) const;
+
+  // Caché: fija el valor de un registro (escribe ya o lo deja sucio en modo
+  // diferido) y modifica solo los bits de mask
+  bool stage_(uint8_t addr, uint8_t val, bool force);
+  bool updateBits_(uint8_t addr, uint8_t mask, uint8_t bits);
+  // ID y LOFF_STATP/N son de solo lectura
+  static inline bool writable_(uint8_t addr) {
+    return addr != ADS_REG_ID && addr != ADS_REG_LOFF_STATP && addr != ADS_REG_LOFF_STATN && addr < NUM_REGS;
+  }
+
+  // Comprobación y normalización de índices [1..8] (registros CHnSET)
+  static inline bool validCh_(uint8_t ch) { return ch>=1 && ch<=NUM_CHSET_REGS; }
   static inline uint8_t chRegAddr_(uint8_t ch) { return ADS_REG_CH1SET + (ch-1); }
 
   // Construcción de CHnSET a partir de sus campos (9.6.1.6)
@@ -183,6 +270,197 @@ private:
   ADS1299_SafeSPI& spi_;  // transporte SPI con guardas de timing (tSDECODE, etc.)
   Pins pins_;
   bool rdatacActive_ = false;
-  // Número de canales detectado (4/6/8) — inicializa al máximo soportado
-  uint8_t num_channels_ = NUM_CHANNELS;
+  bool converting_ = false;
+  // Frames sin sync seguidos y umbral de recoverSync()
+  uint8_t sync_run_ = 0;
+  uint8_t sync_limit_ = 3;
+  // Dispositivos en la cadena (1 = sin daisy-chain)
+  uint8_t num_devices_;
+  // Canales esperados (plantilla) y detectados en el ID (4/6/8)
+  uint8_t expected_channels_;
+  uint8_t num_channels_;
+
+  // Copia del mapa de registros y bits sucios (bit n = registro n)
+  uint8_t  shadow_[NUM_REGS] = {};
+  uint32_t dirty_ = 0;
+  bool     shadowValid_ = false;
+  bool     deferred_ = false;
+};
+
+// ---- Desempaquetado desenrollado: canal I..N-1 ----
+template <uint8_t I, uint8_t N>
+struct ADS1299_Unpack {
+  static inline void run(const uint8_t* b, int32_t* out) {
+    out[I] = ADS1299Core::unpack24(&b[3 * I]);
+    ADS1299_Unpack<I + 1, N>::run(b, out);
+  }
+};
+template <uint8_t N>
+struct ADS1299_Unpack<N, N> {
+  static inline void run(const uint8_t*, int32_t*) {}
+};
+
+// ---- Demultiplexado de la cadena: dispositivo I..D-1 ----
+// Cada dispositivo aporta [STATUS 3B][N × 3B]; el primero en salir es el
+// conectado a DOUT del MCU. Devuelve true si todos traen el sync (1100).
+template <uint8_t I, uint8_t D, uint8_t N>
+struct ADS1299_Demux {
+  static inline bool run(const uint8_t* b, uint32_t* status, int32_t* ch) {
+    status[I] = ((uint32_t)b[0] << 16) | ((uint32_t)b[1] << 8) | b[2];
+    ADS1299_Unpack<0, N>::run(&b[3], &ch[I * N]);
+    bool ok = ADS1299Core::statusHasSync(status[I]);
+    return ADS1299_Demux<I + 1, D, N>::run(&b[3 + 3 * N], status, ch) && ok;
+  }
+};
+template <uint8_t D, uint8_t N>
+struct ADS1299_Demux<D, D, N> {
+  static inline bool run(const uint8_t*, uint32_t*, int32_t*) { return true; }
+};
+
+// N = canales por dispositivo, D = dispositivos en daisy-chain.
+// Todo el frame de la cadena se lee en una sola ráfaga con CS bajo por DRDY
+// (se usa el DRDY del primer dispositivo; START y CLK son comunes).
+template <uint8_t N, uint8_t D = 1>
+class ADS1299PlusT : public ADS1299Core {
+  static_assert(N == 4 || N == 6 || N == 8, "ADS1299PlusT: N debe ser 4, 6 u 8");
+  static_assert(D >= 1 && D <= 4, "ADS1299PlusT: D debe estar en [1..4]");
+
+public:
+  static constexpr uint8_t  CHANNELS_PER_DEVICE = N;
+  static constexpr uint8_t  NUM_DEVICES = D;
+  static constexpr uint8_t  NUM_CHANNELS = N * D;          // array de canales contiguo
+  static constexpr uint16_t BYTES_PER_DEVICE = 3 /*status*/ + 3 * N;
+  static constexpr uint16_t BYTES_PER_FRAME = BYTES_PER_DEVICE * D;
+  // Máscara de canales con toda la cadena activa (bit d·N + i)
+  static constexpr uint32_t ALL_CHANNELS =
+      NUM_CHANNELS >= 32 ? 0xFFFFFFFFUL : (1UL << NUM_CHANNELS) - 1;
+
+  ADS1299PlusT(ADS1299_SafeSPI& spi, const Pins& pins) : ADS1299Core(spi, pins, N, D) {
+    for (uint8_t c = 0; c < NUM_CHANNELS; ++c)
+      active_[c] = c;
+  }
+
+  // Lee un frame completo en RDATAC: por dispositivo 24b STATUS + N×24b canales.
+  // statusOut[d] = STATUS del dispositivo d (lead-off P/N y GPIO propios),
+  // chOut[d*N + i] = canal i del dispositivo d.
+  // Devuelve false si el patrón de sync (1100) no coincide en alguno.
+  inline bool readFrameRDATAC(uint32_t statusOut[D], int32_t chOut[N * D]) {
+    if (!rdatacActive())
+      return false;
+    return readAndDemux_(statusOut, chOut, false);
+  }
+
+  // Lee “on demand” tras RDATA (igual formato que RDATAC).
+  inline bool readDataOnDemand(uint32_t statusOut[D], int32_t chOut[N * D]) {
+    return readAndDemux_(statusOut, chOut, true);
+  }
+
+  // Forma de un solo dispositivo (STATUS por referencia)
+  inline bool readFrameRDATAC(uint32_t& status24, int32_t chOut[N * D]) {
+    static_assert(D == 1, "readFrameRDATAC(uint32_t&): usar la forma con array de STATUS");
+    return readFrameRDATAC(&status24, chOut);
+  }
+  inline bool readDataOnDemand(uint32_t& status24, int32_t chOut[N * D]) {
+    static_assert(D == 1, "readDataOnDemand(uint32_t&): usar la forma con array de STATUS");
+    return readDataOnDemand(&status24, chOut);
+  }
+
+  // ---- Frame crudo: lectura en la ISR, desempaquetado fuera ----
+  // Bytes tal cual salen de DOUT (BYTES_PER_FRAME); decodeFrame() los
+  // convierte después, con el mismo resultado que readFrameRDATAC().
+  // Con setActiveChannels() solo se leen los frameBytes() primeros bytes.
+  inline bool readFrameRawRDATAC(uint8_t raw[BYTES_PER_FRAME]) {
+    if (!rdatacActive())
+      return false;
+    return readFrameBytes_(raw, frameBytes_, false);
+  }
+  // Igual en dos fases: beginFrameRead() baja CS y lanza la transferencia
+  // (DMA si ADS1299_SPI_DMA); endFrameRead() espera y sube CS. Entre ambas
+  // el bus está ocupado y raw no es válido (frameReadBusy() para sondear).
+  inline bool beginFrameRead(uint8_t raw[BYTES_PER_FRAME]) {
+    if (!rdatacActive())
+      return false;
+    return beginFrameBytes_(raw, frameBytes_);
+  }
+  inline bool frameReadBusy() { return frameBytesBusy_(); }
+  inline void endFrameRead() { endFrameBytes_(); }
+
+  static inline bool decodeFrame(const uint8_t raw[BYTES_PER_FRAME],
+                                 uint32_t statusOut[D], int32_t chOut[N * D]) {
+    return ADS1299_Demux<0, D, N>::run(raw, statusOut, chOut);
+  }
+
+  // ---- Canales activos ----
+  // mask: bit d·N + i = canal i del dispositivo d (por defecto todos). Los
+  // frames crudos se leen solo hasta el último canal activo de la cadena: el
+  // ADS1299 saca STATUS y canales en orden y subir CS corta la ráfaga sin
+  // afectar a la conversión siguiente (los STATUS de todos los dispositivos
+  // se leen siempre). Cambiarla solo con la lectura de frames parada: la ISR
+  // usa frameBytes(). Los canales apagados por CHnSET.PD (powerDownChannel)
+  // siguen ocupando su sitio en el frame del chip; esto es lo que se lee.
+  bool setActiveChannels(uint32_t mask) {
+    if (mask == 0 || (mask & ~ALL_CHANNELS) != 0)
+      return false;
+    uint8_t n = 0, last = 0;
+    for (uint8_t c = 0; c < NUM_CHANNELS; ++c) {
+      if (mask & (1UL << c)) {
+        active_[n++] = c;
+        last = c;
+      }
+    }
+    activeMask_ = mask;
+    nActive_ = n;
+    uint16_t bytes = (uint16_t)(BYTES_PER_DEVICE * (last / N) + 3 + 3 * (last % N + 1));
+    uint16_t minBytes = (uint16_t)(BYTES_PER_DEVICE * (D - 1) + 3); // STATUS del último
+    frameBytes_ = bytes > minBytes ? bytes : minBytes;
+    return true;
+  }
+  uint32_t activeChannels() const { return activeMask_; }
+  uint8_t activeCount() const { return nActive_; }
+  // Bytes de cada lectura de frame (BYTES_PER_FRAME con todos los canales)
+  uint16_t frameBytes() const { return frameBytes_; }
+
+  // Como decodeFrame(), pero con los canales activos compactos en chOut
+  // (activeCount() valores, en orden de la cadena). Vale para los frames
+  // leídos con la máscara actual.
+  inline bool decodeActive(const uint8_t raw[BYTES_PER_FRAME], uint32_t statusOut[D],
+                           int32_t* chOut) const {
+    if (nActive_ == NUM_CHANNELS)
+      return decodeFrame(raw, statusOut, chOut);
+    bool ok = true;
+    for (uint8_t d = 0; d < D; ++d) {
+      const uint8_t* b = &raw[BYTES_PER_DEVICE * d];
+      statusOut[d] = ((uint32_t)b[0] << 16) | ((uint32_t)b[1] << 8) | b[2];
+      ok = statusHasSync(statusOut[d]) && ok;
+    }
+    for (uint8_t k = 0; k < nActive_; ++k) {
+      uint8_t c = active_[k];
+      chOut[k] = unpack24(&raw[BYTES_PER_DEVICE * (c / N) + 3 + 3 * (c % N)]);
+    }
+    return ok;
+  }
+
+  // Posición de cada canal activo en la cadena
+  uint8_t activeIndex(uint8_t k) const { return active_[k]; }
+
+private:
+  uint32_t activeMask_ = ALL_CHANNELS;
+  uint8_t  nActive_ = NUM_CHANNELS;
+  uint16_t frameBytes_ = BYTES_PER_FRAME;
+  uint8_t  active_[NUM_CHANNELS];
+
+  inline bool readAndDemux_(uint32_t* statusOut, int32_t* chOut, bool onDemand) {
+    uint8_t rxBuf[BYTES_PER_FRAME];
+    readFrameBytes_(rxBuf, BYTES_PER_FRAME, onDemand);
+    return decodeFrame(rxBuf, statusOut, chOut);
+  }
 };
+
+template <uint8_t N, uint8_t D> constexpr uint8_t ADS1299PlusT<N, D>::CHANNELS_PER_DEVICE;
+template <uint8_t N, uint8_t D> constexpr uint8_t ADS1299PlusT<N, D>::NUM_DEVICES;
+template <uint8_t N, uint8_t D> constexpr uint8_t ADS1299PlusT<N, D>::NUM_CHANNELS;
+template <uint8_t N, uint8_t D> constexpr uint16_t ADS1299PlusT<N, D>::BYTES_PER_DEVICE;
+template <uint8_t N, uint8_t D> constexpr uint16_t ADS1299PlusT<N, D>::BYTES_PER_FRAME;
+template <uint8_t N, uint8_t D> constexpr uint32_t ADS1299PlusT<N, D>::ALL_CHANNELS;
+
+using ADS1299Plus = ADS1299PlusT<ADS1299_NUM_CHANNELS, ADS1299_NUM_DEVICES>;
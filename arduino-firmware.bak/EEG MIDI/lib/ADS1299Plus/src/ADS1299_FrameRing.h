@@ -0,0 +1,64 @@
+// ADS1299_FrameRing.h
+// Cola circular lock-free de un productor / un consumidor (SPSC) para frames.
+// Pensada para que la ISR de DRDY (productor) deposite frames y el loop()
+// (consumidor) los vacíe hacia el transporte sin secciones críticas.
+//
+// - N debe ser potencia de 2 (índices libres de 8 bits, máscara N-1).
+// - head_ solo lo escribe el productor y tail_ solo el consumidor; ambos son
+//   de 1 byte, así que su lectura/escritura es atómica incluso en AVR.
+// - Asume productor y consumidor en el mismo núcleo (ISR + loop); la barrera
+//   de compilador basta para que los datos del slot se escriban antes de
+//   publicar el índice.
+
+#pragma once
+#include <stdint.h>
+
+template <typename T, uint8_t N>
+class ADS1299_FrameRing {
+  static_assert(N >= 2 && N <= 128 && (N & (N - 1)) == 0,
+                "ADS1299_FrameRing: N debe ser potencia de 2 en [2..128]");
+
+public:
+  static constexpr uint8_t CAPACITY = N;
+
+  // ----- Lado productor (ISR) -----
+  // Devuelve el slot libre a rellenar, o nullptr si la cola está llena.
+  inline T* beginWrite() {
+    uint8_t h = head_;
+    if ((uint8_t)(h - tail_) >= N) return nullptr;
+    return &buf_[h & (N - 1)];
+  }
+  // Publica el slot obtenido con beginWrite().
+  inline void commitWrite() {
+    barrier_();
+    head_ = (uint8_t)(head_ + 1);
+  }
+
+  // ----- Lado consumidor (loop) -----
+  // Devuelve el frame más antiguo sin retirarlo, o nullptr si está vacía.
+  inline const T* peek() const {
+    uint8_t t = tail_;
+    if (head_ == t) return nullptr;
+    barrier_();
+    return &buf_[t & (N - 1)];
+  }
+  // Retira el frame devuelto por peek().
+  inline void pop() {
+    barrier_();
+    tail_ = (uint8_t)(tail_ + 1);
+  }
+
+  // Nº de frames pendientes (instantánea; válido desde cualquier lado)
+  inline uint8_t size() const { return (uint8_t)(head_ - tail_); }
+  inline bool empty() const { return head_ == tail_; }
+
+  // Solo con el productor detenido (ISR desenganchada)
+  inline void clear() { tail_ = head_; }
+
+private:
+  static inline void barrier_() { __asm__ __volatile__("" ::: "memory"); }
+
+  T buf_[N];
+  volatile uint8_t head_ = 0;
+  volatile uint8_t tail_ = 0;
+};
@@ -0,0 +1,56 @@
+// ADS1299_Profiles.cpp
+
+#include "ADS1299_Profiles.h"
+#include "ADS1299Plus.h"
+
+static constexpr uint8_t kActive = ADS1299_NUM_CHANNELS;
+
+// Canal EEG normal: ON, GAIN=24, entrada diferencial, sin SRB2
+static constexpr uint8_t kChEEG =
+  ADS_CH_MAKE(true, ADS_GAIN_24, ADS_MUX_NORMAL, false);
+// Canal con la señal de test interna
+static constexpr uint8_t kChTest =
+  ADS_CH_MAKE(true, ADS_GAIN_1, ADS_MUX_TESTSIG, false);
+// Canal con entradas en corto
+static constexpr uint8_t kChShort =
+  ADS_CH_MAKE(true, ADS_GAIN_24, ADS_MUX_SHORT, false);
+
+// CONFIG2 con señal de test interna: 2× (±3.75 mV), fCLK/2^21 (~1 Hz)
+static constexpr uint8_t kCfg2Test =
+  ADS_CFG2_MAKE(true, true, ADS_CALF_CLK_2_21);
+
+// CONFIG4 continuo, comparadores de lead-off apagados
+static constexpr uint8_t kCfg4NoLoff = ADS_CFG4_CONT_CONV;
+
+constexpr ADS1299_Profile ADS1299_PROFILES[ADS_PROFILE_COUNT] PROGMEM = {
+  // ADS_PROFILE_EEG_250_G24
+  ADS_PROFILE_IMAGE(ADS_CFG1_250SPS, ADS_CFG2_TEST_OFF, ADS_CFG3_INTREF_NO_BIAS,
+                    ADS_LOFF_DCAC_24nA_31Hz_80pct, kChEEG, kActive,
+                    0x00, 0x00, 0x00, 0x00, 0x00,
+                    ADS_GPIO_ALL_INPUTS, 0x00, kCfg4NoLoff),
+  // ADS_PROFILE_IMPEDANCE
+  ADS_PROFILE_IMAGE(ADS_CFG1_250SPS, ADS_CFG2_TEST_OFF, ADS_CFG3_INTREF_NO_BIAS,
+                    ADS_LOFF_DCAC_24nA_31Hz_80pct, kChEEG, kActive,
+                    0x00, 0x00, ADS_ACTIVE_MASK(kActive), ADS_ACTIVE_MASK(kActive), 0x00,
+                    ADS_GPIO_ALL_INPUTS, 0x00, ADS_CFG4_CONT_LOFF_ON),
+  // ADS_PROFILE_TEST_SIGNAL
+  ADS_PROFILE_IMAGE(ADS_CFG1_250SPS, kCfg2Test, ADS_CFG3_INTREF_NO_BIAS,
+                    ADS_LOFF_DCAC_24nA_31Hz_80pct, kChTest, kActive,
+                    0x00, 0x00, 0x00, 0x00, 0x00,
+                    ADS_GPIO_ALL_INPUTS, 0x00, kCfg4NoLoff),
+  // ADS_PROFILE_INPUT_SHORT
+  ADS_PROFILE_IMAGE(ADS_CFG1_250SPS, ADS_CFG2_TEST_OFF, ADS_CFG3_INTREF_NO_BIAS,
+                    ADS_LOFF_DCAC_24nA_31Hz_80pct, kChShort, kActive,
+                    0x00, 0x00, 0x00, 0x00, 0x00,
+                    ADS_GPIO_ALL_INPUTS, 0x00, kCfg4NoLoff),
+};
+
+// Comprobaciones en compilación sobre las imágenes
+static_assert((ADS1299_PROFILES[ADS_PROFILE_EEG_250_G24].reg[ADS_REG_CONFIG1 - ADS1299_PROFILE_FIRST] & ADS_CFG1_RSVD) == ADS_CFG1_RSVD,
+              "CONFIG1: bits reservados a 1");
+static_assert((ADS1299_PROFILES[ADS_PROFILE_EEG_250_G24].reg[ADS_REG_CONFIG3 - ADS1299_PROFILE_FIRST] & ADS_CFG3_RSVD) == ADS_CFG3_RSVD,
+              "CONFIG3: bits reservados a 1");
+static_assert(ADS1299_PROFILES[ADS_PROFILE_EEG_250_G24].reg[ADS_REG_LOFF_SENSP - ADS1299_PROFILE_FIRST] == 0x00,
+              "El perfil EEG no debe inyectar corriente de lead-off");
+static_assert(ADS1299_PROFILES[ADS_PROFILE_IMPEDANCE].reg[ADS_REG_CH1SET - ADS1299_PROFILE_FIRST] == kChEEG,
+              "Impedancia: CH1 activo");
@@ -0,0 +1,72 @@
+// ADS1299_Profiles.h
+// Perfiles de registros: imágenes constexpr de CONFIG1..CONFIG4 (0x01..0x17)
+// construidas con los ADS_*_MAKE de ADS1299_Registers.h. Se aplican con una
+// sola ráfaga WREG y se verifican con una sola ráfaga RREG
+// (ADS1299Plus::applyProfile / applyRegisterImage), ~0.3 ms a 2 MHz.
+//
+// Las imágenes viven en flash (PROGMEM) para no gastar RAM en AVR.
+
+#pragma once
+#include <Arduino.h>
+#include "ADS1299_Registers.h"
+
+// Rango de la imagen: de CONFIG1 a CONFIG4, ambos incluidos (el ID no se escribe)
+static constexpr uint8_t ADS1299_PROFILE_FIRST = ADS_REG_CONFIG1;
+static constexpr uint8_t ADS1299_PROFILE_LEN   = ADS_REG_CONFIG4 - ADS_REG_CONFIG1 + 1;
+
+struct ADS1299_Profile {
+  uint8_t reg[ADS1299_PROFILE_LEN]; // reg[i] = registro ADS1299_PROFILE_FIRST + i
+};
+
+// Perfiles predefinidos (índice en ADS1299_PROFILES)
+enum : uint8_t {
+  // EEG: 250 SPS, GAIN=24, entradas diferenciales, referencia interna,
+  // sin inyección de corriente de lead-off (no contamina la banda de 31 Hz)
+  ADS_PROFILE_EEG_250_G24 = 0,
+  // Impedancia: igual que EEG con lead-off AC (31.2 Hz, 24 nA) en todos los
+  // canales activos y comparadores encendidos
+  ADS_PROFILE_IMPEDANCE,
+  // Señal de test interna (onda cuadrada ~1 Hz, 2×) en todos los canales
+  ADS_PROFILE_TEST_SIGNAL,
+  // Entradas en corto: mide el ruido propio del front-end
+  ADS_PROFILE_INPUT_SHORT,
+
+  ADS_PROFILE_COUNT
+};
+
+// CHnSET del canal ch (1..8) según cuántos canales están activos
+constexpr uint8_t ADS_CHSET_FOR(uint8_t ch, uint8_t nActive, uint8_t chActive) {
+  return ch <= nActive ? chActive : ADS_CH_UNUSED;
+}
+
+// Máscara de canales activos (bit n-1 = canal n)
+constexpr uint8_t ADS_ACTIVE_MASK(uint8_t nActive) {
+  return nActive >= 8 ? 0xFF : (uint8_t)((1u << nActive) - 1);
+}
+
+// Imagen completa 0x01..0x17. LOFF_STATP/N (solo lectura) y MISC2 (reservado)
+// van a 0; el dispositivo ignora lo escrito en los primeros.
+#define ADS_PROFILE_IMAGE(cfg1, cfg2, cfg3, loff, chActive, nActive,              \
+                          biasP, biasN, loffP, loffN, flip, gpio, misc1, cfg4)     \
+  { {                                                                              \
+    (cfg1), (cfg2), (cfg3), (loff),                                                \
+    ADS_CHSET_FOR(1, nActive, chActive), ADS_CHSET_FOR(2, nActive, chActive),      \
+    ADS_CHSET_FOR(3, nActive, chActive), ADS_CHSET_FOR(4, nActive, chActive),      \
+    ADS_CHSET_FOR(5, nActive, chActive), ADS_CHSET_FOR(6, nActive, chActive),      \
+    ADS_CHSET_FOR(7, nActive, chActive), ADS_CHSET_FOR(8, nActive, chActive),      \
+    (biasP), (biasN), (loffP), (loffN), (flip),                                    \
+    0x00 /*LOFF_STATP*/, 0x00 /*LOFF_STATN*/,                                      \
+    (gpio), (misc1), 0x00 /*MISC2*/, (cfg4)                                        \
+  } }
+
+// Bits que deben coincidir al releer cada registro de la imagen (los de solo
+// lectura o que reflejan pines se excluyen de la verificación)
+constexpr uint8_t ADS_PROFILE_VERIFY_MASK(uint8_t addr) {
+  return (addr == ADS_REG_LOFF_STATP || addr == ADS_REG_LOFF_STATN) ? 0x00
+       : (addr == ADS_REG_CONFIG3) ? (uint8_t)~ADS_CFG3_BIAS_STAT
+       : (addr == ADS_REG_GPIO)    ? 0x0F   // GPIOD de entradas = nivel del pin
+       : 0xFF;
+}
+
+// Tabla de perfiles predefinidos en flash (ADS1299_Profiles.cpp)
+extern const ADS1299_Profile ADS1299_PROFILES[ADS_PROFILE_COUNT] PROGMEM;
@@ -66,10 +66,15 @@ enum : uint8_t {
 //  CONFIG1 (0x01) — 9.6.1.2 // Construye el byte completo para CONFIG1. 
 // EJEMPLO: 
 // --> uint8_t config1 = ADS_CFG1_MAKE(false, false, ADS_DR_250);
-// --> config1 = 0b10000110 = 0x86
-// =========================
-// [7]=1 (fix), [6]=DAISY_EN, [5]=CLK_EN, [2:0]=DR
-#define ADS_CFG1_DAISY_EN    0x40 // Si está en 1, el chip está en modo daisy-chain (permite conectar varios ADS1299 en serie usando un solo bus SPI). //En nuestro diseño no lo usamos (sólo un ADS1299), así que lo dejaremos en 0.
+// --> config1 = 0b11010110 = 0xD6 (reset = 0x96, que es modo daisy-chain)
+// =========================
+// [7]=1 (fix), [6]=DAISY_EN, [5]=CLK_EN, [4:3]=10 (fix), [2:0]=DR
+// DAISY_EN (nombre del datasheet) es activo a nivel bajo:
+//   0 = modo daisy-chain (reset): varios ADS1299 en serie en un solo bus SPI,
+//       DOUT de cada uno entra por DAISY_IN del anterior.
+//   1 = modo multiple readback: un solo dispositivo, el frame puede releerse.
+#define ADS_CFG1_DAISY_EN    0x40
+#define ADS_CFG1_MULTI_READBACK ADS_CFG1_DAISY_EN // alias con la semántica real del bit
 #define ADS_CFG1_CLK_EN      0x20 // Si está en 1, la señal de reloj interno se copia al pin CLK (útil para sincronizar varios dispositivos). En nuestro caso desactivado.
 // DR data rate:  Define los valores válidos de Data Rate (DR bits [2:0]).
 enum : uint8_t {
@@ -82,7 +87,9 @@ enum : uint8_t {
   ADS_DR_250   = 0b110, // recomendado
   // 111 reservado
 };
-#define ADS_CFG1_MAKE(daisy_en, clk_en, dr) (uint8_t)(0x80 | ((daisy_en)?ADS_CFG1_DAISY_EN:0) | ((clk_en)?ADS_CFG1_CLK_EN:0) | ((dr)&0x07))
+#define ADS_CFG1_RSVD        0x90 // bits reservados: deben escribirse como 1 (bit 7) y 10 (bits 4:3)
+// daisy_en=true → bit6=0 (daisy-chain); false → bit6=1 (multiple readback)
+#define ADS_CFG1_MAKE(daisy_en, clk_en, dr) (uint8_t)(ADS_CFG1_RSVD | ((daisy_en)?0:ADS_CFG1_MULTI_READBACK) | ((clk_en)?ADS_CFG1_CLK_EN:0) | ((dr)&0x07))
 
 // =========================
 //  CONFIG2 (0x02) — 9.6.1.3 (Test tone) // Registro pensado para generar señales de prueba.
@@ -114,15 +121,17 @@ enum : uint8_t { // CAL_FREQ Esto configura los bits [1:0] (CAL_FREQ)
   // false   // biasLoffSens → lead-off no por bias
 // );
 // =========================
-// [7]=PD_REFBUF, [4]=BIAS_MEAS, [3]=BIASREF_INT, [2]=PD_BIAS, [1]=BIAS_LOFF_SENS, [0]=BIAS_STAT (R)
+// [7]=PD_REFBUF, [6:5]=11 (fix), [4]=BIAS_MEAS, [3]=BIASREF_INT, [2]=PD_BIAS, [1]=BIAS_LOFF_SENS, [0]=BIAS_STAT (R)
 #define ADS_CFG3_PD_REFBUF     0x80 // Controla el buffer de referencia interna (4.5 V).
 #define ADS_CFG3_BIAS_MEAS     0x10 //Permite medir BIASIN respecto a BIASREF usando el MUX de canal. solo habilita la ruta de medida. Útil para debug.
 #define ADS_CFG3_BIASREF_INT   0x08 //Selecciona la referencia de BIAS: interna (≈ (AVDD+AVSS)/2) o externa (pin BIASREF).
 #define ADS_CFG3_PD_BIAS       0x04 // Controla el amplificador/driver BIAS (salida en BIASOUT).
 #define ADS_CFG3_BIAS_LOFF_SENS 0x02 // Habilita que el sensado de lead-off se haga a través del nodo BIAS (modo alternativo).
+#define ADS_CFG3_RSVD          0x60 // bits reservados: deben escribirse como 1 (reset = 0x60)
+#define ADS_CFG3_BIAS_STAT     0x01 // solo lectura: estado del lead-off de BIAS
 // helper
 #define ADS_CFG3_MAKE(useIntRef, biasMeas, biasRefInt, biasOn, biasLoffSens) \
-  (uint8_t)((useIntRef?ADS_CFG3_PD_REFBUF:0) | (biasMeas?ADS_CFG3_BIAS_MEAS:0) | (biasRefInt?ADS_CFG3_BIASREF_INT:0) | (biasOn?ADS_CFG3_PD_BIAS:0) | (biasLoffSens?ADS_CFG3_BIAS_LOFF_SENS:0))
+  (uint8_t)(ADS_CFG3_RSVD | (useIntRef?ADS_CFG3_PD_REFBUF:0) | (biasMeas?ADS_CFG3_BIAS_MEAS:0) | (biasRefInt?ADS_CFG3_BIASREF_INT:0) | (biasOn?ADS_CFG3_PD_BIAS:0) | (biasLoffSens?ADS_CFG3_BIAS_LOFF_SENS:0))
 
 
 
@@ -237,8 +246,9 @@ inline bool ADS_IsLeadOffN(uint8_t statN, uint8_t ch) {
 // =========================
 //  CONFIG4 (0x17) — 9.6.1.17
 // =========================
-// [3]=SINGLE_SHOT (1=single-shot, 0=continuo), [1]=PD_LOFF_COMP (0=ON, 1=PD?)*
-// Nota: algunos diagramas invierten semántica; verifica tu revisión de datasheet.
+// [3]=SINGLE_SHOT (1=single-shot, 0=continuo), [1]=PD_LOFF_COMP (1=comparadores ON, 0=apagados)
+// Pese al nombre ("power-down" activo a nivel bajo), el reset 0x00 deja los
+// comparadores de lead-off apagados (tabla de 9.6.1.17).
 #define ADS_CFG4_SINGLE_SHOT   0x08
 #define ADS_CFG4_PD_LOFF_COMP  0x02
 #define ADS_CFG4_CONT_CONV     0x00 // SINGLE_SHOT=0
@@ -287,4 +297,8 @@ static constexpr uint8_t ADS_GPIO_ALL_INPUTS =
 
 // CONFIG4: continuo y comparadores ON
 static constexpr uint8_t ADS_CFG4_CONT_LOFF_ON =
-  (ADS_CFG4_CONT_CONV /*0*/) /* PD_LOFF_COMP=0 → comparadores habilitados */;
+  (ADS_CFG4_CONT_CONV /*0*/) | ADS_CFG4_PD_LOFF_COMP /* =1 → comparadores habilitados */;
+
+// CHnSET de un canal no usado: apagado y con entradas en corto (recomendación 9.6.1.6)
+static constexpr uint8_t ADS_CH_UNUSED =
+  ADS_CH_MAKE(false/*on*/, ADS_GAIN_1, ADS_MUX_SHORT, false/*srb2*/);
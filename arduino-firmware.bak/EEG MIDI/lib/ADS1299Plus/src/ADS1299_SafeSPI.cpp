@@ -1,6 +1,9 @@
 // ADS1299_SafeSPI.cpp
 
 #include "ADS1299_SafeSPI.h"
+#include <string.h>
+
+#if !ADS1299_SPI_MOCK
 
 ADS1299_SafeSPI::ADS1299_SafeSPI(uint8_t csPin) : csPin_(csPin) {}
 
@@ -9,7 +12,27 @@ void ADS1299_SafeSPI::begin()
   pinMode(csPin_, OUTPUT);
   digitalWrite(csPin_, HIGH);
 
+#if defined(__AVR__)
+  // Registro de salida y máscara del pin CS para select()/deselect() rápidos
+  uint8_t port = digitalPinToPort(csPin_);
+  if (port != NOT_A_PIN)
+  {
+    csOut_ = portOutputRegister(port);
+    csMask_ = digitalPinToBitMask(csPin_);
+  }
+#endif
+
   SPI.begin();
+  acquireBus();
+}
+
+void ADS1299_SafeSPI::releaseBus()
+{
+  SPI.endTransaction();
+}
+
+void ADS1299_SafeSPI::acquireBus()
+{
   SPI.beginTransaction(SPISettings(2000000, MSBFIRST, SPI_MODE1));
 }
 
@@ -19,19 +42,64 @@ void ADS1299_SafeSPI::end()
   SPI.end();
 }
 
-void ADS1299_SafeSPI::select()
+uint8_t ADS1299_SafeSPI::xfer(uint8_t data)
 {
-  digitalWrite(csPin_, LOW);
+  return SPI.transfer(data);
 }
 
-void ADS1299_SafeSPI::deselect()
+void ADS1299_SafeSPI::xferBlock(const uint8_t* tx, uint8_t* rx, size_t n)
 {
-  digitalWrite(csPin_, HIGH);
+  if (n == 0)
+    return;
+
+  if (rx == nullptr)
+  {
+    // Solo escritura: SPI.transfer(buf, n) es in-place, no se puede usar sobre tx
+    for (size_t i = 0; i < n; ++i)
+      SPI.transfer(tx ? tx[i] : (uint8_t)0x00);
+    return;
+  }
+
+  if (tx == nullptr)
+    memset(rx, 0x00, n);
+  else if (tx != rx)
+    memcpy(rx, tx, n);
+  SPI.transfer(rx, n);
 }
 
-uint8_t ADS1299_SafeSPI::xfer(uint8_t data)
+void ADS1299_SafeSPI::readBlock(uint8_t* rx, size_t n)
 {
-  return SPI.transfer(data);
+  xferBlock(nullptr, rx, n);
+}
+
+void ADS1299_SafeSPI::startRead(uint8_t* rx, size_t n)
+{
+  if (n == 0)
+    return;
+#if ADS1299_SPI_DMA
+  // En RDATAC el ADS1299 ignora DIN salvo SDATAC (0x11): se envía el propio
+  // buffer a cero (el DMA lee cada byte antes de sobrescribirlo)
+  memset(rx, 0x00, n);
+  SPI.transfer(rx, rx, n, false);
+#else
+  readBlock(rx, n);
+#endif
+}
+
+bool ADS1299_SafeSPI::readBusy()
+{
+#if ADS1299_SPI_DMA
+  return SPI.isBusy();
+#else
+  return false;
+#endif
+}
+
+void ADS1299_SafeSPI::waitRead()
+{
+#if ADS1299_SPI_DMA
+  SPI.waitForTransfer();
+#endif
 }
 
 void ADS1299_SafeSPI::waitDecode()
@@ -39,3 +107,5 @@ void ADS1299_SafeSPI::waitDecode()
   // tSDECODE = ≥4 tCLK. A 2.048 MHz, tCLK≈488 ns → 4*tCLK≈2 µs.
   delayMicroseconds(3);
 }
+
+#endif // !ADS1299_SPI_MOCK
@@ -1,10 +1,47 @@
 // ADS1299_SafeSPI.h
 // Wrapper SPI seguro con timing y control de CS
+//
+// - xferBlock()/readBlock(): transferencia de bloque sobre SPI.transfer(buf, n),
+//   que en AVR solapa la carga del siguiente byte con la espera de SPIF.
+//   Sin huecos entre bytes: usar solo donde el ADS1299 no exige tSDECODE
+//   (lectura de datos y payload de WREG/RREG, ver ADS1299Plus.cpp).
+// - select()/deselect(): en AVR escriben directamente en el registro PORTx del
+//   pin (resuelto una vez en begin()) en lugar de digitalWrite(); en el resto de
+//   núcleos se mantiene digitalWrite().
+// - startRead()/readBusy()/waitRead(): lectura de frame en segundo plano. Con
+//   ADS1299_SPI_DMA = 1 (núcleo Adafruit SAMD21/SAMD51, que expone la
+//   transferencia DMA no bloqueante en SPI.transfer(tx, rx, n, false)) la ISR
+//   de DRDY solo lanza el DMA; en el resto startRead() es readBlock() y vuelve
+//   con la lectura hecha.
+// - ADS1299_SPI_MOCK = 1: la clase se sustituye por un ADS1299 simulado con la
+//   misma API (ADS1299_SafeSPI_Mock.h). Es el valor por defecto en los test de
+//   PlatformIO (PIO_UNIT_TESTING) y en el entorno native.
 
 #pragma once
+
+#ifndef ADS1299_SPI_MOCK
+#if defined(PIO_UNIT_TESTING) || !defined(ARDUINO)
+#define ADS1299_SPI_MOCK 1
+#else
+#define ADS1299_SPI_MOCK 0
+#endif
+#endif
+
+#if ADS1299_SPI_MOCK
+#include "ADS1299_SafeSPI_Mock.h"
+#else
+
 #include <Arduino.h>
 #include <SPI.h>
 
+#ifndef ADS1299_SPI_DMA
+#define ADS1299_SPI_DMA 0
+#endif
+
+#if ADS1299_SPI_DMA && !defined(ARDUINO_ARCH_SAMD)
+#error "ADS1299_SPI_DMA: solo implementado para el núcleo Adafruit SAMD"
+#endif
+
 class ADS1299_SafeSPI
 {
 public:
@@ -13,12 +50,57 @@ public:
   void begin();
   void end();
 
-  void select();
-  void deselect();
+  inline void select() { csWrite_(false); }
+  inline void deselect() { csWrite_(true); }
 
   uint8_t xfer(uint8_t data);
+
+  // Transfiere n bytes. tx == nullptr envía 0x00; rx == nullptr descarta lo
+  // recibido. tx y rx pueden ser el mismo buffer.
+  void xferBlock(const uint8_t* tx, uint8_t* rx, size_t n);
+  // Lee n bytes enviando 0x00 (lectura de frames en RDATAC/RDATA)
+  void readBlock(uint8_t* rx, size_t n);
+
   void waitDecode(); // asegura tSDECODE >= 4 tCLK (~2 µs mínimo)
 
+  // true si startRead() vuelve antes de terminar la transferencia (DMA)
+  static constexpr bool ASYNC_READ = ADS1299_SPI_DMA != 0;
+  // Lanza la lectura de n bytes (enviando 0x00) con CS ya bajo. rx no se
+  // puede tocar hasta que readBusy() sea false o tras waitRead().
+  void startRead(uint8_t* rx, size_t n);
+  bool readBusy();
+  void waitRead();
+
+  // Ceden el bus a otro esclavo (p.ej. el MCU DSP, con otros ajustes SPI) y
+  // lo recuperan con los del ADS1299. Entre ambas no debe ejecutarse la ISR
+  // de DRDY (llamar con interrupciones deshabilitadas).
+  void releaseBus();
+  void acquireBus();
+
 private:
+  inline void csWrite_(bool high)
+  {
+#if defined(__AVR__)
+    if (csOut_ != nullptr)
+    {
+      // CS comparte puerto con otros pines (p.ej. PIN_MCU_CS): el RMW debe ser
+      // atómico frente a la ISR de DRDY, que también selecciona el ADS1299.
+      uint8_t sreg = SREG;
+      cli();
+      if (high) *csOut_ |= csMask_;
+      else      *csOut_ &= (uint8_t)~csMask_;
+      SREG = sreg;
+      return;
+    }
+#endif
+    digitalWrite(csPin_, high ? HIGH : LOW);
+  }
+
   uint8_t csPin_;
+#if defined(__AVR__)
+  volatile uint8_t* csOut_ = nullptr;
+  uint8_t csMask_ = 0;
+#endif
 };
+
+#endif // ADS1299_SPI_MOCK
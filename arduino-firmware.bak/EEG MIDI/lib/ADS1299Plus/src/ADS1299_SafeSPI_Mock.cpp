@@ -0,0 +1,254 @@
+// ADS1299_SafeSPI_Mock.cpp
+
+#include "ADS1299_SafeSPI.h"
+
+#if ADS1299_SPI_MOCK
+
+#include "ADS1299Plus.h"
+#include "ADS1299_Registers.h"
+#include <string.h>
+
+// sin(2πk/64) en Q15 para la señal sintética
+static const int16_t kSine[64] PROGMEM = {
+         0,   3212,   6393,   9512,  12539,  15446,  18204,  20787,
+     23170,  25329,  27245,  28898,  30273,  31356,  32137,  32609,
+     32767,  32609,  32137,  31356,  30273,  28898,  27245,  25329,
+     23170,  20787,  18204,  15446,  12539,   9512,   6393,   3212,
+         0,  -3212,  -6393,  -9512, -12539, -15446, -18204, -20787,
+    -23170, -25329, -27245, -28898, -30273, -31356, -32137, -32609,
+    -32767, -32609, -32137, -31356, -30273, -28898, -27245, -25329,
+    -23170, -20787, -18204, -15446, -12539,  -9512,  -6393,  -3212};
+
+static inline int32_t mock_sin(uint32_t phase)
+{
+  return (int16_t)pgm_read_word(&kSine[phase >> 26]);
+}
+
+// Amplitudes en cuentas (ganancia 24: 1 LSB ≈ 22.35 nV)
+static constexpr int32_t kOffsetStep = 2000; // offset de electrodo por canal
+static constexpr int32_t kAlphaAmp   = 900;  // ~20 µV a 10 Hz
+static constexpr int32_t kMainsAmp   = 220;  // ~5 µV a 50 Hz
+
+// ID de un ADS1299 (DEV_ID = 11, bit 4 fijo, REV_ID = 001) con NU_CH según
+// ADS1299_NUM_CHANNELS (9.6.1.1)
+static constexpr uint8_t kMockId =
+    0x3C | (ADS1299_NUM_CHANNELS == 8 ? 0x02 : ADS1299_NUM_CHANNELS == 6 ? 0x01 : 0x00);
+
+ADS1299_SafeSPI::ADS1299_SafeSPI(uint8_t csPin) : csPin_(csPin), id_(kMockId)
+{
+  reset_();
+}
+
+void ADS1299_SafeSPI::begin()
+{
+#if defined(ARDUINO)
+  pinMode(csPin_, OUTPUT);
+  digitalWrite(csPin_, HIGH);
+  SPI.begin();
+  acquireBus();
+#endif
+  reset_();
+  frames_ = 0;
+  recPos_ = 0;
+}
+
+void ADS1299_SafeSPI::end()
+{
+#if defined(ARDUINO)
+  SPI.endTransaction();
+  SPI.end();
+#endif
+}
+
+void ADS1299_SafeSPI::releaseBus()
+{
+#if defined(ARDUINO)
+  SPI.endTransaction();
+#endif
+}
+
+void ADS1299_SafeSPI::acquireBus()
+{
+#if defined(ARDUINO)
+  SPI.beginTransaction(SPISettings(2000000, MSBFIRST, SPI_MODE1));
+#endif
+}
+
+void ADS1299_SafeSPI::setRecording(const uint8_t* bytes, size_t len)
+{
+  rec_ = len ? bytes : nullptr;
+  recLen_ = rec_ ? len : 0;
+  recPos_ = 0;
+}
+
+// Valores tras RESET (9.6.1): el chip arranca en RDATAC
+void ADS1299_SafeSPI::reset_()
+{
+  memset(regs_, 0, sizeof(regs_));
+  regs_[ADS_REG_ID] = id_;
+  regs_[ADS_REG_CONFIG1] = 0x96;
+  regs_[ADS_REG_CONFIG2] = 0xC0;
+  regs_[ADS_REG_CONFIG3] = 0x60;
+  for (uint8_t i = 0; i < 8; ++i)
+    regs_[ADS_REG_CH1SET + i] = 0x61;
+  regs_[ADS_REG_GPIO] = 0x0F;
+  state_ = ST_CMD;
+  rdatac_ = true;
+  started_ = false;
+  updateRates_();
+}
+
+// Incrementos de fase por frame a la DR de CONFIG1 (fMOD/64 >> DR)
+void ADS1299_SafeSPI::updateRates_()
+{
+  const uint32_t fs = 16000UL >> (regs_[ADS_REG_CONFIG1] & 0x07);
+  alphaStep_ = (uint32_t)(((uint64_t)10 << 32) / fs);
+  mainsStep_ = (uint32_t)(((uint64_t)50 << 32) / fs);
+}
+
+uint8_t ADS1299_SafeSPI::xfer(uint8_t data)
+{
+  switch (state_)
+  {
+  case ST_CMD:
+    if ((data & 0xE0) == ADS_CMD_RREG || (data & 0xE0) == ADS_CMD_WREG)
+    {
+      // Ignorados en RDATAC (9.5.3.10/11): el siguiente byte es otro comando
+      if (!rdatac_)
+      {
+        addr_ = (uint8_t)(data & 0x1F);
+        state_ = (data & 0xE0) == ADS_CMD_RREG ? ST_RREG_N : ST_WREG_N;
+      }
+      return 0;
+    }
+    switch (data)
+    {
+    case ADS_CMD_RESET:  reset_(); break;
+    case ADS_CMD_SDATAC: rdatac_ = false; break;
+    case ADS_CMD_RDATAC: rdatac_ = true; break;
+    case ADS_CMD_START:  started_ = true; break;
+    case ADS_CMD_STOP:   started_ = false; break;
+    default: break; // WAKEUP, STANDBY, RDATA, NOP: nada que simular
+    }
+    return 0;
+
+  case ST_RREG_N:
+  case ST_WREG_N:
+    left_ = (uint8_t)((data & 0x1F) + 1);
+    state_ = state_ == ST_RREG_N ? ST_RREG : ST_WREG;
+    return 0;
+
+  case ST_RREG:
+  {
+    uint8_t v = addr_ < NUM_REGS ? regs_[addr_] : 0;
+    ++addr_;
+    if (--left_ == 0)
+      state_ = ST_CMD;
+    return v;
+  }
+
+  case ST_WREG:
+    // ID y LOFF_STATP/N son de solo lectura
+    if (addr_ < NUM_REGS && addr_ != ADS_REG_ID &&
+        addr_ != ADS_REG_LOFF_STATP && addr_ != ADS_REG_LOFF_STATN)
+    {
+      regs_[addr_] = data;
+      if (addr_ == ADS_REG_CONFIG1)
+        updateRates_();
+    }
+    ++addr_;
+    if (--left_ == 0)
+      state_ = ST_CMD;
+    return 0;
+  }
+  return 0;
+}
+
+void ADS1299_SafeSPI::xferBlock(const uint8_t* tx, uint8_t* rx, size_t n)
+{
+  // Fuera de un RREG/WREG, leer es leer un frame (DIN no cuenta en RDATAC)
+  if (state_ == ST_CMD && rx != nullptr)
+  {
+    frame_(rx, n);
+    return;
+  }
+  for (size_t i = 0; i < n; ++i)
+  {
+    uint8_t v = xfer(tx ? tx[i] : (uint8_t)0x00);
+    if (rx)
+      rx[i] = v;
+  }
+}
+
+void ADS1299_SafeSPI::readBlock(uint8_t* rx, size_t n)
+{
+  xferBlock(nullptr, rx, n);
+}
+
+void ADS1299_SafeSPI::frame_(uint8_t* rx, size_t n)
+{
+#if defined(ARDUINO)
+  // Mismo tiempo de bus que con el chip; lo leído se sustituye
+  memset(rx, 0x00, n);
+  SPI.transfer(rx, n);
+#endif
+  ++frames_;
+
+  // [STATUS 3B][nch × 3B] por dispositivo de la cadena, nch según NU_CH del ID
+  const uint8_t nu = regs_[ADS_REG_ID] & ADS_ID_NU_CH_MASK;
+  const uint8_t nch = nu == 0 ? 4 : nu == 1 ? 6 : 8;
+  const size_t perDev = 3 + 3 * (size_t)nch;
+
+  if (rec_ != nullptr)
+  {
+    // Una lectura corta (ADS1299Plus::setActiveChannels) se salta el resto
+    // del frame, como el chip en el siguiente DRDY
+    const size_t frame = perDev * ADS1299_NUM_DEVICES;
+    for (size_t i = 0; i < (n > frame ? n : frame); ++i)
+    {
+      if (i < n)
+        rx[i] = rec_[recPos_];
+      if (++recPos_ == recLen_)
+        recPos_ = 0;
+    }
+    return;
+  }
+
+  alphaPhase_ += alphaStep_;
+  mainsPhase_ += mainsStep_;
+
+  size_t o = 0;
+  uint8_t ch = 0;
+  while (o + 3 <= n)
+  {
+    rx[o++] = 0xC0; // sync 1100, sin lead-off
+    rx[o++] = 0x00;
+    rx[o++] = 0x00;
+    for (uint8_t i = 0; i < nch && o + 3 <= n; ++i, o += 3)
+    {
+      int32_t v = sample_(ch++);
+      if (v > 0x7FFFFF) v = 0x7FFFFF;
+      if (v < -0x800000) v = -0x800000;
+      rx[o] = (uint8_t)(v >> 16);
+      rx[o + 1] = (uint8_t)(v >> 8);
+      rx[o + 2] = (uint8_t)v;
+    }
+  }
+  for (; o < n; ++o)
+    rx[o] = 0x00;
+}
+
+// Muestra sintética del canal ch (de la cadena) en el frame actual
+int32_t ADS1299_SafeSPI::sample_(uint8_t ch)
+{
+  noise_ ^= noise_ << 13;
+  noise_ ^= noise_ >> 17;
+  noise_ ^= noise_ << 5;
+  int32_t v = kOffsetStep * (int32_t)(ch + 1);
+  v += (kAlphaAmp * mock_sin(alphaPhase_ + ((uint32_t)ch << 28))) >> 15;
+  v += (kMainsAmp * mock_sin(mainsPhase_)) >> 15;
+  v += (int32_t)(noise_ >> 24) - 128;
+  return v;
+}
+
+#endif // ADS1299_SPI_MOCK
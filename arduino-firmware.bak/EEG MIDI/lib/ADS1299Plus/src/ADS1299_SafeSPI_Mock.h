@@ -0,0 +1,109 @@
+// ADS1299_SafeSPI_Mock.h
+// ADS1299_SafeSPI sin ADS1299 (ADS1299_SPI_MOCK = 1): misma API, con un
+// ADS1299 simulado a nivel de bytes detrás. Para los benchmarks
+// (test/test_bench) y el entorno native; ADS1299Plus no cambia.
+//
+// - Comandos (9.5.3): RESET, SDATAC, RDATAC, RDATA, START/STOP. RREG/WREG
+//   sobre un mapa de registros propio con el ID de un ADS1299-N
+//   (N = ADS1299_NUM_CHANNELS), así begin(), configureDefaults() y la
+//   verificación por relectura pasan tal cual. Igual que el chip, en RDATAC
+//   se ignoran RREG/WREG (9.5.3.10/11).
+// - Frames (readBlock()/startRead() fuera de RREG/WREG): los bytes de
+//   setRecording() en bucle o, por defecto, sintéticos: por dispositivo
+//   STATUS con el sync (1100) y canales con offset, alfa de 10 Hz, red de
+//   50 Hz y ruido, en cuentas de 24 bits a la DR de CONFIG1.
+// - En placa (ARDUINO definido) CS y los bytes del frame pasan además por
+//   el pin y el SPI reales con los ajustes del ADS1299: el tiempo de bus
+//   cuenta en las medidas aunque no haya nada conectado (lo que llega por
+//   MISO se descarta). CS va con digitalWrite() también en AVR.
+// - Síncrono: ASYNC_READ = false (con ADS1299_SPI_DMA se mide la lectura
+//   bloqueante).
+
+#pragma once
+#include <Arduino.h>
+#if defined(ARDUINO)
+#include <SPI.h>
+#endif
+
+class ADS1299_SafeSPI
+{
+public:
+  explicit ADS1299_SafeSPI(uint8_t csPin);
+
+  void begin();
+  void end();
+
+  inline void select() { csWrite_(false); }
+  inline void deselect()
+  {
+    csWrite_(true);
+    state_ = ST_CMD; // CS alto aborta un RREG/WREG a medias
+  }
+
+  uint8_t xfer(uint8_t data);
+  void xferBlock(const uint8_t* tx, uint8_t* rx, size_t n);
+  void readBlock(uint8_t* rx, size_t n);
+
+  void waitDecode() {}
+
+  static constexpr bool ASYNC_READ = false;
+  void startRead(uint8_t* rx, size_t n) { readBlock(rx, n); }
+  bool readBusy() { return false; }
+  void waitRead() {}
+
+  void releaseBus();
+  void acquireBus();
+
+  // ---- Control del mock ----
+  // Frames grabados: len bytes de frames consecutivos tal cual salen de DOUT;
+  // cada lectura toma los n siguientes (como mínimo avanza un frame entero de
+  // la cadena) y al final vuelve al principio.
+  // nullptr (o len = 0) vuelve a los sintéticos. El buffer no se copia.
+  void setRecording(const uint8_t* bytes, size_t len);
+  // Valor del registro ID (otro modelo o nº de canales, p.ej. 0x3C = 4 canales)
+  void setDeviceId(uint8_t id) { id_ = regs_[0] = id; }
+  // Frames servidos desde begin()
+  uint32_t framesRead() const { return frames_; }
+  bool rdatac() const { return rdatac_; }
+  bool started() const { return started_; }
+  uint8_t reg(uint8_t addr) const { return addr < NUM_REGS ? regs_[addr] : 0; }
+  // Cambia un registro por detrás del driver (glitch, brownout parcial)
+  void corruptReg(uint8_t addr, uint8_t value) { if (addr < NUM_REGS) regs_[addr] = value; }
+
+private:
+  static constexpr uint8_t NUM_REGS = 0x18; // ID .. CONFIG4
+  enum State : uint8_t { ST_CMD, ST_RREG_N, ST_WREG_N, ST_RREG, ST_WREG };
+
+  void reset_();
+  void frame_(uint8_t* rx, size_t n);
+  void updateRates_();
+  int32_t sample_(uint8_t ch);
+
+  inline void csWrite_(bool high)
+  {
+#if defined(ARDUINO)
+    digitalWrite(csPin_, high ? HIGH : LOW);
+#else
+    (void)high;
+#endif
+  }
+
+  uint8_t csPin_;
+  uint8_t id_;
+  uint8_t regs_[NUM_REGS];
+  State state_ = ST_CMD;
+  uint8_t addr_ = 0;
+  uint8_t left_ = 0;     // bytes de registro pendientes del RREG/WREG
+  bool rdatac_ = false;
+  bool started_ = false;
+
+  const uint8_t* rec_ = nullptr;
+  size_t recLen_ = 0;
+  size_t recPos_ = 0;
+  uint32_t frames_ = 0;
+
+  // Señal sintética: fases (uint32 = una vuelta) e incrementos por frame
+  uint32_t alphaPhase_ = 0, alphaStep_ = 0;
+  uint32_t mainsPhase_ = 0, mainsStep_ = 0;
+  uint32_t noise_ = 0x2545F491UL; // xorshift32
+};
@@ -0,0 +1,46 @@
+// EEGDsp_BandPower.cpp
+
+#include "EEGDsp_BandPower.h"
+#include <math.h>
+
+const float EEGDSP_BAND_EDGES[EEGDSP_NUM_BANDS][2] = {
+  {  0.5f,  4.0f },  // delta
+  {  4.0f,  8.0f },  // theta
+  {  8.0f, 13.0f },  // alpha
+  { 13.0f, 30.0f },  // beta
+  { 30.0f, 50.0f },  // gamma
+};
+
+namespace {
+
+const double PI_D = 3.14159265358979323846;
+// r^N: amortiguamiento de la ventana; su efecto en la ganancia es < 0.5 %
+const double SDFT_RN = 0.99;
+
+int32_t toQ30(double v)
+{
+  return (int32_t)lround(v * (double)(1UL << EEGDSP_COEF_SHIFT));
+}
+
+}  // namespace
+
+void EEGDsp_sdftCoeffs(uint16_t k, uint16_t n, float fs, int32_t& cr, int32_t& ci,
+                       int32_t& rN, uint8_t& band)
+{
+  double r = pow(SDFT_RN, 1.0 / n);
+  double w = 2.0 * PI_D * k / n;
+  cr = toQ30(r * cos(w));
+  ci = toQ30(r * sin(w));
+  rN = toQ30(SDFT_RN);
+
+  float f = fs * k / n;
+  band = EEGDSP_NO_BAND;
+  for (uint8_t b = 0; b < EEGDSP_NUM_BANDS; ++b)
+  {
+    if (f >= EEGDSP_BAND_EDGES[b][0] && f < EEGDSP_BAND_EDGES[b][1])
+    {
+      band = b;
+      break;
+    }
+  }
+}
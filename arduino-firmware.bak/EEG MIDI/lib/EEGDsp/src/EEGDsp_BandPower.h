@@ -0,0 +1,186 @@
+// EEGDsp_BandPower.h
+// Potencia por bandas EEG (delta..gamma) por canal, incremental: DFT
+// deslizante (SDFT) de N muestras sobre los bins que caen en las bandas.
+// Cada muestra actualiza todos los bins; la potencia de la ventana de las
+// últimas N muestras se puede leer en cualquier momento (modo features).
+//
+// Por bin k (ω = 2πk/N), con r < 1 para que el error de redondeo no se acumule:
+//   X_k[n] = r·e^{jω} · (X_k[n-1] + x[n] - r^N·x[n-N])
+//   Y_k    = X_k - (X_{k-1} + X_{k+1}) / 2        (ventana de Hann × 2, en frecuencia)
+//   P_banda = Σ_{k en banda} 4·|Y_k|² / (3·N²)    (media cuadrática, LSB²)
+// Un seno de amplitud A en la banda da A²/2, la misma escala que
+// DSPCore.compute_bandpower en el host. Se siguen los bins 0..K+1 (K = último
+// bin de gamma) para tener los vecinos de todos los de las bandas; con Hann
+// la fuga de un tono a otra banda cae a < -30 dB a dos bins del borde.
+//
+// Punto fijo: entrada de 24 bits >> EEGDSP_SDFT_PRESHIFT (|X| < N·2^21 cabe
+// en int32 con N <= 256), giro con coeficientes Q2.30 y productos int64.
+// Coste por muestra y canal: 4 MAC de 64 bits por bin seguido (N = 128 a
+// 250 SPS: 27 bins de 1.95 Hz, 25 de ellos en las bandas hasta 50 Hz).
+//
+// Portable: no depende de Arduino.h.
+
+#pragma once
+#include <stdint.h>
+#include "EEGDsp_Biquad.h"
+
+// Bandas (mismos límites que DSPCore.bands en el host), [lo, hi) en Hz
+static constexpr uint8_t EEGDSP_NUM_BANDS = 5;
+enum : uint8_t { EEGDSP_DELTA, EEGDSP_THETA, EEGDSP_ALPHA, EEGDSP_BETA, EEGDSP_GAMMA };
+extern const float EEGDSP_BAND_EDGES[EEGDSP_NUM_BANDS][2];
+
+static constexpr uint8_t EEGDSP_SDFT_PRESHIFT = 2;
+static constexpr uint8_t EEGDSP_NO_BAND = 0xFF;
+
+// Nº de bins seguidos (0..K+1) para N y fs: dimensiona MAX_BINS.
+// K = último bin por debajo de 50 Hz, sin pasar de N/2 - 1.
+constexpr uint8_t EEGDsp_bandPowerBins(uint16_t n, uint16_t fs)
+{
+  return (uint8_t)(((50u * n + fs - 1) / fs - 1 < n / 2u - 1 ? (50u * n + fs - 1) / fs - 1
+                                                             : n / 2u - 1) + 2);
+}
+
+// Coeficientes del SDFT: giro r·e^{j2πk/N} y r^N en Q2.30, y banda del bin k
+// (EEGDSP_NO_BAND si no cae en ninguna). Implementación en EEGDsp_BandPower.cpp.
+void EEGDsp_sdftCoeffs(uint16_t k, uint16_t n, float fs, int32_t& cr, int32_t& ci,
+                       int32_t& rN, uint8_t& band);
+
+// CH canales, ventana N (potencia de 2, 16..256), hasta MAX_BINS bins.
+// N = 0: sin RAM (modo features desactivado en compilación).
+template <uint8_t CH, uint16_t N, uint8_t MAX_BINS>
+class EEGDsp_BandPower {
+  static_assert(N >= 16 && N <= 256 && (N & (N - 1)) == 0,
+                "EEGDsp_BandPower: N potencia de 2 en [16..256]");
+  static_assert(MAX_BINS >= 1, "EEGDsp_BandPower: MAX_BINS >= 1");
+
+public:
+  static constexpr uint16_t WINDOW = N;
+
+  // Calcula los bins de las bandas para fs. false si no caben en MAX_BINS.
+  bool configure(float fs) {
+    // Último bin con banda (K); se siguen 0..K+1
+    uint16_t last = 0;
+    int32_t cr, ci, rN = 0;
+    uint8_t band;
+    for (uint16_t k = 1; k < N / 2; ++k) {
+      EEGDsp_sdftCoeffs(k, N, fs, cr, ci, rN, band);
+      if (band != EEGDSP_NO_BAND)
+        last = k;
+    }
+    if (last == 0 || last + 2 > MAX_BINS)
+      return false;
+    for (uint16_t k = 0; k <= last + 1; ++k) {
+      EEGDsp_sdftCoeffs(k, N, fs, cr, ci, rN, band);
+      cr_[k] = cr;
+      ci_[k] = ci;
+      band_[k] = (k == 0 || k > last) ? EEGDSP_NO_BAND : band;
+    }
+    nbins_ = (uint8_t)(last + 2);
+    rN_ = rN;
+    reset();
+    return true;
+  }
+
+  void reset() {
+    for (uint8_t i = 0; i < CH; ++i) {
+      for (uint16_t j = 0; j < N; ++j)
+        hist_[i][j] = 0;
+      for (uint8_t b = 0; b < MAX_BINS; ++b) {
+        re_[i][b] = 0;
+        im_[i][b] = 0;
+      }
+    }
+    pos_ = 0;
+    fill_ = 0;
+  }
+
+  uint8_t bins() const { return nbins_; }
+  // La ventana ya tiene N muestras (antes la potencia sale por defecto)
+  bool primed() const { return fill_ >= N; }
+
+  // Nº de canales que se siguen (los primeros nch; canales activos
+  // compactos). Reinicia la ventana.
+  bool setChannels(uint8_t nch) {
+    if (nch < 1 || nch > CH)
+      return false;
+    nch_ = nch;
+    reset();
+    return true;
+  }
+  uint8_t channels() const { return nch_; }
+
+  // Añade una muestra de los canales
+  void push(const int32_t* x) {
+    const int64_t half = (int64_t)1 << (EEGDSP_COEF_SHIFT - 1);
+    for (uint8_t i = 0; i < nch_; ++i) {
+      int32_t in = x[i] >> EEGDSP_SDFT_PRESHIFT;
+      int32_t old = hist_[i][pos_];
+      hist_[i][pos_] = in;
+      int32_t d = in - (int32_t)(((int64_t)rN_ * old + half) >> EEGDSP_COEF_SHIFT);
+      int32_t* re = re_[i];
+      int32_t* im = im_[i];
+      for (uint8_t b = 0; b < nbins_; ++b) {
+        int64_t a = (int64_t)re[b] + d;
+        int64_t c = im[b];
+        re[b] = (int32_t)((cr_[b] * a - ci_[b] * c + half) >> EEGDSP_COEF_SHIFT);
+        im[b] = (int32_t)((ci_[b] * a + cr_[b] * c + half) >> EEGDSP_COEF_SHIFT);
+      }
+    }
+    pos_ = (uint16_t)((pos_ + 1) & (N - 1));
+    if (fill_ < N)
+      ++fill_;
+  }
+
+  // Potencia de la ventana: out[ch·EEGDSP_NUM_BANDS + banda], LSB² (saturada),
+  // channels() canales
+  void bandPower(uint32_t* out) const {
+    // 4·(2^PRESHIFT)²·|Y|²/(3·N²) = |Y|²·2^6/(3·N²); el desplazamiento va por
+    // bin para no desbordar (|Y| < 2^30) y el /3 al final
+    const uint8_t shift = (uint8_t)(2 * log2N_() + 2 - 2 * EEGDSP_SDFT_PRESHIFT - 4);
+    for (uint8_t i = 0; i < nch_; ++i) {
+      const int32_t* re = re_[i];
+      const int32_t* im = im_[i];
+      uint64_t acc[EEGDSP_NUM_BANDS] = {};
+      for (uint8_t b = 1; b + 1 < nbins_; ++b) {
+        int64_t yr = (int64_t)re[b] - (((int64_t)re[b - 1] + re[b + 1]) >> 1);
+        int64_t yi = (int64_t)im[b] - (((int64_t)im[b - 1] + im[b + 1]) >> 1);
+        acc[band_[b]] += (uint64_t)(yr * yr + yi * yi) >> shift;
+      }
+      for (uint8_t k = 0; k < EEGDSP_NUM_BANDS; ++k) {
+        uint64_t p = acc[k] / 3;
+        out[i * EEGDSP_NUM_BANDS + k] = p > 0xFFFFFFFFull ? 0xFFFFFFFFul : (uint32_t)p;
+      }
+    }
+  }
+
+private:
+  static constexpr uint8_t log2N_() {
+    return N == 16 ? 4 : N == 32 ? 5 : N == 64 ? 6 : N == 128 ? 7 : 8;
+  }
+
+  int32_t  hist_[CH][N] = {};
+  int32_t  re_[CH][MAX_BINS] = {};
+  int32_t  im_[CH][MAX_BINS] = {};
+  int64_t  cr_[MAX_BINS] = {};
+  int64_t  ci_[MAX_BINS] = {};
+  uint8_t  band_[MAX_BINS] = {};
+  int32_t  rN_ = 0;
+  uint16_t pos_ = 0;
+  uint16_t fill_ = 0;
+  uint8_t  nbins_ = 0;
+  uint8_t  nch_ = CH;
+};
+
+template <uint8_t CH, uint8_t MAX_BINS>
+class EEGDsp_BandPower<CH, 0, MAX_BINS> {
+public:
+  static constexpr uint16_t WINDOW = 0;
+  bool configure(float) { return false; }
+  void reset() {}
+  uint8_t bins() const { return 0; }
+  bool primed() const { return false; }
+  bool setChannels(uint8_t nch) { return nch >= 1 && nch <= CH; }
+  uint8_t channels() const { return CH; }
+  void push(const int32_t*) {}
+  void bandPower(uint32_t*) const {}
+};
@@ -0,0 +1,102 @@
+// EEGDsp_Biquad.cpp
+
+#include "EEGDsp_Biquad.h"
+#include <math.h>
+
+namespace {
+
+// Juegos predefinidos: frecuencias de red y banda EEG
+constexpr float NOTCH_Q   = 25.0f;
+constexpr float BAND_LO   = 0.5f;
+constexpr float BAND_HI   = 45.0f;
+constexpr float BUTTER_Q  = 0.70710678f;
+
+// double: en ARM es por software (solo setup()); en AVR double == float
+int32_t toQ30(double v)
+{
+  return (int32_t)lround(v * (double)(1UL << EEGDSP_COEF_SHIFT));
+}
+
+bool validFreq(float fs, float f, float q)
+{
+  return fs > 0.0f && f > 0.0f && f < fs * 0.5f && q > 0.0f;
+}
+
+// Parte común del cookbook: a1/a2 y 1/a0
+void poles(EEGDsp_BiquadCoeffs& c, double w0, double q, double& cosw, double& inv_a0)
+{
+  cosw = cos(w0);
+  double alpha = sin(w0) / (2.0 * q);
+  inv_a0 = 1.0 / (1.0 + alpha);
+  c.a1 = toQ30(-2.0 * cosw * inv_a0);
+  c.a2 = toQ30((1.0 - alpha) * inv_a0);
+}
+
+const double PI_D = 3.14159265358979323846;
+
+}  // namespace
+
+bool EEGDsp_designNotch(EEGDsp_BiquadCoeffs& c, float fs, float f0, float q)
+{
+  if (!validFreq(fs, f0, q))
+    return false;
+  double cosw, inv_a0;
+  poles(c, 2.0 * PI_D * f0 / fs, q, cosw, inv_a0);
+  c.b0 = toQ30(inv_a0);
+  c.b1 = toQ30(-2.0 * cosw * inv_a0);
+  c.b2 = c.b0;
+  return true;
+}
+
+bool EEGDsp_designHighpass(EEGDsp_BiquadCoeffs& c, float fs, float fc, float q)
+{
+  if (!validFreq(fs, fc, q))
+    return false;
+  double cosw, inv_a0;
+  poles(c, 2.0 * PI_D * fc / fs, q, cosw, inv_a0);
+  c.b0 = toQ30((1.0 + cosw) * 0.5 * inv_a0);
+  c.b1 = -2 * c.b0; // b0 + b1 + b2 = 0 exacto: ganancia nula en DC
+  c.b2 = c.b0;
+  return true;
+}
+
+bool EEGDsp_designLowpass(EEGDsp_BiquadCoeffs& c, float fs, float fc, float q)
+{
+  if (!validFreq(fs, fc, q))
+    return false;
+  double cosw, inv_a0;
+  poles(c, 2.0 * PI_D * fc / fs, q, cosw, inv_a0);
+  c.b0 = toQ30((1.0 - cosw) * 0.5 * inv_a0);
+  c.b1 = 2 * c.b0;
+  c.b2 = c.b0;
+  return true;
+}
+
+uint8_t EEGDsp_designFilterSet(EEGDsp_BiquadCoeffs* out, uint8_t maxStages,
+                               EEGDsp_FilterSet set, float fs)
+{
+  uint8_t n = EEGDsp_filterSetStages(set);
+  if (n == 0 || n > maxStages)
+    return 0;
+
+  uint8_t k = 0;
+  if (set == EEGDSP_FILTER_NOTCH50 || set == EEGDSP_FILTER_NOTCH50_BAND)
+  {
+    if (!EEGDsp_designNotch(out[k++], fs, 50.0f, NOTCH_Q))
+      return 0;
+  }
+  else if (set == EEGDSP_FILTER_NOTCH60 || set == EEGDSP_FILTER_NOTCH60_BAND)
+  {
+    if (!EEGDsp_designNotch(out[k++], fs, 60.0f, NOTCH_Q))
+      return 0;
+  }
+  if (set == EEGDSP_FILTER_EEG_BAND || set == EEGDSP_FILTER_NOTCH50_BAND ||
+      set == EEGDSP_FILTER_NOTCH60_BAND)
+  {
+    if (!EEGDsp_designHighpass(out[k++], fs, BAND_LO, BUTTER_Q))
+      return 0;
+    if (!EEGDsp_designLowpass(out[k++], fs, BAND_HI, BUTTER_Q))
+      return 0;
+  }
+  return k;
+}
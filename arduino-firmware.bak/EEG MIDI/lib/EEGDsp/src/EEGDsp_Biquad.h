@@ -0,0 +1,165 @@
+// EEGDsp_Biquad.h
+// Banco de filtros IIR en punto fijo: cascada de biquads por canal, aplicada
+// a cada frame antes de empaquetar (notch de red + banda EEG).
+//
+// Por sección (forma directa I, coeficientes Q2.30 normalizados a a0 = 1):
+//   acc  = b0·x[n] + b1·x[n-1] + b2·x[n-2] - a1·y[n-1] - a2·y[n-2] + e[n-1]
+//   y[n] = acc >> 30,   e[n] = acc & (2^30 - 1)
+// Productos 32×32 → 64 bits y acumulador int64: con muestras de 24 bits no
+// hay desbordamiento. e[n] reinyecta el resto del redondeo (error feedback de
+// primer orden): sin él, el paso alto de 0.5 Hz a 250 SPS (polos a ~0.99 del
+// círculo unidad) amplifica el ruido de cuantización y deja un offset.
+// La salida de la cascada se satura a 24 bits (lo que transporta BATCH/RICE).
+//
+// Coste por sección y canal: 5 MAC de 64 bits + 4 desplazamientos de estado.
+// Orientativo: Cortex-M4 ~20 ciclos (SMLAL), Cortex-M0+ ~150 (sin
+// multiplicación larga en hardware), AVR ~600 (__muldi3 por software).
+// 8 canales × 3 secciones en el Uno ≈ 14 k ciclos ≈ 0.9 ms de los 4 ms por
+// muestra a 250 SPS.
+//
+// Los coeficientes se calculan en setup() (coma flotante, fórmulas del "Audio EQ
+// Cookbook" de R. Bristow-Johnson) para la frecuencia de muestreo real.
+//
+// Portable: no depende de Arduino.h.
+
+#pragma once
+#include <stdint.h>
+
+static constexpr uint8_t EEGDSP_COEF_SHIFT = 30; // Q2.30: |c| < 2
+
+// Coeficientes de una sección (a0 = 1)
+struct EEGDsp_BiquadCoeffs {
+  int32_t b0, b1, b2, a1, a2;
+};
+
+// Estado de una sección en un canal (forma directa I + resto del redondeo)
+struct EEGDsp_BiquadState {
+  int32_t  x1, x2, y1, y2;
+  uint32_t err;
+};
+
+// ---- Diseño (coma flotante, solo en setup()) ----
+// Devuelven false si la frecuencia no está en (0, fs/2) o q <= 0.
+bool EEGDsp_designNotch   (EEGDsp_BiquadCoeffs& c, float fs, float f0, float q);
+bool EEGDsp_designHighpass(EEGDsp_BiquadCoeffs& c, float fs, float fc, float q);
+bool EEGDsp_designLowpass (EEGDsp_BiquadCoeffs& c, float fs, float fc, float q);
+
+// Juegos de coeficientes predefinidos
+enum EEGDsp_FilterSet : uint8_t {
+  EEGDSP_FILTER_NONE = 0,
+  EEGDSP_FILTER_NOTCH50,       // notch 50 Hz (Q = 25, ~2 Hz de ancho)
+  EEGDSP_FILTER_NOTCH60,       // notch 60 Hz
+  EEGDSP_FILTER_EEG_BAND,      // paso alto 0.5 Hz + paso bajo 45 Hz (Butterworth 2º orden)
+  EEGDSP_FILTER_NOTCH50_BAND,  // notch 50 Hz + banda EEG
+  EEGDSP_FILTER_NOTCH60_BAND,  // notch 60 Hz + banda EEG
+};
+
+// Nº de secciones de cada juego (constexpr: dimensiona el banco)
+constexpr uint8_t EEGDsp_filterSetStages(EEGDsp_FilterSet set)
+{
+  return (set == EEGDSP_FILTER_NOTCH50 || set == EEGDSP_FILTER_NOTCH60) ? 1
+       : set == EEGDSP_FILTER_EEG_BAND ? 2
+       : (set == EEGDSP_FILTER_NOTCH50_BAND || set == EEGDSP_FILTER_NOTCH60_BAND) ? 3
+       : 0;
+}
+
+// Rellena out[0..n-1] con el juego `set` para fs. Devuelve n, o 0 si no
+// cabe en maxStages o alguna frecuencia no es válida para fs (p.ej. el paso
+// bajo de 45 Hz con fs <= 90).
+uint8_t EEGDsp_designFilterSet(EEGDsp_BiquadCoeffs* out, uint8_t maxStages,
+                               EEGDsp_FilterSet set, float fs);
+
+// Una muestra por una sección
+static inline int32_t EEGDsp_biquadStep(const EEGDsp_BiquadCoeffs& c, EEGDsp_BiquadState& s,
+                                        int32_t x)
+{
+  int64_t acc = (int64_t)c.b0 * x + (int64_t)c.b1 * s.x1 + (int64_t)c.b2 * s.x2
+              - (int64_t)c.a1 * s.y1 - (int64_t)c.a2 * s.y2 + (int64_t)s.err;
+  int32_t y = (int32_t)(acc >> EEGDSP_COEF_SHIFT);
+  s.err = (uint32_t)acc & ((1UL << EEGDSP_COEF_SHIFT) - 1);
+  s.x2 = s.x1;
+  s.x1 = x;
+  s.y2 = s.y1;
+  s.y1 = y;
+  return y;
+}
+
+// CH canales, hasta MAX_STAGES secciones; mismos coeficientes en todos los canales.
+// MAX_STAGES = 0: banco vacío sin RAM (filtrado desactivado en compilación).
+template <uint8_t CH, uint8_t MAX_STAGES>
+class EEGDsp_BiquadBank {
+  static_assert(CH >= 1, "EEGDsp_BiquadBank: CH >= 1");
+
+public:
+  // Copia n secciones (n = 0 desactiva el filtrado) y reinicia el estado
+  bool configure(const EEGDsp_BiquadCoeffs* c, uint8_t n) {
+    if (n > MAX_STAGES)
+      return false;
+    for (uint8_t k = 0; k < n; ++k)
+      c_[k] = c[k];
+    n_ = n;
+    reset();
+    return true;
+  }
+
+  // Diseña y carga un juego predefinido
+  bool configure(EEGDsp_FilterSet set, float fs) {
+    if (set == EEGDSP_FILTER_NONE)
+      return configure(c_, 0);
+    EEGDsp_BiquadCoeffs c[MAX_STAGES];
+    uint8_t n = EEGDsp_designFilterSet(c, MAX_STAGES, set, fs);
+    return n != 0 && configure(c, n);
+  }
+
+  // Estado a cero (tras un hueco largo o un cambio de configuración del ADC)
+  void reset() {
+    for (uint8_t k = 0; k < MAX_STAGES; ++k)
+      for (uint8_t i = 0; i < CH; ++i)
+        s_[k][i] = EEGDsp_BiquadState{0, 0, 0, 0, 0};
+  }
+
+  uint8_t stages() const { return n_; }
+  bool active() const { return n_ != 0; }
+
+  // Nº de canales que se filtran (los primeros nch; canales activos
+  // compactos). Reinicia el estado.
+  bool setChannels(uint8_t nch) {
+    if (nch < 1 || nch > CH)
+      return false;
+    nch_ = nch;
+    reset();
+    return true;
+  }
+  uint8_t channels() const { return nch_; }
+
+  // Filtra in situ una muestra de los canales
+  void process(int32_t* x) {
+    if (n_ == 0)
+      return;
+    for (uint8_t i = 0; i < nch_; ++i) {
+      int32_t v = x[i];
+      for (uint8_t k = 0; k < n_; ++k)
+        v = EEGDsp_biquadStep(c_[k], s_[k][i], v);
+      x[i] = v > 0x7FFFFF ? 0x7FFFFF : (v < -0x800000 ? -0x800000 : v);
+    }
+  }
+
+private:
+  EEGDsp_BiquadCoeffs c_[MAX_STAGES] = {};
+  EEGDsp_BiquadState  s_[MAX_STAGES][CH] = {};
+  uint8_t n_ = 0;
+  uint8_t nch_ = CH;
+};
+
+template <uint8_t CH>
+class EEGDsp_BiquadBank<CH, 0> {
+public:
+  bool configure(const EEGDsp_BiquadCoeffs*, uint8_t n) { return n == 0; }
+  bool configure(EEGDsp_FilterSet set, float) { return set == EEGDSP_FILTER_NONE; }
+  void reset() {}
+  uint8_t stages() const { return 0; }
+  bool active() const { return false; }
+  bool setChannels(uint8_t nch) { return nch >= 1 && nch <= CH; }
+  uint8_t channels() const { return CH; }
+  void process(int32_t*) {}
+};
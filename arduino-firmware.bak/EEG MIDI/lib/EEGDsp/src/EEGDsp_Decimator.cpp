@@ -0,0 +1,50 @@
+// EEGDsp_Decimator.cpp
+
+#include "EEGDsp_Decimator.h"
+#include <math.h>
+
+namespace {
+
+const double PI_D = 3.14159265358979323846;
+
+// Coeficiente k (sin normalizar) de la sinc enventanada de n términos
+double firTap_(uint8_t k, uint8_t n, float fc)
+{
+  double t = k - (n - 1) * 0.5;
+  double sinc = (t == 0.0) ? 2.0 * fc : sin(2.0 * PI_D * fc * t) / (PI_D * t);
+  // Ventana de n + 2 puntos sin los extremos (que valen 0)
+  double x = 2.0 * PI_D * (k + 1) / (n + 1);
+  return sinc * (0.42 - 0.5 * cos(x) + 0.08 * cos(2.0 * x));
+}
+
+}  // namespace
+
+bool EEGDsp_designLowpassFir(int32_t* h, uint8_t n, float fc)
+{
+  if (n == 0 || !(fc > 0.0f && fc < 0.5f))
+    return false;
+
+  // Sinc enventanada (Blackman), centrada en (n-1)/2. Se evalúa dos veces
+  // (suma y cuantización) para no necesitar un buffer de n doubles en la pila.
+  double sum = 0.0;
+  for (uint8_t k = 0; k < n; ++k)
+    sum += firTap_(k, n, fc);
+
+  // Cuantizar con ganancia en DC 1 y llevar el resto del redondeo al centro
+  const int32_t one = (int32_t)(1UL << EEGDSP_COEF_SHIFT);
+  int32_t total = 0;
+  for (uint8_t k = 0; k < n; ++k)
+  {
+    h[k] = (int32_t)lround(firTap_(k, n, fc) / sum * (double)one);
+    total += h[k];
+  }
+  h[(n - 1) / 2] += one - total;
+  if (n % 2 == 0)
+  {
+    // Dos centros: repartir para mantener la simetría
+    int32_t a = h[(n - 1) / 2], b = h[n / 2];
+    h[(n - 1) / 2] = a - (a - b) / 2;
+    h[n / 2] = b + (a - b) / 2;
+  }
+  return true;
+}
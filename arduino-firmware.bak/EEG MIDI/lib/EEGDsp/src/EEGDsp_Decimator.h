@@ -0,0 +1,119 @@
+// EEGDsp_Decimator.h
+// Diezmado por R con FIR en punto fijo, por canal (modo sobremuestreo: el
+// ADS1299 convierte a R × la tasa de salida y aquí se baja a la de salida).
+//
+//   y[m] = Σ h[k]·x[mR + R-1 - k],  k = 0..TAPS-1    (h en Q2.30, acc int64)
+//
+// Forma polifásica: cada entrada solo se guarda en el historial; el producto
+// escalar de TAPS términos se calcula una vez por salida. Coste por salida y
+// canal: TAPS MAC de 64 bits (TAPS/R por muestra de entrada).
+//
+// Quién decide cuándo sale una muestra es el llamador (emit en push()), a
+// partir del índice de la muestra de entrada: así un frame perdido no
+// desplaza la fase del diezmado.
+//
+// Los coeficientes (sinc enventanada con Blackman, ~-74 dB en la banda
+// eliminada, ganancia en DC exacta) se calculan en setup().
+//
+// Portable: no depende de Arduino.h.
+
+#pragma once
+#include <stdint.h>
+#include "EEGDsp_Biquad.h"
+
+// FIR paso bajo de n coeficientes con corte fc (fracción de la frecuencia de
+// entrada, 0 < fc < 0.5). Devuelve false si los parámetros no son válidos.
+bool EEGDsp_designLowpassFir(int32_t* h, uint8_t n, float fc);
+
+// CH canales, TAPS coeficientes. TAPS = 0: etapa transparente sin RAM.
+template <uint8_t CH, uint8_t TAPS>
+class EEGDsp_FirDecimator {
+  static_assert(CH >= 1, "EEGDsp_FirDecimator: CH >= 1");
+
+public:
+  // Corte por defecto en la mitad de la tasa de salida (0.5 / ratio)
+  bool configure(uint8_t ratio) {
+    if (ratio < 1)
+      return false;
+    ratio_ = ratio;
+    reset();
+    return EEGDsp_designLowpassFir(h_, TAPS, 0.5f / ratio);
+  }
+
+  void reset() {
+    for (uint8_t i = 0; i < CH; ++i)
+      for (uint8_t k = 0; k < TAPS; ++k)
+        hist_[i][k] = 0;
+    pos_ = 0;
+  }
+
+  uint8_t ratio() const { return ratio_; }
+
+  // Nº de canales que se diezman (los primeros nch; canales activos
+  // compactos). Reinicia el historial.
+  bool setChannels(uint8_t nch) {
+    if (nch < 1 || nch > CH)
+      return false;
+    nch_ = nch;
+    reset();
+    return true;
+  }
+  uint8_t channels() const { return nch_; }
+
+  // Añade una muestra de los canales; si emit, escribe la salida en out
+  // (puede ser el mismo buffer que x) y devuelve true.
+  bool push(const int32_t* x, int32_t* out, bool emit) {
+    uint8_t p = pos_;
+    for (uint8_t i = 0; i < nch_; ++i)
+      hist_[i][p] = x[i];
+    pos_ = (uint8_t)(p + 1 == TAPS ? 0 : p + 1);
+    if (!emit)
+      return false;
+
+    // hist_[i][pos_] es la muestra más antigua: h es simétrica, así que el
+    // orden de recorrido da igual; se parte en dos tramos para no usar módulo
+    for (uint8_t i = 0; i < nch_; ++i) {
+      const int32_t* s = hist_[i];
+      int64_t acc = (int64_t)1 << (EEGDSP_COEF_SHIFT - 1); // redondeo
+      uint8_t k = 0;
+      for (uint8_t j = pos_; j < TAPS; ++j, ++k)
+        acc += (int64_t)h_[k] * s[j];
+      for (uint8_t j = 0; j < pos_; ++j, ++k)
+        acc += (int64_t)h_[k] * s[j];
+      int32_t y = (int32_t)(acc >> EEGDSP_COEF_SHIFT);
+      out[i] = y > 0x7FFFFF ? 0x7FFFFF : (y < -0x800000 ? -0x800000 : y);
+    }
+    return true;
+  }
+
+private:
+  int32_t h_[TAPS] = {};
+  int32_t hist_[CH][TAPS] = {};
+  uint8_t pos_ = 0;
+  uint8_t ratio_ = 1;
+  uint8_t nch_ = CH;
+};
+
+template <uint8_t CH>
+class EEGDsp_FirDecimator<CH, 0> {
+public:
+  bool configure(uint8_t ratio) { return ratio == 1; }
+  void reset() {}
+  uint8_t ratio() const { return 1; }
+  bool setChannels(uint8_t nch) {
+    if (nch < 1 || nch > CH)
+      return false;
+    nch_ = nch;
+    return true;
+  }
+  uint8_t channels() const { return nch_; }
+  bool push(const int32_t* x, int32_t* out, bool emit) {
+    if (emit && out != x)
+      for (uint8_t i = 0; i < nch_; ++i)
+        out[i] = x[i];
+    return emit;
+  }
+
+private:
+  uint8_t nch_ = CH;
+};
@@ -0,0 +1,184 @@
+// EEGMidi_Mapper.cpp
+
+#include "EEGMidi_Mapper.h"
+
+namespace {
+
+constexpr uint8_t MIDI_NOTE_OFF = 0x80;
+constexpr uint8_t MIDI_NOTE_ON  = 0x90;
+constexpr uint8_t MIDI_CC       = 0xB0;
+
+// log2(P) en Q3 de los extremos por defecto: 2^12 LSB² (~1.4 µV rms) a
+// 2^24 LSB² (~90 µV rms), el rango útil de alfa/beta en cuero cabelludo
+constexpr uint8_t DEFAULT_LO = 12 * 8;
+constexpr uint8_t DEFAULT_HI = 24 * 8;
+
+constexpr uint8_t  BAND_ALPHA = 2;   // EEGDSP_ALPHA (sin depender de EEGDsp)
+constexpr uint8_t  BAND_BETA  = 3;   // EEGDSP_BETA
+constexpr uint16_t SCALE_PENTATONIC_MAJOR = 0x0295;  // 0 2 4 7 9
+
+uint8_t scaleValue(const EEGMidi_Map& m, uint8_t l)
+{
+  if (l <= m.lo) return 0;
+  if (l >= m.hi) return 127;
+  return (uint8_t)((uint16_t)(l - m.lo) * 127u / (uint16_t)(m.hi - m.lo));
+}
+
+EEGMidi_Map makeMap(uint8_t ch, uint8_t band, uint8_t kind, uint8_t midiCh, uint8_t number)
+{
+  return EEGMidi_Map{ch, band, kind, midiCh, number, 0, DEFAULT_LO, DEFAULT_HI};
+}
+
+}  // namespace
+
+uint8_t EEGMidi_log2Q3(uint32_t x)
+{
+  if (x == 0) return 0;
+  uint8_t e = 31;
+  while (!(x & 0x80000000UL)) {
+    x <<= 1;
+    --e;
+  }
+  // Los 3 bits tras el 1 inicial: fracción lineal de la mantisa
+  return (uint8_t)((e << 3) | ((x >> 28) & 7u));
+}
+
+void EEGMidi_defaultTable(EEGMidi_Table& t, uint8_t nCh)
+{
+  t = EEGMidi_Table{};
+  t.root = 0;
+  t.scale = SCALE_PENTATONIC_MAJOR;
+  t.span = 10;  // dos octavas de pentatónica
+  uint8_t n = 0;
+  for (uint8_t ch = 0; ch < 2 && ch < nCh; ++ch) {
+    t.maps[n++] = makeMap(ch, BAND_ALPHA, EEGMIDI_CC, 0, (uint8_t)(20 + 2 * ch));
+    t.maps[n++] = makeMap(ch, BAND_BETA, EEGMIDI_CC, 0, (uint8_t)(21 + 2 * ch));
+  }
+  if (nCh > 0) t.maps[n++] = makeMap(0, BAND_ALPHA, EEGMIDI_NOTE, 1, 60);
+  t.nMaps = n;
+}
+
+bool EEGMidi_parseTable(const uint8_t* buf, uint16_t n, uint8_t nCh, uint8_t nBands,
+                        EEGMidi_Table& t)
+{
+  if (n < EEGMIDI_TABLE_HEADER || buf[0] != EEGMIDI_TABLE_VER)
+    return false;
+  EEGMidi_Table r = {};
+  r.root = buf[1];
+  r.scale = (uint16_t)(buf[2] | (buf[3] << 8));
+  r.span = buf[4];
+  r.nMaps = buf[5];
+  if (r.root > 11 || (r.scale & 0xF000u) || r.nMaps > EEGMIDI_MAX_MAPS ||
+      n != EEGMIDI_TABLE_HEADER + (uint16_t)r.nMaps * EEGMIDI_MAP_SIZE)
+    return false;
+
+  const uint8_t* p = buf + EEGMIDI_TABLE_HEADER;
+  for (uint8_t i = 0; i < r.nMaps; ++i, p += EEGMIDI_MAP_SIZE) {
+    EEGMidi_Map m{p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7]};
+    if (m.eegCh >= nCh || m.band >= nBands || m.kind > EEGMIDI_NOTE || m.midiCh > 15 ||
+        m.number > 127 || m.velocity > 127 || m.lo >= m.hi)
+      return false;
+    if (m.kind == EEGMIDI_NOTE && r.span == 0)
+      return false;
+    r.maps[i] = m;
+  }
+  t = r;
+  return true;
+}
+
+void EEGMidi_Mapper::configure(const EEGMidi_Table& t)
+{
+  // Las notas que suenan con la tabla actual se apagan en el próximo update()
+  for (uint8_t i = 0; i < t_.nMaps; ++i) {
+    if (note_[i] == EEGMIDI_NO_NOTE || nPendingOff_ == EEGMIDI_MAX_MAPS)
+      continue;
+    pendingOff_[nPendingOff_++] =
+        EEGMidi_Msg{(uint8_t)(MIDI_NOTE_OFF | t_.maps[i].midiCh), note_[i], 0};
+  }
+  t_ = t;
+  for (uint8_t i = 0; i < EEGMIDI_MAX_MAPS; ++i) {
+    last_[i] = 0;
+    note_[i] = EEGMIDI_NO_NOTE;
+    sent_[i] = 0;
+  }
+}
+
+uint8_t EEGMidi_Mapper::noteFor_(const EEGMidi_Map& m, uint8_t step) const
+{
+  uint16_t scale = t_.scale ? t_.scale : 0x0FFF;  // sin escala: cromática
+  uint8_t note = m.number;
+  // Primera nota de la escala >= number; luego `step` notas de la escala más
+  for (;;) {
+    uint8_t pc = (uint8_t)((note + 12 - t_.root) % 12);
+    if (scale & (1u << pc)) {
+      if (step == 0) return note;
+      --step;
+    }
+    if (note == 127) return 127;
+    ++note;
+  }
+}
+
+uint8_t EEGMidi_Mapper::update(const uint32_t* power, uint8_t nBands, EEGMidi_Msg* out,
+                               uint8_t maxOut)
+{
+  uint8_t n = 0;
+  while (nPendingOff_ && n < maxOut)
+    out[n++] = pendingOff_[--nPendingOff_];
+
+  for (uint8_t i = 0; i < t_.nMaps && n + 2 <= maxOut; ++i) {
+    const EEGMidi_Map& m = t_.maps[i];
+    uint8_t l = EEGMidi_log2Q3(power[m.eegCh * nBands + m.band]);
+    uint8_t v = scaleValue(m, l);
+
+    if (m.kind == EEGMIDI_CC) {
+      if (sent_[i] && v == last_[i]) continue;
+      out[n++] = EEGMidi_Msg{(uint8_t)(MIDI_CC | m.midiCh), m.number, v};
+      last_[i] = v;
+      sent_[i] = 1;
+    } else if (m.kind == EEGMIDI_NOTE) {
+      bool sounding = note_[i] != EEGMIDI_NO_NOTE;
+      if (l < m.lo) {
+        // Por debajo del umbral: silencio
+        if (sounding) {
+          out[n++] = EEGMidi_Msg{(uint8_t)(MIDI_NOTE_OFF | m.midiCh), note_[i], 0};
+          note_[i] = EEGMIDI_NO_NOTE;
+        }
+        continue;
+      }
+      uint8_t step = (uint8_t)((uint16_t)v * t_.span / 128u);
+      if (sounding) {
+        // Histéresis: fuera del tramo [a, b) del escalón actual por más de HYST
+        uint8_t s = last_[i];
+        int16_t a = (int16_t)((s * 128u + t_.span - 1) / t_.span);
+        int16_t b = (int16_t)(((s + 1) * 128u + t_.span - 1) / t_.span);
+        if (step == s || (v >= a - EEGMIDI_NOTE_HYST && v < b + EEGMIDI_NOTE_HYST)) continue;
+      }
+      uint8_t note = noteFor_(m, step);
+      if (sounding && note == note_[i]) {
+        last_[i] = step;
+        continue;
+      }
+      if (sounding)
+        out[n++] = EEGMidi_Msg{(uint8_t)(MIDI_NOTE_OFF | m.midiCh), note_[i], 0};
+      uint8_t vel = m.velocity ? m.velocity : (uint8_t)(v ? v : 1);
+      out[n++] = EEGMidi_Msg{(uint8_t)(MIDI_NOTE_ON | m.midiCh), note, vel};
+      note_[i] = note;
+      last_[i] = step;
+    }
+  }
+  return n;
+}
+
+uint8_t EEGMidi_Mapper::releaseAll(EEGMidi_Msg* out, uint8_t maxOut)
+{
+  uint8_t n = 0;
+  while (nPendingOff_ && n < maxOut)
+    out[n++] = pendingOff_[--nPendingOff_];
+  for (uint8_t i = 0; i < t_.nMaps && n < maxOut; ++i) {
+    if (note_[i] == EEGMIDI_NO_NOTE) continue;
+    out[n++] = EEGMidi_Msg{(uint8_t)(MIDI_NOTE_OFF | t_.maps[i].midiCh), note_[i], 0};
+    note_[i] = EEGMIDI_NO_NOTE;
+  }
+  return n;
+}
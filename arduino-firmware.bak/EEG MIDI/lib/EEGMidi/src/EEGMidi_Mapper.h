@@ -0,0 +1,106 @@
+// EEGMidi_Mapper.h
+// Traduce la potencia por bandas del firmware (EEGDsp_BandPower) a mensajes
+// MIDI (CC y notas cuantizadas a una escala), para la salida USB-MIDI directa.
+//
+// Cada entrada de la tabla toma la potencia de un (canal EEG, banda), la pasa
+// a log2 (Q3: 1/8 de octava de potencia, ~0.4 dB) y la escala a 0..127 entre
+// lo y hi:
+//   v = clamp((log2(P) - lo) · 127 / (hi - lo), 0, 127)
+//  - CC: control `number` = v, solo cuando cambia.
+//  - NOTE: escalón v·span/128 de la escala a partir de la nota `number`
+//    (la primera de la escala >= number). Por debajo de lo, silencio.
+//    Histéresis de EEGMIDI_NOTE_HYST en v para no alternar en el borde
+//    entre dos notas. velocity = 0: la velocidad sale de v.
+//
+// La tabla viaja en binario (formato en EEGMidi_parseTable y en
+// docs/protocol.md, "Tabla de mapeo MIDI") para poder subirla desde el host.
+//
+// Portable: no depende de Arduino.h (el envío lo hace el llamador).
+
+#pragma once
+#include <stdint.h>
+
+static constexpr uint8_t EEGMIDI_MAX_MAPS    = 8;
+static constexpr uint8_t EEGMIDI_TABLE_VER   = 1;
+static constexpr uint8_t EEGMIDI_TABLE_HEADER = 6;  // ver, root, scale(2), span, n_maps
+static constexpr uint8_t EEGMIDI_MAP_SIZE    = 8;
+static constexpr uint16_t EEGMIDI_TABLE_MAX  = EEGMIDI_TABLE_HEADER + EEGMIDI_MAX_MAPS * EEGMIDI_MAP_SIZE;
+static constexpr uint8_t EEGMIDI_NOTE_HYST   = 3;
+static constexpr uint8_t EEGMIDI_NO_NOTE     = 0xFF;
+
+enum EEGMidi_Kind : uint8_t {
+  EEGMIDI_OFF  = 0,
+  EEGMIDI_CC   = 1,
+  EEGMIDI_NOTE = 2,
+};
+
+struct EEGMidi_Map {
+  uint8_t eegCh;    // canal EEG (0..n_ch-1)
+  uint8_t band;     // EEGDSP_DELTA..EEGDSP_GAMMA
+  uint8_t kind;     // EEGMidi_Kind
+  uint8_t midiCh;   // canal MIDI 0..15
+  uint8_t number;   // nº de CC o nota más grave
+  uint8_t velocity; // NOTE: velocidad fija, 0 = según v
+  uint8_t lo;       // log2(P) en Q3 que da v = 0
+  uint8_t hi;       // log2(P) en Q3 que da v = 127
+};
+
+struct EEGMidi_Table {
+  uint8_t  root;      // tónica (clase de altura 0..11, 0 = Do)
+  uint16_t scale;     // bit i = semitono i sobre la tónica (0x0AB5 = mayor)
+  uint8_t  span;      // notas de la escala que recorre una entrada NOTE
+  uint8_t  nMaps;
+  EEGMidi_Map maps[EEGMIDI_MAX_MAPS];
+};
+
+// Mensaje de canal MIDI de 3 bytes (NoteOn/NoteOff/CC)
+struct EEGMidi_Msg {
+  uint8_t status, data1, data2;
+};
+
+// Tabla por defecto para nCh canales: alfa y beta de los dos primeros
+// canales a CC 20..23 (canal MIDI 1) y alfa del canal 0 a notas de la
+// pentatónica mayor en Do desde el Do central (canal MIDI 2).
+void EEGMidi_defaultTable(EEGMidi_Table& t, uint8_t nCh);
+
+// Formato binario (little-endian):
+//   [u8 version = 1][u8 root][u16 scale][u8 span][u8 n_maps]
+//   n_maps × [eeg_ch][band][kind][midi_ch][number][velocity][lo][hi]
+// false si la versión, la longitud o algún campo no son válidos para
+// nCh canales EEG y nBands bandas (la tabla de salida no se toca).
+bool EEGMidi_parseTable(const uint8_t* buf, uint16_t n, uint8_t nCh, uint8_t nBands,
+                        EEGMidi_Table& t);
+
+// log2(x) en Q3 (0 para x = 0), interpolación lineal de la mantisa
+uint8_t EEGMidi_log2Q3(uint32_t x);
+
+class EEGMidi_Mapper {
+public:
+  // Copia la tabla; los mensajes para apagar las notas activas de la tabla
+  // anterior salen en la siguiente llamada a update() (o releaseAll()).
+  void configure(const EEGMidi_Table& t);
+
+  // Evalúa la tabla con power[ch·nBands + banda] (LSB², EEGDsp_BandPower) y
+  // escribe en out los mensajes que tocan (como mucho 2 por entrada más los
+  // apagados pendientes). Devuelve cuántos.
+  uint8_t update(const uint32_t* power, uint8_t nBands, EEGMidi_Msg* out, uint8_t maxOut);
+
+  // NoteOff de todas las notas activas (parada de la adquisición)
+  uint8_t releaseAll(EEGMidi_Msg* out, uint8_t maxOut);
+
+  // Cota de mensajes por update()
+  static constexpr uint8_t MAX_MSGS = 2 * EEGMIDI_MAX_MAPS + EEGMIDI_MAX_MAPS;
+
+  const EEGMidi_Table& table() const { return t_; }
+
+private:
+  uint8_t noteFor_(const EEGMidi_Map& m, uint8_t step) const;
+
+  EEGMidi_Table t_ = {};
+  uint8_t last_[EEGMIDI_MAX_MAPS] = {};  // último v (CC) o escalón (NOTE)
+  uint8_t note_[EEGMIDI_MAX_MAPS] = {};  // nota sonando o EEGMIDI_NO_NOTE
+  uint8_t sent_[EEGMIDI_MAX_MAPS] = {};  // CC: ya se envió algún valor
+  // Notas de una tabla anterior pendientes de apagar (status NoteOff, nota)
+  EEGMidi_Msg pendingOff_[EEGMIDI_MAX_MAPS] = {};
+  uint8_t nPendingOff_ = 0;
+};
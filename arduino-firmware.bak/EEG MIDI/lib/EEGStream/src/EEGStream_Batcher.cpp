@@ -0,0 +1,92 @@
+// EEGStream_Batcher.cpp
+
+#include "EEGStream_Batcher.h"
+
+EEGStream_Batcher::EEGStream_Batcher(uint8_t* buf, uint16_t cap, uint8_t nch, uint8_t nstatus,
+                                     uint8_t maxSamples, uint32_t flushUs)
+    : pkt_(buf, cap), cap_(cap), nch_(nch), nstatus_(nstatus),
+      maxSamples_(maxSamples), reqSamples_(maxSamples), flushUs_(flushUs), nact_(nch)
+{
+  mask_ = allChannels_();
+  // Limitar el lote a lo que cabe en el buffer y en un payload
+  setMaxSamples(maxSamples);
+  reset();
+}
+
+bool EEGStream_Batcher::setMaxSamples(uint8_t maxSamples)
+{
+  if (count_ != 0 || maxSamples == 0)
+    return false;
+  const uint16_t header = (uint16_t)(EEG_BATCH_HEADER + (mask_ != allChannels_() ? EEG_CH_MASK_SIZE : 0));
+  uint16_t rec = (uint16_t)(3u * (nact_ + nstatus_));
+  uint16_t room = (cap_ > EEG_OVERHEAD + header) ? (uint16_t)(cap_ - EEG_OVERHEAD - header) : 0;
+  if (room > EEG_MAX_PAYLOAD - header)
+    room = (uint16_t)(EEG_MAX_PAYLOAD - header);
+  uint16_t fit = rec ? (uint16_t)(room / rec) : 0;
+  if (fit == 0)
+    return false;
+  reqSamples_ = maxSamples;
+  maxSamples_ = (fit < maxSamples) ? (uint8_t)fit : maxSamples;
+  return true;
+}
+
+bool EEGStream_Batcher::setChannelMask(uint32_t mask)
+{
+  if (count_ != 0 || mask == 0 || (mask & ~allChannels_()) != 0)
+    return false;
+  mask_ = mask;
+  nact_ = EEG_ChannelCount(mask);
+  setMaxSamples(reqSamples_);
+  reset();
+  return true;
+}
+
+void EEGStream_Batcher::reset()
+{
+  count_ = 0;
+  pkt_.begin(EEG_PKT_BATCH);
+  // Cabecera del lote; base_idx y n_samples se rellenan en finish()
+  pkt_.putU32(0);
+  pkt_.putU8(0);
+  if (mask_ == allChannels_())
+  {
+    pkt_.putU8(nch_);
+    pkt_.putU8(nstatus_);
+    return;
+  }
+  pkt_.putU8((uint8_t)(nch_ | EEG_CH_MASKED));
+  pkt_.putU8(nstatus_);
+  pkt_.putU32(mask_);
+}
+
+bool EEGStream_Batcher::accepts(uint32_t idx) const
+{
+  if (count_ == 0)
+    return true;
+  return count_ < maxSamples_ && idx == baseIdx_ + count_;
+}
+
+void EEGStream_Batcher::add(uint32_t idx, const uint32_t* status, const int32_t* ch, uint32_t nowUs)
+{
+  if (count_ == 0)
+  {
+    baseIdx_ = idx;
+    firstUs_ = nowUs;
+  }
+  for (uint8_t s = 0; s < nstatus_; ++s)
+    pkt_.putU24BE(status[s]);
+  for (uint8_t c = 0; c < nact_; ++c)
+    pkt_.putU24BE((uint32_t)ch[c]); // los 24 bits bajos conservan el complemento a 2
+  ++count_;
+}
+
+uint16_t EEGStream_Batcher::finish(uint8_t seq)
+{
+  uint8_t* p = pkt_.payload();
+  p[0] = (uint8_t)(baseIdx_ & 0xFF);
+  p[1] = (uint8_t)((baseIdx_ >> 8) & 0xFF);
+  p[2] = (uint8_t)((baseIdx_ >> 16) & 0xFF);
+  p[3] = (uint8_t)((baseIdx_ >> 24) & 0xFF);
+  p[4] = count_;
+  return pkt_.finish(seq);
+}
@@ -0,0 +1,86 @@
+// EEGStream_Batcher.h
+// Acumula N muestras consecutivas en un único paquete EEG_PKT_BATCH con los
+// canales empaquetados en 24 bits (3 bytes, MSB-first), sin sign-extension.
+// Una sola cabecera con base_idx por lote: el overhead por muestra pasa de
+// 8 + 4 bytes (SAMPLE) a (8 + 7) / N. Con setChannelMask() solo viajan los
+// canales activos.
+//
+// Uso típico:
+//   if (!b.accepts(idx)) flush();     // lote lleno o hueco en los índices
+//   b.add(idx, status, ch, micros());
+//   if (b.full() || b.due(micros())) flush();
+// donde flush() = b.finish(seq) + escribir b.data()/b.size() + b.reset().
+//
+// Portable: no depende de Arduino.h (el tiempo lo aporta el llamador).
+
+#pragma once
+#include <stdint.h>
+#include "EEGStream_Packet.h"
+
+class EEGStream_Batcher {
+public:
+  // Tamaño de buffer necesario para un lote de maxSamples muestras (con
+  // sitio para la máscara de canales: con uno solo apagado no sobra nada).
+  // Nunca más que un payload: setMaxSamples() recorta el lote a EEG_MAX_PAYLOAD
+  static constexpr uint16_t bufferSize(uint8_t maxSamples, uint8_t nch, uint8_t nstatus) {
+    return EEG_BATCH_HEADER + EEG_CH_MASK_SIZE + (uint32_t)maxSamples * 3u * (nch + nstatus) > EEG_MAX_PAYLOAD
+               ? (uint16_t)(EEG_OVERHEAD + EEG_MAX_PAYLOAD)
+               : (uint16_t)(EEG_OVERHEAD + EEG_BATCH_HEADER + EEG_CH_MASK_SIZE +
+                            (uint16_t)maxSamples * 3u * (nch + nstatus));
+  }
+
+  // buf: bufferSize() bytes; flushUs: antigüedad máxima de la primera muestra
+  EEGStream_Batcher(uint8_t* buf, uint16_t cap, uint8_t nch, uint8_t nstatus,
+                    uint8_t maxSamples, uint32_t flushUs);
+
+  // true si la muestra idx puede añadirse al lote actual (hay sitio y es
+  // consecutiva a la anterior). Si es false hay que cerrar el lote antes.
+  bool accepts(uint32_t idx) const;
+
+  // Añade una muestra. status: n_status palabras de 24 bits; ch: los canales
+  // activos (n_ch sin máscara), compactos.
+  void add(uint32_t idx, const uint32_t* status, const int32_t* ch, uint32_t nowUs);
+
+  bool empty() const { return count_ == 0; }
+  bool full() const { return count_ >= maxSamples_; }
+  // true si la primera muestra del lote lleva más de flushUs esperando
+  bool due(uint32_t nowUs) const { return count_ && (uint32_t)(nowUs - firstUs_) >= flushUs_; }
+
+  uint8_t count() const { return count_; }
+  uint32_t baseIdx() const { return baseIdx_; }
+
+  // Cierra el paquete con el nº de secuencia dado. Devuelve su tamaño total.
+  uint16_t finish(uint8_t seq);
+  const uint8_t* data() const { return pkt_.data(); }
+  uint16_t size() const { return pkt_.size(); }
+
+  // Descarta el lote (tras enviarlo) y prepara uno nuevo
+  void reset();
+
+  // Cambia el tamaño de lote en caliente (se aplica con el lote vacío)
+  bool setMaxSamples(uint8_t maxSamples);
+  uint8_t maxSamples() const { return maxSamples_; }
+
+  // Solo los canales de mask (bit c = canal c de los n_ch) van en el lote,
+  // con la máscara en la cabecera (EEG_CH_MASKED). Con el lote vacío; caben
+  // más muestras por paquete hasta el tamaño pedido en setMaxSamples().
+  bool setChannelMask(uint32_t mask);
+  uint32_t channelMask() const { return mask_; }
+
+private:
+  uint32_t allChannels_() const { return nch_ >= 32 ? 0xFFFFFFFFUL : (1UL << nch_) - 1; }
+
+  EEGStream_PacketBuilder pkt_;
+  uint16_t cap_;
+  uint8_t nch_;
+  uint8_t nstatus_;
+  uint8_t maxSamples_;
+  uint8_t reqSamples_;   // tamaño pedido (maxSamples_ puede ser menor si no cabe)
+  uint32_t flushUs_;
+  uint32_t mask_;
+  uint8_t nact_;         // canales en el lote (popcount de mask_)
+
+  uint8_t count_ = 0;
+  uint32_t baseIdx_ = 0;
+  uint32_t firstUs_ = 0;
+};
@@ -0,0 +1,119 @@
+// EEGStream_Packet.cpp
+
+#include "EEGStream_Packet.h"
+#include <string.h>
+
+// ---- CRC-16/CCITT-FALSE ----
+// Tabla de 16 entradas (nibble): 32 bytes y dos búsquedas por byte,
+// buen compromiso tamaño/velocidad para AVR.
+static const uint16_t kCrcNibble[16] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+uint16_t EEG_Crc16Update(uint16_t crc, const uint8_t* data, uint16_t n)
+{
+  while (n--)
+  {
+    uint8_t b = *data++;
+    crc = (uint16_t)((crc << 4) ^ kCrcNibble[(uint8_t)((crc >> 12) ^ (b >> 4))]);
+    crc = (uint16_t)((crc << 4) ^ kCrcNibble[(uint8_t)((crc >> 12) ^ (b & 0x0F))]);
+  }
+  return crc;
+}
+
+// ---- Builder ----
+void EEGStream_PacketBuilder::begin(uint8_t type)
+{
+  pos_ = EEG_HEADER_SIZE;
+  size_ = 0;
+  overflow_ = (cap_ < EEG_OVERHEAD);
+  if (!overflow_)
+    buf_[2] = type;
+}
+
+bool EEGStream_PacketBuilder::putU8(uint8_t v)
+{
+  if (overflow_ || payloadRoom() < 1)
+  {
+    overflow_ = true;
+    return false;
+  }
+  buf_[pos_++] = v;
+  return true;
+}
+
+bool EEGStream_PacketBuilder::putU16(uint16_t v)
+{
+  if (overflow_ || payloadRoom() < 2)
+  {
+    overflow_ = true;
+    return false;
+  }
+  buf_[pos_++] = (uint8_t)(v & 0xFF);
+  buf_[pos_++] = (uint8_t)(v >> 8);
+  return true;
+}
+
+bool EEGStream_PacketBuilder::putU32(uint32_t v)
+{
+  if (overflow_ || payloadRoom() < 4)
+  {
+    overflow_ = true;
+    return false;
+  }
+  for (uint8_t i = 0; i < 4; ++i)
+  {
+    buf_[pos_++] = (uint8_t)(v & 0xFF);
+    v >>= 8;
+  }
+  return true;
+}
+
+bool EEGStream_PacketBuilder::putU24BE(uint32_t v)
+{
+  if (overflow_ || payloadRoom() < 3)
+  {
+    overflow_ = true;
+    return false;
+  }
+  buf_[pos_++] = (uint8_t)((v >> 16) & 0xFF);
+  buf_[pos_++] = (uint8_t)((v >> 8) & 0xFF);
+  buf_[pos_++] = (uint8_t)(v & 0xFF);
+  return true;
+}
+
+bool EEGStream_PacketBuilder::putBytes(const uint8_t* p, uint16_t n)
+{
+  if (overflow_ || payloadRoom() < n)
+  {
+    overflow_ = true;
+    return false;
+  }
+  memcpy(&buf_[pos_], p, n);
+  pos_ += n;
+  return true;
+}
+
+uint16_t EEGStream_PacketBuilder::finish(uint8_t seq)
+{
+  uint16_t len = payloadSize();
+  if (overflow_ || len > EEG_MAX_PAYLOAD)
+  {
+    size_ = 0;
+    return 0;
+  }
+
+  buf_[0] = EEG_SYNC0;
+  buf_[1] = EEG_SYNC1;
+  buf_[3] = seq;
+  buf_[4] = (uint8_t)(len & 0xFF);
+  buf_[5] = (uint8_t)(len >> 8);
+
+  uint16_t crc = EEG_Crc16Update(EEG_CRC16_INIT, &buf_[2], (uint16_t)(len + 4));
+  buf_[pos_++] = (uint8_t)(crc & 0xFF);
+  buf_[pos_++] = (uint8_t)(crc >> 8);
+
+  size_ = pos_;
+  return size_;
+}
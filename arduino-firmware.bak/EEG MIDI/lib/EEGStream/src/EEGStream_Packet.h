@@ -0,0 +1,51 @@
+// EEGStream_Packet.h
+// Construcción in-place de paquetes del protocolo EEGStream.
+// El payload se escribe directamente en el buffer de salida (sin copias):
+//   begin(type) → put*() → finish(seq) → data()/size()
+// Portable: no depende de Arduino.h.
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "EEGStream_Protocol.h"
+
+class EEGStream_PacketBuilder {
+public:
+  // buf debe tener capacidad para EEG_OVERHEAD + payload máximo esperado
+  EEGStream_PacketBuilder(uint8_t* buf, uint16_t cap) : buf_(buf), cap_(cap) {}
+
+  // Inicia un paquete nuevo del tipo indicado (descarta el anterior)
+  void begin(uint8_t type);
+
+  // Añaden campos al payload. Devuelven false si no caben (el paquete
+  // queda marcado como desbordado y finish() devolverá 0).
+  bool putU8 (uint8_t v);
+  bool putU16(uint16_t v);                 // little-endian
+  bool putU32(uint32_t v);                 // little-endian
+  bool putI32(int32_t v) { return putU32((uint32_t)v); }
+  bool putU24BE(uint32_t v);               // 3 bytes MSB-first (formato nativo ADS1299)
+  bool putBytes(const uint8_t* p, uint16_t n);
+
+  // Cierra el paquete: escribe cabecera y CRC. Devuelve el tamaño total
+  // (cabecera + payload + CRC) o 0 si hubo desbordamiento.
+  uint16_t finish(uint8_t seq);
+
+  // Bytes de payload escritos hasta ahora y espacio restante
+  uint16_t payloadSize() const { return (uint16_t)(pos_ - EEG_HEADER_SIZE); }
+  uint16_t payloadRoom() const {
+    return (pos_ + EEG_CRC_SIZE >= cap_) ? 0 : (uint16_t)(cap_ - pos_ - EEG_CRC_SIZE);
+  }
+
+  // Acceso directo al payload (p.ej. para rellenar campos tras escribir datos)
+  uint8_t* payload() { return &buf_[EEG_HEADER_SIZE]; }
+
+  const uint8_t* data() const { return buf_; }
+  uint16_t size() const { return size_; }
+
+private:
+  uint8_t* buf_;
+  uint16_t cap_;
+  uint16_t pos_ = EEG_HEADER_SIZE;
+  uint16_t size_ = 0;
+  bool overflow_ = false;
+};
@@ -0,0 +1,237 @@
+// EEGStream_Protocol.h
+// Definición del protocolo de paquetes binarios Arduino ↔ host (ver docs/protocol.md).
+// Cabecera portable (solo <stdint.h>): la comparten el firmware y las
+// herramientas nativas del host.
+//
+// Formato de paquete (little-endian):
+//   [0]    0xA5          sync 0
+//   [1]    0x5A          sync 1
+//   [2]    type          tipo de paquete (EEG_PKT_*)
+//   [3]    seq           nº de secuencia (uint8, +1 por paquete, con wrap)
+//   [4..5] len           longitud del payload en bytes (uint16)
+//   [6..]  payload       len bytes
+//   [..+2] crc16         CRC-16/CCITT-FALSE sobre type..payload (sin sync)
+//
+// El receptor busca el sync, valida len <= EEG_MAX_PAYLOAD y comprueba el CRC;
+// si algo falla avanza un byte y vuelve a buscar, así que un byte perdido
+// solo cuesta el paquete afectado.
+
+#pragma once
+#include <stdint.h>
+
+// =========================
+//  Framing
+// =========================
+enum : uint8_t {
+  EEG_SYNC0 = 0xA5,
+  EEG_SYNC1 = 0x5A,
+};
+
+static constexpr uint8_t  EEG_HEADER_SIZE  = 6;    // sync(2) + type + seq + len(2)
+static constexpr uint8_t  EEG_CRC_SIZE     = 2;
+static constexpr uint8_t  EEG_OVERHEAD     = EEG_HEADER_SIZE + EEG_CRC_SIZE;
+static constexpr uint16_t EEG_MAX_PAYLOAD  = 1024; // cota para resincronizar rápido
+
+// Cabecera del payload BATCH: base_idx(4) + n_samples + n_ch + n_status
+static constexpr uint8_t  EEG_BATCH_HEADER = 7;
+
+// Cabecera del payload RICE: la de BATCH + flags + chain
+static constexpr uint8_t  EEG_RICE_HEADER  = 9;
+
+// Payload TIMING: sample_idx + t_drdy_us + t_tx_us
+static constexpr uint8_t  EEG_TIMING_PAYLOAD = 12;
+
+// Payload STATS: sample_idx + 4 contadores u32 + loop_max_us u16 + 2 × u8
+static constexpr uint8_t  EEG_STATS_PAYLOAD  = 24;
+
+// Cabecera del payload FEATURES: sample_idx + n_ch + n_bands + window
+static constexpr uint8_t  EEG_FEATURES_HEADER = 8;
+
+// Payload ACK: cmd + cmd_seq + status + sample_idx + configuración vigente
+static constexpr uint8_t  EEG_ACK_PAYLOAD = 22;
+// Payload PONG: cmd_seq + token + t_rx_us + t_tx_us
+static constexpr uint8_t  EEG_PONG_PAYLOAD = 13;
+
+// Cabecera del payload STATUS: sample_idx + flags + n_status
+static constexpr uint8_t  EEG_STATUS_HEADER = 6;
+// flags de EEG_PKT_STATUS
+static constexpr uint8_t  EEG_STATUS_CHANGED = 0x01;  // 0: estado inicial o repetición
+
+// Cabecera del payload STORED: offset + remaining
+static constexpr uint8_t  EEG_STORED_HEADER = 8;
+
+// Payload GAP: first_idx + n_samples + recovery_us + attempts + flags
+static constexpr uint8_t  EEG_GAP_PAYLOAD = 14;
+// flags de EEG_PKT_GAP
+static constexpr uint8_t  EEG_GAP_RESTORED = 0x01;  // hizo falta RESET y reescribir registros
+static constexpr uint8_t  EEG_GAP_FAILED   = 0x02;  // algún intento no verificó los registros
+
+// Canales activos (BATCH, RICE, FEATURES): con el bit EEG_CH_MASKED en n_ch,
+// la cabecera fija va seguida de [uint32 ch_mask] y el payload solo lleva
+// los popcount(ch_mask) canales activos, en orden de la cadena; n_ch & 0x7F
+// sigue siendo el nº total de canales (columnas) del flujo. Sin el bit, todos.
+static constexpr uint8_t  EEG_CH_MASKED    = 0x80;
+static constexpr uint8_t  EEG_CH_MASK_SIZE = 4;
+
+// Nº de canales de una máscara
+static inline uint8_t EEG_ChannelCount(uint32_t mask) {
+  uint8_t n = 0;
+  for (; mask; mask &= mask - 1) ++n;
+  return n;
+}
+
+// =========================
+//  Tipos de paquete
+// =========================
+enum : uint8_t {
+  // Una muestra: [uint32 sample_idx][int32 ch0]..[int32 chN-1]
+  // (mismo contenido que el antiguo frame de 4 + 4*N bytes)
+  EEG_PKT_SAMPLE = 0x01,
+
+  // Lote de muestras consecutivas con canales en 24 bits nativos:
+  //   [uint32 base_idx][uint8 n_samples][uint8 n_ch][uint8 n_status]
+  //   ([uint32 ch_mask] si n_ch & EEG_CH_MASKED)
+  //   n_samples × ( n_status × STATUS(3B) , n_activos × CH(3B) )
+  // STATUS y CH van MSB-first (tal como salen del ADS1299, ver unpack24).
+  // La muestra k del lote tiene índice base_idx + k.
+  EEG_PKT_BATCH  = 0x02,
+
+  // Lote comprimido sin pérdidas (predicción + Rice adaptativo, ver EEGStream_Rice.h):
+  //   [uint32 base_idx][uint8 n_samples][uint8 n_ch][uint8 n_status]
+  //   [uint8 flags][uint8 chain]([uint32 ch_mask] si n_ch & EEG_CH_MASKED)
+  //   [bitstream MSB-first, relleno a byte]
+  // flags bit0 = keyframe, bits1-2 = orden del predictor (0..2).
+  // chain: +1 por paquete RICE; un paquete no-keyframe solo se decodifica si
+  // el anterior de la cadena llegó (si no, se espera al siguiente keyframe).
+  EEG_PKT_RICE   = 0x03,
+
+  // Marcas de tiempo de una muestra (micros() del firmware, wrap cada ~71 min):
+  //   [uint32 sample_idx][uint32 t_drdy_us][uint32 t_tx_us]
+  // t_drdy_us: flanco de DRDY de esa muestra; t_tx_us: al terminar de escribir
+  // en el transporte el paquete de datos que la contiene (va justo después de
+  // él). Se envía cada TIMING_INTERVAL paquetes de datos.
+  EEG_PKT_TIMING = 0x04,
+
+  // Contadores de salud de la adquisición, cada STATS_INTERVAL_MS:
+  //   [uint32 sample_idx][uint32 sync_errors][uint32 drdy_missed]
+  //   [uint32 ring_overruns][uint32 tx_dropped]
+  //   [uint16 loop_max_us][uint8 ring_hwm][uint8 ring_size]
+  // Los uint32 son totales desde el arranque (con wrap); loop_max_us y
+  // ring_hwm son máximos desde el paquete STATS anterior.
+  EEG_PKT_STATS  = 0x05,
+
+  // Potencia por banda EEG de cada canal (modo features, en vez de muestras):
+  //   [uint32 sample_idx][uint8 n_ch][uint8 n_bands][uint16 window]
+  //   ([uint32 ch_mask] si n_ch & EEG_CH_MASKED)
+  //   n_activos × n_bands × uint32 potencia (canal mayor, bandas delta..gamma)
+  // Potencia media cuadrática en LSB² (seno de amplitud A → A²/2) de las
+  // `window` muestras que terminan en sample_idx, saturada a 0xFFFFFFFF.
+  EEG_PKT_FEATURES = 0x06,
+
+  // Una muestra con solo los canales activos (EEG_PKT_SAMPLE cuando no
+  // están todos):
+  //   [uint32 sample_idx][uint8 n_ch][uint32 ch_mask][int32 × popcount(ch_mask)]
+  // n_ch: nº total de canales (columnas) del flujo.
+  EEG_PKT_SAMPLE_MASKED = 0x07,
+
+  // Evento de STATUS (lead-off P/N y GPIO de cada ADS1299, 9.4.4.2):
+  //   [uint32 sample_idx][uint8 flags][uint8 n_status][n_status × STATUS(3B)]
+  // Se envía cuando cambia algún bit de lead-off (de los canales activos) o
+  // de GPIO, en lugar de un STATUS por muestra en BATCH/RICE (n_status = 0).
+  // sample_idx: primera muestra con el estado nuevo. Con EEG_STATUS_CHANGED
+  // a 0 es el estado al arrancar la adquisición o su repetición periódica.
+  // STATUS va MSB-first, como en BATCH.
+  EEG_PKT_STATUS = 0x08,
+
+  // Tramo del flujo guardado en la memoria externa (store-and-forward, ver
+  // EEGStream_Store.h):
+  //   [uint32 offset][uint32 remaining][bytes]
+  // Los bytes son paquetes de datos completos (SAMPLE, BATCH, RICE...) tal
+  // como se generaron, con su seq y CRC originales, concatenados y troceados
+  // sin respetar fronteras: el host los pasa por otro parser. offset: posición
+  // del primer byte en el flujo guardado (uint32 con wrap; un salto = tramo
+  // perdido); remaining: bytes que quedan guardados tras este tramo.
+  EEG_PKT_STORED = 0x09,
+
+  // Hueco por pérdida de sincronía del ADS1299 (frames seguidos sin el
+  // patrón de STATUS, ver ADS1299Core::recoverSync()):
+  //   [uint32 first_idx][uint32 n_samples][uint32 recovery_us]
+  //   [uint8 attempts][uint8 flags (EEG_GAP_*)]
+  // Las muestras first_idx .. first_idx + n_samples - 1 no existen; se envía
+  // justo antes de la primera muestra válida tras el hueco. recovery_us:
+  // tiempo dentro de los ciclos SDATAC/RDATAC (o RESET) de los attempts
+  // intentos; el resto del hueco son los frames malos hasta detectarlo.
+  EEG_PKT_GAP    = 0x0A,
+
+  // Comando host → Arduino (plano de control, mismo framing):
+  //   [uint8 cmd][argumentos según EEG_CMD_*]
+  // seq es el del host (su propia cuenta); el ACK lo devuelve.
+  EEG_PKT_CMD    = 0x10,
+
+  // Respuesta a un EEG_PKT_CMD, ya aplicado (o rechazado):
+  //   [uint8 cmd][uint8 cmd_seq][uint8 status (EEG_ACK_*)][uint32 sample_idx]
+  //   [uint16 sps][uint8 mode][uint8 batch][uint8 filter][uint8 transport]
+  //   [uint8 acquiring][uint32 ch_mask][uint32 baud]
+  // sample_idx: primera muestra de salida con la configuración nueva. El
+  // resto es la configuración vigente tras el comando (mode = tipo de
+  // paquete de datos: SAMPLE, BATCH, RICE o FEATURES).
+  EEG_PKT_ACK    = 0x11,
+
+  // Respuesta a EEG_CMD_TIME_PING (en lugar del ACK), para sincronizar el
+  // reloj del host con micros() del firmware:
+  //   [uint8 cmd_seq][uint32 token][uint32 t_rx_us][uint32 t_tx_us]
+  // token: el del comando, tal cual. t_rx_us: micros() al completar el
+  // paquete del comando; t_tx_us: al encolar esta respuesta (la espera en la
+  // cola de salida cuenta como retardo de vuelta: el host se queda con los
+  // pings de menor ida y vuelta).
+  EEG_PKT_PONG   = 0x12,
+
+  // Texto de diagnóstico ASCII (sin terminador). Nunca se mezcla con datos.
+  EEG_PKT_DIAG   = 0x7F,
+};
+
+// =========================
+//  Comandos (payload de EEG_PKT_CMD)
+// =========================
+// Los que tocan la adquisición la paran (STOP + SDATAC), aplican el cambio y
+// la reanudan (RDATAC + START) si estaba en marcha: el lote en curso se
+// cierra antes y el primer paquete RICE después es keyframe.
+enum : uint8_t {
+  EEG_CMD_PING          = 0x01,  // sin argumentos: solo devuelve la configuración
+  EEG_CMD_START         = 0x02,  // arranca la adquisición
+  EEG_CMD_STOP          = 0x03,  // la para (sin datos hasta START)
+  EEG_CMD_SET_RATE      = 0x04,  // [uint16 sps de salida]
+  EEG_CMD_SET_MODE      = 0x05,  // [uint8 EEG_PKT_SAMPLE/BATCH/RICE/FEATURES]
+  EEG_CMD_SET_BATCH     = 0x06,  // [uint8 muestras por lote]
+  EEG_CMD_SET_FILTER    = 0x07,  // [uint8 EEGDsp_FilterSet]
+  EEG_CMD_SET_CHANNELS  = 0x08,  // [uint32 máscara de canales activos]
+  EEG_CMD_SET_BAUD      = 0x09,  // [uint32 baud] (ver handshake en docs/protocol.md)
+  EEG_CMD_SET_TRANSPORT = 0x0A,  // [uint8 0 = Serial, 1 = SPI al MCU DSP]
+  EEG_CMD_MIDI_TABLE    = 0x0B,  // [tabla EEGMidi en binario]
+  EEG_CMD_TIME_PING     = 0x0C,  // [uint32 token] → EEG_PKT_PONG (sin ACK)
+  EEG_CMD_SET_STORE     = 0x0D,  // [uint8 EEG_STORE_*]
+};
+
+// Modo de la memoria externa (EEG_CMD_SET_STORE)
+enum : uint8_t {
+  EEG_STORE_OFF    = 0,  // no se guarda nada; lo guardado sigue saliendo
+  EEG_STORE_SPILL  = 1,  // datos a la memoria solo con el enlace atascado
+  EEG_STORE_RECORD = 2,  // todos los datos a la memoria, sin vaciarla
+};
+
+// Estado del ACK
+enum : uint8_t {
+  EEG_ACK_OK          = 0,
+  EEG_ACK_UNKNOWN     = 1,  // comando desconocido
+  EEG_ACK_BAD_ARGS    = 2,  // longitud o valor fuera de rango
+  EEG_ACK_UNSUPPORTED = 3,  // no disponible en esta compilación / placa
+  EEG_ACK_DEVICE      = 4,  // el ADS1299 no aceptó la escritura
+};
+
+// =========================
+//  CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF, sin reflexión, xorout 0)
+// =========================
+static constexpr uint16_t EEG_CRC16_INIT = 0xFFFF;
+
+// Actualiza el CRC con un bloque (implementación en EEGStream_Packet.cpp).
+uint16_t EEG_Crc16Update(uint16_t crc, const uint8_t* data, uint16_t n);
@@ -0,0 +1,65 @@
+// EEGStream_Receiver.cpp
+
+#include "EEGStream_Receiver.h"
+
+// Valida lo que hay en el buffer: sync, longitud y, con el paquete entero, CRC
+EEGStream_Receiver::Check_ EEGStream_Receiver::check_()
+{
+  if (pos_ >= 1 && buf_[0] != EEG_SYNC0)
+    return BAD_;
+  if (pos_ >= 2 && buf_[1] != EEG_SYNC1)
+    return BAD_;
+  if (pos_ < EEG_HEADER_SIZE)
+    return MORE_;
+
+  uint16_t len = (uint16_t)(buf_[4] | (buf_[5] << 8));
+  if (len > EEG_MAX_PAYLOAD || cap_ < EEG_OVERHEAD || len > cap_ - EEG_OVERHEAD)
+  {
+    ++errors_;
+    return BAD_;
+  }
+  uint16_t total = (uint16_t)(EEG_OVERHEAD + len);
+  if (pos_ < total)
+    return MORE_;
+
+  uint16_t crc = EEG_Crc16Update(EEG_CRC16_INIT, &buf_[2], (uint16_t)(EEG_HEADER_SIZE - 2 + len));
+  uint16_t rx = (uint16_t)(buf_[EEG_HEADER_SIZE + len] | (buf_[EEG_HEADER_SIZE + len + 1] << 8));
+  if (crc != rx)
+  {
+    ++errors_;
+    return BAD_;
+  }
+  len_ = len;
+  return DONE_;
+}
+
+bool EEGStream_Receiver::feed(uint8_t b)
+{
+  if (done_)
+  {
+    done_ = false;
+    pos_ = 0;
+  }
+  if (pos_ >= cap_)
+    pos_ = 0; // no debería ocurrir: check_() limita len a cap
+  buf_[pos_++] = b;
+
+  for (;;)
+  {
+    Check_ r = check_();
+    if (r == MORE_)
+      return false;
+    if (r == DONE_)
+    {
+      done_ = true;
+      return true;
+    }
+    // Descartado: seguir desde el siguiente candidato a sync
+    uint16_t i = 1;
+    while (i < pos_ && buf_[i] != EEG_SYNC0)
+      ++i;
+    for (uint16_t j = i; j < pos_; ++j)
+      buf_[j - i] = buf_[j];
+    pos_ = (uint16_t)(pos_ - i);
+  }
+}
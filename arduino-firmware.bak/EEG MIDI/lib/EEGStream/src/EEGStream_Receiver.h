@@ -0,0 +1,48 @@
+// EEGStream_Receiver.h
+// Parser incremental de paquetes EEGStream en el lado que recibe (comandos
+// EEG_PKT_CMD del host en el firmware). Se le pasan los bytes de uno en uno
+// con feed(); cuando devuelve true hay un paquete completo con CRC válido
+// en type()/seq()/payload()/length(), hasta el siguiente feed().
+//
+// Mismas reglas que el receptor del host (eeg_protocol.PacketParser): busca
+// el sync, descarta cabeceras con len > cap y paquetes con CRC incorrecto, y
+// en ambos casos vuelve a buscar el sync a partir del byte siguiente al
+// primer sync del paquete descartado.
+//
+// Portable: no depende de Arduino.h (el llamador lee el puerto).
+
+#pragma once
+#include <stdint.h>
+#include "EEGStream_Protocol.h"
+
+class EEGStream_Receiver {
+public:
+  // buf/cap: almacenamiento del paquete completo (cabecera + payload + CRC);
+  // payloads de más de cap - EEG_OVERHEAD bytes se descartan
+  EEGStream_Receiver(uint8_t* buf, uint16_t cap) : buf_(buf), cap_(cap) {}
+
+  // Añade un byte. true si completa un paquete válido.
+  bool feed(uint8_t b);
+
+  uint8_t type() const { return buf_[2]; }
+  uint8_t seq() const { return buf_[3]; }
+  const uint8_t* payload() const { return &buf_[EEG_HEADER_SIZE]; }
+  uint16_t length() const { return len_; }
+
+  // Paquetes descartados por CRC o longitud desde el arranque
+  uint32_t errors() const { return errors_; }
+
+  // Descarta lo recibido a medias (p.ej. tras cambiar el baud rate)
+  void reset() { pos_ = 0; done_ = false; }
+
+private:
+  enum Check_ : uint8_t { MORE_, DONE_, BAD_ };
+  Check_ check_();
+
+  uint8_t* buf_;
+  uint16_t cap_;
+  uint16_t pos_ = 0;   // bytes del paquete en curso
+  uint16_t len_ = 0;   // payload del paquete completo
+  bool done_ = false;  // el buffer tiene un paquete ya entregado
+  uint32_t errors_ = 0;
+};
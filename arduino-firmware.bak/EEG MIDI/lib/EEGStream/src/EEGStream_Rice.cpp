@@ -0,0 +1,191 @@
+// EEGStream_Rice.cpp
+
+#include "EEGStream_Rice.h"
+
+static constexpr int32_t kMax24 = 8388607;
+static constexpr int32_t kMin24 = -8388608;
+
+EEGStream_RiceEncoder::EEGStream_RiceEncoder(uint8_t* buf, uint16_t cap, EEGStream_RiceState* state,
+                                             uint8_t nch, uint8_t nstatus, uint8_t maxSamples,
+                                             uint32_t flushUs, uint8_t order, uint8_t keyInterval)
+    : pkt_(buf, cap), st_(state), nch_(nch), nstatus_(nstatus),
+      maxSamples_(maxSamples ? maxSamples : 1), flushUs_(flushUs),
+      order_(order > 2 ? 2 : order), keyInterval_(keyInterval ? keyInterval : 1), nact_(nch)
+{
+  mask_ = allChannels_();
+  sinceKey_ = keyInterval_; // el primer paquete siempre es keyframe
+  reset();
+}
+
+void EEGStream_RiceEncoder::reset()
+{
+  count_ = 0;
+  acc_ = 0;
+  accBits_ = 0;
+
+  key_ = (sinceKey_ >= keyInterval_);
+  if (key_)
+  {
+    sinceKey_ = 0;
+    for (uint8_t i = 0; i < nact_ + nstatus_; ++i)
+    {
+      st_[i].h1 = 0;
+      st_[i].h2 = 0;
+      st_[i].a = EEG_RICE_A_INIT;
+      st_[i].n = 1;
+    }
+  }
+  ++sinceKey_;
+
+  pkt_.begin(EEG_PKT_RICE);
+  // base_idx, n_samples y chain se rellenan en finish()
+  pkt_.putU32(0);
+  pkt_.putU8(0);
+  const bool masked = mask_ != allChannels_();
+  pkt_.putU8((uint8_t)(masked ? nch_ | EEG_CH_MASKED : nch_));
+  pkt_.putU8(nstatus_);
+  pkt_.putU8((uint8_t)((key_ ? 0x01 : 0x00) | (order_ << 1)));
+  pkt_.putU8(0);
+  if (masked)
+    pkt_.putU32(mask_);
+}
+
+bool EEGStream_RiceEncoder::roomForSample_() const
+{
+  uint32_t roomBits = (uint32_t)pkt_.payloadRoom() * 8u;
+  return roomBits >= (uint32_t)accBits_ + worstSampleBits(nact_, nstatus_);
+}
+
+bool EEGStream_RiceEncoder::setMaxSamples(uint8_t maxSamples)
+{
+  if (count_ != 0 || maxSamples == 0)
+    return false;
+  maxSamples_ = maxSamples;
+  return true;
+}
+
+bool EEGStream_RiceEncoder::setChannelMask(uint32_t mask)
+{
+  if (count_ != 0 || mask == 0 || (mask & ~allChannels_()) != 0)
+    return false;
+  mask_ = mask;
+  nact_ = EEG_ChannelCount(mask);
+  // Los flujos del predictor cambian: el siguiente paquete arranca de cero
+  forceKeyframe();
+  reset();
+  return true;
+}
+
+bool EEGStream_RiceEncoder::accepts(uint32_t idx) const
+{
+  if (count_ == 0)
+    return roomForSample_();
+  return !full() && idx == baseIdx_ + count_;
+}
+
+// Añade n bits (n <= 24) MSB-first; los bytes completos pasan al paquete
+void EEGStream_RiceEncoder::putBits_(uint32_t v, uint8_t n)
+{
+  if (n == 0)
+    return;
+  acc_ = (acc_ << n) | (v & ((1UL << n) - 1));
+  accBits_ = (uint8_t)(accBits_ + n);
+  while (accBits_ >= 8)
+  {
+    accBits_ = (uint8_t)(accBits_ - 8);
+    pkt_.putU8((uint8_t)(acc_ >> accBits_));
+  }
+  acc_ &= (1UL << accBits_) - 1;
+}
+
+void EEGStream_RiceEncoder::encode_(EEGStream_RiceState& s, int32_t x)
+{
+  if (key_ && count_ == 0)
+  {
+    // Primera muestra del keyframe: en crudo, arranca el historial
+    putBits_((uint32_t)x & 0xFFFFFFUL, 24);
+    s.h1 = x;
+    s.h2 = x;
+    return;
+  }
+
+  int32_t pred = 0;
+  if (order_ == 1)
+  {
+    pred = s.h1;
+  }
+  else if (order_ == 2)
+  {
+    pred = 2 * s.h1 - s.h2;
+    if (pred > kMax24) pred = kMax24;
+    if (pred < kMin24) pred = kMin24;
+  }
+
+  // Con pred y x en 24 bits, |e| < 2^24 y u cabe en EEG_RICE_ESCBITS bits
+  int32_t e = x - pred;
+  uint32_t u = ((uint32_t)e << 1) ^ (e < 0 ? 0xFFFFFFFFUL : 0UL);
+
+  uint8_t k = 0;
+  while (k < 24 && ((uint32_t)s.n << k) < s.a)
+    ++k;
+
+  uint32_t q = u >> k;
+  if (q < EEG_RICE_QMAX)
+  {
+    putBits_(((1UL << q) - 1) << 1, (uint8_t)(q + 1)); // q unos + '0'
+    putBits_(u, k);
+  }
+  else
+  {
+    putBits_((1UL << EEG_RICE_QMAX) - 1, EEG_RICE_QMAX);
+    putBits_(u >> 24, EEG_RICE_ESCBITS - 24);
+    putBits_(u, 24);
+  }
+
+  s.a += u;
+  if (++s.n >= EEG_RICE_RESET)
+  {
+    s.a >>= 1;
+    s.n >>= 1;
+  }
+  s.h2 = s.h1;
+  s.h1 = x;
+}
+
+void EEGStream_RiceEncoder::add(uint32_t idx, const uint32_t* status, const int32_t* ch, uint32_t nowUs)
+{
+  if (count_ == 0)
+  {
+    baseIdx_ = idx;
+    firstUs_ = nowUs;
+  }
+  EEGStream_RiceState* s = st_;
+  for (uint8_t i = 0; i < nstatus_; ++i)
+  {
+    // STATUS como valor de 24 bits con signo: mismo rango que un canal
+    int32_t x = (int32_t)(status[i] & 0xFFFFFFUL);
+    if (x & 0x800000L) x -= 0x1000000L;
+    encode_(*s++, x);
+  }
+  for (uint8_t c = 0; c < nact_; ++c)
+    encode_(*s++, ch[c]);
+  ++count_;
+}
+
+uint16_t EEGStream_RiceEncoder::finish(uint8_t seq)
+{
+  // Relleno con ceros hasta byte
+  if (accBits_)
+    pkt_.putU8((uint8_t)(acc_ << (8 - accBits_)));
+  accBits_ = 0;
+  acc_ = 0;
+
+  uint8_t* p = pkt_.payload();
+  p[0] = (uint8_t)(baseIdx_ & 0xFF);
+  p[1] = (uint8_t)((baseIdx_ >> 8) & 0xFF);
+  p[2] = (uint8_t)((baseIdx_ >> 16) & 0xFF);
+  p[3] = (uint8_t)((baseIdx_ >> 24) & 0xFF);
+  p[4] = count_;
+  p[8] = chain_++;
+  return pkt_.finish(seq);
+}
@@ -0,0 +1,115 @@
+// EEGStream_Rice.h
+// Compresión sin pérdidas del flujo de muestras en paquetes EEG_PKT_RICE.
+// Mismo uso que EEGStream_Batcher (accepts/add/full/due/finish/reset), pero
+// cada valor de 24 bits se sustituye por el residuo de un predictor lineal
+// codificado en Rice con parámetro k adaptativo por canal.
+//
+// Por cada flujo (palabras STATUS primero, luego canales):
+//   pred = 0 | x[n-1] | 2·x[n-1] - x[n-2]    (orden 0/1/2, saturado a 24 bits)
+//   e    = x - pred,  u = zigzag(e)          (0,-1,1,-2.. → 0,1,2,3..)
+//   q    = u >> k:  q < EEG_RICE_QMAX → q unos + '0' + k bits bajos de u
+//                   si no           → EEG_RICE_QMAX unos + u en 25 bits (escape)
+//   k    = mínimo tal que N·2^k >= A, con A = Σu y N = nº de valores
+//          (A y N se dividen a la mitad cada EEG_RICE_RESET valores, estilo LOCO-I)
+//
+// Keyframes: cada keyInterval paquetes (y en el primero) el estado del
+// predictor y de k se reinicia y la primera muestra de cada flujo va en
+// crudo (24 bits). Entre keyframes el estado continúa de un paquete al
+// siguiente, así que perder un paquete cuesta hasta el siguiente keyframe.
+//
+// Portable: no depende de Arduino.h. La referencia del decodificador está
+// en dsp-processor (eeg_protocol.RiceDecoder).
+
+#pragma once
+#include <stdint.h>
+#include "EEGStream_Packet.h"
+
+static constexpr uint8_t  EEG_RICE_QMAX    = 16; // cociente a partir del cual se escapa
+static constexpr uint8_t  EEG_RICE_ESCBITS = 25; // bits del valor crudo tras el escape
+static constexpr uint8_t  EEG_RICE_RESET   = 32; // periodo de reescalado de A/N
+static constexpr uint16_t EEG_RICE_A_INIT  = 64; // A inicial (k≈6 tras un keyframe)
+
+// Estado por flujo (uno por palabra STATUS y por canal)
+struct EEGStream_RiceState {
+  int32_t  h1;  // x[n-1]
+  int32_t  h2;  // x[n-2]
+  uint32_t a;   // suma acumulada de u
+  uint8_t  n;   // nº de valores acumulados en a
+};
+
+class EEGStream_RiceEncoder {
+public:
+  // Peor caso en bits de una muestra (todos los flujos escapados)
+  static constexpr uint16_t worstSampleBits(uint8_t nch, uint8_t nstatus) {
+    return (uint16_t)((nch + nstatus) * (EEG_RICE_QMAX + EEG_RICE_ESCBITS));
+  }
+
+  // buf/cap: buffer del paquete; el lote se cierra cuando no queda sitio para
+  // otra muestra en el peor caso, así que cap no necesita cubrir maxSamples
+  // muestras escapadas (unas 2·(nch+nstatus) bytes por muestra es típico).
+  // state: nch + nstatus entradas. order: 0..2. keyInterval >= 1 paquetes.
+  // nch: canales del flujo (todos activos hasta setChannelMask()).
+  EEGStream_RiceEncoder(uint8_t* buf, uint16_t cap, EEGStream_RiceState* state,
+                        uint8_t nch, uint8_t nstatus, uint8_t maxSamples,
+                        uint32_t flushUs, uint8_t order, uint8_t keyInterval);
+
+  bool accepts(uint32_t idx) const;
+  void add(uint32_t idx, const uint32_t* status, const int32_t* ch, uint32_t nowUs);
+
+  bool empty() const { return count_ == 0; }
+  bool full() const { return count_ >= maxSamples_ || !roomForSample_(); }
+  bool due(uint32_t nowUs) const { return count_ && (uint32_t)(nowUs - firstUs_) >= flushUs_; }
+
+  uint8_t count() const { return count_; }
+  uint32_t baseIdx() const { return baseIdx_; }
+
+  // Cierra el paquete (vacía el acumulador de bits y rellena la cabecera)
+  uint16_t finish(uint8_t seq);
+  const uint8_t* data() const { return pkt_.data(); }
+  uint16_t size() const { return pkt_.size(); }
+
+  // Prepara el siguiente paquete (keyframe si toca por keyInterval)
+  void reset();
+  // Obliga a que el próximo paquete sea keyframe (p.ej. tras reconfigurar)
+  void forceKeyframe() { sinceKey_ = keyInterval_; }
+
+  // Cambia el tamaño de lote en caliente (se aplica con el lote vacío; el
+  // buffer sigue cerrando antes el lote si no cabe otra muestra)
+  bool setMaxSamples(uint8_t maxSamples);
+  uint8_t maxSamples() const { return maxSamples_; }
+
+  // Solo los canales de mask (bit c = canal c de los nch) van en el lote, con
+  // la máscara en la cabecera (EEG_CH_MASKED); add() recibe los activos
+  // compactos. Con el lote vacío; el siguiente paquete es keyframe.
+  bool setChannelMask(uint32_t mask);
+  uint32_t channelMask() const { return mask_; }
+
+  // Bytes de payload de bitstream del lote actual (para estadísticas)
+  uint16_t payloadSize() const { return pkt_.payloadSize(); }
+
+private:
+  uint32_t allChannels_() const { return nch_ >= 32 ? 0xFFFFFFFFUL : (1UL << nch_) - 1; }
+  bool roomForSample_() const;
+  void putBits_(uint32_t v, uint8_t n);
+  void encode_(EEGStream_RiceState& s, int32_t x);
+
+  EEGStream_PacketBuilder pkt_;
+  EEGStream_RiceState* st_;
+  uint8_t nch_;
+  uint8_t nstatus_;
+  uint8_t maxSamples_;
+  uint32_t flushUs_;
+  uint8_t order_;
+  uint8_t keyInterval_;
+  uint32_t mask_;
+  uint8_t nact_;           // canales en el lote (popcount de mask_)
+
+  uint8_t count_ = 0;
+  uint32_t baseIdx_ = 0;
+  uint32_t firstUs_ = 0;
+  bool key_ = true;        // el paquete en curso es keyframe
+  uint8_t sinceKey_ = 0;   // paquetes desde el último keyframe
+  uint8_t chain_ = 0;      // contador de paquetes RICE
+  uint32_t acc_ = 0;       // acumulador de bits (MSB-first)
+  uint8_t accBits_ = 0;
+};
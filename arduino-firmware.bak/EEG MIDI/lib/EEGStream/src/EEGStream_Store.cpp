@@ -0,0 +1,139 @@
+// EEGStream_Store.cpp
+
+#include "EEGStream_Store.h"
+#include <string.h>
+
+bool EEGStream_Store::begin()
+{
+  ok_ = false;
+  ps_ = dev_.pageSize();
+  pages_ = dev_.pageCount();
+  const uint16_t ep = dev_.erasePages();
+  if (ps_ == 0 || (ps_ & (ps_ - 1)) != 0 || ep == 0 || dev_.burst() == 0)
+    return false;
+  if (pages_ % ep != 0 || ramBytes_ / ps_ < 2)
+    return false;
+
+  cap_ = pages_ * ps_;
+  unit_ = (uint32_t)ep * ps_;
+  slots_ = (uint8_t)(ramBytes_ / ps_ > 255 ? 255 : ramBytes_ / ps_);
+  // Borrado por adelantado: toda la RAM y un bloque más, para que lo que se
+  // acumula durante un borrado se programe después sin esperar a otro
+  ahead_ = ((uint32_t)slots_ * ps_ + unit_ - 1) / unit_ * unit_ + unit_;
+  if (cap_ < ahead_ + unit_)
+    return false;
+  head_ = tail_ = committed_ = 0;
+  commitPage_ = 0;
+  commitSlot_ = 0;
+  progOff_ = 0;
+  erasedAhead_ = 0;
+  ok_ = true;
+  return true;
+}
+
+bool EEGStream_Store::push(const uint8_t* data, uint16_t len)
+{
+  // Margen de los bloques borrados por adelantado (ver poll()); en RAM, las
+  // páginas aún sin programar
+  if (!ok_ || len == 0 || pending() + len > capacity() ||
+      tail_ - committed_ + len > (uint32_t)slots_ * ps_)
+  {
+    ++dropped_;
+    return false;
+  }
+
+  while (len > 0)
+  {
+    const uint16_t off = (uint16_t)(tail_ & (ps_ - 1));
+    const uint8_t s = (uint8_t)((commitSlot_ + (tail_ - off - committed_) / ps_) % slots_);
+    uint16_t n = (uint16_t)(ps_ - off);
+    if (n > len)
+      n = len;
+    memcpy(slot_(s) + off, data, n);
+    data += n;
+    len = (uint16_t)(len - n);
+    tail_ += n;
+  }
+  return true;
+}
+
+void EEGStream_Store::poll()
+{
+  if (!ok_ || dev_.busy())
+    return;
+
+  // Sin página llena que programar se borra el bloque siguiente mientras
+  // quepa en la reserva; con página, solo si no hay nada borrado
+  const bool full = tail_ - committed_ >= ps_;
+  if (erasedAhead_ == 0 || (!full && erasedAhead_ + unit_ <= ahead_))
+  {
+    const uint32_t page = (commitPage_ + erasedAhead_ / ps_) % pages_;
+    if (!dev_.erase(page))
+      ++errors_;
+    erasedAhead_ += unit_;
+    return;
+  }
+  if (!full)
+    return;
+
+  uint16_t n = dev_.burst();
+  if (n > ps_ - progOff_)
+    n = (uint16_t)(ps_ - progOff_);
+  if (!dev_.program(commitPage_, progOff_, slot_(commitSlot_) + progOff_, n))
+    ++errors_;
+  progOff_ = (uint16_t)(progOff_ + n);
+  if (progOff_ < ps_)
+    return;
+
+  // Página completa en la memoria: su hueco de RAM queda libre
+  progOff_ = 0;
+  committed_ += ps_;
+  erasedAhead_ -= ps_;
+  commitPage_ = (commitPage_ + 1) % pages_;
+  commitSlot_ = (uint8_t)((commitSlot_ + 1) % slots_);
+}
+
+// Página física del byte head_ (ya en la memoria); off = head_ dentro de la página
+uint32_t EEGStream_Store::headPage_(uint16_t off) const
+{
+  const uint32_t back = (committed_ - (head_ - off)) / ps_;
+  return (commitPage_ + pages_ - back % pages_) % pages_;
+}
+
+uint16_t EEGStream_Store::read(uint8_t* out, uint16_t max)
+{
+  if (!ok_ || empty() || max == 0)
+    return 0;
+
+  const uint16_t off = (uint16_t)(head_ & (ps_ - 1));
+  uint32_t n = pending();
+  if (n > max)
+    n = max;
+  if (n > (uint32_t)(ps_ - off))
+    n = ps_ - off;
+
+  const uint32_t inFlash = committed_ - head_;
+  if (inFlash != 0 && inFlash <= cap_)
+  {
+    if (n > inFlash)
+      n = inFlash;
+    if (n > dev_.burst())
+      n = dev_.burst();
+    if (dev_.busy())
+      return 0;
+    if (!dev_.read(headPage_(off), off, out, (uint16_t)n))
+    {
+      // El tramo se pierde: el host ve el salto de offset
+      ++errors_;
+      head_ += n;
+      return 0;
+    }
+  }
+  else
+  {
+    const uint8_t s = (uint8_t)((commitSlot_ + (head_ - off - committed_) / ps_) % slots_);
+    memcpy(out, slot_(s) + off, n);
+  }
+  head_ += n;
+  return (uint16_t)n;
+}
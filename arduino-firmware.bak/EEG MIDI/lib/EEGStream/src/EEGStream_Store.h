@@ -0,0 +1,112 @@
+// EEGStream_Store.h
+// Store-and-forward: FIFO de bytes (paquetes completos, tal cual) sobre una
+// memoria paginada externa (flash NOR SPI...). Cuando el enlace se atasca,
+// los paquetes de datos se guardan aquí en vez de descartarse y salen más
+// tarde, troceados en paquetes EEG_PKT_STORED, con el hueco que deje el flujo
+// en vivo.
+//
+//   st.push(pkt, len);        // paquete completo o nada (nunca bloquea)
+//   st.poll();                // cada loop(): un paso de borrado/programación
+//   n = st.read(buf, max);    // siguiente tramo del flujo guardado
+//
+// La escritura va a través de RAM: las páginas se llenan en `ram` y se
+// programan enteras, en ráfagas de burst() bytes, solo con la memoria libre
+// (busy() = false): ninguna llamada espera a la memoria. Los bloques de
+// borrado se borran por adelantado (mientras no hay página que programar)
+// hasta cubrir toda la RAM y un bloque más: lo que se acumula en RAM durante
+// un borrado se programa después sin esperar a otro. Esa reserva queda
+// siempre libre entre lo escrito y lo pendiente de leer; el borrado nunca
+// pisa datos sin leer. Lo que aún no está en la memoria se lee
+// directamente de RAM.
+//
+// Las posiciones son offsets en el flujo guardado (uint32 con wrap): offset()
+// es el del próximo byte de read(), el que lleva EEG_PKT_STORED para que el
+// host detecte huecos. El contenido no sobrevive a un reinicio.
+//
+// Portable: no depende de Arduino.h; el dispositivo concreto lo implementa
+// el firmware.
+
+#pragma once
+#include <stdint.h>
+
+// Memoria paginada. program()/erase() solo lanzan la operación (la memoria
+// queda busy()); read() es síncrono y solo se llama con la memoria libre.
+class EEGStream_PageDevice {
+public:
+  virtual uint16_t pageSize() const = 0;    // potencia de 2
+  virtual uint32_t pageCount() const = 0;   // múltiplo de erasePages()
+  virtual uint16_t erasePages() const = 0;  // páginas por bloque de borrado
+  virtual uint16_t burst() const = 0;       // bytes máximos por program()/read()
+  virtual bool busy() = 0;
+  // Borra el bloque que empieza en page (múltiplo de erasePages())
+  virtual bool erase(uint32_t page) = 0;
+  // Programa n bytes (n <= burst()) de page a partir de off (dentro de la página)
+  virtual bool program(uint32_t page, uint16_t off, const uint8_t* data, uint16_t n) = 0;
+  virtual bool read(uint32_t page, uint16_t off, uint8_t* data, uint16_t n) = 0;
+};
+
+class EEGStream_Store {
+public:
+  // ram: al menos 2 páginas (ramSize()); cada página más admite una ráfaga
+  // de datos más larga mientras la memoria está ocupada
+  static constexpr uint16_t ramSize(uint16_t pageSize, uint8_t pages) {
+    return (uint16_t)(pageSize * (pages < 2 ? 2 : pages));
+  }
+
+  EEGStream_Store(EEGStream_PageDevice& dev, uint8_t* ram, uint16_t ramBytes)
+      : dev_(dev), ram_(ram), ramBytes_(ramBytes) {}
+
+  // false si la geometría no es válida (página no potencia de 2, RAM de
+  // menos de 2 páginas, memoria sin sitio para la reserva de borrado y un
+  // bloque más); sin begin() no admite nada
+  bool begin();
+  bool ready() const { return ok_; }
+
+  // Guarda un paquete completo. false (y cuenta en dropped()) si no cabe en la
+  // memoria o en las páginas de RAM.
+  bool push(const uint8_t* data, uint16_t len);
+
+  // Avanza el borrado/programación pendiente (como mucho una operación)
+  void poll();
+
+  // Copia hasta max bytes del flujo guardado a partir de offset(). Devuelve
+  // los copiados (0 si no hay nada o la memoria está ocupada).
+  uint16_t read(uint8_t* out, uint16_t max);
+
+  uint32_t offset() const { return head_; }
+  uint32_t pending() const { return tail_ - head_; }
+  bool empty() const { return tail_ == head_; }
+  // Bytes que pueden llegar a estar pendientes a la vez
+  uint32_t capacity() const { return ok_ ? cap_ - ahead_ : 0; }
+
+  // Paquetes descartados por falta de sitio y operaciones fallidas
+  uint32_t dropped() const { return dropped_; }
+  uint32_t errors() const { return errors_; }
+
+private:
+  uint8_t* slot_(uint8_t s) const { return ram_ + (uint16_t)s * ps_; }
+  uint32_t headPage_(uint16_t off) const;
+
+  EEGStream_PageDevice& dev_;
+  uint8_t* ram_;
+  uint16_t ramBytes_;
+  bool ok_ = false;
+
+  uint16_t ps_ = 0;        // bytes por página
+  uint32_t pages_ = 0;     // páginas de la memoria
+  uint32_t cap_ = 0;       // bytes de la memoria
+  uint32_t unit_ = 0;      // bytes por bloque de borrado
+  uint32_t ahead_ = 0;     // bytes que se borran por adelantado (bloques enteros)
+  uint8_t slots_ = 0;      // páginas de RAM
+
+  uint32_t head_ = 0;      // próximo byte a leer
+  uint32_t tail_ = 0;      // próximo byte a guardar
+  uint32_t committed_ = 0; // bytes ya en la memoria (múltiplo de ps_)
+  uint32_t commitPage_ = 0;  // página física de committed_
+  uint8_t commitSlot_ = 0;   // página de RAM de committed_
+  uint16_t progOff_ = 0;     // bytes ya programados de esa página
+  uint32_t erasedAhead_ = 0; // bytes borrados a partir de committed_
+
+  uint32_t dropped_ = 0;
+  uint32_t errors_ = 0;
+};
@@ -0,0 +1,90 @@
+// EEGStream_Transport.cpp
+
+#include "EEGStream_Transport.h"
+
+// Longitud total del paquete que empieza offset bytes después de tail_
+uint16_t EEGStream_TxQueue::packetLenAt_(uint16_t offset) const
+{
+  uint16_t p = at_((uint16_t)(tail_ + offset));
+  uint16_t lo = buf_[at_((uint16_t)(p + 4))];
+  uint16_t hi = buf_[at_((uint16_t)(p + 5))];
+  return (uint16_t)(EEG_OVERHEAD + (lo | (hi << 8)));
+}
+
+// Descarta el paquete más antiguo que aún no se ha empezado a enviar
+bool EEGStream_TxQueue::dropOldest_()
+{
+  if (count_ == frontRem_)
+    return false; // solo queda el paquete en curso (o nada)
+
+  uint16_t victim = packetLenAt_(frontRem_);
+  if (frontRem_ == 0)
+  {
+    tail_ = at_((uint16_t)(tail_ + victim));
+  }
+  else
+  {
+    // El resto del paquete en curso se desplaza sobre el descartado
+    // (de atrás adelante: los tramos pueden solaparse)
+    for (uint16_t i = frontRem_; i-- > 0;)
+      buf_[at_((uint16_t)(tail_ + victim + i))] = buf_[at_((uint16_t)(tail_ + i))];
+    tail_ = at_((uint16_t)(tail_ + victim));
+  }
+  count_ = (uint16_t)(count_ - victim);
+  ++dropped_;
+  return true;
+}
+
+bool EEGStream_TxQueue::push(const uint8_t* pkt, uint16_t len, bool dropOldest)
+{
+  if (len < EEG_OVERHEAD || len > cap_)
+  {
+    ++dropped_;
+    return false;
+  }
+  while ((uint16_t)(cap_ - count_) < len)
+  {
+    if (!dropOldest || !dropOldest_())
+    {
+      ++dropped_;
+      return false;
+    }
+  }
+
+  uint16_t head = at_((uint16_t)(tail_ + count_));
+  for (uint16_t i = 0; i < len; ++i)
+  {
+    buf_[head] = pkt[i];
+    if (++head == cap_)
+      head = 0;
+  }
+  count_ = (uint16_t)(count_ + len);
+  return true;
+}
+
+uint16_t EEGStream_TxQueue::pump(EEGStream_Sink& sink)
+{
+  uint16_t total = 0;
+  while (count_)
+  {
+    uint16_t room = sink.writable();
+    if (room == 0)
+      break;
+    if (frontRem_ == 0)
+      frontRem_ = packetLenAt_(0);
+
+    // Tramo contiguo dentro del paquete en curso
+    uint16_t n = frontRem_;
+    if (n > (uint16_t)(cap_ - tail_)) n = (uint16_t)(cap_ - tail_);
+    if (n > room) n = room;
+
+    uint16_t w = sink.write(&buf_[tail_], n);
+    tail_ = at_((uint16_t)(tail_ + w));
+    count_ = (uint16_t)(count_ - w);
+    frontRem_ = (uint16_t)(frontRem_ - w);
+    total = (uint16_t)(total + w);
+    if (w < n)
+      break;
+  }
+  return total;
+}
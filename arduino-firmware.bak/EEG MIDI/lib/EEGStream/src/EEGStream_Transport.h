@@ -0,0 +1,62 @@
+// EEGStream_Transport.h
+// Transporte no bloqueante: cola de paquetes completos (staging) que se vacía
+// hacia un sink solo en la medida que este admite sin bloquear.
+//
+//   q.push(pkt, len, dropOldest);   // al generar un paquete (nunca bloquea)
+//   q.pump(sink);                   // cada loop(): escribe lo que quepa
+//
+// La cola guarda los paquetes tal cual (ya con framing y CRC); su longitud se
+// lee de la cabecera, así que no hay metadatos por paquete. Con la cola llena:
+//   - dropOldest = true : se descartan los paquetes más antiguos aún no
+//     empezados (el que está a medio enviar nunca se corta: rompería el framing)
+//   - dropOldest = false: se descarta el paquete nuevo
+// En ambos casos el host ve el hueco en seq (y en sample_idx si eran datos).
+//
+// Portable: no depende de Arduino.h; el sink concreto (Serial, SPI...) lo
+// implementa el firmware.
+
+#pragma once
+#include <stdint.h>
+#include "EEGStream_Protocol.h"
+
+// Destino de bytes sin bloqueo
+class EEGStream_Sink {
+public:
+  // Bytes que write() acepta ahora mismo sin bloquear
+  virtual uint16_t writable() = 0;
+  // Escribe hasta n bytes (n <= writable()); devuelve los escritos
+  virtual uint16_t write(const uint8_t* data, uint16_t n) = 0;
+};
+
+class EEGStream_TxQueue {
+public:
+  // buf/cap: almacenamiento de la cola; debe admitir al menos el paquete más grande
+  EEGStream_TxQueue(uint8_t* buf, uint16_t cap) : buf_(buf), cap_(cap) {}
+
+  // Encola un paquete completo. Devuelve false si se descartó (no cabe ni
+  // liberando los antiguos, o dropOldest = false y no hay sitio).
+  bool push(const uint8_t* pkt, uint16_t len, bool dropOldest);
+
+  // Escribe en el sink lo que admita. Devuelve los bytes escritos.
+  uint16_t pump(EEGStream_Sink& sink);
+
+  bool empty() const { return count_ == 0; }
+  uint16_t fill() const { return count_; }
+  uint16_t capacity() const { return cap_; }
+  uint16_t room() const { return (uint16_t)(cap_ - count_); }
+
+  // Paquetes descartados desde el arranque (propios y antiguos)
+  uint32_t dropped() const { return dropped_; }
+
+private:
+  uint16_t at_(uint16_t i) const { return (uint16_t)(i >= cap_ ? i - cap_ : i); }
+  uint16_t packetLenAt_(uint16_t offset) const;
+  bool dropOldest_();
+
+  uint8_t* buf_;
+  uint16_t cap_;
+  uint16_t tail_ = 0;      // siguiente byte a enviar
+  uint16_t count_ = 0;     // bytes en cola
+  uint16_t frontRem_ = 0;  // bytes que faltan del paquete a medio enviar (0 = en frontera)
+  uint32_t dropped_ = 0;
+};
@@ -7,18 +7,46 @@
 #include <SPI.h>
 #include "ADS1299Plus.h"
 #include "ADS1299_SafeSPI.h"
+#include "ADS1299_FrameRing.h"
+#include "EEGStream_Packet.h"
+#include "EEGStream_Batcher.h"
+#include "EEGStream_Rice.h"
+#include "EEGStream_Transport.h"
+#include "EEGStream_Receiver.h"
+#include "EEGStream_Store.h"
+#include "EEGDsp_Biquad.h"
+#include "EEGDsp_Decimator.h"
+#include "EEGDsp_BandPower.h"
+#include "EEGMidi_Mapper.h"
 
 // Pines de ejemplo — ajústalos según tu placa y wiring.
 // CS suele usarse en el pin 10 en muchos shields/placas Arduino.
 // DRDY debe conectarse a un pin digital que pueda leerse (ej. 2).
+// En ESP32 los GPIO 6–11 son de la flash: se usa el bus VSPI (SS = 5).
+// (El ESP32-S3 no tiene esa restricción y usa los pines por defecto.)
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_IDF_TARGET_ESP32)
+static constexpr uint8_t PIN_CS    = 5;
+static constexpr uint8_t PIN_DRDY  = 4;
+static constexpr uint8_t PIN_START = 16;
+static constexpr uint8_t PIN_RESET = 17;
+static constexpr uint8_t PIN_PWDN  = 21;
+#else
 static constexpr uint8_t PIN_CS    = 10;
-static constexpr uint8_t PIN_SCLK  = SCK;
-static constexpr uint8_t PIN_MOSI  = MOSI;
-static constexpr uint8_t PIN_MISO  = MISO;
 static constexpr uint8_t PIN_DRDY  = 2;
 static constexpr uint8_t PIN_START = 3;
 static constexpr uint8_t PIN_RESET = 4;
 static constexpr uint8_t PIN_PWDN  = 5;
+#endif
+static constexpr uint8_t PIN_SCLK  = SCK;
+static constexpr uint8_t PIN_MOSI  = MOSI;
+static constexpr uint8_t PIN_MISO  = MISO;
+
+// La ISR de DRDY debe estar en IRAM en ESP32
+#if defined(ARDUINO_ARCH_ESP32)
+#define DRDY_ISR_ATTR IRAM_ATTR
+#else
+#define DRDY_ISR_ATTR
+#endif
 
 // Instancia del wrapper SPI y del driver ADS1299Plus
 ADS1299_SafeSPI safeSpi(PIN_CS);
@@ -26,70 +54,1761 @@ ADS1299Plus::Pins adsPins = { PIN_CS, PIN_SCLK, PIN_MOSI, PIN_MISO, PIN_DRDY, PI
 ADS1299Plus ads(safeSpi, adsPins);
 
 // Configuración de salida hacia el microprocesador DSP
-// Si `BINARY_OUTPUT` es true, el Arduino enviará frames binarios
-// con el siguiente formato (little-endian):
-// [uint32_t sample_idx][int32_t ch0][int32_t ch1]...[int32_t chN]
-// Donde cada channel es un valor sign-extended de 24 bits en un int32_t.
+// Si `BINARY_OUTPUT` es true, por Serial solo viajan paquetes binarios del
+// protocolo EEGStream (ver docs/protocol.md y EEGStream_Protocol.h):
+//   [A5 5A][type][seq][len u16][payload][crc16]
+// Cada muestra va en un paquete EEG_PKT_SAMPLE con payload (little-endian)
+// [uint32_t sample_idx][int32_t ch0]...[int32_t chN-1], canales de 24 bits
+// sign-extended. Los mensajes de diagnóstico van como EEG_PKT_DIAG.
+// Si es false, la salida es texto legible para el monitor serie (sin binario).
 static const bool BINARY_OUTPUT = true;
 
+// Formato del flujo binario:
+//  - true : lotes EEG_PKT_BATCH de hasta BATCH_SAMPLES muestras consecutivas,
+//           canales (y STATUS) en 24 bits nativos bajo una sola cabecera.
+//  - false: un paquete EEG_PKT_SAMPLE por muestra (int32 por canal).
+// El lote se cierra al llenarse, al cumplirse BATCH_FLUSH_US desde su primera
+// muestra o si hay un hueco en sample_idx (los índices del lote son implícitos).
+static const bool BATCH_OUTPUT = true;
+static constexpr uint8_t  BATCH_SAMPLES  = 16;    // 4..32 según RAM/latencia
+static constexpr uint32_t BATCH_FLUSH_US = 50000; // latencia máxima añadida
+
+// Compresión sin pérdidas de los lotes (EEG_PKT_RICE en lugar de EEG_PKT_BATCH):
+// residuo del predictor de orden RICE_ORDER (0..2) codificado en Rice con k
+// adaptativo por canal. Keyframe cada RICE_KEY_INTERVAL paquetes: un paquete
+// perdido cuesta como mucho ese nº de lotes. Con EEG típico baja de ~3 B a
+// ~1 B por canal y muestra (ver docs/protocol.md). Requiere BATCH_OUTPUT.
+static const bool COMPRESS_OUTPUT = true;
+static constexpr uint8_t RICE_ORDER        = 1;
+static constexpr uint8_t RICE_KEY_INTERVAL = 8;   // 8 lotes ≈ 0.5 s a 250 SPS
+// El lote se cierra antes si no cabe; con daisy-chain (>8 canales) el buffer
+// debe admitir al menos una muestra en el peor caso (todas escapadas)
+static constexpr uint16_t RICE_BUF_MIN =
+    EEG_OVERHEAD + EEG_RICE_HEADER + (EEGStream_RiceEncoder::worstSampleBits(ADS1299Plus::NUM_CHANNELS, ADS1299Plus::NUM_DEVICES) + 7) / 8;
+static constexpr uint16_t RICE_BUF_SIZE = 2 * RICE_BUF_MIN > 160 ? 2 * RICE_BUF_MIN : 160;
+
+// Con BINARY_OUTPUT, emite además un paquete EEG_PKT_DIAG por frame con STATUS
+// y cuentas crudas (enteros, sin floats). Solo para depurar: multiplica el tráfico.
+static const bool DEBUG_TEXT = false;
+
+// Instrumentación de latencia: cada TIMING_INTERVAL paquetes de datos se envía
+// un EEG_PKT_TIMING con el micros() del DRDY de su primera muestra y el de su
+// escritura en el transporte (ver tools de latencia en dsp-processor).
+// 16 lotes de 16 muestras ≈ un registro por segundo a 250 SPS.
+static const bool TIMING_OUTPUT = true;
+static constexpr uint8_t TIMING_INTERVAL = 16;
+
+// Contadores de salud (EEG_PKT_STATS) cada STATS_INTERVAL_MS: errores de sync,
+// DRDY perdidos, desbordes de la cola, atascos del transporte, tiempo máximo
+// de loop() y ocupación máxima de la cola. 32 B/s de overhead.
+static const bool STATS_OUTPUT = true;
+static constexpr uint16_t STATS_INTERVAL_MS = 1000;
+
+// Eventos de STATUS (EEG_PKT_STATUS): el lead-off P/N y los GPIO de cada
+// ADS1299 (9.4.4.2) solo viajan cuando cambian, con el índice de la primera
+// muestra con el estado nuevo, en vez de 3 B de STATUS por dispositivo y
+// muestra en BATCH/RICE. Un cambio cuenta cuando dura STATUS_DEBOUNCE
+// muestras seguidas (el comparador de lead-off rebota cerca del umbral) y
+// el estado se repite cada STATUS_REFRESH_MS para un host que llegue tarde.
+// false: STATUS en cada muestra de BATCH/RICE, sin eventos.
+static const bool STATUS_EVENTS = true;
+static constexpr uint8_t  STATUS_DEBOUNCE = 4;      // 16 ms a 250 SPS
+static constexpr uint16_t STATUS_REFRESH_MS = 5000;
+
+// Recuperación de la sincronía (ADS1299Core::recoverSync()): con
+// SYNC_LOSS_FRAMES frames seguidos sin el patrón de STATUS (ruido en DOUT,
+// bytes perdidos tras un brownout) se sale de RDATAC, se relee el mapa de
+// registros contra la caché y se vuelve a entrar, sin reinicializar; solo
+// con registros corruptos RESET y reescritura de la caché. Unos 100 us a
+// 2 MHz: cuesta uno o dos frames más que los malos. Con BINARY_OUTPUT cada
+// hueco sale en un EEG_PKT_GAP con las muestras perdidas y lo que duró.
+static const bool SYNC_RECOVERY = true;
+static constexpr uint8_t SYNC_LOSS_FRAMES = 3;
+
+// Sobremuestreo y diezmado (lib/EEGDsp): el ADS1299 convierte a
+// OUTPUT_SPS × OVERSAMPLE_RATIO y un FIR por canal baja a OUTPUT_SPS antes
+// de filtrar y empaquetar. Mejor SNR en banda y antialiasing con el mismo
+// ancho de banda de enlace. OVERSAMPLE_RATIO = 1, 2, 4, 8 o 16:
+//  - hasta 4: una etapa de 10·R coeficientes;
+//  - 8 y 16: una etapa previa por R/4 (8·R/4 coeficientes) y la final por 4.
+// Coste por muestra de salida y canal: 40 MAC (R = 4), 168 (R = 16); el
+// setup() lo mide y lo manda en un DIAG. Solo para placas de 32 bits: en el
+// Uno la ISR ya no da abasto a 1 kSPS.
+// El índice de muestra (sample_idx de los paquetes, TIMING y STATS) es el de
+// salida; drdyUs es el DRDY de la última conversión que entra en la muestra.
+static constexpr uint16_t OUTPUT_SPS = 250;
+static constexpr uint8_t  OVERSAMPLE_RATIO = 1;
+static constexpr uint8_t  DECIM_R2 = OVERSAMPLE_RATIO > 4 ? 4 : OVERSAMPLE_RATIO;
+static constexpr uint8_t  DECIM_R1 = OVERSAMPLE_RATIO / DECIM_R2;
+static constexpr uint8_t  DECIM1_TAPS = DECIM_R1 > 1 ? 8 * DECIM_R1 : 0;
+static constexpr uint8_t  DECIM2_TAPS = DECIM_R2 > 1 ? 10 * DECIM_R2 : 0;
+static constexpr uint32_t ADC_SPS = (uint32_t)OUTPUT_SPS * OVERSAMPLE_RATIO;
+static_assert(DECIM_R1 * DECIM_R2 == OVERSAMPLE_RATIO && ADC_SPS <= 4000,
+              "OVERSAMPLE_RATIO: 1, 2, 4, 8 o 16 y ADC_SPS <= 4000");
+
+// CONFIG1.DR para ADC_SPS (250 SPS × 2^k)
+static constexpr uint8_t adcDataRate(uint32_t sps) {
+  return sps >= 4000 ? ADS_DR_4k : sps >= 2000 ? ADS_DR_2k : sps >= 1000 ? ADS_DR_1k
+       : sps >= 500 ? ADS_DR_500 : ADS_DR_250;
+}
+
+// Periodo nominal de DRDY (el de ADC_SPS, o el de EEG_CMD_SET_RATE). Un
+// flanco que llega más de 1.5 periodos después del anterior cuenta los que
+// faltan como perdidos y avanza sample_idx en consecuencia.
+static uint32_t drdy_period_us = 1000000UL / ADC_SPS;
+
+// Filtrado en el firmware (lib/EEGDsp): cascada de biquads Q2.30 por canal
+// sobre cada frame válido, antes de empaquetar. Quita DC/deriva y la red en
+// origen, y el flujo comprime mejor en RICE; el host puede saltarse el
+// detrend (DSPCore.preprocess(detrend=False)). STATUS no se toca.
+// En el Uno cuesta 20 B de RAM por sección y canal y ~0.3 ms por sección con
+// 8 canales: desactivado por defecto.
+#if defined(__AVR__)
+static constexpr EEGDsp_FilterSet FILTER_SET = EEGDSP_FILTER_NONE;
+#else
+static constexpr EEGDsp_FilterSet FILTER_SET = EEGDSP_FILTER_NOTCH50_BAND;
+#endif
+static constexpr float FILTER_FS = OUTPUT_SPS; // tras el diezmado
+
+// Modo features (lib/EEGDsp, EEG_PKT_FEATURES): en vez de las muestras se
+// envía la potencia por banda (delta..gamma) de cada canal sobre las últimas
+// FEATURE_WINDOW muestras ya filtradas, FEATURE_RATE_HZ veces por segundo.
+// DFT deslizante: cada muestra actualiza FEATURE_BINS bins por canal, sin
+// picos de CPU al emitir. Con 8 canales son 168 B/s frente a ~6 kB/s de BATCH.
+// RAM: 4·(FEATURE_WINDOW + 2·FEATURE_BINS) B por canal (~730 B con N = 128):
+// no cabe en el Uno junto al resto.
+static const bool FEATURE_OUTPUT = false;
+static constexpr uint16_t FEATURE_WINDOW = 128;  // potencia de 2: 0.51 s, bins de 1.95 Hz
+static constexpr uint8_t  FEATURE_RATE_HZ = 4;
+static constexpr uint16_t FEATURE_HOP = OUTPUT_SPS / FEATURE_RATE_HZ;
+static constexpr uint8_t  FEATURE_BINS = EEGDsp_bandPowerBins(FEATURE_WINDOW, OUTPUT_SPS);
+
+// Canales activos al arrancar (bit d·N + i = canal i del dispositivo d; el
+// host los cambia con EEG_CMD_SET_CHANNELS). Los demás se apagan (CHnSET.PD)
+// y no se leen, ni se filtran, ni viajan: los paquetes llevan solo los
+// activos y la máscara en la cabecera (EEG_CH_MASKED, ver docs/protocol.md).
+// Un montaje de 2 canales en un ADS1299-8 ocupa ~1/4 del enlace y de la CPU
+// por muestra. Con daisy-chain el patrón debe ser el mismo en cada ADS1299.
+static constexpr uint32_t ACTIVE_CHANNELS = ADS1299Plus::ALL_CHANNELS;
+
+// Plano de control (EEG_PKT_CMD, ver docs/protocol.md): el host cambia en
+// caliente por Serial la frecuencia de muestreo, el formato del flujo, el
+// tamaño de lote, los filtros, los canales activos, el baud rate y el
+// transporte; cada comando se responde con un EEG_PKT_ACK. Requiere
+// BINARY_OUTPUT. En las placas de 32 bits (CONTROL_BUFFERS) los buffers se
+// dimensionan para cualquier formato y juego de filtros; en el Uno se quedan
+// en lo que pide la configuración de arriba y el resto se responde con
+// EEG_ACK_UNSUPPORTED.
+static const bool CONTROL_INPUT = true;
+#if defined(__AVR__)
+static constexpr bool CONTROL_BUFFERS = false;
+#else
+static constexpr bool CONTROL_BUFFERS = CONTROL_INPUT;
+#endif
+// Bytes de Serial que loop() procesa como mucho por vuelta
+static constexpr uint8_t  CONTROL_BYTES_PER_LOOP = 64;
+// Baud rate de arranque y ventana, tras EEG_CMD_SET_BAUD, para que llegue un
+// comando válido al baud nuevo; si no llega se vuelve al anterior
+static constexpr uint32_t LINK_BAUD = 115200;
+static constexpr uint16_t BAUD_CONFIRM_MS = 2000;
+// Formatos y juegos de filtros disponibles en caliente
+static constexpr bool FEATURES_AVAILABLE = FEATURE_OUTPUT || CONTROL_BUFFERS;
+static constexpr bool BATCH_AVAILABLE = !COMPRESS_OUTPUT || CONTROL_BUFFERS;
+static constexpr uint8_t FILTER_STAGES_MAX = CONTROL_BUFFERS ? 3 : EEGDsp_filterSetStages(FILTER_SET);
+
+// Longitud máxima del texto de un paquete de diagnóstico
+static constexpr uint8_t DIAG_MAX_TEXT = 96;
+
 // Envío por SPI hacia el microprocesador DSP
 // Define el pin CS que selecciona al microprocesador (ajústalo al socket "MCU_SPI3 / Sock SE5 SPI").
 // Evita usar el mismo CS que el ADS1299 (PIN_CS).
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_IDF_TARGET_ESP32)
+static constexpr uint8_t PIN_MCU_CS = 15;
+#else
 static constexpr uint8_t PIN_MCU_CS = 9; // <--- cámbialo según tu wiring
-static const bool USE_SPI_FOR_DSP = true; // true = enviar por SPI, false = usar Serial
-
-// Contador de muestras enviado en cada frame
-static uint32_t sample_idx = 0;
-
-// Empaqueta y envía un frame por el puerto serie seleccionado.
-// Usa orden little-endian: LSB primero.
-static void sendSampleFrameBinary(Stream &serial, uint32_t idx, const int32_t ch[], uint8_t nchan) {
-  // Tamaño: 4 bytes (idx) + 4*nchan bytes (canales)
-  uint16_t len = 4 + 4 * nchan;
-  // Buffer en stack — cuidado con MCU con poca RAM; nchan típicamente pequeño (4/8)
-  uint8_t buf[4 + 4 * ADS1299Plus::NUM_CHANNELS];
-
-  // Empaquetar sample_idx (little-endian)
-  for (uint8_t i = 0; i < 4; ++i) buf[i] = (uint8_t)((idx >> (8 * i)) & 0xFF);
-
-  // Empaquetar canales (cada int32_t en little-endian)
-  for (uint8_t c = 0; c < nchan; ++c) {
-    int32_t v = ch[c];
-    uint16_t base = 4 + 4 * c;
-    for (uint8_t b = 0; b < 4; ++b) {
-      buf[base + b] = (uint8_t)((((uint32_t)v) >> (8 * b)) & 0xFF);
+#endif
+static const bool USE_SPI_FOR_DSP = false; // true = enviar por SPI, false = usar Serial
+// Reloj del enlace (el Uno llega a F_CPU/2 = 8 MHz; bajarlo con cables largos)
+static constexpr uint32_t SPI_DSP_CLOCK_HZ = 4000000;
+// Ráfaga máxima por transacción (CS bajo) y presupuesto de bytes por loop().
+// Una ráfaga de 64 B dura ~0.15 ms a 4 MHz: es lo máximo que se retrasa la
+// lectura de un frame del ADS1299 (el flanco de DRDY se marca siempre a tiempo).
+static constexpr uint16_t SPI_SINK_CHUNK = 64;
+static constexpr uint16_t SPI_SINK_BYTES_PER_LOOP = 512;
+// Handshake con el MCU (PIN_NONE para no usarlo):
+//  - PIN_MCU_DATA_READY (salida, activo bajo): hay paquetes en la cola.
+//  - PIN_MCU_REQ (entrada, activo bajo): el MCU puede recibir; solo se
+//    envía mientras esté bajo, así el MCU tira de los datos a su ritmo.
+static constexpr uint8_t PIN_NONE = 0xFF;
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_IDF_TARGET_ESP32)
+static constexpr uint8_t PIN_MCU_DATA_READY = 25;
+static constexpr uint8_t PIN_MCU_REQ        = 26;
+#else
+static constexpr uint8_t PIN_MCU_DATA_READY = 6;
+static constexpr uint8_t PIN_MCU_REQ        = 7;
+#endif
+
+// Salida por USB nativo (Teensy, RP2040, ESP32-S3 con TinyUSB; build flag
+// EEG_NATIVE_USB=1). Serial es un CDC y el baud rate no cuenta: lo que
+// limita es cuántos bytes lleva cada paquete USB. El flujo se acumula en
+// paquetes de USB_PACKET_SIZE bytes y se entregan llenos, o a medias si el
+// primer byte lleva USB_FLUSH_US esperando (cota de latencia añadida).
+// Mismos paquetes que por UART: en el host solo cambia el puerto.
+#ifndef EEG_NATIVE_USB
+#define EEG_NATIVE_USB 0
+#endif
+static const bool USB_NATIVE_OUTPUT = EEG_NATIVE_USB != 0;
+#if defined(__IMXRT1062__)
+static constexpr uint16_t USB_PACKET_SIZE = 512; // Teensy 4.x: USB de alta velocidad
+#else
+static constexpr uint16_t USB_PACKET_SIZE = 64;  // USB de velocidad completa
+#endif
+static constexpr uint32_t USB_FLUSH_US = 2000;
+// Sin USB nativo el buffer del sink no se usa: mínimo para no gastar RAM
+static constexpr uint16_t USB_BUF_SIZE = USB_NATIVE_OUTPUT ? USB_PACKET_SIZE : 1;
+
+// Salida USB-MIDI directa (build flag EEG_USB_MIDI=1): la potencia por bandas
+// (ventana FEATURE_WINDOW, ver modo features) pasa por la tabla de mapeo
+// (lib/EEGMidi) cada MIDI_HOP muestras y los CC/notas salen por el puerto
+// MIDI de la placa, sin pasar por el host. Retardo añadido: MIDI_HOP muestras
+// (8 ms a 250 SPS) + un intervalo USB (1 ms); el resto es la propia ventana.
+// El flujo de datos sigue saliendo por Serial como siempre.
+// Núcleos: Teensy con USB "Serial + MIDI" (USB_MIDI_SERIAL) y los que usan
+// Adafruit TinyUSB (USE_TINYUSB: RP2040 arduino-pico, SAMD de Adafruit).
+#ifndef EEG_USB_MIDI
+#define EEG_USB_MIDI 0
+#endif
+#if EEG_USB_MIDI && !defined(USB_MIDI_SERIAL)
+#if defined(USE_TINYUSB)
+#include <Adafruit_TinyUSB.h>
+#else
+#error "EEG_USB_MIDI: núcleo sin USB-MIDI (Teensy con USB_MIDI_SERIAL o USE_TINYUSB)"
+#endif
+#endif
+static const bool MIDI_OUTPUT = EEG_USB_MIDI != 0;
+static constexpr uint8_t MIDI_HOP = 2;
+static constexpr bool BAND_POWER_USED = FEATURES_AVAILABLE || MIDI_OUTPUT;
+
+// Transporte no bloqueante: todos los paquetes pasan por una cola de salida
+// (TX_QUEUE_SIZE bytes como mínimo; crece si el paquete más grande no cabe
+// con holgura) que loop() vacía hacia Serial o SPI solo con lo que el sink
+// admite sin bloquear.
+// Política ante sobrecarga sostenida (la cola se llena):
+//  - TX_OVERLOAD_DROP_OLDEST: se descartan los paquetes más antiguos en cola
+//    (prioriza latencia: lo que llega al host es reciente).
+//  - TX_OVERLOAD_COMPRESS: con la cola por encima de TX_HIGH_WATER se pasa a
+//    lotes comprimidos (EEG_PKT_RICE) hasta que lleva TX_RECOVER_MS por debajo
+//    de TX_LOW_WATER; si aun así se llena, se descartan los más antiguos.
+//    Sin efecto en modo RICE (ya comprime siempre).
+enum TxOverloadPolicy : uint8_t { TX_OVERLOAD_DROP_OLDEST, TX_OVERLOAD_COMPRESS };
+static constexpr TxOverloadPolicy TX_OVERLOAD_POLICY = TX_OVERLOAD_COMPRESS;
+static constexpr uint16_t TX_QUEUE_SIZE  = 320;
+static constexpr uint32_t TX_RECOVER_MS  = 2000;
+
+// Store-and-forward (EEGStream_Store.h) en una flash NOR SPI externa
+// (W25Qxx o compatible JEDEC, hasta 16 MB) en el bus del ADS1299 con CS en
+// PIN_STORE_CS. Se activa con el flag de compilación EEG_STORE=1; por
+// defecto no (en Uno no cabe: 16 KB de RAM de páginas).
+// Modos (EEG_CMD_SET_STORE, arranca en EEG_STORE_SPILL):
+//  - SPILL: con la cola de salida por encima de TX_HIGH_WATER los paquetes de
+//    datos van a la flash en vez de a la cola hasta que baja de TX_LOW_WATER.
+//    Lo guardado vuelve en paquetes EEG_PKT_STORED solo con la cola por
+//    debajo de TX_LOW_WATER: el flujo en vivo tiene prioridad.
+//  - RECORD: todos los paquetes de datos a la flash y ninguno en vivo; el
+//    límite es la flash, no el enlace. Mientras se borra un sector (tSE,
+//    45 ms típ., STORE_ERASE_MAX_MS máx.) no se programa nada y los datos se
+//    acumulan en las STORE_RAM_PAGES páginas de RAM: STORE_RECORD_BPS es el
+//    flujo que aguanta un borrado en el peor caso sin perder nada (~39 KB/s:
+//    1000 SPS con 4 canales o 500 con 8, contando un SAMPLE por muestra;
+//    test_storeRecord en test/test_bench lo comprueba). SET_STORE RECORD y
+//    SET_RATE con RECORD por encima devuelven BAD_ARGS. En media los
+//    borrados tienen que ir cerca del típico (~58 KB/s sostenidos con una
+//    programación de 0.4 ms por ráfaga); una flash con todos los borrados al
+//    máximo solo sostiene ~9 KB/s y lo que no cabe cuenta en txDropped.
+//    Volver a SPILL u OFF lo descarga. SPILL guarda al ritmo del flujo en
+//    vivo y tiene la misma cota.
+//  - OFF: no se guarda nada más; lo guardado sigue saliendo.
+// El destino cambia entre paquetes y el primer lote RICE de cada tramo es
+// keyframe: ambos flujos se decodifican por separado.
+// Cada acceso a la flash es una ráfaga de STORE_BURST bytes con el mismo
+// arbitraje que el sink SPI (la ISR de DRDY aplaza la lectura del frame).
+#ifndef EEG_STORE
+#define EEG_STORE 0
+#endif
+static const bool STORE_OUTPUT = EEG_STORE != 0;
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_IDF_TARGET_ESP32)
+static constexpr uint8_t PIN_STORE_CS = 27;
+#else
+static constexpr uint8_t PIN_STORE_CS = 8;
+#endif
+static constexpr uint32_t STORE_FLASH_CLOCK_HZ = 8000000;
+static constexpr uint16_t STORE_BURST = 64;       // ~70 us a 8 MHz, como SPI_SINK_CHUNK
+static constexpr uint8_t  STORE_RAM_PAGES = 64;    // páginas de 256 B en espera de programar
+static constexpr uint16_t STORE_ERASE_MAX_MS = 400; // tSE máx. de un sector de 4 KB (W25Q)
+static constexpr uint16_t STORE_PKT_DATA = 128;    // bytes guardados por EEG_PKT_STORED
+
+// Adquisición por interrupción: la ISR de DRDY (flanco de bajada) lee los
+// bytes del frame por SPI y los deja en una cola SPSC; loop() los desempaqueta
+// y los pasa al transporte. Con ADS1299_SPI_DMA (SAMD) la ISR solo lanza el
+// DMA sobre el slot libre de la cola; el slot se publica al terminar, mientras
+// la CPU procesa los anteriores (doble buffer o más, según ACQ_RING_SIZE).
+// Si es false se usa el sondeo clásico de digitalRead(PIN_DRDY) en loop().
+static const bool USE_DRDY_INTERRUPT = true;
+
+// Profundidad de la cola de frames (potencia de 2). 16 frames = 64 ms a 250 SPS.
+// Con daisy-chain cada frame crece 3 B por canal: se reduce para no agotar RAM
+// (16–32 canales requieren en la práctica una placa con más RAM que el Uno).
+// Las placas de 32 bits van holgadas: 64 frames = 4 ms a 16 kSPS.
+#if defined(__AVR__)
+static constexpr uint8_t ACQ_RING_SIZE = ADS1299Plus::NUM_CHANNELS > 8 ? 4 : 16;
+#else
+static constexpr uint8_t ACQ_RING_SIZE = 64;
+#endif
+
+// Frame adquirido: índice asignado en el flanco de DRDY (los huecos en
+// sample_idx indican frames perdidos por cola llena), micros() del flanco y
+// los bytes crudos de la cadena (ADS1299Plus::decodeFrame en loop()).
+struct AcqFrame {
+  uint32_t idx;
+  uint32_t drdyUs;
+  uint8_t  raw[ADS1299Plus::BYTES_PER_FRAME];
+};
+
+static ADS1299_FrameRing<AcqFrame, ACQ_RING_SIZE> acqRing;
+
+static EEGDsp_BiquadBank<ADS1299Plus::NUM_CHANNELS, FILTER_STAGES_MAX> filterBank;
+static EEGDsp_FirDecimator<ADS1299Plus::NUM_CHANNELS, DECIM1_TAPS> decim1;
+static EEGDsp_FirDecimator<ADS1299Plus::NUM_CHANNELS, DECIM2_TAPS> decim2;
+static EEGDsp_BandPower<ADS1299Plus::NUM_CHANNELS, BAND_POWER_USED ? FEATURE_WINDOW : 0,
+                        FEATURE_BINS> bandPower;
+
+// Contador de muestras: se incrementa en cada DRDY, se envíe o no el frame
+static volatile uint32_t sample_idx = 0;
+
+// ---- Configuración en caliente ----
+// Arrancan con la de compilación; el plano de control solo las cambia con la
+// adquisición parada (salvo el transporte y el baud rate, entre paquetes).
+static uint16_t output_sps = OUTPUT_SPS;
+static uint16_t feature_hop = FEATURE_HOP;
+// Tipo de paquete de datos: EEG_PKT_SAMPLE, BATCH, RICE o FEATURES
+static uint8_t stream_mode = FEATURE_OUTPUT ? EEG_PKT_FEATURES
+                           : !BATCH_OUTPUT  ? EEG_PKT_SAMPLE
+                           : COMPRESS_OUTPUT ? EEG_PKT_RICE : EEG_PKT_BATCH;
+static EEGDsp_FilterSet filter_set = FILTER_SET;
+static bool use_spi = USE_SPI_FOR_DSP;
+static uint32_t link_baud = LINK_BAUD;
+// Cambio de baud rate negociado (EEG_CMD_SET_BAUD): el ACK sale al baud
+// actual, se vacía la cola y se cambia; si en BAUD_CONFIRM_MS no llega un
+// comando válido al baud nuevo se vuelve al anterior.
+enum BaudState : uint8_t { BAUD_IDLE, BAUD_DRAIN, BAUD_CONFIRM };
+static BaudState baud_state = BAUD_IDLE;
+static uint32_t baud_pending = 0;
+static uint32_t baud_since_ms = 0;
+static bool baud_resume = false; // reanudar la adquisición al terminar
+// Canales encendidos (bit i = canal i de la cadena); ACTIVE_CHANNELS se
+// aplica en setup()
+static uint32_t channel_mask = ADS1299Plus::ALL_CHANNELS;
+// Bits de STATUS que generan eventos: sync, lead-off de los canales activos
+// (el patrón de un dispositivo, igual en todos) y GPIO
+static constexpr uint32_t statusEventBits(uint8_t devMask) {
+  return ADS_STATUS_SYNC_MASK | ((uint32_t)devMask << 12) | ((uint32_t)devMask << 4) | 0x0Fu;
+}
+static uint32_t status_bits = statusEventBits((uint8_t)((1u << ADS1299Plus::CHANNELS_PER_DEVICE) - 1));
+// true mientras el ADS1299 convierte (START) y se leen frames (RDATAC)
+static bool acquiring = false;
+
+// ---- Contadores de salud ----
+// Totales acumulados (uint32 con wrap: el host trabaja con diferencias) y
+// máximos de ventana, que se reinician en cada EEG_PKT_STATS. Los que toca
+// la ISR son volatile y se copian con interrupciones deshabilitadas.
+struct AcqStats {
+  volatile uint32_t drdyMissed;   // flancos de DRDY no atendidos a tiempo
+  volatile uint32_t ringOverruns; // frames descartados con la cola llena
+  volatile uint8_t  ringHwm;      // ocupación máxima de la cola en la ventana
+  uint32_t syncErrors;            // frames sin el patrón de sync en STATUS
+  uint32_t txDropped;             // paquetes descartados por la cola de salida llena
+  uint16_t loopMaxUs;             // duración máxima de loop() en la ventana
+};
+static AcqStats stats = {};
+static uint32_t last_drdy_us = 0;
+static bool drdy_seen = false;
+static uint32_t last_stats_ms = 0;
+// Recuperación de la sincronía en curso: la ISR asigna el índice sin leer
+static volatile bool sync_recovering = false;
+// El ADS1299 se reinició (RESET en recoverSync()): hasta su primer DRDY no
+// convierte, y ese hueco va al índice pero no cuenta como DRDY perdidos
+static volatile bool drdy_restarted = false;
+
+// Índice de la muestra cuyo DRDY llegó en t. Si desde el anterior pasó más de
+// 1.5 periodos, los flancos intermedios se perdieron (ISR bloqueada, loop en
+// sondeo demasiado lento): se cuentan y dejan su hueco en sample_idx.
+static uint32_t nextSampleIdx(uint32_t t) {
+  uint32_t idx = sample_idx;
+  if (drdy_seen) {
+    uint32_t dt = t - last_drdy_us;
+    if (dt > drdy_period_us + drdy_period_us / 2) {
+      uint32_t missed = (dt + drdy_period_us / 2) / drdy_period_us - 1;
+      if (!drdy_restarted) stats.drdyMissed = stats.drdyMissed + missed;
+      idx += missed;
+    }
+  }
+  drdy_restarted = false;
+  drdy_seen = true;
+  last_drdy_us = t;
+  sample_idx = idx + 1;
+  return idx;
+}
+
+// Nº de secuencia de paquete (uint8 con wrap) y buffer de construcción
+static uint8_t tx_seq = 0;
+// EEG_PKT_SAMPLE_MASKED con un solo canal apagado ocupa 1 byte más que SAMPLE
+static constexpr uint16_t SAMPLE_PAYLOAD = 4 + 1 + EEG_CH_MASK_SIZE + 4 * ADS1299Plus::NUM_CHANNELS;
+static constexpr uint16_t FEATURE_PAYLOAD =
+    FEATURES_AVAILABLE ? EEG_FEATURES_HEADER + 4 * EEGDSP_NUM_BANDS * ADS1299Plus::NUM_CHANNELS : 0;
+static constexpr uint16_t TX_PAYLOAD_BASE =
+    SAMPLE_PAYLOAD > DIAG_MAX_TEXT ? SAMPLE_PAYLOAD : DIAG_MAX_TEXT;
+static constexpr uint16_t TX_PAYLOAD_DATA =
+    FEATURE_PAYLOAD > TX_PAYLOAD_BASE ? FEATURE_PAYLOAD : TX_PAYLOAD_BASE;
+static constexpr uint16_t STORED_PAYLOAD = STORE_OUTPUT ? EEG_STORED_HEADER + STORE_PKT_DATA : 0;
+static constexpr uint16_t TX_PAYLOAD_MAX =
+    STORED_PAYLOAD > TX_PAYLOAD_DATA ? STORED_PAYLOAD : TX_PAYLOAD_DATA;
+static uint8_t txBuf[EEG_OVERHEAD + TX_PAYLOAD_MAX];
+static EEGStream_PacketBuilder txPkt(txBuf, sizeof(txBuf));
+
+// ---- Transporte ----
+// Sink Serial: solo escribe lo que cabe en el buffer de TX (nunca bloquea)
+class SerialSink : public EEGStream_Sink {
+public:
+  explicit SerialSink(Stream &s) : s_(s) {}
+  uint16_t writable() override {
+    int n = s_.availableForWrite();
+    return n > 0 ? (uint16_t)n : 0;
+  }
+  uint16_t write(const uint8_t *data, uint16_t n) override {
+    return (uint16_t)s_.write(data, n);
+  }
+private:
+  Stream &s_;
+};
+
+// ---- Arbitraje del bus SPI (ADS1299 + MCU DSP + flash) ----
+// Mientras el sink SPI o la flash tienen el bus, la ISR de DRDY solo marca el
+// flanco y asigna el índice; la lectura del frame se hace al terminar la ráfaga.
+static volatile bool spi_bus_lent = false;
+static volatile bool drdy_deferred = false;
+static uint32_t deferred_idx = 0;
+static uint32_t deferred_us = 0;
+static void acquireFrame(uint32_t idx, uint32_t t);
+static void finishFrameRead(bool wait);
+
+// Presta el bus a otro periférico para una ráfaga corta (el frame del
+// ADS1299 sigue válido hasta el próximo DRDY)
+static void lendSpiBus() {
+  noInterrupts();
+  finishFrameRead(true); // un DMA del ADS1299 en curso tiene el bus
+  spi_bus_lent = true;
+  safeSpi.releaseBus();
+  interrupts();
+}
+
+// Devuelve el bus y atiende el DRDY que llegase durante la ráfaga, en el
+// mismo contexto que la ISR (interrupciones deshabilitadas)
+static void reclaimSpiBus() {
+  noInterrupts();
+  safeSpi.acquireBus();
+  spi_bus_lent = false;
+  if (drdy_deferred) {
+    drdy_deferred = false;
+    acquireFrame(deferred_idx, deferred_us);
+  }
+  interrupts();
+}
+
+// Sink SPI hacia el MCU DSP (Arduino maestro, SPI_DSP_CLOCK_HZ, modo 0).
+// Ráfagas de hasta SPI_SINK_CHUNK bytes con interrupciones habilitadas.
+// Sale por SPI.transfer(buf, n), que en AVR solapa la carga del siguiente
+// byte y en los núcleos con DMA (SAMD/STM32/ESP32) la usa si está disponible.
+// El MCU recibe el mismo flujo de paquetes que el host por Serial.
+class SpiSink : public EEGStream_Sink {
+public:
+  SpiSink(uint8_t csPin, uint8_t readyPin, uint8_t reqPin)
+      : cs_(csPin), ready_(readyPin), req_(reqPin) {}
+  void begin() {
+    pinMode(cs_, OUTPUT);
+    digitalWrite(cs_, HIGH);
+    if (ready_ != PIN_NONE) {
+      pinMode(ready_, OUTPUT);
+      digitalWrite(ready_, HIGH);
+    }
+    if (req_ != PIN_NONE) pinMode(req_, INPUT_PULLUP);
+  }
+  // Presupuesto de bytes por loop(): acota lo que el envío retiene el loop
+  void refill() { budget_ = SPI_SINK_BYTES_PER_LOOP; }
+  // Línea de datos listos hacia el MCU
+  void setDataReady(bool pending) {
+    if (ready_ != PIN_NONE) digitalWrite(ready_, pending ? LOW : HIGH);
+  }
+  uint16_t writable() override {
+    if (req_ != PIN_NONE && digitalRead(req_) != LOW) return 0; // el MCU no pide
+    return budget_ < SPI_SINK_CHUNK ? budget_ : SPI_SINK_CHUNK;
+  }
+  uint16_t write(const uint8_t *data, uint16_t n) override {
+    // SPI.transfer(buf, n) pisa el buffer con lo recibido: copia local
+    uint8_t burst[SPI_SINK_CHUNK];
+    if (n > SPI_SINK_CHUNK) n = SPI_SINK_CHUNK;
+    memcpy(burst, data, n);
+
+    lendSpiBus();
+    SPI.beginTransaction(SPISettings(SPI_DSP_CLOCK_HZ, MSBFIRST, SPI_MODE0));
+    digitalWrite(cs_, LOW);
+    SPI.transfer(burst, n);
+    digitalWrite(cs_, HIGH);
+    SPI.endTransaction();
+    reclaimSpiBus();
+
+    budget_ = (uint16_t)(budget_ - n);
+    return n;
+  }
+private:
+  uint8_t cs_;
+  uint8_t ready_;
+  uint8_t req_;
+  uint16_t budget_ = 0;
+};
+
+// Sink USB nativo: agrupa el flujo en paquetes USB completos (ver USB_NATIVE_OUTPUT).
+// write() solo copia al paquete en curso; poll() lo entrega al CDC cuando está
+// lleno o vencido y el CDC tiene sitio para él entero.
+class UsbSink : public EEGStream_Sink {
+public:
+  explicit UsbSink(Stream &s) : s_(s) {}
+  uint16_t writable() override { return (uint16_t)(USB_BUF_SIZE - fill_); }
+  uint16_t write(const uint8_t *data, uint16_t n) override {
+    if (n > USB_BUF_SIZE - fill_) n = (uint16_t)(USB_BUF_SIZE - fill_);
+    if (fill_ == 0) firstUs_ = micros();
+    memcpy(&buf_[fill_], data, n);
+    fill_ = (uint16_t)(fill_ + n);
+    if (fill_ == USB_BUF_SIZE) poll(false);
+    return n;
+  }
+  // force: entregar ya aunque no esté lleno ni vencido (vaciado en setup())
+  void poll(bool force) {
+    if (fill_ == 0) return;
+    if (!force && fill_ < USB_BUF_SIZE && micros() - firstUs_ < USB_FLUSH_US) return;
+    int room = s_.availableForWrite();
+    if (room < (int)fill_) return; // el host no ha recogido: se reintenta
+    s_.write(buf_, fill_);
+    if (fill_ < USB_BUF_SIZE) sendNow_();
+    fill_ = 0;
+  }
+  bool idle() const { return fill_ == 0; }
+private:
+  // Un paquete corto no sale hasta el timeout del núcleo: forzarlo
+  void sendNow_() {
+#if defined(TEENSYDUINO)
+    Serial.send_now();
+#elif defined(ARDUINO_ARCH_RP2040)
+    s_.flush(); // tud_cdc_write_flush(), no espera al host
+#endif
+  }
+  Stream &s_;
+  uint8_t buf_[USB_BUF_SIZE];
+  uint16_t fill_ = 0;
+  uint32_t firstUs_ = 0;
+};
+
+static SerialSink serialSink(Serial);
+static UsbSink usbSink(Serial);
+static SpiSink spiSink(PIN_MCU_CS, PIN_MCU_DATA_READY, PIN_MCU_REQ);
+
+// ---- Flash SPI (store-and-forward) ----
+// NOR SPI con comandos JEDEC estándar (W25Qxx, 8.2): lectura 0x03, página
+// 0x02 (se admiten programaciones parciales de una página ya borrada) y
+// borrado de sector de 4 KB 0x20, con direcciones de 3 bytes. El sector es
+// la unidad de borrado más corta (tSE 45 ms típ. frente a 150 ms de un
+// bloque de 64 KB): es lo que tiene que cubrir la RAM del store. Cada comando
+// es una ráfaga corta con el bus prestado (lendSpiBus()); la espera de una
+// programación o un borrado se sondea en busy() (SR1.BUSY), nunca se bloquea.
+class SpiFlash : public EEGStream_PageDevice {
+public:
+  static constexpr uint16_t PAGE = 256;
+
+  explicit SpiFlash(uint8_t csPin) : cs_(csPin) {}
+
+  // Despierta la flash y lee el JEDEC ID; false si no responde, tiene menos
+  // de 256 KB o no se direcciona con 3 bytes
+  bool begin() {
+    pinMode(cs_, OUTPUT);
+    digitalWrite(cs_, HIGH);
+    uint8_t cmd = CMD_WAKE;
+    command_(&cmd, 1, nullptr, 0);
+    delayMicroseconds(5); // tRES1
+    cmd = CMD_JEDEC_ID;
+    uint8_t id[3] = {0, 0, 0};
+    command_(&cmd, 1, id, sizeof(id));
+    if (id[0] == 0x00 || id[0] == 0xFF || id[2] < 18 || id[2] > 24) return false;
+    pages_ = (1UL << id[2]) / PAGE;
+    busy_ = false;
+    return true;
+  }
+  uint32_t capacityBytes() const { return pages_ * PAGE; }
+
+  uint16_t pageSize() const override { return PAGE; }
+  uint32_t pageCount() const override { return pages_; }
+  uint16_t erasePages() const override { return SECTOR / PAGE; }
+  uint16_t burst() const override { return STORE_BURST; }
+
+  bool busy() override {
+    if (!busy_) return false;
+    uint8_t cmd = CMD_READ_SR1, sr = 0;
+    command_(&cmd, 1, &sr, 1);
+    busy_ = (sr & SR1_BUSY) != 0;
+    return busy_;
+  }
+  bool erase(uint32_t page) override { return write_(CMD_SECTOR_ERASE, page * PAGE, nullptr, 0); }
+  bool program(uint32_t page, uint16_t off, const uint8_t *data, uint16_t n) override {
+    return write_(CMD_PAGE_PROGRAM, page * PAGE + off, data, n);
+  }
+  bool read(uint32_t page, uint16_t off, uint8_t *data, uint16_t n) override {
+    if (n > STORE_BURST) return false;
+    uint8_t hdr[4];
+    header_(hdr, CMD_READ, page * PAGE + off);
+    command_(hdr, sizeof(hdr), data, n);
+    return true;
+  }
+
+private:
+  static constexpr uint32_t SECTOR = 4096;
+  enum : uint8_t {
+    CMD_WRITE_ENABLE = 0x06, CMD_READ_SR1 = 0x05, CMD_READ = 0x03, CMD_PAGE_PROGRAM = 0x02,
+    CMD_SECTOR_ERASE = 0x20, CMD_JEDEC_ID = 0x9F, CMD_WAKE = 0xAB,
+  };
+  static constexpr uint8_t SR1_BUSY = 0x01;
+
+  static void header_(uint8_t *h, uint8_t cmd, uint32_t addr) {
+    h[0] = cmd;
+    h[1] = (uint8_t)(addr >> 16);
+    h[2] = (uint8_t)(addr >> 8);
+    h[3] = (uint8_t)addr;
+  }
+
+  // WREN + comando con dirección y datos; la flash queda ocupada
+  bool write_(uint8_t cmdByte, uint32_t addr, const uint8_t *data, uint16_t n) {
+    if (n > STORE_BURST) return false;
+    uint8_t buf[4 + STORE_BURST];
+    header_(buf, cmdByte, addr);
+    if (n) memcpy(&buf[4], data, n);
+    uint8_t wren = CMD_WRITE_ENABLE;
+    command_(&wren, 1, nullptr, 0);
+    command_(buf, (uint16_t)(4 + n), nullptr, 0);
+    busy_ = true;
+    return true;
+  }
+
+  // Una transacción con CS bajo: out (se pisa con lo recibido) y luego n bytes a in
+  void command_(uint8_t *out, uint16_t nOut, uint8_t *in, uint16_t nIn) {
+    lendSpiBus();
+    SPI.beginTransaction(SPISettings(STORE_FLASH_CLOCK_HZ, MSBFIRST, SPI_MODE0));
+    digitalWrite(cs_, LOW);
+    SPI.transfer(out, nOut);
+    if (nIn) SPI.transfer(in, nIn);
+    digitalWrite(cs_, HIGH);
+    SPI.endTransaction();
+    reclaimSpiBus();
+  }
+
+  uint8_t cs_;
+  uint32_t pages_ = 0;
+  bool busy_ = false;
+};
+
+static SpiFlash storeFlash(PIN_STORE_CS);
+static uint8_t storeRam[STORE_OUTPUT ? EEGStream_Store::ramSize(SpiFlash::PAGE, STORE_RAM_PAGES) : 1];
+static EEGStream_Store store(storeFlash, storeRam, sizeof(storeRam));
+// Modo de la memoria (EEG_STORE_*) y destino de los paquetes de datos ahora
+static uint8_t store_mode = STORE_OUTPUT ? EEG_STORE_SPILL : EEG_STORE_OFF;
+static bool store_spilling = false; // SPILL con el enlace atascado
+static bool store_route = false;    // true: el paquete en construcción va a la flash
+
+// ---- USB-MIDI ----
+// Puerto MIDI de clase USB (ver MIDI_OUTPUT). send() nunca bloquea: con el
+// endpoint lleno (host que no lee) el mensaje se descarta.
+#if EEG_USB_MIDI && defined(USE_TINYUSB) && !defined(USB_MIDI_SERIAL)
+static Adafruit_USBD_MIDI usbMidiPort;
+#endif
+
+class MidiOut {
+public:
+  void begin() {
+#if EEG_USB_MIDI && defined(USE_TINYUSB) && !defined(USB_MIDI_SERIAL)
+    usbMidiPort.begin();
+    // La interfaz MIDI se añade tras la enumeración: reconectar para que el host la vea
+    if (TinyUSBDevice.mounted()) {
+      TinyUSBDevice.detach();
+      delay(10);
+      TinyUSBDevice.attach();
     }
+#endif
+  }
+  void send(const EEGMidi_Msg &m) {
+#if EEG_USB_MIDI && defined(USB_MIDI_SERIAL)
+    usbMIDI.send(m.status & 0xF0, m.data1, m.data2, (m.status & 0x0F) + 1, 0);
+#elif EEG_USB_MIDI
+    // Paquete USB-MIDI: cable 0 + CIN (= nibble alto del status en mensajes de canal)
+    const uint8_t pkt[4] = {(uint8_t)(m.status >> 4), m.status, m.data1, m.data2};
+    usbMidiPort.writePacket(pkt);
+#else
+    (void)m;
+#endif
+  }
+  // Entregar ya el paquete USB a medio llenar
+  void flush() {
+#if EEG_USB_MIDI && defined(USB_MIDI_SERIAL)
+    usbMIDI.send_now();
+#endif
   }
+};
+
+static MidiOut midiOut;
+static EEGMidi_Mapper midiMapper;
+
+// Cola de salida: todos los paquetes pasan por aquí y loop() la vacía hacia
+// el sink activo poco a poco, sin bloquear la adquisición.
+// Paquete más grande posible: lote BATCH, lote RICE o txPkt
+static constexpr bool RICE_USED =
+    COMPRESS_OUTPUT || TX_OVERLOAD_POLICY == TX_OVERLOAD_COMPRESS || CONTROL_BUFFERS;
+static constexpr uint16_t BATCH_PKT_MAX =
+    !BATCH_AVAILABLE ? 0 : EEGStream_Batcher::bufferSize(BATCH_SAMPLES, ADS1299Plus::NUM_CHANNELS,
+                                                        ADS1299Plus::NUM_DEVICES);
+static constexpr uint16_t RICE_PKT_MAX = RICE_USED ? RICE_BUF_SIZE : 0;
+static constexpr uint16_t STREAM_PKT_MAX =
+    BATCH_PKT_MAX > RICE_PKT_MAX ? BATCH_PKT_MAX : RICE_PKT_MAX;
+static constexpr uint16_t TX_PKT_MAX =
+    STREAM_PKT_MAX > EEG_OVERHEAD + TX_PAYLOAD_MAX ? STREAM_PKT_MAX : EEG_OVERHEAD + TX_PAYLOAD_MAX;
+static_assert(TX_PKT_MAX <= EEG_OVERHEAD + EEG_MAX_PAYLOAD, "TX_PKT_MAX mayor que un paquete válido");
+// Con STORE_OUTPUT caben 4 paquetes: las marcas de agua tienen que ver más
+// de uno para distinguir un enlace atascado de uno que va justo
+static constexpr uint16_t TX_QUEUE_MIN = STORE_OUTPUT ? 4 * TX_PKT_MAX : TX_PKT_MAX + TX_PKT_MAX / 4;
+static constexpr uint16_t TX_QUEUE_BYTES = TX_QUEUE_MIN > TX_QUEUE_SIZE ? TX_QUEUE_MIN : TX_QUEUE_SIZE;
+static constexpr uint16_t TX_HIGH_WATER = TX_QUEUE_BYTES * 3 / 4;
+static constexpr uint16_t TX_LOW_WATER  = TX_QUEUE_BYTES / 4;
+static_assert(TX_QUEUE_BYTES >= EEG_OVERHEAD + TX_PAYLOAD_MAX, "TX_QUEUE_SIZE demasiado pequeño");
+static uint8_t txQueueBuf[TX_QUEUE_BYTES];
+static EEGStream_TxQueue txQueue(txQueueBuf, sizeof(txQueueBuf));
+// Flujo que admite RECORD: lo que llega durante un borrado del peor caso
+// cabe en la RAM del store, sin contar la página a medio llenar y el
+// paquete más largo que sale de verdad (TX_PKT_MAX)
+static constexpr uint32_t STORE_RECORD_BPS =
+    ((uint32_t)EEGStream_Store::ramSize(SpiFlash::PAGE, STORE_RAM_PAGES) - SpiFlash::PAGE - TX_PKT_MAX) *
+    1000UL / STORE_ERASE_MAX_MS;
+
+static EEGStream_Sink &activeSink() {
+  if (use_spi) return spiSink;
+  if (USB_NATIVE_OUTPUT) return usbSink;
+  return serialSink;
+}
+
+// Escribe en el sink lo que admita ahora mismo
+static void transportPump() {
+  if (use_spi) spiSink.refill();
+  txQueue.pump(activeSink());
+  if (use_spi) spiSink.setDataReady(!txQueue.empty());
+  if (USB_NATIVE_OUTPUT) usbSink.poll(false);
+}
+
+// Vacía la cola esperando al sink (solo en setup(), errores fatales y
+// cambios de transporte o baud rate, con la adquisición parada)
+static void transportDrain() {
+  while (!txQueue.empty()) transportPump();
+  if (USB_NATIVE_OUTPUT) {
+    while (!usbSink.idle()) usbSink.poll(true);
+  }
+}
 
-  serial.write(buf, len);
+// Encola un paquete. Con la cola llena descarta los más antiguos (nunca el
+// que está a medio enviar); el host ve el hueco en seq.
+static void transportSend(const uint8_t *data, uint16_t len) {
+  if (!txQueue.push(data, len, true)) ++stats.txDropped;
 }
 
-// Enviar frame binario por SPI (MCU como esclavo, Arduino como maestro)
-// Envía LSB-first (little-endian) para cada campo.
-static void sendSampleFrameSPI(uint8_t csPin, uint32_t idx, const int32_t ch[], uint8_t nchan) {
-  // Configurar transacción SPI (1 MHz, modo 0)
-  SPI.beginTransaction(SPISettings(1000000, MSBFIRST, SPI_MODE0));
-  digitalWrite(csPin, LOW);
+// Paquetes de datos desde el último EEG_PKT_TIMING
+static uint8_t timing_pkts = 0;
 
-  // Enviar idx LSB-first
-  for (uint8_t i = 0; i < 4; ++i) {
-    SPI.transfer((uint8_t)((idx >> (8 * i)) & 0xFF));
+// Tras encolar un paquete de datos: de vez en cuando, sus marcas de tiempo.
+// idx/drdyUs son los de su primera muestra; txUs es el momento en que entra
+// en la cola de salida.
+static void noteDataSent(uint32_t idx, uint32_t drdyUs) {
+  uint32_t txUs = micros();
+  if (!TIMING_OUTPUT || ++timing_pkts < TIMING_INTERVAL) return;
+  timing_pkts = 0;
+
+  // txPkt ya está libre: el paquete de datos se copió a la cola
+  txPkt.begin(EEG_PKT_TIMING);
+  txPkt.putU32(idx);
+  txPkt.putU32(drdyUs);
+  txPkt.putU32(txUs);
+  uint16_t len = txPkt.finish(tx_seq++);
+  if (len) transportSend(txPkt.data(), len);
+}
+
+static void updateStoreRoute();
+
+// Paquete de datos ya cerrado: a la cola de salida o, con el destino en la
+// flash, a la memoria (sin EEG_PKT_TIMING: su t_tx no diría nada del enlace)
+static void sendData(const uint8_t *data, uint16_t len, uint32_t idx, uint32_t drdyUs) {
+  if (STORE_OUTPUT && store_route) {
+    if (!store.push(data, len)) ++stats.txDropped;
+    return;
   }
+  transportSend(data, len);
+  noteDataSent(idx, drdyUs);
+}
 
-  // Enviar canales (int32_t) LSB-first
-  for (uint8_t c = 0; c < nchan; ++c) {
-    uint32_t v = (uint32_t)ch[c];
-    for (uint8_t b = 0; b < 4; ++b) {
-      SPI.transfer((uint8_t)((v >> (8 * b)) & 0xFF));
+// Vacía la flash en paquetes EEG_PKT_STORED con el hueco que deja el flujo en
+// vivo (cola por debajo de TX_LOW_WATER); no con el enlace atascado, en
+// RECORD ni durante un cambio de baud (BAUD_DRAIN espera a la cola vacía:
+// con lo guardado saliendo detrás esperaría a toda la flash). SPILL pasa a
+// la flash desde TX_HIGH_WATER hasta volver a TX_LOW_WATER.
+static void drainStore() {
+  if (!STORE_OUTPUT) return;
+  store.poll();
+  uint16_t fill = txQueue.fill();
+  if (fill >= TX_HIGH_WATER) store_spilling = true;
+  else if (fill <= TX_LOW_WATER) store_spilling = false;
+  if (store_spilling || store_mode == EEG_STORE_RECORD || baud_state != BAUD_IDLE) return;
+  while (!store.empty() && txQueue.fill() <= TX_LOW_WATER) {
+    uint8_t buf[STORE_PKT_DATA];
+    const uint32_t offset = store.offset();
+    uint16_t n = 0, k;
+    while (n < STORE_PKT_DATA && (k = store.read(&buf[n], (uint16_t)(STORE_PKT_DATA - n))) > 0)
+      n = (uint16_t)(n + k);
+    if (n == 0) return; // flash ocupada: en el próximo loop()
+
+    txPkt.begin(EEG_PKT_STORED);
+    txPkt.putU32(offset);
+    txPkt.putU32(store.pending());
+    txPkt.putBytes(buf, n);
+    // Sin paquete no se gasta seq: el host vería un hueco que no existe
+    uint16_t len = txPkt.finish(tx_seq);
+    if (len) {
+      ++tx_seq;
+      transportSend(txPkt.data(), len);
     }
   }
+}
+
+// Empaqueta un frame en un paquete EEG_PKT_SAMPLE y lo encola.
+// Campos en little-endian: LSB primero.
+// Con todos los canales activos el nº es constante de compilación
+// (ADS1299_NUM_CHANNELS); si no, EEG_PKT_SAMPLE_MASKED con la máscara y
+// solo los activos (ch[] compacto, como lo deja decodeActive()).
+static void sendSampleFrameBinary(uint32_t idx, uint32_t drdyUs, const int32_t ch[]) {
+  updateStoreRoute();
+  const uint8_t n = ads.activeCount();
+  if (n == ADS1299Plus::NUM_CHANNELS) {
+    txPkt.begin(EEG_PKT_SAMPLE);
+    txPkt.putU32(idx);
+  } else {
+    txPkt.begin(EEG_PKT_SAMPLE_MASKED);
+    txPkt.putU32(idx);
+    txPkt.putU8(ADS1299Plus::NUM_CHANNELS);
+    txPkt.putU32(ads.activeChannels());
+  }
+  for (uint8_t c = 0; c < n; ++c) txPkt.putI32(ch[c]);
+
+  uint16_t len = txPkt.finish(tx_seq++);
+  if (len) sendData(txPkt.data(), len, idx, drdyUs);
+}
+
+// Paquete EEG_PKT_FEATURES con la potencia por banda de la ventana que
+// termina en la muestra idx (en LSB², ver EEGDsp_BandPower.h); solo los
+// canales activos, con la máscara si no lo están todos
+static void sendFeatures(uint32_t idx, uint32_t drdyUs) {
+  uint32_t p[ADS1299Plus::NUM_CHANNELS * EEGDSP_NUM_BANDS];
+  bandPower.bandPower(p);
+  updateStoreRoute();
+  const uint8_t n = ads.activeCount();
+  const bool masked = n != ADS1299Plus::NUM_CHANNELS;
+
+  txPkt.begin(EEG_PKT_FEATURES);
+  txPkt.putU32(idx);
+  txPkt.putU8((uint8_t)(masked ? ADS1299Plus::NUM_CHANNELS | EEG_CH_MASKED : ADS1299Plus::NUM_CHANNELS));
+  txPkt.putU8(EEGDSP_NUM_BANDS);
+  txPkt.putU16(FEATURE_WINDOW);
+  if (masked) txPkt.putU32(ads.activeChannels());
+  for (uint16_t k = 0; k < (uint16_t)n * EEGDSP_NUM_BANDS; ++k) txPkt.putU32(p[k]);
+
+  uint16_t len = txPkt.finish(tx_seq++);
+  if (len) sendData(txPkt.data(), len, idx, drdyUs);
+}
+
+// ---- Eventos de STATUS ----
+// Último estado enviado por dispositivo y el candidato a sustituirlo
+struct StatusTrack {
+  uint32_t sent[ADS1299Plus::NUM_DEVICES];
+  uint32_t next[ADS1299Plus::NUM_DEVICES];
+  uint32_t nextIdx;   // primera muestra con `next`
+  uint8_t  stable;    // muestras seguidas con `next` (0: ninguno)
+  bool     valid;     // false: el primer frame sale como estado inicial
+  uint32_t sentMs;    // millis() del último EEG_PKT_STATUS
+};
+static StatusTrack statusTrack;
+
+static void sendStatus(uint32_t idx, uint8_t flags) {
+  txPkt.begin(EEG_PKT_STATUS);
+  txPkt.putU32(idx);
+  txPkt.putU8(flags);
+  txPkt.putU8(ADS1299Plus::NUM_DEVICES);
+  for (uint8_t d = 0; d < ADS1299Plus::NUM_DEVICES; ++d) txPkt.putU24BE(statusTrack.sent[d]);
+  uint16_t len = txPkt.finish(tx_seq++);
+  if (len) transportSend(txPkt.data(), len);
+  statusTrack.sentMs = millis();
+}
+
+// Compara el STATUS de la muestra idx con el último enviado; un estado
+// distinto se envía cuando lleva STATUS_DEBOUNCE muestras seguidas.
+static void trackStatus(uint32_t idx, const uint32_t status[]) {
+  StatusTrack &t = statusTrack;
+  bool same = true, sameNext = true;
+  uint32_t cur[ADS1299Plus::NUM_DEVICES];
+  for (uint8_t d = 0; d < ADS1299Plus::NUM_DEVICES; ++d) {
+    cur[d] = status[d] & status_bits;
+    same = same && cur[d] == t.sent[d];
+    sameNext = sameNext && cur[d] == t.next[d];
+  }
+  if (!t.valid) {
+    memcpy(t.sent, cur, sizeof(cur));
+    t.valid = true;
+    t.stable = 0;
+    sendStatus(idx, 0);
+    return;
+  }
+  if (same) {
+    // Rebote: vuelve al estado enviado
+    t.stable = 0;
+    if (millis() - t.sentMs >= STATUS_REFRESH_MS) sendStatus(idx, 0);
+    return;
+  }
+  if (t.stable == 0 || !sameNext) {
+    memcpy(t.next, cur, sizeof(cur));
+    t.nextIdx = idx;
+    t.stable = 0;
+  }
+  if (++t.stable < STATUS_DEBOUNCE) return;
+  memcpy(t.sent, t.next, sizeof(t.next));
+  t.stable = 0;
+  sendStatus(t.nextIdx, EEG_STATUS_CHANGED);
+}
+
+// Evalúa la tabla de mapeo con la ventana actual y envía los mensajes MIDI
+static void sendMidi() {
+  uint32_t p[ADS1299Plus::NUM_CHANNELS * EEGDSP_NUM_BANDS];
+  EEGMidi_Msg msgs[EEGMidi_Mapper::MAX_MSGS];
+  bandPower.bandPower(p);
+  // Filas compactas (canales activos) a su sitio en la cadena para la tabla
+  // de mapeo; los apagados a 0. De atrás adelante: activeIndex(a) >= a.
+  uint8_t a = ads.activeCount();
+  for (uint8_t c = ADS1299Plus::NUM_CHANNELS; c-- > 0;) {
+    const bool on = a > 0 && ads.activeIndex((uint8_t)(a - 1)) == c;
+    if (on) --a;
+    for (uint8_t b = 0; b < EEGDSP_NUM_BANDS; ++b)
+      p[c * EEGDSP_NUM_BANDS + b] = on ? p[a * EEGDSP_NUM_BANDS + b] : 0;
+  }
+  uint8_t n = midiMapper.update(p, EEGDSP_NUM_BANDS, msgs, EEGMidi_Mapper::MAX_MSGS);
+  for (uint8_t k = 0; k < n; ++k) midiOut.send(msgs[k]);
+  if (n) midiOut.flush();
+}
+
+// Lote en construcción: 1 palabra STATUS por dispositivo (lead-off y GPIO
+// de cada ADS1299 de la cadena; ninguna con STATUS_EVENTS) + NUM_CHANNELS
+// canales por muestra (como mucho: con canales apagados caben más muestras
+// hasta BATCH_SAMPLES)
+static constexpr uint8_t BATCH_STATUS_WORDS = STATUS_EVENTS ? 0 : ADS1299Plus::NUM_DEVICES;
+// Lotes que pueden llegar a usarse (BATCH_AVAILABLE, RICE_USED): el inactivo se queda en el mínimo de RAM
+static uint8_t batchBuf[EEGStream_Batcher::bufferSize(BATCH_AVAILABLE ? BATCH_SAMPLES : 1,
+                                                      ADS1299Plus::NUM_CHANNELS, BATCH_STATUS_WORDS)];
+static EEGStream_Batcher batcher(batchBuf, sizeof(batchBuf), ADS1299Plus::NUM_CHANNELS,
+                                 BATCH_STATUS_WORDS, BATCH_SAMPLES, BATCH_FLUSH_US);
+
+// Lote comprimido: buffer de paquete + estado del predictor por flujo
+static uint8_t riceBuf[RICE_USED ? RICE_BUF_SIZE : EEG_OVERHEAD + EEG_RICE_HEADER];
+static EEGStream_RiceState riceState[ADS1299Plus::NUM_CHANNELS + BATCH_STATUS_WORDS];
+static EEGStream_RiceEncoder riceEnc(riceBuf, sizeof(riceBuf), riceState, ADS1299Plus::NUM_CHANNELS,
+                                     BATCH_STATUS_WORDS, BATCH_SAMPLES, BATCH_FLUSH_US,
+                                     RICE_ORDER, RICE_KEY_INTERVAL);
+
+// Compresión activa ahora (modo RICE, o forzada por sobrecarga)
+static bool compress_now = COMPRESS_OUTPUT;
+// millis() desde el que la cola está por debajo de TX_LOW_WATER
+static uint32_t tx_calm_since_ms = 0;
+
+// micros() del DRDY de la primera muestra del lote en construcción
+static uint32_t batch_drdy_us = 0;
+
+// Cierra y encola el lote pendiente (si lo hay)
+static void flushBatch() {
+  if (compress_now) {
+    if (riceEnc.empty()) return;
+    uint32_t idx = riceEnc.baseIdx();
+    uint16_t len = riceEnc.finish(tx_seq++);
+    if (len) sendData(riceEnc.data(), len, idx, batch_drdy_us);
+    riceEnc.reset();
+    return;
+  }
+  if (batcher.empty()) return;
+  uint32_t idx = batcher.baseIdx();
+  uint16_t len = batcher.finish(tx_seq++);
+  if (len) sendData(batcher.data(), len, idx, batch_drdy_us);
+  batcher.reset();
+}
+
+// true si el lote activo lleva demasiado tiempo esperando
+static bool batchDue(uint32_t nowUs) {
+  return compress_now ? riceEnc.due(nowUs) : batcher.due(nowUs);
+}
+
+// Política TX_OVERLOAD_COMPRESS: pasa a lotes comprimidos con la cola por
+// encima de TX_HIGH_WATER y vuelve a BATCH cuando lleva TX_RECOVER_MS por
+// debajo de TX_LOW_WATER. El cambio se hace entre lotes y el primer lote
+// comprimido es keyframe (el estado del predictor no sigue del anterior).
+static void updateOverload() {
+  if (TX_OVERLOAD_POLICY != TX_OVERLOAD_COMPRESS || stream_mode != EEG_PKT_BATCH) return;
+
+  uint16_t fill = txQueue.fill();
+  uint32_t now = millis();
+  if (fill >= TX_HIGH_WATER) {
+    tx_calm_since_ms = now;
+    if (!compress_now) {
+      flushBatch();
+      compress_now = true;
+      riceEnc.forceKeyframe();
+      riceEnc.reset();
+    }
+  } else if (fill > TX_LOW_WATER) {
+    tx_calm_since_ms = now;
+  } else if (compress_now && now - tx_calm_since_ms >= TX_RECOVER_MS) {
+    flushBatch();
+    compress_now = false;
+  }
+}
+
+// Destino de los paquetes de datos desde el siguiente (se llama entre
+// paquetes, con el lote en construcción vacío; store_spilling lo lleva
+// drainStore()). Al cambiar, el siguiente lote RICE es keyframe: el flujo en
+// vivo y el guardado se decodifican por separado.
+static void updateStoreRoute() {
+  if (!STORE_OUTPUT) return;
+  const bool route = store.ready() && (store_mode == EEG_STORE_RECORD ||
+                                       (store_mode == EEG_STORE_SPILL && store_spilling));
+  if (route == store_route) return;
+  store_route = route;
+  riceEnc.forceKeyframe();
+  riceEnc.reset();
+}
+
+// Añade un frame al lote; lo encola cuando se llena
+static void sendSampleFrameBatched(uint32_t idx, uint32_t drdyUs,
+                                   const uint32_t status[], const int32_t ch[]) {
+  updateOverload();
+  if (compress_now) {
+    if (!riceEnc.accepts(idx)) flushBatch();
+    if (riceEnc.empty()) {
+      batch_drdy_us = drdyUs;
+      updateStoreRoute();
+    }
+    riceEnc.add(idx, status, ch, micros());
+    if (riceEnc.full()) flushBatch();
+    return;
+  }
+  if (!batcher.accepts(idx)) flushBatch();
+  if (batcher.empty()) {
+    batch_drdy_us = drdyUs;
+    updateStoreRoute();
+  }
+  batcher.add(idx, status, ch, micros());
+  if (batcher.full()) flushBatch();
+}
+
+// true desde que loop() vacía la cola de salida (fin de setup())
+static bool streaming = false;
+
+// Mensaje de diagnóstico: paquete EEG_PKT_DIAG en modo binario, línea de texto
+// en modo texto. Nunca se escribe texto suelto en el flujo binario.
+// Antes de la adquisición (setup, errores fatales) se envía en el acto.
+static void sendDiag(Stream &serial, const char *msg) {
+  if (!BINARY_OUTPUT) {
+    serial.println(msg);
+    return;
+  }
+  uint16_t n = (uint16_t)strlen(msg);
+  if (n > DIAG_MAX_TEXT) n = DIAG_MAX_TEXT;
+
+  txPkt.begin(EEG_PKT_DIAG);
+  txPkt.putBytes((const uint8_t *)msg, n);
+  uint16_t len = txPkt.finish(tx_seq++);
+  if (len) transportSend(txPkt.data(), len);
+  if (!streaming) transportDrain();
+}
+
+// Paquete EEG_PKT_STATS con los contadores de salud; reinicia los máximos de
+// ventana. Solo en modo binario (en modo texto no hay donde intercalarlo).
+static void sendStats() {
+  noInterrupts();
+  uint32_t idx = sample_idx / OVERSAMPLE_RATIO;
+  uint32_t missed = stats.drdyMissed;
+  uint32_t overruns = stats.ringOverruns;
+  uint8_t hwm = stats.ringHwm;
+  stats.ringHwm = acqRing.size();
+  interrupts();
+
+  txPkt.begin(EEG_PKT_STATS);
+  txPkt.putU32(idx);
+  txPkt.putU32(stats.syncErrors);
+  txPkt.putU32(missed);
+  txPkt.putU32(overruns);
+  txPkt.putU32(stats.txDropped);
+  txPkt.putU16(stats.loopMaxUs);
+  txPkt.putU8(hwm);
+  txPkt.putU8(ACQ_RING_SIZE);
+  stats.loopMaxUs = 0;
 
-  digitalWrite(csPin, HIGH);
-  SPI.endTransaction();
+  uint16_t len = txPkt.finish(tx_seq++);
+  if (len) transportSend(txPkt.data(), len);
+}
+
+// Slot de la cola con una lectura DMA en curso (solo con ASYNC_READ)
+static AcqFrame *volatile dma_slot = nullptr;
+
+static void commitFrame() {
+  acqRing.commitWrite();
+  uint8_t used = acqRing.size();
+  if (used > stats.ringHwm) stats.ringHwm = used;
+}
+
+// Cierra la lectura DMA en curso (CS alto) y publica su slot. wait = false
+// solo la cierra si ya terminó. Con interrupciones deshabilitadas.
+static void finishFrameRead(bool wait) {
+  AcqFrame *f = dma_slot;
+  if (f == nullptr) return;
+  if (!wait && ads.frameReadBusy()) return;
+  ads.endFrameRead();
+  dma_slot = nullptr;
+  commitFrame();
+}
+
+// Lee el frame de la muestra idx (DRDY en t) y lo publica en la cola.
+// Se ejecuta en la ISR o, si el bus estaba ocupado por el MCU DSP, al final
+// de esa ráfaga; siempre con interrupciones deshabilitadas.
+static void acquireFrame(uint32_t idx, uint32_t t) {
+  // Un DMA anterior sin cerrar (loop() no llegó a tiempo): se cierra aquí
+  finishFrameRead(true);
+
+  AcqFrame *f = acqRing.beginWrite();
+  if (f == nullptr) {
+    // Cola llena: el frame se pierde pero el índice avanza (hueco visible)
+    stats.ringOverruns = stats.ringOverruns + 1;
+    return;
+  }
+  f->idx = idx;
+  f->drdyUs = t;
+  if (ADS1299_SafeSPI::ASYNC_READ) {
+    if (ads.beginFrameRead(f->raw)) dma_slot = f;
+  } else if (ads.readFrameRawRDATAC(f->raw)) {
+    commitFrame();
+  }
+}
+
+// ISR de DRDY: lectura mínima del frame y publicación en la cola.
+// Solo mueve bytes (select()/readBlock()/deselect() o el DMA), sin esperas,
+// desempaquetado ni Serial.
+static void DRDY_ISR_ATTR onDrdyFalling() {
+  // Marca del flanco lo antes posible (micros() es seguro con interrupciones off)
+  uint32_t t = micros();
+  uint32_t idx = nextSampleIdx(t);
+  // recoverSync() tiene el bus: el frame se pierde (va en el EEG_PKT_GAP)
+  if (sync_recovering) return;
+
+  if (spi_bus_lent) {
+    // Ráfaga al MCU o a la flash en curso: el frame sigue válido hasta el próximo DRDY
+    deferred_idx = idx;
+    deferred_us = t;
+    drdy_deferred = true;
+    return;
+  }
+  acquireFrame(idx, t);
+}
+
+// Pasa una conversión por el diezmado; true (y ch = muestra de salida)
+// cuando idx cierra un grupo de OVERSAMPLE_RATIO. La fase se toma del índice,
+// no de un contador: un frame perdido no la desplaza.
+static bool decimate(uint32_t idx, int32_t *ch) {
+  int32_t mid[ADS1299Plus::NUM_CHANNELS];
+  if (!decim1.push(ch, mid, idx % DECIM_R1 == DECIM_R1 - 1u)) return false;
+  uint32_t j = idx / DECIM_R1;
+  return decim2.push(mid, ch, j % DECIM_R2 == DECIM_R2 - 1u);
+}
+
+// Mide el diezmado con datos sintéticos: µs por muestra de salida (todos los
+// canales) frente a su periodo. Deja el estado a cero.
+static void benchDecimator() {
+  int32_t ch[ADS1299Plus::NUM_CHANNELS];
+  const uint16_t outs = 64;
+  uint32_t t0 = micros();
+  for (uint32_t n = 0; n < (uint32_t)outs * OVERSAMPLE_RATIO; ++n) {
+    for (uint8_t i = 0; i < ADS1299Plus::NUM_CHANNELS; ++i) ch[i] = (int32_t)(n * 2654435761UL) >> 8;
+    decimate(n, ch);
+  }
+  uint32_t us = (micros() - t0) / outs;
+  decim1.reset();
+  decim2.reset();
+
+  char msg[DIAG_MAX_TEXT + 1];
+  snprintf(msg, sizeof(msg), "Diezmado x%u: %lu us por muestra (%u canales), periodo %lu us",
+           (unsigned)OVERSAMPLE_RATIO, (unsigned long)us, (unsigned)ADS1299Plus::NUM_CHANNELS,
+           (unsigned long)(1000000UL / OUTPUT_SPS));
+  sendDiag(Serial, msg);
+}
+
+// ---- Recuperación de la sincronía ----
+// Hueco abierto: del primer frame malo de la racha al primero bueno tras
+// recoverSync() (índices del ADC)
+struct SyncGap {
+  uint32_t firstIdx;    // primer frame sin sync
+  uint32_t resumeIdx;   // primer frame leído tras la última recuperación
+  uint32_t recoveryUs;  // dentro de recoverSync(), todos los intentos
+  uint8_t  attempts;    // 0: ningún hueco abierto
+  uint8_t  flags;       // EEG_GAP_*
+};
+static SyncGap syncGap;
+
+// Ciclo de recuperación con la ISR sin leer frames (sample_idx sigue
+// avanzando con cada DRDY). Desde loop(), con la adquisición en marcha.
+static void recoverAdsSync() {
+  noInterrupts();
+  finishFrameRead(true);
+  drdy_deferred = false;
+  sync_recovering = true;
+  interrupts();
+
+  uint32_t t0 = micros();
+  uint8_t r = ads.recoverSync();
+  syncGap.recoveryUs += micros() - t0;
+  if (syncGap.attempts < 0xFF) ++syncGap.attempts;
+  if (r == ADS1299Core::SYNC_RESTORED) {
+    syncGap.flags |= EEG_GAP_RESTORED;
+    drdy_restarted = true;
+  } else if (r == ADS1299Core::SYNC_FAILED && !(syncGap.flags & EEG_GAP_FAILED)) {
+    // Se reintenta con la siguiente racha; el aviso, una vez por hueco
+    syncGap.flags |= EEG_GAP_FAILED;
+    sendDiag(Serial, "WARNING: registros del ADS1299 sin verificar tras la pérdida de sync");
+  }
+
+  noInterrupts();
+  syncGap.resumeIdx = sample_idx;
+  sync_recovering = false;
+  interrupts();
+}
+
+// Frame sin sync: abre el hueco con el primero de la racha y recupera al
+// llegar a SYNC_LOSS_FRAMES
+static void noteSyncLoss(uint32_t idx) {
+  if (syncGap.attempts == 0 && ads.syncLossRun() == 0) {
+    syncGap.firstIdx = idx;
+    syncGap.recoveryUs = 0;
+    syncGap.flags = 0;
+  }
+  if (ads.trackSync(false)) recoverAdsSync();
+}
+
+// Cierra el hueco abierto justo antes de la muestra válida idx (del ADC):
+// EEG_PKT_GAP en binario, una línea de diagnóstico en modo texto
+static void sendGap(uint32_t idx) {
+  const uint32_t first = syncGap.firstIdx / OVERSAMPLE_RATIO;
+  const uint32_t n = idx / OVERSAMPLE_RATIO - first;
+  if (!BINARY_OUTPUT) {
+    char msg[DIAG_MAX_TEXT + 1];
+    snprintf(msg, sizeof(msg), "Sync recuperada: %lu muestras perdidas desde %lu (%lu us)",
+             (unsigned long)n, (unsigned long)first, (unsigned long)syncGap.recoveryUs);
+    sendDiag(Serial, msg);
+    syncGap.attempts = 0;
+    return;
+  }
+  txPkt.begin(EEG_PKT_GAP);
+  txPkt.putU32(first);
+  txPkt.putU32(n);
+  txPkt.putU32(syncGap.recoveryUs);
+  txPkt.putU8(syncGap.attempts);
+  txPkt.putU8(syncGap.flags);
+  // Sin paquete no se gasta seq: el host vería un hueco que no existe
+  uint16_t len = txPkt.finish(tx_seq);
+  if (len) {
+    ++tx_seq;
+    transportSend(txPkt.data(), len);
+  }
+  syncGap.attempts = 0;
+}
+
+// Desempaqueta un frame ya adquirido y lo publica por el transporte configurado.
+static void publishFrame(const AcqFrame &f) {
+  uint32_t status[ADS1299Plus::NUM_DEVICES];
+  int32_t  ch[ADS1299Plus::NUM_CHANNELS]; // activos, compactos
+  // Leído antes de la última recuperación: ya cuenta en el hueco
+  if (SYNC_RECOVERY && syncGap.attempts && (int32_t)(f.idx - syncGap.resumeIdx) < 0) return;
+  if (!ads.decodeActive(f.raw, status, ch)) {
+    // Contado en EEG_PKT_STATS; el texto solo en depuración (un DIAG por frame)
+    ++stats.syncErrors;
+    if (DEBUG_TEXT || !BINARY_OUTPUT) sendDiag(Serial, "Frame inválido o error de sincronía");
+    if (SYNC_RECOVERY && acquiring) noteSyncLoss(f.idx);
+    return;
+  }
+  if (SYNC_RECOVERY) {
+    ads.trackSync(true);
+    if (syncGap.attempts) sendGap(f.idx);
+  }
+  uint32_t idx = f.idx;
+  if (OVERSAMPLE_RATIO > 1) {
+    if (!decimate(idx, ch)) return; // aún no toca muestra de salida
+    idx /= OVERSAMPLE_RATIO;
+  }
+  if (STATUS_EVENTS && BINARY_OUTPUT) trackStatus(idx, status);
+  filterBank.process(ch);
+
+  const bool features = FEATURES_AVAILABLE && BINARY_OUTPUT && stream_mode == EEG_PKT_FEATURES;
+  if (BAND_POWER_USED && (MIDI_OUTPUT || features)) {
+    // La fase de cada salto también sale del índice
+    bandPower.push(ch);
+    if (bandPower.primed()) {
+      if (MIDI_OUTPUT && idx % MIDI_HOP == MIDI_HOP - 1u) sendMidi();
+      if (features && idx % feature_hop == feature_hop - 1u) sendFeatures(idx, f.drdyUs);
+    }
+    // Modo features: solo la potencia por bandas
+    if (features) return;
+  }
+
+  // `decodeActive` ya devuelve canales sign-extended (int32_t)
+  // gracias a `unpack24()` en `ADS1299Plus.h`.
+  // Nota: `unpack24` hace sign-extension (MSB-first -> int32_t),
+  // por eso `ch[]` ya contiene valores con signo listos para uso.
+
+  if (BINARY_OUTPUT) {
+    // Enviar paquete binario al microprocesador DSP
+    if (stream_mode != EEG_PKT_SAMPLE) sendSampleFrameBatched(idx, f.drdyUs, status, ch);
+    else                               sendSampleFrameBinary(idx, f.drdyUs, ch);
+
+    if (DEBUG_TEXT) {
+      // Depuración opcional en su propio tipo de paquete, sin floats
+      char msg[DIAG_MAX_TEXT + 1];
+      int n = snprintf(msg, sizeof(msg), "S:0x%06lX", (unsigned long)status[0]);
+      for (uint8_t i = 0; i < ads.activeCount() && n > 0 && n < (int)sizeof(msg); ++i) {
+        n += snprintf(msg + n, sizeof(msg) - n, " C%u:%ld", (unsigned)(ads.activeIndex(i) + 1), (long)ch[i]);
+      }
+      sendDiag(Serial, msg);
+    }
+    return;
+  }
+
+  // Modo texto: estado y canales convertidos a voltaje para el monitor serie
+  Serial.print("S:0x");
+  Serial.print(status[0], HEX);
+
+  // LSB según la imagen proporcionada
+  const float LSB = 2.235e-8f;
+
+  for (uint8_t i = 0; i < ads.activeCount(); ++i) {
+    float voltage = (float)ch[i] * LSB;
+    Serial.print(" C"); Serial.print(ads.activeIndex(i) + 1); Serial.print(":");
+    Serial.print(voltage, 2);
+    if (i != (ads.activeCount() - 1)) Serial.print(", ");
+  }
+  Serial.println();
+}
+
+// ---- Adquisición ----
+// Publica los frames que quedan en la cola de adquisición
+static void drainAcqRing() {
+  const AcqFrame *f;
+  while ((f = acqRing.peek()) != nullptr) {
+    publishFrame(*f);
+    acqRing.pop();
+  }
+}
+
+// Apaga las notas que sonaban (la potencia por bandas deja de actualizarse)
+static void releaseMidi() {
+  EEGMidi_Msg msgs[EEGMidi_Mapper::MAX_MSGS];
+  uint8_t n = midiMapper.releaseAll(msgs, EEGMidi_Mapper::MAX_MSGS);
+  for (uint8_t k = 0; k < n; ++k) midiOut.send(msgs[k]);
+  if (n) midiOut.flush();
+}
+
+// Para la adquisición (STOP + SDATAC, 9.5.3) y deja el bus SPI del ADS1299
+// libre para escribir registros. Los frames ya leídos y el lote en curso
+// salen con la configuración con la que se tomaron.
+static void stopAcquisition() {
+  if (!acquiring) return;
+  acquiring = false;
+  if (USE_DRDY_INTERRUPT) detachInterrupt(digitalPinToInterrupt(PIN_DRDY));
+  noInterrupts();
+  finishFrameRead(true);
+  drdy_deferred = false;
+  interrupts();
+  ads.cmdStop();
+  ads.cmdSDATAC();
+
+  drainAcqRing();
+  flushBatch();
+  if (MIDI_OUTPUT) releaseMidi();
+}
+
+// Arranca la adquisición (RDATAC + START). El estado de los filtros y del
+// predictor RICE no sigue del tramo anterior; el hueco de la pausa no cuenta
+// como DRDY perdidos y sample_idx continúa donde se quedó.
+static void startAcquisition() {
+  if (acquiring) return;
+  decim1.reset();
+  decim2.reset();
+  filterBank.reset();
+  if (BAND_POWER_USED) bandPower.reset();
+  riceEnc.forceKeyframe();
+  riceEnc.reset();
+  statusTrack.valid = false;
+  drdy_seen = false;
+  // Un hueco de sync abierto queda dentro de la pausa
+  syncGap.attempts = 0;
+  ads.trackSync(true);
+
+  ads.cmdRDATAC();
+  ads.cmdStart();
+  if (USE_DRDY_INTERRUPT) {
+    // A partir de aquí el bus SPI del ADS1299 pertenece a la ISR
+    attachInterrupt(digitalPinToInterrupt(PIN_DRDY), onDrdyFalling, FALLING);
+  }
+  acquiring = true;
+}
+
+// ---- Plano de control ----
+// Paquete de comando más largo: la tabla MIDI (solo con MIDI_OUTPUT)
+static uint8_t cmdBuf[EEG_OVERHEAD + 1 + (MIDI_OUTPUT ? EEGMIDI_TABLE_MAX : 4)];
+static EEGStream_Receiver cmdRx(cmdBuf, sizeof(cmdBuf));
+// micros() al completar el último comando (t_rx de EEG_PKT_PONG)
+static uint32_t cmd_rx_us = 0;
+
+static uint8_t batchSamples() {
+  return compress_now ? riceEnc.maxSamples() : batcher.maxSamples();
+}
+
+// EEG_PKT_ACK con el estado y la configuración vigente
+static void sendAck(uint8_t cmd, uint8_t cmdSeq, uint8_t status) {
+  noInterrupts();
+  uint32_t idx = sample_idx / OVERSAMPLE_RATIO;
+  interrupts();
+
+  txPkt.begin(EEG_PKT_ACK);
+  txPkt.putU8(cmd);
+  txPkt.putU8(cmdSeq);
+  txPkt.putU8(status);
+  txPkt.putU32(idx);
+  txPkt.putU16(output_sps);
+  txPkt.putU8(stream_mode);
+  txPkt.putU8(batchSamples());
+  txPkt.putU8(filter_set);
+  txPkt.putU8(use_spi ? 1 : 0);
+  txPkt.putU8(acquiring ? 1 : 0);
+  txPkt.putU32(channel_mask);
+  txPkt.putU32(link_baud);
+  uint16_t len = txPkt.finish(tx_seq++);
+  if (len) transportSend(txPkt.data(), len);
+}
+
+// EEG_PKT_PONG de un EEG_CMD_TIME_PING: con token y t_rx del comando y
+// t_tx = al encolar, el host estima el offset y la deriva de micros()
+static void sendPong(uint8_t cmdSeq, uint32_t token, uint32_t rxUs) {
+  txPkt.begin(EEG_PKT_PONG);
+  txPkt.putU8(cmdSeq);
+  txPkt.putU32(token);
+  txPkt.putU32(rxUs);
+  txPkt.putU32(micros());
+  uint16_t len = txPkt.finish(tx_seq++);
+  if (len) transportSend(txPkt.data(), len);
+}
+
+// Frecuencia de salida OUTPUT_SPS·2^k: los bins de bandas y los filtros
+// están dimensionados para OUTPUT_SPS y a más frecuencia siempre caben
+// RECORD hasta STORE_RECORD_BPS, con la cota de un SAMPLE por muestra (un
+// lote BATCH ocupa menos por muestra, y RICE en la práctica menos aún)
+static bool recordRateOk(uint16_t sps) {
+  return (uint32_t)sps * (EEG_OVERHEAD + SAMPLE_PAYLOAD) <= STORE_RECORD_BPS;
+}
+
+// El ADC se queda en 4 kSPS como mucho también con RECORD, aunque el
+// ADS1299 llega a 16 kSPS: a 8/16 kSPS el periodo de frame (125/62 us) no
+// deja sitio a una ráfaga de flash (~70 us) más la lectura del frame, y el
+// flujo (16 kSPS × 8 canales en BATCH ≈ 400 KB/s) es diez veces
+// STORE_RECORD_BPS.
+static uint8_t applyRate(uint16_t sps) {
+  uint32_t adc = (uint32_t)sps * OVERSAMPLE_RATIO;
+  if (sps < OUTPUT_SPS || adc > 4000 || sps % OUTPUT_SPS != 0) return EEG_ACK_BAD_ARGS;
+  uint16_t k = sps / OUTPUT_SPS;
+  if ((k & (k - 1)) != 0) return EEG_ACK_BAD_ARGS;
+  if (store_mode == EEG_STORE_RECORD && !recordRateOk(sps)) return EEG_ACK_BAD_ARGS;
+  if (!ads.setDataRate(adcDataRate(adc))) return EEG_ACK_DEVICE;
+  output_sps = sps;
+  drdy_period_us = 1000000UL / adc;
+  feature_hop = sps / FEATURE_RATE_HZ;
+  if (!filterBank.configure(filter_set, sps)) {
+    filter_set = EEGDSP_FILTER_NONE;
+    filterBank.configure(filter_set, sps);
+  }
+  if (BAND_POWER_USED) bandPower.configure(sps);
+  return EEG_ACK_OK;
+}
+
+static bool modeAvailable(uint8_t mode) {
+  switch (mode) {
+    case EEG_PKT_SAMPLE:   return true;
+    case EEG_PKT_BATCH:    return BATCH_AVAILABLE;
+    case EEG_PKT_RICE:     return RICE_USED;
+    case EEG_PKT_FEATURES: return FEATURES_AVAILABLE;
+    default:               return false;
+  }
+}
+
+static uint8_t applyMode(uint8_t mode) {
+  if (mode != EEG_PKT_SAMPLE && mode != EEG_PKT_BATCH && mode != EEG_PKT_RICE &&
+      mode != EEG_PKT_FEATURES)
+    return EEG_ACK_BAD_ARGS;
+  if (!modeAvailable(mode)) return EEG_ACK_UNSUPPORTED;
+  // El lote pendiente ya salió en stopAcquisition()
+  stream_mode = mode;
+  compress_now = (mode == EEG_PKT_RICE);
+  tx_calm_since_ms = millis();
+  return EEG_ACK_OK;
+}
+
+static uint8_t applyBatch(uint8_t n) {
+  if (n == 0 || n > BATCH_SAMPLES) return EEG_ACK_BAD_ARGS;
+  // El buffer de BATCH puede admitir menos (Uno con COMPRESS_OUTPUT): el ACK
+  // devuelve el tamaño efectivo
+  if (!batcher.setMaxSamples(n) || !riceEnc.setMaxSamples(n)) return EEG_ACK_DEVICE;
+  return EEG_ACK_OK;
+}
+
+static uint8_t applyFilter(uint8_t set) {
+  if (set > EEGDSP_FILTER_NOTCH60_BAND) return EEG_ACK_BAD_ARGS;
+  if (EEGDsp_filterSetStages((EEGDsp_FilterSet)set) > FILTER_STAGES_MAX) return EEG_ACK_UNSUPPORTED;
+  if (!filterBank.configure((EEGDsp_FilterSet)set, output_sps)) return EEG_ACK_BAD_ARGS;
+  filter_set = (EEGDsp_FilterSet)set;
+  return EEG_ACK_OK;
+}
+
+// Canales encendidos (CHnSET.PD, 9.6.1.6) y lead-off solo en ellos. Con
+// daisy-chain los WREG llegan a todos los dispositivos a la vez (CS común):
+// el patrón tiene que ser el mismo en todos. Los apagados no se leen (la
+// ráfaga SPI se corta tras el último activo), no pasan por el diezmado, los
+// filtros ni la potencia por bandas y no viajan en los paquetes, que llevan
+// la máscara (EEG_CH_MASKED). Con la adquisición parada: lote vacío.
+static uint8_t applyChannels(uint32_t mask) {
+  constexpr uint8_t PER = ADS1299Plus::CHANNELS_PER_DEVICE;
+  const uint32_t devMask = (1UL << PER) - 1;
+  if (mask == 0 || (mask & ~ADS1299Plus::ALL_CHANNELS) != 0) return EEG_ACK_BAD_ARGS;
+  const uint8_t dev0 = (uint8_t)(mask & devMask);
+  for (uint8_t d = 1; d < ADS1299Plus::NUM_DEVICES; ++d) {
+    if (((mask >> (d * PER)) & devMask) != dev0) return EEG_ACK_BAD_ARGS;
+  }
+  ads.beginUpdate();
+  bool ok = true;
+  for (uint8_t c = 0; c < PER; ++c) ok = ads.powerDownChannel(c + 1, !(dev0 & (1u << c))) && ok;
+  ok = ads.enableLeadOffSenseP(dev0) && ok;
+  ok = ads.enableLeadOffSenseN(dev0) && ok;
+  ok = ads.commitRegs() && ok;
+  if (!ok) return EEG_ACK_DEVICE;
+  status_bits = statusEventBits(dev0);
+  const uint8_t n = EEG_ChannelCount(mask);
+  ads.setActiveChannels(mask);
+  decim1.setChannels(n);
+  decim2.setChannels(n);
+  filterBank.setChannels(n);
+  bandPower.setChannels(n);
+  batcher.setChannelMask(mask);
+  riceEnc.setChannelMask(mask);
+  channel_mask = mask;
+  return EEG_ACK_OK;
+}
+
+static uint8_t applyTransport(uint8_t spi) {
+  if (spi > 1) return EEG_ACK_BAD_ARGS;
+  if ((spi != 0) == use_spi) return EEG_ACK_OK;
+  // Lo que está en cola sale por el transporte anterior
+  transportDrain();
+  if (spi) spiSink.begin();
+  else spiSink.setDataReady(false);
+  use_spi = spi != 0;
+  return EEG_ACK_OK;
+}
+
+// El destino cambia en el siguiente paquete de datos (ver updateStoreRoute())
+static uint8_t applyStore(uint8_t mode) {
+  if (mode > EEG_STORE_RECORD) return EEG_ACK_BAD_ARGS;
+  if (!STORE_OUTPUT || !store.ready()) return mode == EEG_STORE_OFF ? EEG_ACK_OK : EEG_ACK_UNSUPPORTED;
+  if (mode == EEG_STORE_RECORD && !recordRateOk(output_sps)) return EEG_ACK_BAD_ARGS;
+  store_mode = mode;
+  return EEG_ACK_OK;
+}
+
+static uint8_t applyMidiTable(const uint8_t *p, uint16_t n) {
+  if (!MIDI_OUTPUT) return EEG_ACK_UNSUPPORTED;
+  EEGMidi_Table table;
+  if (!EEGMidi_parseTable(p, n, ADS1299Plus::NUM_CHANNELS, EEGDSP_NUM_BANDS, table)) return EEG_ACK_BAD_ARGS;
+  // Las notas de la tabla anterior se apagan en el próximo update()
+  midiMapper.configure(table);
+  return EEG_ACK_OK;
+}
+
+static uint32_t getU32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Bytes de argumentos de cada comando (-1: longitud variable o desconocido)
+static int16_t cmdArgLen(uint8_t cmd) {
+  switch (cmd) {
+    case EEG_CMD_PING:
+    case EEG_CMD_START:
+    case EEG_CMD_STOP:          return 0;
+    case EEG_CMD_SET_RATE:      return 2;
+    case EEG_CMD_SET_MODE:
+    case EEG_CMD_SET_BATCH:
+    case EEG_CMD_SET_FILTER:
+    case EEG_CMD_SET_TRANSPORT:
+    case EEG_CMD_SET_STORE:     return 1;
+    case EEG_CMD_SET_CHANNELS:
+    case EEG_CMD_SET_BAUD:
+    case EEG_CMD_TIME_PING:     return 4;
+    default:                    return -1;
+  }
+}
+
+// Ejecuta el comando recibido en cmdRx y responde con su ACK
+static void handleCommand() {
+  const uint8_t *p = cmdRx.payload();
+  const uint16_t n = cmdRx.length();
+  const uint8_t seq = cmdRx.seq();
+  if (n == 0) return;
+  const uint8_t cmd = p[0];
+  const uint8_t *arg = p + 1;
+  const uint16_t argLen = (uint16_t)(n - 1);
+  const int16_t want = cmdArgLen(cmd);
+  if (want >= 0 && argLen != (uint16_t)want) {
+    sendAck(cmd, seq, EEG_ACK_BAD_ARGS);
+    return;
+  }
+  if (cmd == EEG_CMD_TIME_PING) {
+    // Lo antes posible: no toca la adquisición ni lleva ACK
+    sendPong(seq, getU32(arg), cmd_rx_us);
+    return;
+  }
+
+  // Comandos que cambian la adquisición: parar, aplicar y reanudar
+  const bool reconfig = cmd == EEG_CMD_SET_RATE || cmd == EEG_CMD_SET_MODE ||
+                        cmd == EEG_CMD_SET_BATCH || cmd == EEG_CMD_SET_FILTER ||
+                        cmd == EEG_CMD_SET_CHANNELS;
+  const bool resume = acquiring;
+  if (reconfig) stopAcquisition();
+
+  uint8_t status = EEG_ACK_OK;
+  switch (cmd) {
+    case EEG_CMD_PING:
+      break;
+    case EEG_CMD_START:
+      startAcquisition();
+      break;
+    case EEG_CMD_STOP:
+      stopAcquisition();
+      break;
+    case EEG_CMD_SET_RATE:
+      status = applyRate((uint16_t)(arg[0] | (arg[1] << 8)));
+      break;
+    case EEG_CMD_SET_MODE:
+      status = applyMode(arg[0]);
+      break;
+    case EEG_CMD_SET_BATCH:
+      status = applyBatch(arg[0]);
+      break;
+    case EEG_CMD_SET_FILTER:
+      status = applyFilter(arg[0]);
+      break;
+    case EEG_CMD_SET_CHANNELS:
+      status = applyChannels(getU32(arg));
+      break;
+    case EEG_CMD_SET_TRANSPORT:
+      status = applyTransport(arg[0]);
+      break;
+    case EEG_CMD_MIDI_TABLE:
+      status = applyMidiTable(arg, argLen);
+      break;
+    case EEG_CMD_SET_STORE:
+      status = applyStore(arg[0]);
+      break;
+    case EEG_CMD_SET_BAUD: {
+      // Sin sentido en un CDC (USB nativo) o con el flujo por SPI
+      uint32_t baud = getU32(arg);
+      if (baud < 9600 || baud > 4000000) status = EEG_ACK_BAD_ARGS;
+      else if (USB_NATIVE_OUTPUT || use_spi || baud_state != BAUD_IDLE) status = EEG_ACK_UNSUPPORTED;
+      if (status != EEG_ACK_OK) break;
+      // El ACK sale al baud actual; el cambio, en loop() con la cola vacía
+      baud_resume = acquiring;
+      stopAcquisition();
+      baud_pending = baud;
+      baud_state = BAUD_DRAIN;
+      break;
+    }
+    default:
+      status = EEG_ACK_UNKNOWN;
+      break;
+  }
+
+  if (reconfig && resume) startAcquisition();
+  sendAck(cmd, seq, status);
+}
+
+// Avanza el cambio de baud rate pendiente
+static void updateBaud() {
+  if (baud_state == BAUD_DRAIN) {
+    if (!txQueue.empty()) return;
+    Serial.flush(); // el ACK tiene que haber salido entero
+    Serial.begin(baud_pending);
+    cmdRx.reset();
+    baud_since_ms = millis();
+    baud_state = BAUD_CONFIRM;
+  } else if (baud_state == BAUD_CONFIRM && millis() - baud_since_ms >= BAUD_CONFIRM_MS) {
+    // El host no llegó al baud nuevo: volver al anterior
+    Serial.begin(link_baud);
+    cmdRx.reset();
+    baud_state = BAUD_IDLE;
+    sendDiag(Serial, "WARNING: baud rate sin confirmar, se vuelve al anterior");
+    if (baud_resume) startAcquisition();
+  }
+}
+
+// Lee comandos de Serial (como mucho CONTROL_BYTES_PER_LOOP bytes por vuelta)
+static void pollCommands() {
+  if (baud_state == BAUD_DRAIN) return; // lo que llegue ahora es del baud nuevo
+  for (uint8_t k = 0; k < CONTROL_BYTES_PER_LOOP && Serial.available() > 0; ++k) {
+    int b = Serial.read();
+    if (b < 0 || !cmdRx.feed((uint8_t)b)) continue;
+    cmd_rx_us = micros();
+    if (cmdRx.type() != EEG_PKT_CMD) continue;
+    if (baud_state == BAUD_CONFIRM) {
+      // Primer comando válido al baud nuevo: queda confirmado
+      link_baud = baud_pending;
+      baud_state = BAUD_IDLE;
+      if (baud_resume) startAcquisition();
+    }
+    handleCommand();
+  }
 }
 
 void setup() {
-  Serial.begin(115200);
+  Serial.begin(LINK_BAUD);
   while (!Serial) { ; }
 
   // Configuración de pines locales
@@ -98,68 +1817,135 @@ void setup() {
   pinMode(PIN_RESET, OUTPUT);
   pinMode(PIN_PWDN, OUTPUT);
   digitalWrite(PIN_PWDN, HIGH); // dejar PWDN inactivo (HIGH) si el HW lo requiere
+  if (STORE_OUTPUT) {
+    // La flash comparte el bus: deseleccionada antes de hablar con el ADS1299
+    pinMode(PIN_STORE_CS, OUTPUT);
+    digitalWrite(PIN_STORE_CS, HIGH);
+  }
 
   // Inicializar SPI seguro y el ADS1299
   safeSpi.begin();
+  if (use_spi) spiSink.begin();
   if (!ads.begin()) {
-    Serial.println("ERROR: ads.begin() falló");
+    if (ads.detectedChannels() != ADS1299Plus::CHANNELS_PER_DEVICE) {
+      // El ID indica otro modelo (ADS1299-4/6/8): recompilar con ADS1299_NUM_CHANNELS
+      char msg[64];
+      snprintf(msg, sizeof(msg), "ERROR: ADS1299 de %u canales, firmware para %u",
+               (unsigned)ads.detectedChannels(), (unsigned)ADS1299Plus::CHANNELS_PER_DEVICE);
+      sendDiag(Serial, msg);
+    } else {
+      sendDiag(Serial, "ERROR: ads.begin() falló");
+    }
     while (1) delay(1000);
   }
 
   if (!ads.configureDefaults()) {
-    Serial.println("ERROR: configureDefaults() falló");
+    sendDiag(Serial, "ERROR: configureDefaults() falló");
     while (1) delay(1000);
   }
+  ads.setSyncLossLimit(SYNC_LOSS_FRAMES);
+
+  if (OVERSAMPLE_RATIO > 1) {
+    if (!ads.setDataRate(adcDataRate(ADC_SPS)) ||
+        !decim1.configure(DECIM_R1) || !decim2.configure(DECIM_R2)) {
+      sendDiag(Serial, "ERROR: no se pudo configurar el sobremuestreo");
+      while (1) delay(1000);
+    }
+    benchDecimator();
+  }
+
+  if (!filterBank.configure(FILTER_SET, FILTER_FS)) {
+    // No fatal: se envía sin filtrar
+    sendDiag(Serial, "WARNING: filtro no válido para la frecuencia de muestreo");
+  }
+
+  if (BAND_POWER_USED && !bandPower.configure(OUTPUT_SPS)) {
+    sendDiag(Serial, "ERROR: bandas EEG no válidas para la ventana y la frecuencia de muestreo");
+    while (1) delay(1000);
+  }
+
+  if (MIDI_OUTPUT) {
+    EEGMidi_Table table;
+    EEGMidi_defaultTable(table, ADS1299Plus::NUM_CHANNELS);
+    midiMapper.configure(table);
+    midiOut.begin();
+  }
+
+  if (ACTIVE_CHANNELS != ADS1299Plus::ALL_CHANNELS && applyChannels(ACTIVE_CHANNELS) != EEG_ACK_OK) {
+    // No fatal: se leen todos
+    sendDiag(Serial, "WARNING: ACTIVE_CHANNELS no válido (mismo patrón en cada ADS1299)");
+  }
+
+  if (STORE_OUTPUT) {
+    // No fatal: sin flash no hay store-and-forward
+    if (storeFlash.begin() && store.begin()) {
+      char msg[48];
+      snprintf(msg, sizeof(msg), "Flash store-and-forward: %lu KB",
+               (unsigned long)(storeFlash.capacityBytes() / 1024));
+      sendDiag(Serial, msg);
+    } else {
+      store_mode = EEG_STORE_OFF;
+      sendDiag(Serial, "WARNING: flash de store-and-forward no encontrada");
+    }
+  }
 
   // Leer ID para verificar comunicación
   uint8_t devId = 0;
   if (ads.readDeviceID(devId)) {
-    Serial.print("ADS1299 ID: 0x"); Serial.println(devId, HEX);
+    char msg[24];
+    snprintf(msg, sizeof(msg), "ADS1299 ID: 0x%02X", devId);
+    sendDiag(Serial, msg);
   } else {
-    Serial.println("WARNING: no se leyó el ID del ADS1299");
+    sendDiag(Serial, "WARNING: no se leyó el ID del ADS1299");
   }
 
-  // Entrar en modo de adquisición continua (RDATAC)
-  ads.cmdRDATAC();
-  Serial.println("Entrando en RDATAC. Esperando DRDY y mostrando frames...");
+  // Entrar en modo de adquisición continua (RDATAC + START)
+  sendDiag(Serial, "Entrando en RDATAC. Esperando DRDY y enviando frames...");
+  startAcquisition();
+  // A partir de aquí la cola de salida la vacía loop()
+  streaming = true;
 }
 
 void loop() {
-  // DRDY es activo bajo: cuando esté LOW, hay un frame listo.
-  if (digitalRead(PIN_DRDY) == LOW) {
-    uint32_t status;
-    int32_t ch[ADS1299Plus::NUM_CHANNELS] = {0};
-
-    if (ads.readFrameRDATAC(status, ch)) {
-      // Imprime el estado y los canales convertidos a voltaje
-      Serial.print("S:0x");
-      Serial.print(status, HEX);
-
-      // LSB según la imagen proporcionada
-      const float LSB = 2.235e-8f;
-
-      // `ads.readFrameRDATAC` ya devuelve canales sign-extended (int32_t)
-      // gracias a `unpack24()` en `ADS1299Plus.h`.
-      // Nota: `unpack24` hace sign-extension (MSB-first -> int32_t),
-      // por eso `ch[]` ya contiene valores con signo listos para uso.
-      
-      if (BINARY_OUTPUT) {
-        // Enviar frame binario al microprocesador DSP
-        sendSampleFrameBinary(Serial, sample_idx, ch, ADS1299Plus::NUM_CHANNELS);
-        sample_idx++;
-      }
-      
-      // SIEMPRE mostrar valores en voltios por Serial para depuración
-      // (independientemente de BINARY_OUTPUT)
-      for (uint8_t i = 0; i < ADS1299Plus::NUM_CHANNELS; ++i) {
-        float voltage = (float)ch[i] * LSB;
-        Serial.print(" C"); Serial.print(i + 1); Serial.print(":");
-        Serial.print(voltage, 2);
-        if (i != (ADS1299Plus::NUM_CHANNELS - 1)) Serial.print(", ");
-      }
-      Serial.println();
-    } else {
-      Serial.println("Frame inválido o error de sincronía");
+  uint32_t t0 = micros();
+
+  if (USE_DRDY_INTERRUPT) {
+    if (ADS1299_SafeSPI::ASYNC_READ) {
+      // Publicar el frame del DMA si ya terminó (libera CS antes del próximo DRDY)
+      noInterrupts();
+      finishFrameRead(false);
+      interrupts();
     }
+    // Vaciar la cola: un Serial lento solo retrasa el envío, no la adquisición
+    drainAcqRing();
+  } else if (acquiring && digitalRead(PIN_DRDY) == LOW) {
+    // Modo sondeo: DRDY es activo bajo, cuando esté LOW hay un frame listo.
+    AcqFrame f;
+    f.drdyUs = micros();
+    f.idx = nextSampleIdx(f.drdyUs);
+    if (ads.readFrameRawRDATAC(f.raw)) publishFrame(f);
   }
-}
\ No newline at end of file
+
+  // Un lote a medio llenar no espera más de BATCH_FLUSH_US
+  if (stream_mode != EEG_PKT_SAMPLE && batchDue(micros())) flushBatch();
+
+  // Comandos del host (plano de control)
+  if (CONTROL_INPUT && BINARY_OUTPUT) {
+    pollCommands();
+    updateBaud();
+  }
+
+  if (STATS_OUTPUT && BINARY_OUTPUT && millis() - last_stats_ms >= STATS_INTERVAL_MS) {
+    last_stats_ms = millis();
+    sendStats();
+  }
+
+  // Flash: un paso de programación y lo que quepa de lo guardado
+  drainStore();
+
+  // Transporte: solo lo que el sink admite sin bloquear
+  transportPump();
+
+  uint32_t dt = micros() - t0;
+  if (dt > stats.loopMaxUs) stats.loopMaxUs = dt > 0xFFFF ? 0xFFFF : (uint16_t)dt;
+}
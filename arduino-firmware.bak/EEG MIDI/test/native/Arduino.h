@@ -0,0 +1,163 @@
+// Arduino.h (entorno native)
+// Capa Arduino mínima para compilar el firmware en el PC (pio test -e native):
+// tiempo real de la máquina, pines como simples variables (digitalRead()
+// devuelve lo último escrito; DRDY en reposo = HIGH), interrupciones sin
+// efecto y Serial hacia stdout. No define ARDUINO: ADS1299_SafeSPI es el mock
+// (ADS1299_SafeSPI_Mock.h) y nada toca hardware.
+// Requiere C++17 (variables inline).
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <thread>
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define memcpy_P memcpy
+
+static constexpr uint8_t SS = 10;
+static constexpr uint8_t MOSI = 11;
+static constexpr uint8_t MISO = 12;
+static constexpr uint8_t SCK = 13;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+// ---- Tiempo ----
+namespace arduino_native {
+using Clock = std::chrono::steady_clock;
+inline const Clock::time_point t0 = Clock::now();
+inline uint64_t elapsedUs() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t0).count();
+}
+
+// ---- Pines e interrupciones ----
+static constexpr uint8_t NUM_PINS = 64;
+inline uint8_t pinLevel[NUM_PINS] = {};
+inline void (*pinIsr[NUM_PINS])() = {};
+inline bool pinsReady = false;
+inline void initPins() {
+  if (pinsReady) return;
+  for (uint8_t i = 0; i < NUM_PINS; ++i) pinLevel[i] = HIGH;
+  pinsReady = true;
+}
+} // namespace arduino_native
+
+inline unsigned long micros() { return (unsigned long)(uint32_t)arduino_native::elapsedUs(); }
+inline unsigned long millis() { return (unsigned long)(uint32_t)(arduino_native::elapsedUs() / 1000); }
+inline void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline void delayMicroseconds(unsigned int us) {
+  // Espera activa: sleep_for no baja de decenas de µs
+  uint64_t end = arduino_native::elapsedUs() + us;
+  while (arduino_native::elapsedUs() < end) {
+  }
+}
+inline void yield() {}
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+  arduino_native::initPins();
+  if (pin < arduino_native::NUM_PINS && mode == INPUT_PULLUP) arduino_native::pinLevel[pin] = HIGH;
+}
+inline void digitalWrite(uint8_t pin, uint8_t val) {
+  arduino_native::initPins();
+  if (pin < arduino_native::NUM_PINS) arduino_native::pinLevel[pin] = val ? HIGH : LOW;
+}
+inline int digitalRead(uint8_t pin) {
+  arduino_native::initPins();
+  return pin < arduino_native::NUM_PINS ? arduino_native::pinLevel[pin] : LOW;
+}
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+// El handler queda registrado; nadie lo dispara (el bench llama a la ISR a mano)
+inline void attachInterrupt(int irq, void (*isr)(), int) {
+  if (irq >= 0 && irq < arduino_native::NUM_PINS) arduino_native::pinIsr[irq] = isr;
+}
+inline void detachInterrupt(int irq) {
+  if (irq >= 0 && irq < arduino_native::NUM_PINS) arduino_native::pinIsr[irq] = nullptr;
+}
+
+// ---- Print / Stream ----
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t *buf, size_t n) {
+    size_t k = 0;
+    while (k < n && write(buf[k])) ++k;
+    return k;
+  }
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v, int base = DEC) { return print((long)v, base); }
+  size_t print(unsigned v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(long v, int base = DEC) {
+    if (base == DEC) return printf_("%ld", v);
+    return print((unsigned long)v, base);
+  }
+  size_t print(unsigned long v, int base = DEC) {
+    return base == HEX ? printf_("%lX", v) : base == OCT ? printf_("%lo", v) : printf_("%lu", v);
+  }
+  size_t print(double v, int digits = 2) { return printf_("%.*f", digits, v); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(T v) { return print(v) + println(); }
+  template <typename T> size_t println(T v, int fmt) { return print(v, fmt) + println(); }
+
+private:
+  template <typename... A> size_t printf_(const char *fmt, A... a) {
+    char buf[40];
+    int n = snprintf(buf, sizeof(buf), fmt, a...);
+    return n > 0 ? write((const uint8_t *)buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1) : 0;
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+// Serial: salida a stdout, sin entrada
+class NativeSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  void end() {}
+  explicit operator bool() const { return true; }
+  size_t write(uint8_t b) override { return fputc(b, stdout) == EOF ? 0 : 1; }
+  size_t write(const uint8_t *buf, size_t n) override { return fwrite(buf, 1, n, stdout); }
+  using Print::write;
+  int availableForWrite() override { return 4096; }
+  void flush() override { fflush(stdout); }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+};
+
+inline NativeSerial Serial;
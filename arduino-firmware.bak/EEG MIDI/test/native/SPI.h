@@ -0,0 +1,33 @@
+// SPI.h (entorno native)
+// Bus SPI sin periférico: transfer() devuelve 0x00 (MISO a nivel bajo) y no
+// cuesta nada. Solo para que compile el sink SPI hacia el MCU DSP; el ADS1299
+// es el mock (ADS1299_SafeSPI_Mock.h).
+
+#pragma once
+#include "Arduino.h"
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class SPISettings {
+public:
+  SPISettings() {}
+  SPISettings(uint32_t, uint8_t, uint8_t) {}
+};
+
+class SPIClass {
+public:
+  void begin() {}
+  void end() {}
+  void beginTransaction(SPISettings) {}
+  void endTransaction() {}
+  void usingInterrupt(int) {}
+  uint8_t transfer(uint8_t) { return 0x00; }
+  void transfer(void *buf, size_t n) { memset(buf, 0x00, n); }
+};
+
+inline SPIClass SPI;
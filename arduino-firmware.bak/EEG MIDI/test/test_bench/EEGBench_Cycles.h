@@ -0,0 +1,73 @@
+// EEGBench_Cycles.h
+// Contador de ciclos de CPU para los benchmarks (test/test_bench):
+// - Cortex-M3/M4/M7 (SAMD51, STM32F4, Teensy 4): DWT CYCCNT (C1.8 del ARMv7-M ARM).
+// - ESP32 / ESP32-S3: registro CCOUNT (ESP.getCycleCount()).
+// - Cortex-M0+ (SAMD21, RP2040) y AVR, sin contador de ciclos: micros() × MHz.
+//   Resolución de 1 µs (4 µs en el Uno): solo valen los promedios.
+// - native: TSC en x86-64, calibrado contra steady_clock; en otras CPU,
+//   nanosegundos (se informa como reloj de 1 GHz).
+// EEGBench_cycles() es un uint32 con wrap: restar siempre dos lecturas.
+// EEGBench_begin() antes de la primera medida.
+
+#pragma once
+#include <Arduino.h>
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+
+#define EEG_BENCH_COUNTER "DWT CYCCNT"
+static inline void EEGBench_begin() {
+  *(volatile uint32_t *)0xE000EDFCUL |= 1UL << 24; // DEMCR.TRCENA
+  *(volatile uint32_t *)0xE0001FB0UL = 0xC5ACCE55UL; // DWT LAR (lo exige el Cortex-M7)
+  *(volatile uint32_t *)0xE0001000UL |= 1UL;         // DWT_CTRL.CYCCNTENA
+}
+static inline uint32_t EEGBench_cycles() { return *(volatile uint32_t *)0xE0001004UL; }
+#if defined(F_CPU_ACTUAL)
+static inline uint32_t EEGBench_hz() { return F_CPU_ACTUAL; } // Teensy 4: reloj fijado en arranque
+#else
+static inline uint32_t EEGBench_hz() { return F_CPU; }
+#endif
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#define EEG_BENCH_COUNTER "CCOUNT"
+static inline void EEGBench_begin() {}
+static inline uint32_t EEGBench_cycles() { return ESP.getCycleCount(); }
+static inline uint32_t EEGBench_hz() { return ESP.getCpuFreqMHz() * 1000000UL; }
+
+#elif defined(ARDUINO)
+
+#define EEG_BENCH_COUNTER "micros()"
+static inline void EEGBench_begin() {}
+static inline uint32_t EEGBench_cycles() { return (uint32_t)micros() * (uint32_t)(F_CPU / 1000000UL); }
+static inline uint32_t EEGBench_hz() { return F_CPU; }
+
+#elif defined(__x86_64__) || defined(__i386__)
+
+#include <x86intrin.h>
+#define EEG_BENCH_COUNTER "TSC"
+namespace eeg_bench {
+inline uint32_t tscHz = 0;
+}
+static inline uint32_t EEGBench_cycles() { return (uint32_t)__rdtsc(); }
+static inline void EEGBench_begin() {
+  // TSC invariante: su frecuencia no es la del núcleo, se mide contra el reloj
+  auto t0 = std::chrono::steady_clock::now();
+  uint64_t c0 = __rdtsc();
+  delay(50);
+  uint64_t c1 = __rdtsc();
+  double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  eeg_bench::tscHz = (uint32_t)((double)(c1 - c0) / s);
+}
+static inline uint32_t EEGBench_hz() { return eeg_bench::tscHz; }
+
+#else
+
+#define EEG_BENCH_COUNTER "ns"
+static inline void EEGBench_begin() {}
+static inline uint32_t EEGBench_cycles() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+static inline uint32_t EEGBench_hz() { return 1000000000UL; }
+
+#endif
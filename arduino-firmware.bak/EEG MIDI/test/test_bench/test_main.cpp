@@ -0,0 +1,423 @@
+// test_main.cpp
+// Benchmarks del camino crítico del firmware: ciclos de CPU por muestra de
+// cada etapa frente al presupuesto (ciclos por periodo de muestreo) a 250,
+// 500, 1000 y 2000 SPS.
+//
+//   pio test -e native -f test_bench     (PC, referencia)
+//   pio test -e samd51 -f test_bench     (igual con cualquier placa de platformio.ini)
+//
+// Compila src/main.cpp tal cual (incluido aquí, con setup()/loop()/Serial
+// renombrados) con la configuración del entorno: se mide el firmware que se
+// sube, no variantes. El ADS1299 es el mock (ADS1299_SafeSPI_Mock.h, activo en
+// los test de PlatformIO): en placa el frame pasa igualmente por el SPI real,
+// así que readFrameRDATAC y la ISR incluyen el tiempo de bus. En native,
+// EEG_BENCH_FRAMES=<fichero> sirve frames grabados (bytes crudos de DOUT)
+// en lugar de los sintéticos.
+//
+// En placa falla si loop() con un frame no cabe en el periodo de ADC_SPS.
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <unity.h>
+#if defined(USE_TINYUSB)
+#include <Adafruit_TinyUSB.h>
+#endif
+#include "ADS1299Plus.h"
+#include "ADS1299_SafeSPI.h"
+#include "ADS1299_FrameRing.h"
+#include "EEGStream_Packet.h"
+#include "EEGStream_Batcher.h"
+#include "EEGStream_Rice.h"
+#include "EEGStream_Transport.h"
+#include "EEGStream_Store.h"
+#include "EEGDsp_Biquad.h"
+#include "EEGDsp_Decimator.h"
+#include "EEGDsp_BandPower.h"
+#include "EEGMidi_Mapper.h"
+#include "EEGBench_Cycles.h"
+
+// Serial del firmware: acepta todo sin bloquear y solo cuenta bytes, así el
+// transporte cuesta lo suyo sin mezclar paquetes binarios con la salida del
+// test (que va por el Serial real)
+class BenchSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  operator bool() { return true; }
+  size_t write(uint8_t) { ++bytes; return 1; }
+  size_t write(const uint8_t *, size_t n) { bytes += n; return n; }
+  using Print::write;
+  int availableForWrite() { return 0x7FFF; }
+  int available() { return 0; }
+  int read() { return -1; }
+  int peek() { return -1; }
+  void flush() {}
+  void send_now() {} // Teensy (UsbSink)
+  uint32_t bytes = 0;
+};
+static BenchSerial benchSerial;
+
+#pragma push_macro("Serial")
+#undef Serial
+#define Serial benchSerial
+#define setup eeg_setup
+#define loop eeg_loop
+#include "../../src/main.cpp"
+#undef loop
+#undef setup
+#pragma pop_macro("Serial")
+
+// ---- Medida ----
+static constexpr uint16_t BENCH_SAMPLES = 256; // llamadas por pasada
+static constexpr uint8_t  BENCH_RUNS = 3;      // se queda la mejor pasada
+static constexpr uint16_t BENCH_RATES[] = {250, 500, 1000, 2000};
+static constexpr uint8_t  BENCH_FRAMES = 16;   // frames de entrada distintos
+
+// Coste de leer el contador (se descuenta de cada medida)
+static uint32_t bench_overhead = 0;
+static uint32_t bench_idx = 0;
+static uint8_t  bench_raw[BENCH_FRAMES][ADS1299Plus::BYTES_PER_FRAME];
+static uint32_t bench_status[BENCH_FRAMES][ADS1299Plus::NUM_DEVICES];
+static int32_t  bench_ch[BENCH_FRAMES][ADS1299Plus::NUM_CHANNELS];
+static uint32_t bench_loop_cycles = 0;
+static volatile int32_t bench_sink; // que el optimizador no quite lo medido
+
+// Ciclos medios por llamada a body(i), sin contar prep(i) (fuera de la medida)
+template <typename Prep, typename Body>
+static uint32_t benchCycles(Prep prep, Body body) {
+  uint32_t best = 0xFFFFFFFFUL;
+  for (uint8_t r = 0; r < BENCH_RUNS; ++r) {
+    uint32_t total = 0;
+    for (uint16_t i = 0; i < BENCH_SAMPLES; ++i) {
+      prep(i);
+      uint32_t t0 = EEGBench_cycles();
+      body(i);
+      uint32_t dt = EEGBench_cycles() - t0;
+      total += dt > bench_overhead ? dt - bench_overhead : 0;
+    }
+    uint32_t mean = (total + BENCH_SAMPLES / 2) / BENCH_SAMPLES;
+    if (mean < best) best = mean;
+  }
+  return best;
+}
+
+static void noPrep(uint16_t) {}
+
+// Una línea por etapa: ciclos por muestra y % del presupuesto por tasa
+static void report(const char *name, uint32_t cycles) {
+  char msg[128];
+  int n = snprintf(msg, sizeof(msg), "%-22s %8lu ciclos/muestra |", name, (unsigned long)cycles);
+  for (uint8_t k = 0; k < sizeof(BENCH_RATES) / sizeof(BENCH_RATES[0]) && n > 0 && n < (int)sizeof(msg); ++k) {
+    uint32_t budget = EEGBench_hz() / BENCH_RATES[k];
+    uint32_t pm = (uint32_t)(((uint64_t)cycles * 1000 + budget / 2) / budget); // ‰
+    n += snprintf(msg + n, sizeof(msg) - n, " %u: %lu.%lu%%", (unsigned)BENCH_RATES[k],
+                  (unsigned long)(pm / 10), (unsigned long)(pm % 10));
+  }
+  TEST_MESSAGE(msg);
+}
+
+// La cola de salida se vacía fuera de la medida (salvo en loop())
+static void drainTx() {
+  transportDrain();
+}
+
+// ---- Etapas ----
+static void test_unpack24() {
+  uint32_t c = benchCycles(noPrep, [](uint16_t i) {
+    const uint8_t *raw = bench_raw[i % BENCH_FRAMES];
+    int32_t acc = 0;
+    for (uint8_t d = 0; d < ADS1299Plus::NUM_DEVICES; ++d) {
+      const uint8_t *b = &raw[d * ADS1299Plus::BYTES_PER_DEVICE + 3];
+      for (uint8_t k = 0; k < ADS1299Plus::CHANNELS_PER_DEVICE; ++k) acc ^= ADS1299Core::unpack24(&b[3 * k]);
+    }
+    bench_sink = acc;
+  });
+  report("unpack24 (frame)", c);
+}
+
+static void test_decodeFrame() {
+  uint32_t status[ADS1299Plus::NUM_DEVICES];
+  int32_t ch[ADS1299Plus::NUM_CHANNELS];
+  uint32_t c = benchCycles(noPrep, [&](uint16_t i) {
+    ADS1299Plus::decodeFrame(bench_raw[i % BENCH_FRAMES], status, ch);
+    bench_sink = ch[ADS1299Plus::NUM_CHANNELS - 1];
+  });
+  report("decodeFrame", c);
+}
+
+static void test_readFrameRDATAC() {
+  uint32_t status[ADS1299Plus::NUM_DEVICES];
+  int32_t ch[ADS1299Plus::NUM_CHANNELS];
+  bool ok = true;
+  uint32_t c = benchCycles(noPrep, [&](uint16_t) {
+    ok = ads.readFrameRDATAC(status, ch) && ok;
+  });
+  TEST_ASSERT_TRUE_MESSAGE(ok, "readFrameRDATAC: frame sin sync");
+  report("readFrameRDATAC", c);
+}
+
+static void test_isr() {
+  uint32_t c = benchCycles([](uint16_t) {
+    while (acqRing.peek() != nullptr) acqRing.pop();
+  }, [](uint16_t) { onDrdyFalling(); });
+  while (acqRing.peek() != nullptr) acqRing.pop();
+  report("ISR DRDY", c);
+}
+
+static void test_recoverSync() {
+  // Registros intactos: solo SDATAC → RREG del mapa → RDATAC
+  uint32_t c = benchCycles(noPrep, [](uint16_t) { bench_sink = ads.recoverSync(); });
+  TEST_ASSERT_EQUAL_UINT8(ADS1299Core::SYNC_RESYNCED, ads.recoverSync());
+  TEST_ASSERT_TRUE(safeSpi.rdatac());
+  report("recoverSync", c);
+
+  // Registro corrupto: RESET, caché reescrita y la conversión como estaba
+  const uint8_t ch1 = ads.shadowReg(ADS_REG_CH1SET);
+  safeSpi.corruptReg(ADS_REG_CH1SET, (uint8_t)(ch1 ^ ADS_CH_PD));
+  TEST_ASSERT_EQUAL_UINT8(ADS1299Core::SYNC_RESTORED, ads.recoverSync());
+  TEST_ASSERT_EQUAL_HEX8(ch1, safeSpi.reg(ADS_REG_CH1SET));
+  TEST_ASSERT_TRUE(safeSpi.rdatac() && safeSpi.started());
+}
+
+static void test_filter() {
+  int32_t ch[ADS1299Plus::NUM_CHANNELS];
+  uint32_t c = benchCycles([&](uint16_t i) {
+    memcpy(ch, bench_ch[i % BENCH_FRAMES], sizeof(ch));
+  }, [&](uint16_t) {
+    filterBank.process(ch);
+    bench_sink = ch[ADS1299Plus::NUM_CHANNELS - 1];
+  });
+  char name[24];
+  snprintf(name, sizeof(name), "biquads (%u secc.)", (unsigned)EEGDsp_filterSetStages(FILTER_SET));
+  report(name, c);
+}
+
+static void test_decimator() {
+  if (OVERSAMPLE_RATIO == 1) TEST_IGNORE_MESSAGE("OVERSAMPLE_RATIO = 1: sin diezmado");
+  int32_t ch[ADS1299Plus::NUM_CHANNELS];
+  uint32_t c = benchCycles([&](uint16_t i) {
+    memcpy(ch, bench_ch[i % BENCH_FRAMES], sizeof(ch));
+  }, [&](uint16_t) { decimate(bench_idx++, ch); });
+  decim1.reset();
+  decim2.reset();
+  char name[24];
+  snprintf(name, sizeof(name), "diezmado x%u", (unsigned)OVERSAMPLE_RATIO);
+  report(name, c * OVERSAMPLE_RATIO); // por muestra de salida
+}
+
+static void test_bandpower() {
+#if defined(__AVR__)
+  TEST_IGNORE_MESSAGE("potencia por bandas: no cabe en la RAM del Uno");
+#else
+  static EEGDsp_BandPower<ADS1299Plus::NUM_CHANNELS, FEATURE_WINDOW, FEATURE_BINS> bands;
+  TEST_ASSERT_TRUE(bands.configure(OUTPUT_SPS));
+  uint32_t c = benchCycles(noPrep, [](uint16_t i) { bands.push(bench_ch[i % BENCH_FRAMES]); });
+  report("DFT deslizante", c);
+#endif
+}
+
+static void test_sendSampleFrameBinary() {
+  uint32_t c = benchCycles([](uint16_t) { drainTx(); }, [](uint16_t i) {
+    sendSampleFrameBinary(bench_idx++, micros(), bench_ch[i % BENCH_FRAMES]);
+  });
+  drainTx();
+  report("sendSampleFrameBinary", c);
+}
+
+static void test_batch() {
+  const bool rice = compress_now;
+  uint32_t c = benchCycles([](uint16_t) {
+    drainTx();
+    tx_calm_since_ms = millis(); // sin cambio de modo a mitad de medida
+  }, [](uint16_t i) {
+    uint8_t f = i % BENCH_FRAMES;
+    sendSampleFrameBatched(bench_idx++, micros(), bench_status[f], bench_ch[f]);
+  });
+  flushBatch();
+  drainTx();
+  report(rice ? "lote RICE" : "lote BATCH", c);
+}
+
+static void test_publishFrame() {
+  static AcqFrame f;
+  uint32_t c = benchCycles([](uint16_t i) {
+    drainTx();
+    memcpy(f.raw, bench_raw[i % BENCH_FRAMES], sizeof(f.raw));
+    f.idx = bench_idx++;
+    f.drdyUs = micros();
+  }, [](uint16_t) { publishFrame(f); });
+  drainTx();
+  report("publishFrame", c);
+}
+
+static void test_loop() {
+  // Un DRDY (ISR, fuera de la medida) y la vuelta de loop() que lo publica
+  uint32_t c = benchCycles([](uint16_t) { onDrdyFalling(); }, [](uint16_t) { eeg_loop(); });
+  drainTx();
+  bench_loop_cycles = c;
+  report("loop() (1 frame)", c);
+}
+
+static void test_budget() {
+#if defined(ARDUINO)
+  char msg[64];
+  snprintf(msg, sizeof(msg), "loop() no cabe en el periodo a %lu SPS", (unsigned long)ADC_SPS);
+  TEST_ASSERT_TRUE_MESSAGE(bench_loop_cycles < EEGBench_hz() / ADC_SPS, msg);
+#else
+  TEST_IGNORE_MESSAGE("native: sin presupuesto real (solo referencia)");
+#endif
+}
+
+// ---- Store-and-forward ----
+// RECORD a STORE_RECORD_BPS contra una flash simulada en tiempo virtual: la
+// geometría de SpiFlash (sectores de 4 KB, ráfagas de STORE_BURST), 0.4 ms
+// por programación (tPP típ. de una página entera), borrados de 45 ms (tSE
+// típ.) salvo uno de cada 16 al máximo (STORE_ERASE_MAX_MS) y un poll() cada
+// 250 us (una vuelta de loop() por frame a 4 kSPS). Ningún push() puede
+// fallar; tampoco se programa una página sin borrar.
+class BenchFlash : public EEGStream_PageDevice {
+public:
+  static constexpr uint32_t PAGES = 4096; // 1 MB: 20 s a STORE_RECORD_BPS sin wrap
+  uint32_t nowUs = 0;
+  uint32_t unerased = 0; // programaciones de una página sin borrar
+
+  void reset() {
+    nowUs = busyUntilUs_ = 0;
+    erases_ = unerased = 0;
+    memset(erased_, 0, sizeof(erased_));
+  }
+  uint16_t pageSize() const override { return SpiFlash::PAGE; }
+  uint32_t pageCount() const override { return PAGES; }
+  uint16_t erasePages() const override { return 4096 / SpiFlash::PAGE; }
+  uint16_t burst() const override { return STORE_BURST; }
+  bool busy() override { return (int32_t)(nowUs - busyUntilUs_) < 0; }
+  bool erase(uint32_t page) override {
+    memset(&erased_[page], 1, erasePages());
+    busyUntilUs_ = nowUs + (++erases_ % 16 == 8 ? STORE_ERASE_MAX_MS * 1000UL : 45000UL);
+    return true;
+  }
+  bool program(uint32_t page, uint16_t off, const uint8_t *, uint16_t n) override {
+    if (!erased_[page]) ++unerased;
+    if (off + n == SpiFlash::PAGE) erased_[page] = 0;
+    busyUntilUs_ = nowUs + 400;
+    return true;
+  }
+  bool read(uint32_t, uint16_t, uint8_t *, uint16_t) override { return true; }
+
+private:
+  uint32_t busyUntilUs_ = 0;
+  uint32_t erases_ = 0;
+  uint8_t erased_[PAGES];
+};
+
+#if EEG_STORE || !defined(ARDUINO)
+static BenchFlash bench_flash;
+static uint8_t bench_store_ram[EEGStream_Store::ramSize(SpiFlash::PAGE, STORE_RAM_PAGES)];
+#endif
+
+static void test_storeRecord() {
+#if EEG_STORE || !defined(ARDUINO)
+  static uint8_t pkt[TX_PKT_MAX];
+  // Un SAMPLE por muestra (la cota de recordRateOk()) y el paquete más largo
+  // que emite el firmware (TX_PKT_MAX, como mucho un payload máximo)
+  const uint16_t sizes[] = {EEG_OVERHEAD + SAMPLE_PAYLOAD, TX_PKT_MAX};
+  for (uint16_t len : sizes) {
+    bench_flash.reset();
+    EEGStream_Store st(bench_flash, bench_store_ram, sizeof(bench_store_ram));
+    TEST_ASSERT_TRUE(st.begin());
+    uint64_t credit = 0; // bytes·1e6 aún sin empaquetar
+    uint32_t failed = 0;
+    for (uint32_t t = 0; t < 20000000UL; t += 250) {
+      bench_flash.nowUs = t;
+      credit += (uint64_t)STORE_RECORD_BPS * 250;
+      for (; credit >= (uint64_t)len * 1000000; credit -= (uint64_t)len * 1000000)
+        if (!st.push(pkt, len)) ++failed;
+      st.poll();
+    }
+    char msg[96];
+    snprintf(msg, sizeof(msg), "RECORD a %lu B/s, paquetes de %u B: %lu push() fallidos",
+             (unsigned long)STORE_RECORD_BPS, (unsigned)len, (unsigned long)failed);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_TRUE_MESSAGE(failed == 0 && st.dropped() == 0, msg);
+    TEST_ASSERT_TRUE(bench_flash.unerased == 0 && st.errors() == 0);
+  }
+#else
+  TEST_IGNORE_MESSAGE("sin EEG_STORE: no cabe la RAM del store");
+#endif
+}
+
+// ---- Arranque ----
+#if !defined(ARDUINO)
+// Frames grabados (EEG_BENCH_FRAMES); se quedan vivos durante todo el bench
+static uint8_t *bench_recording = nullptr;
+static void loadRecording() {
+  const char *path = getenv("EEG_BENCH_FRAMES");
+  if (path == nullptr) return;
+  FILE *fp = fopen(path, "rb");
+  if (fp == nullptr) return;
+  fseek(fp, 0, SEEK_END);
+  long len = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (len >= (long)ADS1299Plus::BYTES_PER_FRAME) {
+    bench_recording = (uint8_t *)malloc((size_t)len);
+    if (bench_recording && fread(bench_recording, 1, (size_t)len, fp) == (size_t)len)
+      safeSpi.setRecording(bench_recording, (size_t)len - (size_t)len % ADS1299Plus::BYTES_PER_FRAME);
+  }
+  fclose(fp);
+}
+#endif
+
+static int runBenchmarks() {
+  eeg_setup();
+  // El bench es el único que lee el ADS1299 (simulado)
+  if (USE_DRDY_INTERRUPT) detachInterrupt(digitalPinToInterrupt(PIN_DRDY));
+#if !defined(ARDUINO)
+  loadRecording();
+#endif
+
+  EEGBench_begin();
+  bench_overhead = 0;
+  bench_overhead = benchCycles(noPrep, [](uint16_t) {});
+
+  for (uint8_t f = 0; f < BENCH_FRAMES; ++f) {
+    ads.readFrameRawRDATAC(bench_raw[f]);
+    ADS1299Plus::decodeFrame(bench_raw[f], bench_status[f], bench_ch[f]);
+  }
+
+  UNITY_BEGIN();
+  char msg[128];
+  snprintf(msg, sizeof(msg), "%s a %lu Hz, %u canales, ADC %lu SPS; presupuesto: %lu/%lu/%lu/%lu ciclos",
+           EEG_BENCH_COUNTER, (unsigned long)EEGBench_hz(), (unsigned)ADS1299Plus::NUM_CHANNELS,
+           (unsigned long)ADC_SPS, (unsigned long)(EEGBench_hz() / 250), (unsigned long)(EEGBench_hz() / 500),
+           (unsigned long)(EEGBench_hz() / 1000), (unsigned long)(EEGBench_hz() / 2000));
+  TEST_MESSAGE(msg);
+  RUN_TEST(test_unpack24);
+  RUN_TEST(test_decodeFrame);
+  RUN_TEST(test_readFrameRDATAC);
+  RUN_TEST(test_isr);
+  RUN_TEST(test_recoverSync);
+  RUN_TEST(test_decimator);
+  RUN_TEST(test_filter);
+  RUN_TEST(test_bandpower);
+  RUN_TEST(test_sendSampleFrameBinary);
+  RUN_TEST(test_batch);
+  RUN_TEST(test_publishFrame);
+  RUN_TEST(test_loop);
+  RUN_TEST(test_budget);
+  RUN_TEST(test_storeRecord);
+  return UNITY_END();
+}
+
+void setUp() {}
+void tearDown() {}
+
+#if defined(ARDUINO)
+void setup() {
+  delay(2000); // el test runner abre el puerto tras el reset
+  runBenchmarks();
+}
+void loop() {}
+#else
+int main() {
+  return runBenchmarks();
+}
+#endif
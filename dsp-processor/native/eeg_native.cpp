@@ -0,0 +1,978 @@
+// eeg_native.cpp
+// Decodificador nativo del flujo EEG (docs/protocol.md) para DataReceiver.
+// Hace en C++ la parte que en Python cuesta por byte y por muestra:
+//  - buffer de lectura anticipada sobre el fd del puerto serie (read_fd) o
+//    sobre bytes ya leídos (feed);
+//  - búsqueda de sync y CRC-16 con la misma política de resincronización
+//    que eeg_protocol.PacketParser;
+//  - desempaquetado de 24 bits (BATCH) y descompresión RICE (predictor +
+//    Rice adaptativo, mismo estado que eeg_protocol.RiceDecoder);
+//  - paquetes con máscara de canales (EEG_CH_MASKED, SAMPLE_MASKED): los
+//    activos van a su columna y los apagados quedan a 0 (NaN en float32);
+//  - sincronización de micros() del firmware con el reloj del host a partir
+//    de PKT_PONG y PKT_TIMING (misma lógica que eeg_protocol.ClockSync), para
+//    que take(times=True) dé la hora de adquisición de cada muestra.
+// Las muestras se acumulan en buffers contiguos que take() entrega sin copiar
+// como objetos Block con el protocolo de buffer: np.asarray(block) es una
+// vista (samples, channels) int32 o float32 sin copia. No depende de NumPy
+// en compilación.
+// El resto de paquetes (DIAG, TIMING, STATS, FEATURES, PONG...) se guardan tal
+// cual como (type, seq, payload) para que los trate Python (packets()).
+//
+// Constantes y CRC: los del firmware (lib/EEGStream, cabeceras portables).
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "EEGStream_Protocol.h"
+#include "EEGStream_Rice.h"
+// CRC-16 del firmware: se compila en esta misma unidad (setuptools no admite
+// fuentes fuera del directorio del paquete)
+#include "EEGStream_Packet.cpp"
+
+namespace {
+
+constexpr double   DEFAULT_LSB  = 2.235e-8;   // V por cuenta (ganancia 24)
+constexpr size_t   RX_COMPACT   = 1 << 16;    // se compacta el buffer a partir de aquí
+constexpr int32_t  MAX24        = 8388607;
+constexpr int32_t  MIN24        = -8388608;
+
+// Reloj del host: time.perf_counter() (se toma en el módulo al importarlo)
+PyObject* perfCounter = nullptr;
+
+double hostNow()
+{
+  PyObject* t = PyObject_CallNoArgs(perfCounter);
+  if (!t) {
+    PyErr_Clear();
+    return NAN;
+  }
+  double v = PyFloat_AsDouble(t);
+  Py_DECREF(t);
+  return v;
+}
+
+// ---- Buffer de crecimiento (su memoria pasa a un Block sin copiar) ----
+struct GrowBuf {
+  char*  p   = nullptr;
+  size_t n   = 0;   // bytes usados
+  size_t cap = 0;
+
+  bool reserve(size_t extra) {
+    if (n + extra <= cap) return true;
+    size_t c = cap ? cap : 4096;
+    while (c < n + extra) c *= 2;
+    char* q = (char*)realloc(p, c);
+    if (!q) return false;
+    p = q;
+    cap = c;
+    return true;
+  }
+  // Cede la memoria al llamador y queda vacío
+  char* release() {
+    char* q = p;
+    p = nullptr;
+    n = cap = 0;
+    return q;
+  }
+  void clear() { n = 0; }
+  ~GrowBuf() { free(p); }
+};
+
+// =========================
+//  Block: array 1-D/2-D de solo lectura con el protocolo de buffer
+// =========================
+struct BlockObject {
+  PyObject_HEAD
+  char*       data;
+  Py_ssize_t  shape[2];
+  Py_ssize_t  strides[2];
+  int         ndim;
+  Py_ssize_t  itemsize;
+  char        format[2];
+};
+
+PyTypeObject* BlockType = nullptr;
+
+// Toma la propiedad de data (malloc); rows × cols elementos (cols = 0: 1-D)
+// de 4 bytes ('d': 8)
+PyObject* newBlock(char* data, Py_ssize_t rows, Py_ssize_t cols, char fmt)
+{
+  BlockObject* b = PyObject_New(BlockObject, BlockType);
+  if (!b) {
+    free(data);
+    return nullptr;
+  }
+  b->data = data;
+  b->itemsize = fmt == 'd' ? 8 : 4;
+  b->format[0] = fmt;
+  b->format[1] = 0;
+  b->ndim = cols ? 2 : 1;
+  b->shape[0] = rows;
+  b->shape[1] = cols;
+  b->strides[0] = cols ? cols * b->itemsize : b->itemsize;
+  b->strides[1] = b->itemsize;
+  return (PyObject*)b;
+}
+
+void Block_dealloc(BlockObject* b)
+{
+  free(b->data);
+  PyTypeObject* tp = Py_TYPE(b);
+  PyObject_Free(b);
+  Py_DECREF(tp);
+}
+
+int Block_getbuffer(BlockObject* b, Py_buffer* view, int flags)
+{
+  if (flags & PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "Block es de solo lectura");
+    return -1;
+  }
+  static char empty = 0;
+  view->obj = (PyObject*)b;
+  Py_INCREF(b);
+  view->buf = b->data ? b->data : &empty;
+  view->len = b->shape[0] * (b->ndim == 2 ? b->shape[1] : 1) * b->itemsize;
+  view->readonly = 1;
+  view->itemsize = b->itemsize;
+  view->format = (flags & PyBUF_FORMAT) ? b->format : nullptr;
+  view->ndim = b->ndim;
+  view->shape = (flags & PyBUF_ND) ? b->shape : nullptr;
+  view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? b->strides : nullptr;
+  view->suboffsets = nullptr;
+  view->internal = nullptr;
+  return 0;
+}
+
+void Block_releasebuffer(BlockObject*, Py_buffer*) {}
+
+Py_ssize_t Block_len(BlockObject* b) { return b->shape[0]; }
+
+PyObject* Block_get_shape(BlockObject* b, void*)
+{
+  if (b->ndim == 1) return Py_BuildValue("(n)", b->shape[0]);
+  return Py_BuildValue("(nn)", b->shape[0], b->shape[1]);
+}
+
+PyObject* Block_get_format(BlockObject* b, void*) { return PyUnicode_FromString(b->format); }
+
+PyGetSetDef Block_getset[] = {
+  {"shape", (getter)Block_get_shape, nullptr, "(samples,) o (samples, channels)", nullptr},
+  {"format", (getter)Block_get_format, nullptr, "formato struct: 'I', 'i', 'f' o 'd'", nullptr},
+  {nullptr, nullptr, nullptr, nullptr, nullptr},
+};
+
+PyType_Slot Block_slots[] = {
+  {Py_tp_dealloc, (void*)Block_dealloc},
+  {Py_tp_getset, (void*)Block_getset},
+  {Py_sq_length, (void*)Block_len},
+  {Py_bf_getbuffer, (void*)Block_getbuffer},
+  {Py_bf_releasebuffer, (void*)Block_releasebuffer},
+  {Py_tp_doc, (void*)"Bloque de muestras contiguo (np.asarray(block) no copia)."},
+  {0, nullptr},
+};
+
+PyType_Spec Block_spec = {
+  "eeg_native.Block", sizeof(BlockObject), 0, Py_TPFLAGS_DEFAULT, Block_slots,
+};
+
+// =========================
+//  ClockSync: micros() del firmware -> s del host (ver eeg_protocol.ClockSync)
+// =========================
+inline int64_t wrapI32(uint32_t v) { return (int64_t)(int32_t)v; }
+
+struct ClockSync {
+  static constexpr size_t WINDOW        = 32;
+  static constexpr double DELAY_SLACK   = 0.5;
+  static constexpr double DELAY_FLOOR_S = 100e-6;
+  static constexpr double MIN_SPAN_US   = 1e6;
+  static constexpr double MAX_DRIFT     = 0.01;
+  static constexpr double PERIOD_TOL    = 0.01;
+
+  struct Ping { double devUs, offset, delay; };
+  std::vector<Ping> pings;
+  bool haveLast = false;
+  int64_t lastUs = 0;    // último micros() desenrollado
+  double a = NAN, b = 0.0, ref = 0.0;
+  double rtt = NAN;
+  unsigned long long nPings = 0;
+  // Anclas sample_idx -> µs del firmware (PKT_TIMING)
+  bool haveAnchor = false;
+  uint32_t baseIdx = 0, anchorIdx = 0;
+  int64_t baseUs = 0, anchorUs = 0;
+  double periodUs = NAN;
+
+  void reset() { *this = ClockSync(); }
+
+  bool synced() const { return !isnan(a); }
+
+  int64_t unwrap(uint32_t t) {
+    if (!haveLast) {
+      haveLast = true;
+      lastUs = t;
+      return lastUs;
+    }
+    int64_t u = lastUs + wrapI32(t - (uint32_t)lastUs);
+    if (u > lastUs) lastUs = u;
+    return u;
+  }
+
+  double hostFrom(double t) const { return t * 1e-6 + a + b * (t - ref) * 1e-6; }
+
+  double hostTime(uint32_t tDev) const {
+    if (!synced()) return NAN;
+    return hostFrom((double)(lastUs + wrapI32(tDev - (uint32_t)lastUs)));
+  }
+
+  double sampleTime(uint32_t idx) const {
+    if (!synced() || isnan(periodUs)) return NAN;
+    return hostFrom((double)anchorUs + (double)wrapI32(idx - anchorIdx) * periodUs);
+  }
+
+  // Payload PKT_PONG llegado en tRecv
+  void addPong(const uint8_t* p, double tRecv) {
+    if (isnan(tRecv)) return;
+    uint32_t token = (uint32_t)p[1] | ((uint32_t)p[2] << 8) | ((uint32_t)p[3] << 16) | ((uint32_t)p[4] << 24);
+    uint32_t rx = (uint32_t)p[5] | ((uint32_t)p[6] << 8) | ((uint32_t)p[7] << 16) | ((uint32_t)p[8] << 24);
+    uint32_t tx = (uint32_t)p[9] | ((uint32_t)p[10] << 8) | ((uint32_t)p[11] << 16) | ((uint32_t)p[12] << 24);
+    int64_t recvUs = llround(tRecv * 1e6);
+    double tSend = (double)(recvUs - (int64_t)((uint32_t)recvUs - token)) * 1e-6;
+    int64_t t2 = unwrap(rx);
+    int64_t t3 = t2 + (int64_t)(uint32_t)(tx - rx);
+    unwrap(tx);
+    double mid = (double)(t2 + t3) / 2;
+    rtt = tRecv - tSend;
+    double delay = rtt - (double)(t3 - t2) * 1e-6;
+    pings.push_back({mid, (tSend + tRecv) / 2 - mid * 1e-6, delay});
+    if (pings.size() > WINDOW) pings.erase(pings.begin());
+    ++nPings;
+    fit();
+  }
+
+  // Pings de menor retardo; recta offset(t) por mínimos cuadrados
+  void fit() {
+    double dmin = INFINITY;
+    for (const Ping& q : pings) dmin = q.delay < dmin ? q.delay : dmin;
+    const double lim = dmin * (1 + DELAY_SLACK) + DELAY_FLOOR_S;
+    double n = 0, sum = 0, lo = INFINITY, hi = -INFINITY;
+    for (const Ping& q : pings) {
+      if (q.delay > lim) continue;
+      n += 1;
+      sum += q.devUs;
+      lo = q.devUs < lo ? q.devUs : lo;
+      hi = q.devUs > hi ? q.devUs : hi;
+    }
+    const double r = sum / n;
+    double sxx = 0, sxy = 0;
+    for (const Ping& q : pings) {
+      if (q.delay > lim) continue;
+      sxx += (q.devUs - r) * (q.devUs - r);
+      sxy += (q.devUs - r) * q.offset;
+    }
+    if (n >= 2 && hi - lo >= MIN_SPAN_US && sxx > 0) {
+      double s = sxy / sxx * 1e6;
+      b = s > MAX_DRIFT ? MAX_DRIFT : (s < -MAX_DRIFT ? -MAX_DRIFT : s);
+    }
+    double acc = 0;
+    for (const Ping& q : pings)
+      if (q.delay <= lim) acc += q.offset - b * (q.devUs - r) * 1e-6;
+    a = acc / n;
+    ref = r;
+  }
+
+  // Payload PKT_TIMING: [u32 idx][u32 t_drdy][u32 t_tx]
+  void addTiming(uint32_t idx, uint32_t tDrdy) {
+    int64_t t = unwrap(tDrdy);
+    int64_t dIdx = haveAnchor ? wrapI32(idx - anchorIdx) : 0;
+    if (!haveAnchor || dIdx <= 0) {
+      // Primera ancla, o sample_idx ha vuelto atrás (adquisición reiniciada)
+      baseIdx = idx;
+      baseUs = t;
+      periodUs = NAN;
+    } else {
+      double period = (double)(t - anchorUs) / (double)dIdx;
+      if (isnan(periodUs) || fabs(period - periodUs) > PERIOD_TOL * periodUs) {
+        baseIdx = anchorIdx;
+        baseUs = anchorUs;
+        periodUs = period;
+      } else {
+        periodUs = (double)(t - baseUs) / (double)wrapI32(idx - baseIdx);
+      }
+    }
+    haveAnchor = true;
+    anchorIdx = idx;
+    anchorUs = t;
+  }
+};
+
+// =========================
+//  Decoder
+// =========================
+struct DecoderObject {
+  PyObject_HEAD
+  // Lectura anticipada: bytes válidos en rx[rxHead..rx.size())
+  std::vector<uint8_t>* rx;
+  size_t rxHead;
+  int lastSeq;  // -1: ninguno
+
+  // Muestras acumuladas (misma forma hasta el próximo take())
+  GrowBuf* idx;
+  GrowBuf* ch;
+  GrowBuf* st;
+  Py_ssize_t nSamples;
+  int nCh;      // columnas (canales de la cadena); -1: aún sin muestras
+  int nStatus;
+  uint32_t chMask;  // columnas con datos (canales activos)
+
+  // Estado RICE entre paquetes
+  std::vector<EEGStream_RiceState>* rice;
+  int riceChain;  // -1: esperando keyframe
+  uint32_t riceMask;  // canales del último paquete decodificado
+
+  PyObject* other;  // lista de (type, seq, payload)
+
+  ClockSync* clock;
+  double rxTime;  // hora del host de los últimos bytes leídos
+
+  // Estadísticas (mismos nombres que PacketParser / RiceDecoder)
+  unsigned long long packetsOk, crcErrors, bytesSkipped, seqGaps;
+  unsigned long long ricePacketsDropped, decodeErrors, samplesDropped;
+};
+
+inline uint16_t rdU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+inline uint32_t rdU32(const uint8_t* p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+inline int32_t s24(uint32_t v)
+{
+  v &= 0xFFFFFF;
+  return (v & 0x800000) ? (int32_t)v - 0x1000000 : (int32_t)v;
+}
+
+inline uint32_t allColumns(int nCh) { return nCh >= 32 ? 0xFFFFFFFFu : (1u << nCh) - 1; }
+
+// Canales de un paquete: sin EEG_CH_MASKED en el byte n_ch, todos; con él,
+// la máscara u32 en p[pos] (pos avanza). cols[] = columna de cada activo.
+// false si la máscara no cabe o no vale para n_ch columnas.
+bool parseChannels(const uint8_t* p, uint16_t len, uint8_t nChByte, size_t& pos,
+                   int& nCols, uint32_t& mask, int& nAct, uint8_t cols[32])
+{
+  nCols = nChByte & ~EEG_CH_MASKED;
+  if (nCols < 1 || nCols > 32) return false;
+  mask = allColumns(nCols);
+  if (nChByte & EEG_CH_MASKED) {
+    if (len < pos + EEG_CH_MASK_SIZE) return false;
+    uint32_t m = rdU32(p + pos);
+    pos += EEG_CH_MASK_SIZE;
+    if (m == 0 || (m & ~mask) != 0) return false;
+    mask = m;
+  }
+  nAct = 0;
+  for (int c = 0; c < nCols; ++c)
+    if (mask & (1u << c)) cols[nAct++] = (uint8_t)c;
+  return true;
+}
+
+// Prepara las muestras de un paquete con n_ch/n_status; false sin memoria.
+// Un cambio de forma (o de canales activos) descarta lo acumulado
+// (reconfiguración del firmware).
+bool beginSamples(DecoderObject* d, int nCh, uint32_t mask, int nStatus, size_t n)
+{
+  if (d->nSamples && (nCh != d->nCh || mask != d->chMask || nStatus != d->nStatus)) {
+    d->samplesDropped += (unsigned long long)d->nSamples;
+    d->idx->clear();
+    d->ch->clear();
+    d->st->clear();
+    d->nSamples = 0;
+  }
+  d->nCh = nCh;
+  d->chMask = mask;
+  d->nStatus = nStatus;
+  return d->idx->reserve(n * 4) && d->ch->reserve(n * 4 * nCh) && d->st->reserve(n * 4 * nStatus);
+}
+
+inline void pushU32(GrowBuf* b, uint32_t v)
+{
+  memcpy(b->p + b->n, &v, 4);
+  b->n += 4;
+}
+
+// Fila de columnas a partir de los activos: los apagados a 0
+inline int32_t* beginRow(DecoderObject* d, int nCols, int nAct)
+{
+  int32_t* out = (int32_t*)(d->ch->p + d->ch->n);
+  if (nAct != nCols) memset(out, 0, 4 * (size_t)nCols);
+  return out;
+}
+
+bool decodeSample(DecoderObject* d, const uint8_t* p, uint16_t len)
+{
+  if (len < 8 || (len - 4) % 4) return false;
+  int nCh = (len - 4) / 4;
+  if (!beginSamples(d, nCh, allColumns(nCh), 0, 1)) return false;
+  pushU32(d->idx, rdU32(p));
+  memcpy(d->ch->p + d->ch->n, p + 4, 4 * (size_t)nCh);  // int32 LE: se copia tal cual
+  d->ch->n += 4 * (size_t)nCh;
+  ++d->nSamples;
+  return true;
+}
+
+// [u32 idx][u8 n_ch][u32 ch_mask][int32 × activos]
+bool decodeSampleMasked(DecoderObject* d, const uint8_t* p, uint16_t len)
+{
+  if (len < 9) return false;
+  size_t pos = 5;
+  int nCols, nAct;
+  uint32_t mask;
+  uint8_t cols[32];
+  if (!parseChannels(p, len, (uint8_t)(p[4] | EEG_CH_MASKED), pos, nCols, mask, nAct, cols)) return false;
+  if (len != pos + 4 * (size_t)nAct || !beginSamples(d, nCols, mask, 0, 1)) return false;
+  pushU32(d->idx, rdU32(p));
+  int32_t* out = beginRow(d, nCols, nAct);
+  for (int k = 0; k < nAct; ++k) out[cols[k]] = (int32_t)rdU32(p + pos + 4 * k);
+  d->ch->n += 4 * (size_t)nCols;
+  ++d->nSamples;
+  return true;
+}
+
+bool decodeBatch(DecoderObject* d, const uint8_t* p, uint16_t len)
+{
+  if (len < EEG_BATCH_HEADER) return false;
+  uint32_t base = rdU32(p);
+  int n = p[4], nSt = p[6];
+  size_t pos = EEG_BATCH_HEADER;
+  int nCh, nAct;
+  uint32_t mask;
+  uint8_t cols[32];
+  if (!parseChannels(p, len, p[5], pos, nCh, mask, nAct, cols)) return false;
+  size_t rec = 3 * (size_t)(nAct + nSt);
+  if (len != pos + n * rec) return false;
+  if (!beginSamples(d, nCh, mask, nSt, (size_t)n)) return false;
+
+  const uint8_t* q = p + pos;
+  for (int k = 0; k < n; ++k) {
+    pushU32(d->idx, base + (uint32_t)k);
+    for (int s = 0; s < nSt; ++s, q += 3)
+      pushU32(d->st, ((uint32_t)q[0] << 16) | ((uint32_t)q[1] << 8) | q[2]);
+    int32_t* out = beginRow(d, nCh, nAct);
+    for (int c = 0; c < nAct; ++c, q += 3)
+      out[cols[c]] = s24(((uint32_t)q[0] << 16) | ((uint32_t)q[1] << 8) | q[2]);
+    d->ch->n += 4 * (size_t)nCh;
+  }
+  d->nSamples += n;
+  return true;
+}
+
+// Lector de bits MSB-first sobre el bitstream RICE
+struct BitReader {
+  const uint8_t* p;
+  size_t nbits;
+  size_t pos = 0;
+  bool ok = true;
+
+  uint32_t bit() {
+    if (pos >= nbits) {
+      ok = false;
+      return 0;
+    }
+    uint32_t b = (p[pos >> 3] >> (7 - (pos & 7))) & 1u;
+    ++pos;
+    return b;
+  }
+  uint32_t bits(unsigned n) {
+    uint32_t v = 0;
+    while (n--) v = (v << 1) | bit();
+    return v;
+  }
+};
+
+inline int32_t ricePredict(const EEGStream_RiceState& s, unsigned order)
+{
+  if (order == 1) return s.h1;
+  if (order == 2) {
+    int64_t p = 2 * (int64_t)s.h1 - s.h2;
+    return p > MAX24 ? MAX24 : (p < MIN24 ? MIN24 : (int32_t)p);
+  }
+  return 0;
+}
+
+inline unsigned riceK(const EEGStream_RiceState& s)
+{
+  unsigned k = 0;
+  while (k < 24 && ((uint64_t)s.n << k) < s.a) ++k;
+  return k;
+}
+
+// 1: decodificado; 0: paquete descartado (falta keyframe); -1: inválido
+int decodeRice(DecoderObject* d, const uint8_t* p, uint16_t len)
+{
+  if (len < EEG_RICE_HEADER) return -1;
+  uint32_t base = rdU32(p);
+  int n = p[4], nSt = p[6];
+  bool key = p[7] & 0x01;
+  unsigned order = (p[7] >> 1) & 0x03;
+  int chain = p[8];
+  size_t pos = EEG_RICE_HEADER;
+  int nCh, nAct;
+  uint32_t mask;
+  uint8_t cols[32];
+  if (!parseChannels(p, len, p[5], pos, nCh, mask, nAct, cols)) return -1;
+  size_t nStreams = (size_t)(nAct + nSt);
+  std::vector<EEGStream_RiceState>& streams = *d->rice;
+
+  if (key) {
+    streams.assign(nStreams, EEGStream_RiceState{0, 0, EEG_RICE_A_INIT, 1});
+  } else if (d->riceChain < 0 || chain != ((d->riceChain + 1) & 0xFF) || streams.size() != nStreams ||
+             mask != d->riceMask) {
+    d->riceChain = -1;
+    ++d->ricePacketsDropped;
+    return 0;
+  }
+  if (!beginSamples(d, nCh, mask, nSt, (size_t)n)) return -1;
+
+  BitReader rd{p + pos, 8u * (size_t)(len - pos)};
+  size_t idx0 = d->idx->n, ch0 = d->ch->n, st0 = d->st->n;
+  for (int i = 0; i < n && rd.ok; ++i) {
+    pushU32(d->idx, base + (uint32_t)i);
+    int32_t* out = beginRow(d, nCh, nAct);
+    for (size_t j = 0; j < nStreams; ++j) {
+      EEGStream_RiceState& s = streams[j];
+      int32_t x;
+      if (key && i == 0) {
+        x = s24(rd.bits(24));
+        s.h1 = s.h2 = x;
+      } else {
+        unsigned k = riceK(s);
+        unsigned q = 0;
+        while (q < EEG_RICE_QMAX && rd.bit()) ++q;
+        uint32_t u = q == EEG_RICE_QMAX ? rd.bits(EEG_RICE_ESCBITS) : (q << k) | rd.bits(k);
+        int32_t e = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+        x = ricePredict(s, order) + e;
+        s.a += u;
+        if (++s.n >= EEG_RICE_RESET) {
+          s.a >>= 1;
+          s.n >>= 1;
+        }
+        s.h2 = s.h1;
+        s.h1 = x;
+      }
+      if ((int)j < nSt) pushU32(d->st, (uint32_t)x & 0xFFFFFF);
+      else out[cols[j - nSt]] = x;
+    }
+    d->ch->n += 4 * (size_t)nCh;
+  }
+  if (!rd.ok) {
+    // Bitstream truncado: se deshace el paquete y se espera al keyframe
+    d->idx->n = idx0;
+    d->ch->n = ch0;
+    d->st->n = st0;
+    d->riceChain = -1;
+    return -1;
+  }
+  d->nSamples += n;
+  d->riceChain = chain;
+  d->riceMask = mask;
+  return 1;
+}
+
+bool keepPacket(DecoderObject* d, uint8_t type, uint8_t seq, const uint8_t* p, uint16_t len)
+{
+  PyObject* t = Py_BuildValue("(iiy#)", (int)type, (int)seq, (const char*)p, (Py_ssize_t)len);
+  if (!t) return false;
+  int r = PyList_Append(d->other, t);
+  Py_DECREF(t);
+  return r == 0;
+}
+
+// Procesa los paquetes completos del buffer. -1 con excepción puesta.
+int parse(DecoderObject* d)
+{
+  std::vector<uint8_t>& rx = *d->rx;
+  size_t head = d->rxHead;
+  const size_t end = rx.size();
+
+  for (;;) {
+    const uint8_t* base = rx.data();
+    size_t avail = end - head;
+    const uint8_t* s = avail ? (const uint8_t*)memchr(base + head, EEG_SYNC0, avail) : nullptr;
+    // Sync: A5 seguido de 5A (o A5 al final, pendiente del siguiente byte)
+    while (s && (size_t)(s - base) + 1 < end && s[1] != EEG_SYNC1)
+      s = (const uint8_t*)memchr(s + 1, EEG_SYNC0, end - (size_t)(s + 1 - base));
+    if (!s) {
+      d->bytesSkipped += avail;
+      head = end;
+      break;
+    }
+    size_t start = (size_t)(s - base);
+    d->bytesSkipped += start - head;
+    head = start;
+
+    if (end - head < EEG_HEADER_SIZE) break;
+    const uint8_t* h = base + head;
+    uint8_t type = h[2], seq = h[3];
+    uint16_t len = rdU16(h + 4);
+    if (len > EEG_MAX_PAYLOAD) {
+      ++d->bytesSkipped;
+      ++head;
+      continue;
+    }
+    size_t total = (size_t)EEG_HEADER_SIZE + len + EEG_CRC_SIZE;
+    if (end - head < total) break;
+
+    uint16_t crc = EEG_Crc16Update(EEG_CRC16_INIT, h + 2, (uint16_t)(EEG_HEADER_SIZE - 2 + len));
+    if (crc != rdU16(h + EEG_HEADER_SIZE + len)) {
+      ++d->crcErrors;
+      ++d->bytesSkipped;
+      ++head;
+      continue;
+    }
+    head += total;
+    if (d->lastSeq >= 0 && seq != ((d->lastSeq + 1) & 0xFF)) ++d->seqGaps;
+    d->lastSeq = seq;
+    ++d->packetsOk;
+
+    const uint8_t* pl = h + EEG_HEADER_SIZE;
+    bool ok = true;
+    if (type == EEG_PKT_SAMPLE) ok = decodeSample(d, pl, len);
+    else if (type == EEG_PKT_BATCH) ok = decodeBatch(d, pl, len);
+    else if (type == EEG_PKT_RICE) ok = decodeRice(d, pl, len) >= 0;
+    else if (type == EEG_PKT_SAMPLE_MASKED) ok = decodeSampleMasked(d, pl, len);
+    else {
+      // El reloj se actualiza aquí (hora de llegada exacta); Python los ve igual
+      if (type == EEG_PKT_PONG && len == EEG_PONG_PAYLOAD) d->clock->addPong(pl, d->rxTime);
+      else if (type == EEG_PKT_TIMING && len == EEG_TIMING_PAYLOAD) d->clock->addTiming(rdU32(pl), rdU32(pl + 4));
+      if (!keepPacket(d, type, seq, pl, len)) {
+        d->rxHead = head;
+        return -1;
+      }
+    }
+    if (!ok) ++d->decodeErrors;
+  }
+
+  // Compactar: lo consumido sale del buffer cuando ya es grande
+  if (head == end) {
+    rx.clear();
+    head = 0;
+  } else if (head >= RX_COMPACT) {
+    rx.erase(rx.begin(), rx.begin() + (std::ptrdiff_t)head);
+    head = 0;
+  }
+  d->rxHead = head;
+  return 0;
+}
+
+// ---- Métodos ----
+PyObject* Decoder_new(PyTypeObject* type, PyObject*, PyObject*)
+{
+  DecoderObject* d = (DecoderObject*)type->tp_alloc(type, 0);
+  if (!d) return nullptr;
+  d->rx = new std::vector<uint8_t>();
+  d->idx = new GrowBuf();
+  d->ch = new GrowBuf();
+  d->st = new GrowBuf();
+  d->rice = new std::vector<EEGStream_RiceState>();
+  d->clock = new ClockSync();
+  d->rxTime = NAN;
+  d->other = PyList_New(0);
+  d->lastSeq = -1;
+  d->nCh = -1;
+  d->riceChain = -1;
+  if (!d->other) {
+    Py_DECREF(d);
+    return nullptr;
+  }
+  return (PyObject*)d;
+}
+
+void Decoder_dealloc(DecoderObject* d)
+{
+  delete d->rx;
+  delete d->idx;
+  delete d->ch;
+  delete d->st;
+  delete d->rice;
+  delete d->clock;
+  Py_XDECREF(d->other);
+  PyTypeObject* tp = Py_TYPE(d);
+  tp->tp_free((PyObject*)d);
+  Py_DECREF(tp);
+}
+
+PyObject* Decoder_feed(DecoderObject* d, PyObject* args, PyObject* kw)
+{
+  static const char* kwlist[] = {"data", "t_host", nullptr};
+  PyObject* arg;
+  PyObject* tHost = Py_None;
+  if (!PyArg_ParseTupleAndKeywords(args, kw, "O|O", (char**)kwlist, &arg, &tHost)) return nullptr;
+  double t = NAN;
+  if (tHost != Py_None) {
+    t = PyFloat_AsDouble(tHost);
+    if (t == -1.0 && PyErr_Occurred()) return nullptr;
+  }
+  Py_buffer b;
+  if (PyObject_GetBuffer(arg, &b, PyBUF_SIMPLE) < 0) return nullptr;
+  d->rxTime = tHost == Py_None ? hostNow() : t;
+  Py_ssize_t before = d->nSamples;
+  const uint8_t* p = (const uint8_t*)b.buf;
+  d->rx->insert(d->rx->end(), p, p + b.len);
+  PyBuffer_Release(&b);
+  if (parse(d) < 0) return nullptr;
+  return PyLong_FromSsize_t(d->nSamples - before);
+}
+
+PyObject* Decoder_read_fd(DecoderObject* d, PyObject* args, PyObject* kw)
+{
+#ifdef _WIN32
+  (void)d; (void)args; (void)kw;
+  PyErr_SetString(PyExc_NotImplementedError, "read_fd no disponible en Windows: usar feed()");
+  return nullptr;
+#else
+  static const char* kwlist[] = {"fd", "timeout_ms", "max_bytes", nullptr};
+  int fd, timeout = 0;
+  Py_ssize_t maxBytes = 65536;
+  if (!PyArg_ParseTupleAndKeywords(args, kw, "i|in", (char**)kwlist, &fd, &timeout, &maxBytes))
+    return nullptr;
+  if (maxBytes <= 0) maxBytes = 1;
+
+  std::vector<uint8_t>& rx = *d->rx;
+  size_t old = rx.size();
+  rx.resize(old + (size_t)maxBytes);
+  ssize_t got = 0;
+  int err = 0;
+  Py_BEGIN_ALLOW_THREADS
+  struct pollfd pfd = {fd, POLLIN, 0};
+  int pr = poll(&pfd, 1, timeout);
+  if (pr > 0) {
+    got = read(fd, rx.data() + old, (size_t)maxBytes);
+    if (got < 0) err = errno;
+  } else if (pr < 0) {
+    err = errno;
+  }
+  Py_END_ALLOW_THREADS
+  if (err == EAGAIN || err == EWOULDBLOCK || err == EINTR) {
+    err = 0;
+    got = 0;
+  }
+  rx.resize(old + (got > 0 ? (size_t)got : 0));
+  if (got > 0) d->rxTime = hostNow();
+  if (err) {
+    errno = err;
+    return PyErr_SetFromErrno(PyExc_OSError);
+  }
+  if (parse(d) < 0) return nullptr;
+  return PyLong_FromSsize_t(got);
+#endif
+}
+
+PyObject* Decoder_take(DecoderObject* d, PyObject* args, PyObject* kw)
+{
+  static const char* kwlist[] = {"float32", "scale", "times", nullptr};
+  int asFloat = 0, withTimes = 0;
+  double scale = DEFAULT_LSB;
+  if (!PyArg_ParseTupleAndKeywords(args, kw, "|pdp", (char**)kwlist, &asFloat, &scale, &withTimes))
+    return nullptr;
+
+  Py_ssize_t n = d->nSamples;
+  Py_ssize_t nCh = d->nCh < 0 ? 0 : d->nCh;
+  Py_ssize_t nSt = d->nStatus;
+  char* chData = d->ch->release();
+  if (asFloat && n) {
+    // Conversión a voltios en una pasada, sobre la misma memoria (4 bytes → 4 bytes);
+    // los canales apagados, NaN
+    const uint32_t mask = d->chMask;
+    for (Py_ssize_t i = 0; i < n * nCh; ++i) {
+      int32_t v;
+      memcpy(&v, chData + 4 * i, 4);
+      float f = (mask >> (i % nCh)) & 1u ? (float)(v * scale) : NAN;
+      memcpy(chData + 4 * i, &f, 4);
+    }
+  }
+  // Hora del host del DRDY de cada muestra, con el ajuste de ahora
+  char* tData = nullptr;
+  if (withTimes) {
+    tData = (char*)malloc(n ? 8 * (size_t)n : 8);
+    if (!tData) {
+      free(chData);
+      return PyErr_NoMemory();
+    }
+    const uint32_t* ix = (const uint32_t*)d->idx->p;
+    double* tt = (double*)tData;
+    for (Py_ssize_t i = 0; i < n; ++i) tt[i] = d->clock->sampleTime(ix[i]);
+  }
+  PyObject* idx = newBlock(d->idx->release(), n, 0, 'I');
+  PyObject* ch = newBlock(chData, n, nCh ? nCh : 1, asFloat ? 'f' : 'i');
+  if (!nCh && ch) ((BlockObject*)ch)->shape[1] = 0;
+  PyObject* st = newBlock(d->st->release(), n, nSt ? nSt : 1, 'I');
+  if (!nSt && st) ((BlockObject*)st)->shape[1] = 0;
+  PyObject* tm = withTimes ? newBlock(tData, n, 0, 'd') : nullptr;
+  d->nSamples = 0;
+  if (!idx || !ch || !st || (withTimes && !tm)) {
+    Py_XDECREF(idx);
+    Py_XDECREF(ch);
+    Py_XDECREF(st);
+    Py_XDECREF(tm);
+    return nullptr;
+  }
+  if (withTimes) return Py_BuildValue("(NNNN)", idx, ch, st, tm);
+  return Py_BuildValue("(NNN)", idx, ch, st);
+}
+
+PyObject* Decoder_packets(DecoderObject* d, PyObject*)
+{
+  PyObject* out = d->other;
+  PyObject* fresh = PyList_New(0);
+  if (!fresh) return nullptr;
+  d->other = fresh;
+  return out;
+}
+
+PyObject* Decoder_reset(DecoderObject* d, PyObject*)
+{
+  d->rx->clear();
+  d->rxHead = 0;
+  d->lastSeq = -1;
+  d->rice->clear();
+  d->riceChain = -1;
+  d->clock->reset();
+  Py_RETURN_NONE;
+}
+
+PyObject* Decoder_host_time(DecoderObject* d, PyObject* arg)
+{
+  unsigned long t = PyLong_AsUnsignedLongMask(arg);
+  if (t == (unsigned long)-1 && PyErr_Occurred()) return nullptr;
+  return PyFloat_FromDouble(d->clock->hostTime((uint32_t)t));
+}
+
+PyObject* Decoder_clock_stats(DecoderObject* d, PyObject*)
+{
+  const ClockSync& c = *d->clock;
+  double dmin = NAN;
+  for (const ClockSync::Ping& q : c.pings) dmin = isnan(dmin) || q.delay < dmin ? q.delay : dmin;
+  return Py_BuildValue("{s:O,s:d,s:d,s:d,s:d,s:K,s:d}", "synced", c.synced() ? Py_True : Py_False,
+                       "offset_s", c.a, "drift_ppm", c.b * 1e6, "rtt_s", c.rtt, "delay_min_s", dmin,
+                       "pings", c.nPings, "period_us", c.periodUs);
+}
+
+PyObject* Decoder_get_pending(DecoderObject* d, void*) { return PyLong_FromSsize_t(d->nSamples); }
+PyObject* Decoder_get_n_ch(DecoderObject* d, void*) { return PyLong_FromLong(d->nCh); }
+PyObject* Decoder_get_ch_mask(DecoderObject* d, void*)
+{
+  return PyLong_FromUnsignedLong(d->nCh < 0 ? 0 : d->chMask);
+}
+
+#define COUNTER(name, field)                                                            \
+  PyObject* Decoder_get_##name(DecoderObject* d, void*) {                               \
+    return PyLong_FromUnsignedLongLong(d->field);                                       \
+  }
+COUNTER(packets_ok, packetsOk)
+COUNTER(crc_errors, crcErrors)
+COUNTER(bytes_skipped, bytesSkipped)
+COUNTER(seq_gaps, seqGaps)
+COUNTER(rice_packets_dropped, ricePacketsDropped)
+COUNTER(decode_errors, decodeErrors)
+COUNTER(samples_dropped, samplesDropped)
+#undef COUNTER
+
+PyMethodDef Decoder_methods[] = {
+  {"feed", (PyCFunction)(void (*)(void))Decoder_feed, METH_VARARGS | METH_KEYWORDS,
+   "feed(data, t_host=None) -> nº de muestras nuevas. Añade bytes (cualquier objeto buffer) "
+   "y decodifica; t_host: su hora de llegada (time.perf_counter(), por defecto ahora)."},
+  {"read_fd", (PyCFunction)(void (*)(void))Decoder_read_fd, METH_VARARGS | METH_KEYWORDS,
+   "read_fd(fd, timeout_ms=0, max_bytes=65536) -> bytes leídos. Lee del fd sin el GIL "
+   "(POSIX) y decodifica."},
+  {"take", (PyCFunction)(void (*)(void))Decoder_take, METH_VARARGS | METH_KEYWORDS,
+   "take(float32=False, scale=LSB, times=False) -> (idx, channels, status[, t_host]). Entrega "
+   "las muestras acumuladas como Block (n,), (n, n_ch) y (n, n_status) sin copiar; con times, "
+   "también la hora del host (float64, NaN sin sincronizar) del DRDY de cada una."},
+  {"packets", (PyCFunction)Decoder_packets, METH_NOARGS,
+   "packets() -> lista de (type, seq, payload) de los paquetes que no son de muestras."},
+  {"reset", (PyCFunction)Decoder_reset, METH_NOARGS,
+   "Descarta el buffer de entrada y el estado de secuencia, RICE y reloj."},
+  {"host_time", (PyCFunction)Decoder_host_time, METH_O,
+   "host_time(t_dev_us) -> s del host (time.perf_counter()) de un micros() del firmware; NaN "
+   "sin sincronizar."},
+  {"clock_stats", (PyCFunction)Decoder_clock_stats, METH_NOARGS,
+   "clock_stats() -> dict con synced, offset_s, drift_ppm, rtt_s, delay_min_s, pings y "
+   "period_us (ver eeg_protocol.ClockSync.stats())."},
+  {nullptr, nullptr, 0, nullptr},
+};
+
+PyGetSetDef Decoder_getset[] = {
+  {"pending", (getter)Decoder_get_pending, nullptr, "muestras acumuladas", nullptr},
+  {"n_ch", (getter)Decoder_get_n_ch, nullptr, "canales de las últimas muestras (-1: ninguna)", nullptr},
+  {"ch_mask", (getter)Decoder_get_ch_mask, nullptr,
+   "columnas con datos de las últimas muestras (bit c = canal c; 0: ninguna)", nullptr},
+  {"packets_ok", (getter)Decoder_get_packets_ok, nullptr, nullptr, nullptr},
+  {"crc_errors", (getter)Decoder_get_crc_errors, nullptr, nullptr, nullptr},
+  {"bytes_skipped", (getter)Decoder_get_bytes_skipped, nullptr, nullptr, nullptr},
+  {"seq_gaps", (getter)Decoder_get_seq_gaps, nullptr, nullptr, nullptr},
+  {"rice_packets_dropped", (getter)Decoder_get_rice_packets_dropped, nullptr,
+   "paquetes RICE descartados esperando keyframe", nullptr},
+  {"decode_errors", (getter)Decoder_get_decode_errors, nullptr,
+   "paquetes de muestras con CRC válido pero payload inválido", nullptr},
+  {"samples_dropped", (getter)Decoder_get_samples_dropped, nullptr,
+   "muestras descartadas por un cambio de n_ch/ch_mask/n_status antes de take()", nullptr},
+  {nullptr, nullptr, nullptr, nullptr, nullptr},
+};
+
+PyType_Slot Decoder_slots[] = {
+  {Py_tp_new, (void*)Decoder_new},
+  {Py_tp_dealloc, (void*)Decoder_dealloc},
+  {Py_tp_methods, (void*)Decoder_methods},
+  {Py_tp_getset, (void*)Decoder_getset},
+  {Py_tp_doc, (void*)"Decodificador incremental del flujo EEG (SAMPLE/BATCH/RICE)."},
+  {0, nullptr},
+};
+
+PyType_Spec Decoder_spec = {
+  "eeg_native.Decoder", sizeof(DecoderObject), 0, Py_TPFLAGS_DEFAULT, Decoder_slots,
+};
+
+PyModuleDef moduleDef = {
+  PyModuleDef_HEAD_INIT, "eeg_native",
+  "Decodificador nativo del protocolo EEG (ver dsp-processor/native).", -1,
+  nullptr, nullptr, nullptr, nullptr, nullptr,
+};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit_eeg_native(void)
+{
+  PyObject* m = PyModule_Create(&moduleDef);
+  if (!m) return nullptr;
+  BlockType = (PyTypeObject*)PyType_FromSpec(&Block_spec);
+  PyObject* dec = PyType_FromSpec(&Decoder_spec);
+  if (!BlockType || !dec || PyModule_AddObject(m, "Block", (PyObject*)BlockType) < 0) {
+    Py_XDECREF(dec);
+    Py_DECREF(m);
+    return nullptr;
+  }
+  Py_INCREF(BlockType);  // referencia propia del módulo (newBlock)
+  PyObject* timeMod = PyImport_ImportModule("time");
+  perfCounter = timeMod ? PyObject_GetAttrString(timeMod, "perf_counter") : nullptr;
+  Py_XDECREF(timeMod);
+  if (!perfCounter) {
+    Py_DECREF(m);
+    return nullptr;
+  }
+  if (PyModule_AddObject(m, "Decoder", dec) < 0 ||
+      PyModule_AddObject(m, "LSB", PyFloat_FromDouble(DEFAULT_LSB)) < 0) {
+    Py_DECREF(m);
+    return nullptr;
+  }
+  return m;
+}
@@ -0,0 +1,951 @@
+// eeg_replay.cpp
+// Emulador del dispositivo para pruebas de carga del host: reproduce
+// grabaciones EDF (mathrecordingeeg/*.edf) como el flujo binario del firmware
+// (docs/protocol.md) por un pty, un socket TCP o un fichero, para medir
+// dónde satura data_receiver.py → DSPCore → midi_writer.py sin casco.
+//
+//  - El EDF se lee proyectado en memoria (mmap), registro a registro: no se
+//    carga entero ni se copia más que el registro en curso.
+//  - Los paquetes los construyen las mismas clases del firmware
+//    (lib/EEGStream: PacketBuilder, Batcher, RiceEncoder, TxQueue) con la
+//    misma política que src/main.cpp: SAMPLE (36 bytes de payload con 8
+//    canales), BATCH o RICE, TIMING cada 16 paquetes de datos, STATS cada
+//    segundo y un único tx_seq. Mismos bytes que enviaría la placa.
+//  - Ritmo: tiempo real (--rate 1), N× (--rate N) o lo más rápido posible
+//    (--rate 0, sin pérdidas: espera al lector). Con ritmo, una cola de
+//    salida con descarte de los más antiguos como la del firmware: si el
+//    host no lee a tiempo se ven huecos en seq y tx_dropped en STATS.
+//  - Fallos inyectables: pérdida de bytes (--loss, --loss-burst) después de
+//    la cola, como en el cable, y jitter en el instante de salida de cada
+//    muestra (--jitter).
+//
+//   ./eeg_replay ../mathrecordingeeg/Subject00_1.edf --pty --link /tmp/eeg
+//   python main.py --port /tmp/eeg
+//   ./eeg_replay ../mathrecordingeeg/Subject00_1.edf --tcp 5555 --rate 8
+//   python main.py --port socket://localhost:5555
+//
+// Solo POSIX. Lo compila setup.py junto a las extensiones, o a mano:
+//   c++ -O3 -std=c++14 -I"../../arduino-firmware.bak/EEG MIDI/lib/EEGStream/src"
+//       eeg_replay.cpp -o eeg_replay
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "EEGStream_Protocol.h"
+#include "EEGStream_Packet.h"
+#include "EEGStream_Batcher.h"
+#include "EEGStream_Rice.h"
+#include "EEGStream_Transport.h"
+// Implementación del firmware en esta misma unidad (como eeg_native.cpp):
+// una sola orden de compilación y ninguna copia del código del emisor
+#include "EEGStream_Packet.cpp"
+#include "EEGStream_Batcher.cpp"
+#include "EEGStream_Rice.cpp"
+#include "EEGStream_Transport.cpp"
+
+namespace {
+
+// ---- Configuración del firmware (src/main.cpp) ----
+constexpr uint32_t STATUS_WORD      = 0xC00000; // 1100 + lead-off y GPIO a 0 (datasheet 9.4.4.2)
+constexpr uint32_t BATCH_FLUSH_US   = 50000;
+constexpr uint16_t TX_QUEUE_SIZE    = 320;
+constexpr uint8_t  ACQ_RING_SIZE    = 16;       // solo informativo en STATS
+constexpr uint16_t DIAG_MAX_TEXT    = 160;
+constexpr uint8_t  CH_PER_DEVICE    = 8;        // ADS1299-8: una palabra STATUS cada 8 canales
+constexpr int32_t  MAX24            = 8388607;
+constexpr int32_t  MIN24            = -8388608;
+
+constexpr uint16_t SINK_CHUNK       = 1024;     // bytes por write() al descriptor
+constexpr double   DEFAULT_LSB      = 2.235e-8; // V por cuenta (ganancia 24)
+
+volatile sig_atomic_t g_stop = 0;
+void onSignal(int) { g_stop = 1; }
+
+// ---- Tiempo ----
+uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void sleepUntilNs(uint64_t t) {
+  struct timespec ts;
+  ts.tv_sec = (time_t)(t / 1000000000ull);
+  ts.tv_nsec = (long)(t % 1000000000ull);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR && !g_stop) {
+  }
+}
+
+// ---- Aleatorio reproducible (xorshift64*, --seed) ----
+struct Rng {
+  uint64_t s;
+  explicit Rng(uint64_t seed) : s(seed ? seed : 0x9E3779B97F4A7C15ull) {}
+  uint64_t next() {
+    s ^= s >> 12;
+    s ^= s << 25;
+    s ^= s >> 27;
+    return s * 0x2545F4914F6CDD1Dull;
+  }
+  double uniform() { return (double)(next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+// =========================
+//  Lectura de EDF
+// =========================
+struct EdfSignal {
+  std::string label;
+  std::string unit;
+  double physMin, physMax;
+  double digMin, digMax;
+  uint32_t spr;      // muestras por registro
+  uint32_t offset;   // muestras de las señales anteriores dentro del registro
+};
+
+std::string field(const char* p, size_t n) {
+  size_t a = 0, b = n;
+  while (a < b && (p[a] == ' ' || p[a] == '\0')) ++a;
+  while (b > a && (p[b - 1] == ' ' || p[b - 1] == '\0')) --b;
+  return std::string(p + a, b - a);
+}
+
+// Voltios por unidad física del EDF
+double unitScale(const std::string& u) {
+  if (u == "V") return 1.0;
+  if (u == "mV") return 1e-3;
+  if (u == "nV") return 1e-9;
+  return 1e-6; // uV, µV (UTF-8 o Latin-1) y cabeceras sin unidad
+}
+
+bool isAnnotation(const EdfSignal& s) { return s.label == "EDF Annotations"; }
+
+class EdfFile {
+public:
+  EdfFile() = default;
+  EdfFile(const EdfFile&) = delete;
+  EdfFile& operator=(const EdfFile&) = delete;
+  ~EdfFile() {
+    if (map_ != MAP_FAILED) munmap(map_, size_);
+  }
+
+  bool open(const char* path, std::string& err) {
+    path_ = path;
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return fail(err, strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 256) {
+      ::close(fd);
+      return fail(err, "no es un EDF (menos de 256 bytes)");
+    }
+    size_ = (size_t)st.st_size;
+    map_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map_ == MAP_FAILED) return fail(err, strerror(errno));
+    madvise(map_, size_, MADV_SEQUENTIAL);
+
+    const char* h = (const char*)map_;
+    headerBytes_ = (size_t)atol(field(h + 184, 8).c_str());
+    long nrec = atol(field(h + 236, 8).c_str());
+    duration_ = atof(field(h + 244, 8).c_str());
+    int ns = atoi(field(h + 252, 4).c_str());
+    if (ns <= 0 || headerBytes_ != 256 + 256 * (size_t)ns || headerBytes_ > size_ || duration_ <= 0)
+      return fail(err, "cabecera EDF inválida");
+
+    const char* s = h + 256;
+    sig_.resize((size_t)ns);
+    uint32_t off = 0;
+    for (int i = 0; i < ns; ++i) {
+      EdfSignal& g = sig_[(size_t)i];
+      g.label   = field(s + 16 * i, 16);
+      g.unit    = field(s + ns * 96 + 8 * i, 8);
+      g.physMin = atof(field(s + ns * 104 + 8 * i, 8).c_str());
+      g.physMax = atof(field(s + ns * 112 + 8 * i, 8).c_str());
+      g.digMin  = atof(field(s + ns * 120 + 8 * i, 8).c_str());
+      g.digMax  = atof(field(s + ns * 128 + 8 * i, 8).c_str());
+      g.spr     = (uint32_t)atol(field(s + ns * 216 + 8 * i, 8).c_str());
+      g.offset  = off;
+      off += g.spr;
+      if (g.digMax <= g.digMin) g.digMax = g.digMin + 1; // evita dividir por 0
+    }
+    recBytes_ = (size_t)off * 2;
+    if (recBytes_ == 0) return fail(err, "registros vacíos");
+    // -1 = grabación sin cerrar: lo que haya en el fichero
+    size_t avail = (size_ - headerBytes_) / recBytes_;
+    records_ = nrec < 0 || (size_t)nrec > avail ? avail : (size_t)nrec;
+    if (records_ == 0) return fail(err, "sin registros de datos");
+    return true;
+  }
+
+  const std::vector<EdfSignal>& signals() const { return sig_; }
+  size_t records() const { return records_; }
+  double duration() const { return duration_; }
+  const std::string& path() const { return path_; }
+
+  // Registro r: las señales una tras otra, int16 little-endian
+  const uint8_t* record(size_t r) const {
+    return (const uint8_t*)map_ + headerBytes_ + r * recBytes_;
+  }
+
+  // Libera las páginas ya leídas (los EDF de horas no se quedan en RAM)
+  void release(size_t r) const {
+    long page = sysconf(_SC_PAGESIZE);
+    size_t end = headerBytes_ + r * recBytes_;
+    end -= end % (size_t)page;
+    if (end) madvise(map_, end, MADV_DONTNEED);
+  }
+
+private:
+  bool fail(std::string& err, const char* why) {
+    err = path_ + ": " + why;
+    return false;
+  }
+
+  std::string path_;
+  void* map_ = MAP_FAILED;
+  size_t size_ = 0;
+  size_t headerBytes_ = 0;
+  size_t recBytes_ = 0;
+  size_t records_ = 0;
+  double duration_ = 0;
+  std::vector<EdfSignal> sig_;
+};
+
+// ---- Selección de canales (--channels: índices o etiquetas, con o sin "EEG ") ----
+bool labelMatches(const std::string& label, const std::string& want) {
+  if (strcasecmp(label.c_str(), want.c_str()) == 0) return true;
+  return label.size() > 4 && strncasecmp(label.c_str(), "EEG ", 4) == 0 &&
+         strcasecmp(label.c_str() + 4, want.c_str()) == 0;
+}
+
+bool selectChannels(const EdfFile& f, const std::string& spec, size_t defaultCount,
+                    std::vector<size_t>& out, std::string& err) {
+  const std::vector<EdfSignal>& sig = f.signals();
+  out.clear();
+  if (spec.empty() || spec == "all") {
+    for (size_t i = 0; i < sig.size(); ++i) {
+      if (isAnnotation(sig[i])) continue;
+      if (!out.empty() && sig[i].spr != sig[out[0]].spr) continue; // otra frecuencia
+      out.push_back(i);
+      if (spec.empty() && out.size() == defaultCount) break;
+    }
+  } else {
+    size_t a = 0;
+    while (a <= spec.size()) {
+      size_t b = spec.find(',', a);
+      if (b == std::string::npos) b = spec.size();
+      std::string tok = spec.substr(a, b - a);
+      a = b + 1;
+      if (tok.empty()) continue;
+      char* end = nullptr;
+      long k = strtol(tok.c_str(), &end, 10);
+      size_t found = sig.size();
+      if (*end == '\0') {
+        if (k >= 0 && (size_t)k < sig.size()) found = (size_t)k;
+      } else {
+        for (size_t i = 0; i < sig.size(); ++i)
+          if (labelMatches(sig[i].label, tok)) { found = i; break; }
+      }
+      if (found == sig.size() || isAnnotation(sig[found])) {
+        err = f.path() + ": no hay canal '" + tok + "'";
+        return false;
+      }
+      out.push_back(found);
+    }
+  }
+  if (out.empty()) {
+    err = f.path() + ": ningún canal de señal";
+    return false;
+  }
+  for (size_t i : out) {
+    if (sig[i].spr != sig[out[0]].spr) {
+      err = f.path() + ": los canales elegidos tienen frecuencias distintas";
+      return false;
+    }
+  }
+  return true;
+}
+
+// ---- Fuente de muestras: ficheros EDF uno tras otro (y en bucle con --loop) ----
+struct EdfTrack {
+  EdfFile* file;
+  std::vector<size_t> idx;     // señal del EDF por canal
+  std::vector<double> gain;    // cuentas por valor digital
+  std::vector<double> offset;  // cuentas con valor digital 0
+};
+
+class Source {
+public:
+  Source(std::vector<EdfTrack>& tracks, bool loop) : tracks_(tracks), loop_(loop) {}
+
+  uint8_t channels() const { return (uint8_t)tracks_[0].idx.size(); }
+  uint32_t samplesPerRecord() const {
+    return tracks_[0].file->signals()[tracks_[0].idx[0]].spr;
+  }
+
+  // Siguiente muestra en cuentas del ADS1299 (saturadas a 24 bits)
+  bool next(int32_t* ch) {
+    if (pos_ >= buf_.size()) {
+      if (!load_()) return false;
+    }
+    memcpy(ch, &buf_[pos_], tracks_[0].idx.size() * sizeof(int32_t));
+    pos_ += tracks_[0].idx.size();
+    return true;
+  }
+
+private:
+  // Convierte el registro siguiente (spr × nch) en buf_
+  bool load_() {
+    for (;;) {
+      EdfTrack& t = tracks_[track_];
+      if (rec_ < t.file->records()) break;
+      t.file->release(rec_);
+      rec_ = 0;
+      if (++track_ == tracks_.size()) {
+        if (!loop_) return false;
+        track_ = 0;
+      }
+    }
+    EdfTrack& t = tracks_[track_];
+    const std::vector<EdfSignal>& sig = t.file->signals();
+    const uint8_t* r = t.file->record(rec_++);
+    size_t nch = t.idx.size();
+    uint32_t spr = sig[t.idx[0]].spr;
+    buf_.resize((size_t)spr * nch);
+    for (size_t c = 0; c < nch; ++c) {
+      const uint8_t* p = r + 2 * (size_t)sig[t.idx[c]].offset;
+      for (uint32_t i = 0; i < spr; ++i) {
+        int16_t d = (int16_t)(p[2 * i] | (p[2 * i + 1] << 8));
+        double v = d * t.gain[c] + t.offset[c];
+        buf_[(size_t)i * nch + c] = v >= MAX24 ? MAX24 : v <= MIN24 ? MIN24 : (int32_t)lround(v);
+      }
+    }
+    if ((rec_ & 63) == 0) t.file->release(rec_);
+    pos_ = 0;
+    return true;
+  }
+
+  std::vector<EdfTrack>& tracks_;
+  bool loop_;
+  size_t track_ = 0;
+  size_t rec_ = 0;
+  std::vector<int32_t> buf_;
+  size_t pos_ = 0;
+};
+
+// =========================
+//  Salida
+// =========================
+
+// Descriptor (pty, socket o fichero) como EEGStream_Sink. La pérdida de
+// bytes se aplica aquí, después de la cola: el paquete entra entero en la
+// cola y se corrompe en el "cable", como un byte perdido en el UART.
+class FdSink : public EEGStream_Sink {
+public:
+  FdSink(int fd, double lossP, uint16_t lossBurst, Rng& rng)
+      : fd_(fd), lossP_(lossP), lossBurst_(lossBurst ? lossBurst : 1), rng_(rng) {}
+
+  uint16_t writable() override {
+    flush_();
+    return n_ || closed_ ? 0 : SINK_CHUNK;
+  }
+
+  uint16_t write(const uint8_t* data, uint16_t n) override {
+    for (uint16_t i = 0; i < n; ++i) {
+      if (!lossLeft_ && lossP_ > 0 && rng_.uniform() < lossP_) lossLeft_ = lossBurst_;
+      if (lossLeft_) {
+        --lossLeft_;
+        ++lost_;
+        continue;
+      }
+      buf_[n_++] = data[i];
+    }
+    flush_();
+    return n;
+  }
+
+  // Espera (hasta timeoutMs) a que el descriptor admita más bytes
+  void waitWritable(int timeoutMs) {
+    if (!n_ || closed_) return;
+    struct pollfd p = {fd_, POLLOUT, 0};
+    poll(&p, 1, timeoutMs);
+    flush_();
+  }
+
+  bool idle() const { return n_ == 0; }
+  bool closed() const { return closed_; }
+  uint64_t bytesOut() const { return out_; }
+  uint64_t bytesLost() const { return lost_; }
+
+private:
+  void flush_() {
+    while (n_ && !closed_) {
+      ssize_t w = ::write(fd_, buf_ + off_, n_);
+      if (w > 0) {
+        off_ += (uint16_t)w;
+        n_ -= (uint16_t)w;
+        out_ += (uint64_t)w;
+        continue;
+      }
+      if (w < 0 && errno == EINTR) continue;
+      if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+      closed_ = true; // EPIPE, EIO (pty sin lector)...
+    }
+    off_ = 0;
+  }
+
+  int fd_;
+  double lossP_;
+  uint16_t lossBurst_;
+  Rng& rng_;
+  uint8_t buf_[SINK_CHUNK];
+  uint16_t n_ = 0;
+  uint16_t off_ = 0;
+  uint16_t lossLeft_ = 0;
+  bool closed_ = false;
+  uint64_t out_ = 0;
+  uint64_t lost_ = 0;
+};
+
+// ---- Aperturas ----
+int openPty(const char* link, int& slave) {
+  int m = posix_openpt(O_RDWR | O_NOCTTY);
+  if (m < 0 || grantpt(m) != 0 || unlockpt(m) != 0) return -1;
+  const char* name = ptsname(m);
+  // El extremo esclavo queda abierto: sin lector el pty no da EIO, y en
+  // crudo (sin eco ni modo de línea) los bytes pasan tal cual
+  slave = ::open(name, O_RDWR | O_NOCTTY);
+  if (slave < 0) return -1;
+  struct termios t;
+  tcgetattr(slave, &t);
+  cfmakeraw(&t);
+  tcsetattr(slave, TCSANOW, &t);
+  if (link) {
+    unlink(link);
+    if (symlink(name, link) != 0) {
+      fprintf(stderr, "eeg_replay: no se pudo crear %s: %s\n", link, strerror(errno));
+      return -1;
+    }
+  }
+  fprintf(stderr, "eeg_replay: pty %s%s%s\n", name, link ? " -> " : "", link ? link : "");
+  return m;
+}
+
+int acceptTcp(uint16_t port) {
+  int s = socket(AF_INET6, SOCK_STREAM, 0);
+  bool v6 = s >= 0;
+  if (!v6) s = socket(AF_INET, SOCK_STREAM, 0);
+  if (s < 0) return -1;
+  int one = 1, zero = 0;
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  int rc;
+  if (v6) {
+    setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+    struct sockaddr_in6 a = {};
+    a.sin6_family = AF_INET6;
+    a.sin6_addr = in6addr_any;
+    a.sin6_port = htons(port);
+    rc = bind(s, (struct sockaddr*)&a, sizeof(a));
+  } else {
+    struct sockaddr_in a = {};
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_ANY);
+    a.sin_port = htons(port);
+    rc = bind(s, (struct sockaddr*)&a, sizeof(a));
+  }
+  if (rc != 0 || listen(s, 1) != 0) {
+    ::close(s);
+    return -1;
+  }
+  fprintf(stderr, "eeg_replay: esperando conexión en el puerto %u\n", (unsigned)port);
+  int c;
+  do {
+    c = accept(s, nullptr, nullptr);
+  } while (c < 0 && errno == EINTR && !g_stop);
+  ::close(s);
+  if (c >= 0) setsockopt(c, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return c;
+}
+
+// =========================
+//  Emisor (política de src/main.cpp)
+// =========================
+enum Format { FMT_SAMPLE, FMT_BATCH, FMT_RICE };
+
+struct Options {
+  std::vector<const char*> files;
+  std::string channels;
+  Format format = FMT_RICE;
+  uint8_t devices = 0;          // 0: uno por cada 8 canales
+  uint8_t batch = 16;
+  uint8_t order = 1;
+  uint8_t keyInterval = 8;
+  double rate = 1.0;
+  bool loop = false;
+  bool pty = false;
+  const char* link = nullptr;
+  long tcp = -1;
+  const char* out = nullptr;
+  double loss = 0;
+  uint16_t lossBurst = 1;
+  double jitterMs = 0;
+  uint64_t seed = 1;
+  uint8_t timing = 16;
+  uint32_t statsMs = 1000;
+  long queue = 0;               // 0: tamaño del firmware
+  double lsb = DEFAULT_LSB;
+  bool quiet = false;
+};
+
+class Emitter {
+public:
+  Emitter(const Options& o, uint8_t nch, FdSink& sink)
+      : o_(o), nch_(nch), sink_(sink),
+        // SAMPLE, o DIAG/STATS/TIMING si es mayor
+        pktBuf_(EEG_OVERHEAD + (4 + 4u * nch > DIAG_MAX_TEXT ? 4 + 4u * nch : DIAG_MAX_TEXT)),
+        batchBuf_(EEGStream_Batcher::bufferSize(o.batch, nch, o.devices)),
+        riceBuf_(riceSize(nch, o.devices)),
+        riceState_((size_t)nch + o.devices),
+        pkt_(pktBuf_.data(), (uint16_t)pktBuf_.size()),
+        batcher_(batchBuf_.data(), (uint16_t)batchBuf_.size(), nch, o.devices, o.batch, BATCH_FLUSH_US),
+        rice_(riceBuf_.data(), (uint16_t)riceBuf_.size(), riceState_.data(), nch, o.devices, o.batch,
+              BATCH_FLUSH_US, o.order, o.keyInterval),
+        queueBuf_(queueSize(o, nch)),
+        queue_(queueBuf_.data(), (uint16_t)queueBuf_.size()),
+        status_(o.devices, STATUS_WORD) {}
+
+  // Mismo tamaño que RICE_BUF_SIZE del firmware: el cierre por falta de sitio
+  // (RiceEncoder::full) depende de él
+  static uint16_t riceSize(uint8_t nch, uint8_t nstatus) {
+    uint16_t mn = (uint16_t)(EEG_OVERHEAD + EEG_RICE_HEADER +
+                             (EEGStream_RiceEncoder::worstSampleBits(nch, nstatus) + 7) / 8);
+    return 2 * mn > 160 ? (uint16_t)(2 * mn) : 160;
+  }
+
+  // TX_QUEUE_BYTES del firmware (o --queue)
+  static uint16_t queueSize(const Options& o, uint8_t nch) {
+    if (o.queue > 0) return (uint16_t)o.queue;
+    uint16_t mx = o.format == FMT_SAMPLE ? (uint16_t)(EEG_OVERHEAD + 4 + 4u * nch)
+                : o.format == FMT_BATCH  ? EEGStream_Batcher::bufferSize(o.batch, nch, o.devices)
+                                         : riceSize(nch, o.devices);
+    if (mx < EEG_OVERHEAD + EEG_STATS_PAYLOAD) mx = EEG_OVERHEAD + EEG_STATS_PAYLOAD;
+    return (uint16_t)(mx + mx / 4) > TX_QUEUE_SIZE ? (uint16_t)(mx + mx / 4) : TX_QUEUE_SIZE;
+  }
+
+  // Mensaje inicial (DIAG), como los de setup()
+  void diag(const char* msg) {
+    pkt_.begin(EEG_PKT_DIAG);
+    pkt_.putBytes((const uint8_t*)msg, (uint16_t)strlen(msg));
+    uint16_t len = pkt_.finish(seq_++);
+    if (len) send_(pkt_.data(), len);
+  }
+
+  // Una muestra del ADS1299: drdyUs = su instante en la grabación; nowUs =
+  // reloj del dispositivo al procesarla (más tarde si el emulador va con retraso)
+  void sample(uint32_t idx, uint32_t drdyUs, uint32_t nowUs, const int32_t* ch) {
+    tick(idx, nowUs);
+    if (o_.format == FMT_SAMPLE) {
+      pkt_.begin(EEG_PKT_SAMPLE);
+      pkt_.putU32(idx);
+      for (uint8_t c = 0; c < nch_; ++c) pkt_.putI32(ch[c]);
+      uint16_t len = pkt_.finish(seq_++);
+      if (!len) return;
+      send_(pkt_.data(), len);
+      noteDataSent_(idx, drdyUs, nowUs);
+      return;
+    }
+    if (o_.format == FMT_RICE) {
+      if (!rice_.accepts(idx)) flushBatch(nowUs);
+      if (rice_.empty()) batchDrdyUs_ = drdyUs;
+      rice_.add(idx, status_.data(), ch, nowUs);
+      if (rice_.full()) flushBatch(nowUs);
+      return;
+    }
+    if (!batcher_.accepts(idx)) flushBatch(nowUs);
+    if (batcher_.empty()) batchDrdyUs_ = drdyUs;
+    batcher_.add(idx, status_.data(), ch, nowUs);
+    if (batcher_.full()) flushBatch(nowUs);
+  }
+
+  // Lo que loop() hace en cada vuelta: lote vencido y STATS periódico.
+  // samples = muestras adquiridas hasta ahora (sample_idx de STATS)
+  void tick(uint32_t samples, uint32_t nowUs) {
+    if (o_.format == FMT_RICE ? rice_.due(nowUs) : o_.format == FMT_BATCH && batcher_.due(nowUs))
+      flushBatch(nowUs);
+    if (o_.statsMs && nowUs / 1000 - lastStatsMs_ >= o_.statsMs) {
+      lastStatsMs_ = nowUs / 1000;
+      sendStats_(samples);
+    }
+  }
+
+  void flushBatch(uint32_t nowUs) {
+    if (o_.format == FMT_RICE) {
+      if (rice_.empty()) return;
+      uint32_t idx = rice_.baseIdx();
+      uint16_t len = rice_.finish(seq_++);
+      if (len) {
+        send_(rice_.data(), len);
+        noteDataSent_(idx, batchDrdyUs_, nowUs);
+      }
+      rice_.reset();
+      return;
+    }
+    if (o_.format != FMT_BATCH || batcher_.empty()) return;
+    uint32_t idx = batcher_.baseIdx();
+    uint16_t len = batcher_.finish(seq_++);
+    if (len) {
+      send_(batcher_.data(), len);
+      noteDataSent_(idx, batchDrdyUs_, nowUs);
+    }
+    batcher_.reset();
+  }
+
+  void pump() { queue_.pump(sink_); }
+
+  // Vacía la cola esperando al lector (fin de la reproducción y --rate 0)
+  void drain() {
+    while ((!queue_.empty() || !sink_.idle()) && !sink_.closed() && !g_stop) {
+      pump();
+      sink_.waitWritable(100);
+    }
+  }
+
+  // Peor retraso del emulador desde el último STATS (va en loop_max_us)
+  void noteLag(uint64_t lagUs) {
+    if (lagUs > lagMaxUs_) lagMaxUs_ = lagUs;
+  }
+
+  uint16_t queueFill() const { return queue_.fill(); }
+  uint16_t queueCapacity() const { return queue_.capacity(); }
+  uint32_t dropped() const { return queue_.dropped(); }
+
+private:
+  // Con ritmo, la cola descarta los paquetes más antiguos como el firmware;
+  // a máxima velocidad (--rate 0) se espera al lector y no se pierde nada.
+  void send_(const uint8_t* data, uint16_t len) {
+    if (o_.rate > 0) {
+      queue_.push(data, len, true);
+      return;
+    }
+    while (queue_.room() < len && !sink_.closed() && !g_stop) {
+      pump();
+      if (queue_.room() < len) sink_.waitWritable(100);
+    }
+    queue_.push(data, len, false);
+  }
+
+  void noteDataSent_(uint32_t idx, uint32_t drdyUs, uint32_t nowUs) {
+    if (!o_.timing || ++timingPkts_ < o_.timing) return;
+    timingPkts_ = 0;
+    pkt_.begin(EEG_PKT_TIMING);
+    pkt_.putU32(idx);
+    pkt_.putU32(drdyUs);
+    pkt_.putU32(nowUs);
+    uint16_t len = pkt_.finish(seq_++);
+    if (len) send_(pkt_.data(), len);
+  }
+
+  // Sin adquisición real: sync/DRDY/ring a 0; tx_dropped = descartes de la cola
+  void sendStats_(uint32_t samples) {
+    pkt_.begin(EEG_PKT_STATS);
+    pkt_.putU32(samples);
+    pkt_.putU32(0);
+    pkt_.putU32(0);
+    pkt_.putU32(0);
+    pkt_.putU32(queue_.dropped());
+    pkt_.putU16(lagMaxUs_ > 0xFFFF ? 0xFFFF : (uint16_t)lagMaxUs_);
+    pkt_.putU8(0);
+    pkt_.putU8(ACQ_RING_SIZE);
+    lagMaxUs_ = 0;
+    uint16_t len = pkt_.finish(seq_++);
+    if (len) send_(pkt_.data(), len);
+  }
+
+  const Options& o_;
+  uint8_t nch_;
+  FdSink& sink_;
+  std::vector<uint8_t> pktBuf_;
+  std::vector<uint8_t> batchBuf_;
+  std::vector<uint8_t> riceBuf_;
+  std::vector<EEGStream_RiceState> riceState_;
+  EEGStream_PacketBuilder pkt_;
+  EEGStream_Batcher batcher_;
+  EEGStream_RiceEncoder rice_;
+  std::vector<uint8_t> queueBuf_;
+  EEGStream_TxQueue queue_;
+  std::vector<uint32_t> status_;
+  uint8_t seq_ = 0;
+  uint8_t timingPkts_ = 0;
+  uint32_t batchDrdyUs_ = 0;
+  uint32_t lastStatsMs_ = 0;
+  uint64_t lagMaxUs_ = 0;
+};
+
+// =========================
+//  Línea de órdenes
+// =========================
+void usage() {
+  fprintf(stderr,
+          "uso: eeg_replay FICHERO.edf [...] (--pty [--link RUTA] | --tcp PUERTO | --out FICHERO|-)\n"
+          "  --channels L     canales: índices o etiquetas separados por comas, o 'all'\n"
+          "                   (por defecto los 8 primeros de señal)\n"
+          "  --devices D      palabras STATUS por muestra (ADS1299 en cadena; def. 1 cada 8 canales)\n"
+          "  --format F       sample | batch | rice (def. rice)\n"
+          "  --batch N        muestras por lote (def. 16)\n"
+          "  --order K        orden del predictor RICE, 0..2 (def. 1)\n"
+          "  --key N          keyframe RICE cada N lotes (def. 8)\n"
+          "  --rate X         1 = tiempo real, N = N veces, 0 = máxima velocidad sin pérdidas\n"
+          "  --loop           vuelve a empezar al acabar\n"
+          "  --loss P         probabilidad de perder cada byte (0..1)\n"
+          "  --loss-burst N   bytes perdidos seguidos en cada pérdida (def. 1)\n"
+          "  --jitter MS      retraso aleatorio 0..MS de cada muestra (con --rate > 0)\n"
+          "  --seed S         semilla de pérdidas y jitter (def. 1)\n"
+          "  --timing N       EEG_PKT_TIMING cada N paquetes de datos (def. 16, 0 = no)\n"
+          "  --stats MS       EEG_PKT_STATS cada MS de dispositivo (def. 1000, 0 = no)\n"
+          "  --queue BYTES    cola de salida (def. la del firmware)\n"
+          "  --lsb V          voltios por cuenta (def. 2.235e-8, ganancia 24)\n"
+          "  --quiet          sin progreso en stderr\n");
+}
+
+bool parseArgs(int argc, char** argv, Options& o) {
+  for (int i = 1; i < argc; ++i) {
+    const char* a = argv[i];
+    auto val = [&](const char*& v) {
+      if (i + 1 >= argc) return false;
+      v = argv[++i];
+      return true;
+    };
+    const char* v = nullptr;
+    if (a[0] != '-') {
+      o.files.push_back(a);
+    } else if (!strcmp(a, "--pty")) {
+      o.pty = true;
+    } else if (!strcmp(a, "--loop")) {
+      o.loop = true;
+    } else if (!strcmp(a, "--quiet")) {
+      o.quiet = true;
+    } else if (!strcmp(a, "-h") || !strcmp(a, "--help")) {
+      return false;
+    } else if (!val(v)) {
+      fprintf(stderr, "eeg_replay: falta el valor de %s\n", a);
+      return false;
+    } else if (!strcmp(a, "--link")) {
+      o.link = v;
+    } else if (!strcmp(a, "--tcp")) {
+      o.tcp = atol(v);
+    } else if (!strcmp(a, "--out")) {
+      o.out = v;
+    } else if (!strcmp(a, "--channels")) {
+      o.channels = v;
+    } else if (!strcmp(a, "--devices")) {
+      o.devices = (uint8_t)atoi(v);
+    } else if (!strcmp(a, "--format")) {
+      if (!strcmp(v, "sample")) o.format = FMT_SAMPLE;
+      else if (!strcmp(v, "batch")) o.format = FMT_BATCH;
+      else if (!strcmp(v, "rice")) o.format = FMT_RICE;
+      else return false;
+    } else if (!strcmp(a, "--batch")) {
+      o.batch = (uint8_t)atoi(v);
+    } else if (!strcmp(a, "--order")) {
+      o.order = (uint8_t)atoi(v);
+    } else if (!strcmp(a, "--key")) {
+      o.keyInterval = (uint8_t)atoi(v);
+    } else if (!strcmp(a, "--rate")) {
+      o.rate = atof(v);
+    } else if (!strcmp(a, "--loss")) {
+      o.loss = atof(v);
+    } else if (!strcmp(a, "--loss-burst")) {
+      o.lossBurst = (uint16_t)atoi(v);
+    } else if (!strcmp(a, "--jitter")) {
+      o.jitterMs = atof(v);
+    } else if (!strcmp(a, "--seed")) {
+      o.seed = strtoull(v, nullptr, 0);
+    } else if (!strcmp(a, "--timing")) {
+      o.timing = (uint8_t)atoi(v);
+    } else if (!strcmp(a, "--stats")) {
+      o.statsMs = (uint32_t)atol(v);
+    } else if (!strcmp(a, "--queue")) {
+      o.queue = atol(v);
+    } else if (!strcmp(a, "--lsb")) {
+      o.lsb = atof(v);
+    } else {
+      fprintf(stderr, "eeg_replay: opción desconocida %s\n", a);
+      return false;
+    }
+  }
+  int outs = (o.pty ? 1 : 0) + (o.tcp >= 0 ? 1 : 0) + (o.out ? 1 : 0);
+  if (o.files.empty() || outs != 1) return false;
+  if (o.tcp > 65535 || o.queue > 65535 || o.rate < 0 || o.lsb <= 0 || o.loss < 0 || o.loss > 1 ||
+      o.order > 2 || o.keyInterval < 1 || o.batch < 1 || o.jitterMs < 0) {
+    fprintf(stderr, "eeg_replay: valor fuera de rango\n");
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options o;
+  if (!parseArgs(argc, argv, o)) {
+    usage();
+    return 2;
+  }
+
+  // ---- Ficheros y canales ----
+  std::vector<EdfFile> files(o.files.size());
+  std::vector<EdfTrack> tracks;
+  double fs = 0;
+  std::string err;
+  for (size_t i = 0; i < files.size(); ++i) {
+    EdfTrack t;
+    t.file = &files[i];
+    if (!files[i].open(o.files[i], err) ||
+        !selectChannels(files[i], o.channels, CH_PER_DEVICE, t.idx, err)) {
+      fprintf(stderr, "eeg_replay: %s\n", err.c_str());
+      return 1;
+    }
+    const std::vector<EdfSignal>& sig = files[i].signals();
+    double f = sig[t.idx[0]].spr / files[i].duration();
+    if (i && (t.idx.size() != tracks[0].idx.size() || fabs(f - fs) > 1e-9)) {
+      fprintf(stderr, "eeg_replay: %s no tiene los mismos canales o frecuencia que %s\n", o.files[i],
+              o.files[0]);
+      return 1;
+    }
+    fs = f;
+    for (size_t c : t.idx) {
+      const EdfSignal& g = sig[c];
+      double k = (g.physMax - g.physMin) / (g.digMax - g.digMin) * unitScale(g.unit) / o.lsb;
+      t.gain.push_back(k);
+      t.offset.push_back((g.physMin - g.digMin * (g.physMax - g.physMin) / (g.digMax - g.digMin)) *
+                         unitScale(g.unit) / o.lsb);
+    }
+    tracks.push_back(t);
+  }
+  size_t nch = tracks[0].idx.size();
+  if (!o.devices) o.devices = (uint8_t)((nch + CH_PER_DEVICE - 1) / CH_PER_DEVICE);
+  if (nch > 255 || 4 + 4 * nch > EEG_MAX_PAYLOAD ||
+      (o.format == FMT_BATCH && EEG_BATCH_HEADER + (size_t)o.batch * 3 * (nch + o.devices) > EEG_MAX_PAYLOAD) ||
+      (o.format == FMT_RICE && Emitter::riceSize((uint8_t)nch, o.devices) - EEG_OVERHEAD > EEG_MAX_PAYLOAD)) {
+    fprintf(stderr, "eeg_replay: demasiados canales o muestras por lote para un paquete\n");
+    return 1;
+  }
+
+  // ---- Salida ----
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  int fd = -1, slave = -1;
+  if (o.pty) fd = openPty(o.link, slave);
+  else if (o.tcp >= 0) fd = acceptTcp((uint16_t)o.tcp);
+  else if (!strcmp(o.out, "-")) fd = STDOUT_FILENO;
+  else fd = ::open(o.out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    if (!g_stop) fprintf(stderr, "eeg_replay: no se pudo abrir la salida: %s\n", strerror(errno));
+    return 1;
+  }
+  // Con ritmo la escritura no bloquea: si el lector no da abasto se llena la cola
+  if (o.rate > 0) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  Rng rng(o.seed);
+  FdSink sink(fd, o.loss, o.lossBurst, rng);
+  Emitter em(o, (uint8_t)nch, sink);
+  Source src(tracks, o.loop);
+
+  char msg[DIAG_MAX_TEXT];
+  snprintf(msg, sizeof(msg), "eeg_replay: %s %uch %g SPS", o.files[0], (unsigned)nch, fs);
+  em.diag(msg);
+  if (!o.quiet) {
+    char rate[24];
+    if (o.rate > 0) snprintf(rate, sizeof(rate), "%gx", o.rate);
+    else snprintf(rate, sizeof(rate), "máximo");
+    fprintf(stderr, "eeg_replay: %u canales, %g SPS, %s, ritmo %s, cola %u B\n", (unsigned)nch, fs,
+            o.format == FMT_SAMPLE ? "SAMPLE" : o.format == FMT_BATCH ? "BATCH" : "RICE", rate,
+            (unsigned)em.queueCapacity());
+  }
+
+  // ---- Reproducción ----
+  // Reloj del dispositivo (micros() del firmware): con ritmo, el tiempo real
+  // escalado por --rate; a máxima velocidad, el de la grabación.
+  std::vector<int32_t> ch(nch);
+  const double periodNs = 1e9 / (fs * (o.rate > 0 ? o.rate : 1));
+  const double jitterNs = o.jitterMs * 1e6;
+  const uint64_t t0 = nowNs();
+  uint64_t release = t0, lastReport = t0, lastBytes = 0;
+  uint32_t k = 0, lastK = 0;
+  auto devUs = [&](uint64_t t) { return (uint32_t)((double)(t - t0) * o.rate / 1000.0); };
+
+  while (!g_stop && !sink.closed() && src.next(ch.data())) {
+    uint32_t drdyUs = (uint32_t)llround(k * 1e6 / fs);
+    uint32_t nowUs = drdyUs;
+    if (o.rate > 0) {
+      uint64_t due = t0 + (uint64_t)(k * periodNs) + (uint64_t)(rng.uniform() * jitterNs);
+      if (due > release) release = due; // el jitter no reordena muestras
+      uint64_t t;
+      // Mientras llega el instante de la muestra: vaciar la cola y cerrar lotes vencidos
+      while ((t = nowNs()) < release && !g_stop) {
+        em.pump();
+        em.tick(k, devUs(t));
+        uint64_t left = release - t;
+        if (!sink.idle() && left > 1000000) sink.waitWritable((int)(left / 1000000));
+        else sleepUntilNs(release);
+      }
+      em.noteLag((t - release) / 1000);
+      nowUs = devUs(t);
+    }
+    em.sample(k, drdyUs, nowUs, ch.data());
+    em.pump();
+    ++k;
+
+    uint64_t t = nowNs();
+    if (!o.quiet && t - lastReport >= 1000000000ull) {
+      double dt = (t - lastReport) / 1e9;
+      double lagMs = o.rate > 0 && t > release ? (t - release) / 1e6 : 0;
+      fprintf(stderr, "eeg_replay: %.1f s  %.0f SPS  %.1f kB/s  cola %u/%u B  descartes %u  perdidos %llu B  retraso %.1f ms\n",
+              k / fs, (k - lastK) / dt, (sink.bytesOut() - lastBytes) / dt / 1000.0,
+              (unsigned)em.queueFill(), (unsigned)em.queueCapacity(), (unsigned)em.dropped(),
+              (unsigned long long)sink.bytesLost(), lagMs);
+      lastReport = t;
+      lastK = k;
+      lastBytes = sink.bytesOut();
+    }
+  }
+
+  // Último lote y lo que quede en cola
+  em.flushBatch(o.rate > 0 ? devUs(nowNs()) : (uint32_t)llround(k * 1e6 / fs));
+  bool stopped = g_stop;
+  g_stop = 0;
+  em.drain();
+  // pty: que el lector recoja lo que queda antes de cerrar (al cerrar se descarta)
+  if (slave >= 0) {
+    int pending = 0;
+    for (int i = 0; i < 200 && ioctl(slave, FIONREAD, &pending) == 0 && pending > 0 && !g_stop; ++i)
+      usleep(10000);
+  }
+  if (!o.quiet) {
+    fprintf(stderr, "eeg_replay: %u muestras, %llu bytes, %u paquetes descartados, %llu bytes perdidos%s\n", k,
+            (unsigned long long)sink.bytesOut(), (unsigned)em.dropped(), (unsigned long long)sink.bytesLost(),
+            stopped ? " (interrumpido)" : sink.closed() ? " (el lector cerró)" : "");
+  }
+  if (o.link) unlink(o.link);
+  if (fd != STDOUT_FILENO) ::close(fd);
+  if (slave >= 0) ::close(slave);
+  return 0;
+}
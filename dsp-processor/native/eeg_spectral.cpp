@@ -0,0 +1,909 @@
+// eeg_spectral.cpp
+// Motor espectral nativo para DSPCore (src/dsp_core.py): PSD multitaper,
+// periodograma, Welch y espectrograma de todos los canales en una llamada,
+// más la integración por bandas.
+//
+// Plan(n, tapers, scale, onesided, detrend) guarda lo que DSPCore recalculaba
+// en cada ventana: la FFT de n puntos (mixed-radix 2/3/4/5/genérico, Bluestein
+// si n tiene un factor primo grande), la tabla de tapers (DPSS o una ventana)
+// y la escala de densidad. psd() hace, por canal y segmento:
+//     P[k] = scale · media_taper,segmento |FFT((x - media?) · w)[k]|²
+// (×2 en los bins interiores si onesided, igual que scipy.signal).
+//
+// Dos secuencias reales comparten una FFT compleja: z = a + i·b, y como
+//     |A_k|² + |B_k|² = (|Z_k|² + |Z_(n-k)|²) / 2
+// la suma de potencias de dos tapers (o dos segmentos de Welch) sale de |Z|²
+// sin desentrelazar. |Z|², ese plegado y la suma por bandas tienen núcleos
+// AVX2 (elegidos en tiempo de ejecución) y NEON, con versión escalar.
+//
+// Stream(plan, n_ch, n_seg, hop) es la versión incremental para streaming:
+// Welch sobre la ventana reciente actualizado cada hop muestras con una sola
+// FFT por canal (se reutilizan los segmentos solapados ya transformados).
+//
+// Entrada y salida por el protocolo de buffer (float64 contiguo): el
+// llamador reserva la salida (np.empty) y no hace falta NumPy al compilar.
+// El cálculo se hace sin el GIL.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SPECTRAL_X86_DISPATCH 1
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(__AVX2__)
+#define SPECTRAL_AVX2_STATIC 1
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define SPECTRAL_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+typedef std::complex<double> cd;
+
+constexpr int BLUESTEIN_FACTOR = 31;  // factor primo a partir del cual conviene Bluestein
+
+// Producto complejo sin el tratamiento de NaN/inf de operator* (__muldc3)
+inline cd mul(const cd& a, const cd& b)
+{
+  return cd(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+// =========================
+//  FFT compleja (mixed-radix, estilo kissfft, decimación en el tiempo)
+// =========================
+struct Fft {
+  size_t n = 0;
+  std::vector<int> factors;  // pares (radix, resto)
+  std::vector<cd> tw;        // exp(-2πi·k/n)
+
+  // Bluestein: convolución con un chirp mediante una FFT de m = 2^k puntos
+  bool bluestein = false;
+  size_t m = 0;
+  std::vector<cd> chirp;  // exp(-πi·j²/n)
+  std::vector<cd> kernelF;  // FFT de conj(chirp) extendido
+  Fft* sub = nullptr;
+
+  Fft() {}
+  Fft(const Fft&) = delete;
+  Fft& operator=(const Fft&) = delete;
+  ~Fft() { delete sub; }
+
+  bool init(size_t len);
+  // Transformada directa in situ; work: n elementos (o 2·m con Bluestein)
+  void exec(cd* data, cd* work) const;
+  size_t workSize() const { return bluestein ? 2 * m : n; }
+
+private:
+  void work_(cd* out, const cd* f, size_t fstride, const int* fac) const;
+  void bf2_(cd* F, size_t fstride, size_t m) const;
+  void bf3_(cd* F, size_t fstride, size_t m) const;
+  void bf4_(cd* F, size_t fstride, size_t m) const;
+  void bf5_(cd* F, size_t fstride, size_t m) const;
+  void bfGeneric_(cd* F, size_t fstride, size_t m, int p) const;
+};
+
+bool Fft::init(size_t len)
+{
+  n = len;
+  factors.clear();
+  size_t r = len;
+  int p = 4;
+  int maxFactor = 1;
+  while (r > 1) {
+    while (r % p) {
+      p = (p == 4) ? 2 : (p == 2) ? 3 : p + 2;
+      if ((size_t)p * p > r) p = (int)r;
+    }
+    r /= p;
+    factors.push_back(p);
+    factors.push_back((int)r);
+    if (p > maxFactor) maxFactor = p;
+  }
+  bluestein = maxFactor > BLUESTEIN_FACTOR;
+  if (!bluestein) {
+    tw.resize(n);
+    for (size_t k = 0; k < n; ++k)
+      tw[k] = std::polar(1.0, -2.0 * Py_MATH_PI * (double)k / (double)n);
+    return true;
+  }
+
+  m = 1;
+  while (m < 2 * n - 1) m <<= 1;
+  sub = new Fft();
+  if (!sub->init(m)) return false;
+  chirp.resize(n);
+  for (size_t j = 0; j < n; ++j) {
+    // j² mod 2n para no perder precisión en el ángulo
+    unsigned long long q = ((unsigned long long)j * j) % (2ull * n);
+    chirp[j] = std::polar(1.0, -Py_MATH_PI * (double)q / (double)n);
+  }
+  kernelF.assign(m, cd(0, 0));
+  kernelF[0] = std::conj(chirp[0]);
+  for (size_t j = 1; j < n; ++j)
+    kernelF[j] = kernelF[m - j] = std::conj(chirp[j]);
+  std::vector<cd> w(m);
+  sub->exec(kernelF.data(), w.data());
+  return true;
+}
+
+void Fft::bf2_(cd* F, size_t fstride, size_t mm) const
+{
+  cd* F2 = F + mm;
+  for (size_t k = 0; k < mm; ++k) {
+    cd t = mul(F2[k], tw[k * fstride]);
+    F2[k] = F[k] - t;
+    F[k] += t;
+  }
+}
+
+void Fft::bf3_(cd* F, size_t fstride, size_t mm) const
+{
+  const double epi3 = tw[fstride * mm].imag();  // -sin(2π/3)
+  for (size_t k = 0; k < mm; ++k) {
+    cd s1 = mul(F[k + mm], tw[k * fstride]);
+    cd s2 = mul(F[k + 2 * mm], tw[2 * k * fstride]);
+    cd s3 = s1 + s2;
+    cd s0 = (s1 - s2) * epi3;
+    cd a = F[k] - s3 * 0.5;
+    F[k] += s3;
+    F[k + 2 * mm] = cd(a.real() + s0.imag(), a.imag() - s0.real());
+    F[k + mm] = cd(a.real() - s0.imag(), a.imag() + s0.real());
+  }
+}
+
+void Fft::bf4_(cd* F, size_t fstride, size_t mm) const
+{
+  for (size_t k = 0; k < mm; ++k) {
+    cd s0 = mul(F[k + mm], tw[k * fstride]);
+    cd s1 = mul(F[k + 2 * mm], tw[2 * k * fstride]);
+    cd s2 = mul(F[k + 3 * mm], tw[3 * k * fstride]);
+    cd s5 = F[k] - s1;
+    cd f0 = F[k] + s1;
+    cd s3 = s0 + s2;
+    cd s4 = s0 - s2;
+    F[k + 2 * mm] = f0 - s3;
+    F[k] = f0 + s3;
+    F[k + mm] = cd(s5.real() + s4.imag(), s5.imag() - s4.real());
+    F[k + 3 * mm] = cd(s5.real() - s4.imag(), s5.imag() + s4.real());
+  }
+}
+
+void Fft::bf5_(cd* F, size_t fstride, size_t mm) const
+{
+  const cd ya = tw[fstride * mm];
+  const cd yb = tw[2 * fstride * mm];
+  for (size_t k = 0; k < mm; ++k) {
+    cd s0 = F[k];
+    cd s1 = mul(F[k + mm], tw[k * fstride]);
+    cd s2 = mul(F[k + 2 * mm], tw[2 * k * fstride]);
+    cd s3 = mul(F[k + 3 * mm], tw[3 * k * fstride]);
+    cd s4 = mul(F[k + 4 * mm], tw[4 * k * fstride]);
+    cd s7 = s1 + s4, s10 = s1 - s4, s8 = s2 + s3, s9 = s2 - s3;
+    F[k] = s0 + s7 + s8;
+    cd s5(s0.real() + s7.real() * ya.real() + s8.real() * yb.real(),
+          s0.imag() + s7.imag() * ya.real() + s8.imag() * yb.real());
+    cd s6(s10.imag() * ya.imag() + s9.imag() * yb.imag(),
+          -s10.real() * ya.imag() - s9.real() * yb.imag());
+    F[k + mm] = s5 - s6;
+    F[k + 4 * mm] = s5 + s6;
+    cd s11(s0.real() + s7.real() * yb.real() + s8.real() * ya.real(),
+           s0.imag() + s7.imag() * yb.real() + s8.imag() * ya.real());
+    cd s12(-s10.imag() * yb.imag() + s9.imag() * ya.imag(),
+           s10.real() * yb.imag() - s9.real() * ya.imag());
+    F[k + 2 * mm] = s11 + s12;
+    F[k + 3 * mm] = s11 - s12;
+  }
+}
+
+void Fft::bfGeneric_(cd* F, size_t fstride, size_t mm, int p) const
+{
+  cd scratch[BLUESTEIN_FACTOR];
+  for (size_t u = 0; u < mm; ++u) {
+    for (int q = 0; q < p; ++q) scratch[q] = F[u + q * mm];
+    for (int q1 = 0; q1 < p; ++q1) {
+      size_t k = u + q1 * mm;
+      size_t step = fstride * k;  // < n
+      size_t t = 0;
+      cd acc = scratch[0];
+      for (int q = 1; q < p; ++q) {
+        t += step;
+        if (t >= n) t -= n;
+        acc += mul(scratch[q], tw[t]);
+      }
+      F[k] = acc;
+    }
+  }
+}
+
+void Fft::work_(cd* out, const cd* f, size_t fstride, const int* fac) const
+{
+  const int p = fac[0];
+  const size_t mm = (size_t)fac[1];
+  if (mm == 1) {
+    for (int q = 0; q < p; ++q) out[q] = f[q * fstride];
+  } else {
+    for (int q = 0; q < p; ++q) work_(out + q * mm, f + q * fstride, fstride * p, fac + 2);
+  }
+  switch (p) {
+    case 2: bf2_(out, fstride, mm); break;
+    case 3: bf3_(out, fstride, mm); break;
+    case 4: bf4_(out, fstride, mm); break;
+    case 5: bf5_(out, fstride, mm); break;
+    default: bfGeneric_(out, fstride, mm, p); break;
+  }
+}
+
+void Fft::exec(cd* data, cd* work) const
+{
+  if (n <= 1) return;
+  if (!bluestein) {
+    work_(work, data, 1, factors.data());
+    memcpy((void*)data, work, n * sizeof(cd));
+    return;
+  }
+  cd* a = work;
+  cd* w = work + m;
+  for (size_t j = 0; j < n; ++j) a[j] = mul(data[j], chirp[j]);
+  for (size_t j = n; j < m; ++j) a[j] = cd(0, 0);
+  sub->exec(a, w);
+  // Producto y transformada inversa por conjugación: ifft(v) = conj(fft(conj(v)))/m
+  for (size_t j = 0; j < m; ++j) a[j] = std::conj(mul(a[j], kernelF[j]));
+  sub->exec(a, w);
+  const double inv = 1.0 / (double)m;
+  for (size_t k = 0; k < n; ++k) data[k] = mul(std::conj(a[k]) * inv, chirp[k]);
+}
+
+// =========================
+//  Núcleos vectoriales
+// =========================
+// pw[j] = |z_j|² (z entrelazado re, im)
+void powerScalar(const double* z, double* pw, size_t n)
+{
+  for (size_t j = 0; j < n; ++j) pw[j] = z[2 * j] * z[2 * j] + z[2 * j + 1] * z[2 * j + 1];
+}
+
+// acc[k] += (pw[k] + pw[(n-k) mod n]) / 2, k = 0..nf-1
+void foldScalar(const double* pw, size_t n, size_t nf, double* acc)
+{
+  acc[0] += pw[0];
+  for (size_t k = 1; k < nf; ++k) acc[k] += 0.5 * (pw[k] + pw[n - k]);
+}
+
+double sumScalar(const double* p, size_t n)
+{
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  size_t j = 0;
+  for (; j + 4 <= n; j += 4) {
+    s0 += p[j];
+    s1 += p[j + 1];
+    s2 += p[j + 2];
+    s3 += p[j + 3];
+  }
+  for (; j < n; ++j) s0 += p[j];
+  return (s0 + s1) + (s2 + s3);
+}
+
+#if defined(SPECTRAL_X86_DISPATCH) || defined(SPECTRAL_AVX2_STATIC)
+#if defined(SPECTRAL_X86_DISPATCH)
+#define SPECTRAL_AVX2_FN __attribute__((target("avx2,fma")))
+#else
+#define SPECTRAL_AVX2_FN
+#endif
+
+SPECTRAL_AVX2_FN void powerAvx2(const double* z, double* pw, size_t n)
+{
+  size_t j = 0;
+  for (; j + 4 <= n; j += 4) {
+    __m256d a = _mm256_loadu_pd(z + 2 * j);      // r0 i0 r1 i1
+    __m256d b = _mm256_loadu_pd(z + 2 * j + 4);  // r2 i2 r3 i3
+    __m256d h = _mm256_hadd_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b));  // p0 p2 p1 p3
+    _mm256_storeu_pd(pw + j, _mm256_permute4x64_pd(h, 0xD8));
+  }
+  powerScalar(z + 2 * j, pw + j, n - j);
+}
+
+SPECTRAL_AVX2_FN void foldAvx2(const double* pw, size_t n, size_t nf, double* acc)
+{
+  acc[0] += pw[0];
+  const __m256d half = _mm256_set1_pd(0.5);
+  size_t k = 1;
+  // pw[n-k-3..n-k] invertido ↔ k..k+3
+  for (; k + 4 <= nf; k += 4) {
+    __m256d f = _mm256_loadu_pd(pw + k);
+    __m256d r = _mm256_permute4x64_pd(_mm256_loadu_pd(pw + n - k - 3), 0x1B);
+    __m256d a = _mm256_loadu_pd(acc + k);
+    _mm256_storeu_pd(acc + k, _mm256_fmadd_pd(_mm256_add_pd(f, r), half, a));
+  }
+  for (; k < nf; ++k) acc[k] += 0.5 * (pw[k] + pw[n - k]);
+}
+
+SPECTRAL_AVX2_FN double sumAvx2(const double* p, size_t n)
+{
+  __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+  size_t j = 0;
+  for (; j + 8 <= n; j += 8) {
+    s0 = _mm256_add_pd(s0, _mm256_loadu_pd(p + j));
+    s1 = _mm256_add_pd(s1, _mm256_loadu_pd(p + j + 4));
+  }
+  double t[4];
+  _mm256_storeu_pd(t, _mm256_add_pd(s0, s1));
+  return (t[0] + t[1]) + (t[2] + t[3]) + sumScalar(p + j, n - j);
+}
+#endif
+
+#if defined(SPECTRAL_NEON)
+void powerNeon(const double* z, double* pw, size_t n)
+{
+  size_t j = 0;
+  for (; j + 2 <= n; j += 2) {
+    float64x2x2_t v = vld2q_f64(z + 2 * j);  // (r0 r1), (i0 i1)
+    vst1q_f64(pw + j, vfmaq_f64(vmulq_f64(v.val[0], v.val[0]), v.val[1], v.val[1]));
+  }
+  powerScalar(z + 2 * j, pw + j, n - j);
+}
+
+void foldNeon(const double* pw, size_t n, size_t nf, double* acc)
+{
+  acc[0] += pw[0];
+  size_t k = 1;
+  for (; k + 2 <= nf; k += 2) {
+    float64x2_t f = vld1q_f64(pw + k);
+    float64x2_t r = vld1q_f64(pw + n - k - 1);
+    r = vextq_f64(r, r, 1);
+    vst1q_f64(acc + k, vfmaq_n_f64(vld1q_f64(acc + k), vaddq_f64(f, r), 0.5));
+  }
+  for (; k < nf; ++k) acc[k] += 0.5 * (pw[k] + pw[n - k]);
+}
+
+double sumNeon(const double* p, size_t n)
+{
+  float64x2_t s0 = vdupq_n_f64(0), s1 = vdupq_n_f64(0);
+  size_t j = 0;
+  for (; j + 4 <= n; j += 4) {
+    s0 = vaddq_f64(s0, vld1q_f64(p + j));
+    s1 = vaddq_f64(s1, vld1q_f64(p + j + 2));
+  }
+  return vaddvq_f64(vaddq_f64(s0, s1)) + sumScalar(p + j, n - j);
+}
+#endif
+
+struct Kernels {
+  void (*power)(const double*, double*, size_t);
+  void (*fold)(const double*, size_t, size_t, double*);
+  double (*sum)(const double*, size_t);
+  const char* name;
+};
+
+Kernels kern = {powerScalar, foldScalar, sumScalar, "scalar"};
+
+void selectKernels()
+{
+#if defined(SPECTRAL_X86_DISPATCH)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    kern = Kernels{powerAvx2, foldAvx2, sumAvx2, "avx2"};
+#elif defined(SPECTRAL_AVX2_STATIC)
+  kern = Kernels{powerAvx2, foldAvx2, sumAvx2, "avx2"};
+#elif defined(SPECTRAL_NEON)
+  kern = Kernels{powerNeon, foldNeon, sumNeon, "neon"};
+#endif
+}
+
+// =========================
+//  Buffers de entrada/salida (float64 C-contiguo)
+// =========================
+struct DoubleBuf {
+  Py_buffer view;
+  bool ok = false;
+  Py_ssize_t rows = 1, cols = 0;
+
+  bool get(PyObject* obj, bool writable, const char* what)
+  {
+    int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0);
+    if (PyObject_GetBuffer(obj, &view, flags) < 0) return false;
+    ok = true;
+    const char* f = view.format ? view.format : "B";
+    if (*f == '<' || *f == '=' || *f == '@') ++f;
+    if (strcmp(f, "d") != 0 || view.itemsize != 8 || view.ndim < 1 || view.ndim > 2) {
+      PyErr_Format(PyExc_TypeError, "%s: se espera un buffer float64 1-D o 2-D", what);
+      return false;
+    }
+    cols = view.shape[view.ndim - 1];
+    rows = view.ndim == 2 ? view.shape[0] : 1;
+    return true;
+  }
+  double* data() const { return (double*)view.buf; }
+  Py_ssize_t size() const { return rows * cols; }
+  ~DoubleBuf()
+  {
+    if (ok) PyBuffer_Release(&view);
+  }
+};
+
+// =========================
+//  Plan
+// =========================
+struct PlanObject {
+  PyObject_HEAD
+  Fft* fft;
+  std::vector<double>* tapers;  // nTapers × n
+  Py_ssize_t n, nFreq, nTapers;
+  double scale;
+  int onesided;
+  int detrend;
+};
+
+PyObject* Plan_new(PyTypeObject* type, PyObject* args, PyObject* kw)
+{
+  static const char* kwlist[] = {"n", "tapers", "scale", "onesided", "detrend", nullptr};
+  Py_ssize_t n;
+  PyObject* tapersObj;
+  double scale;
+  int onesided = 0, detrend = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kw, "nOd|pp", (char**)kwlist, &n, &tapersObj, &scale,
+                                   &onesided, &detrend))
+    return nullptr;
+  if (n < 2) {
+    PyErr_SetString(PyExc_ValueError, "n debe ser >= 2");
+    return nullptr;
+  }
+  DoubleBuf tb;
+  if (!tb.get(tapersObj, false, "tapers")) return nullptr;
+  if (tb.cols != n || tb.rows < 1) {
+    PyErr_SetString(PyExc_ValueError, "tapers debe tener forma (K, n) o (n,)");
+    return nullptr;
+  }
+
+  PlanObject* p = (PlanObject*)type->tp_alloc(type, 0);
+  if (!p) return nullptr;
+  p->fft = new Fft();
+  p->tapers = new std::vector<double>(tb.data(), tb.data() + tb.size());
+  p->n = n;
+  p->nFreq = n / 2 + 1;
+  p->nTapers = tb.rows;
+  p->scale = scale;
+  p->onesided = onesided;
+  p->detrend = detrend;
+  if (!p->fft->init((size_t)n)) {
+    Py_DECREF(p);
+    return PyErr_NoMemory();
+  }
+  return (PyObject*)p;
+}
+
+void Plan_dealloc(PlanObject* p)
+{
+  delete p->fft;
+  delete p->tapers;
+  PyTypeObject* tp = Py_TYPE(p);
+  tp->tp_free((PyObject*)p);
+  Py_DECREF(tp);
+}
+
+// Media de las potencias de todos los (segmento, taper) de un acumulador.
+// jobs: inicios de segmento en x; cada segmento se multiplica por cada taper.
+void accumulate(const PlanObject* p, const double* x, const Py_ssize_t* starts, size_t nSeg,
+                double* acc, std::vector<cd>& z, std::vector<cd>& work, std::vector<double>& pw)
+{
+  const size_t n = (size_t)p->n;
+  const size_t nf = (size_t)p->nFreq;
+  const size_t K = (size_t)p->nTapers;
+  const double* tap = p->tapers->data();
+  const size_t nJobs = nSeg * K;
+  memset(acc, 0, nf * sizeof(double));
+
+  double* zr = reinterpret_cast<double*>(z.data());
+  for (size_t j0 = 0; j0 < nJobs; j0 += 2) {
+    // Trabajo j = segmento j / K con el taper j % K; dos por FFT (parte real
+    // e imaginaria). Con un número impar, la parte imaginaria va a cero.
+    for (int half = 0; half < 2; ++half) {
+      size_t j = j0 + half;
+      if (j >= nJobs) {
+        for (size_t i = 0; i < n; ++i) zr[2 * i + half] = 0.0;
+        continue;
+      }
+      const double* seg = x + starts[j / K];
+      const double* w = tap + (j % K) * n;
+      double mean = 0.0;
+      if (p->detrend) mean = kern.sum(seg, n) / (double)n;
+      for (size_t i = 0; i < n; ++i) zr[2 * i + half] = (seg[i] - mean) * w[i];
+    }
+    p->fft->exec(z.data(), work.data());
+    kern.power(zr, pw.data(), n);
+    kern.fold(pw.data(), n, nf, acc);
+  }
+
+  double s = p->scale / (double)nJobs;
+  for (size_t k = 0; k < nf; ++k) acc[k] *= s;
+  if (p->onesided) {
+    // Como scipy: n par sin duplicar Nyquist
+    size_t last = (n % 2 == 0) ? nf - 1 : nf;
+    for (size_t k = 1; k < last; ++k) acc[k] *= 2.0;
+  }
+}
+
+PyObject* Plan_psd(PlanObject* p, PyObject* args, PyObject* kw)
+{
+  static const char* kwlist[] = {"x", "out", "step", "n_seg", "offset", "average", nullptr};
+  PyObject *xObj, *outObj;
+  Py_ssize_t step = 0, nSeg = 1, offset = -1;
+  int average = 1;
+  if (!PyArg_ParseTupleAndKeywords(args, kw, "OO|nnnp", (char**)kwlist, &xObj, &outObj, &step,
+                                   &nSeg, &offset, &average))
+    return nullptr;
+  DoubleBuf xb, ob;
+  if (!xb.get(xObj, false, "x") || !ob.get(outObj, true, "out")) return nullptr;
+  if (nSeg < 1 || step < 0 || (nSeg > 1 && step == 0)) {
+    PyErr_SetString(PyExc_ValueError, "n_seg >= 1 y step > 0 con varios segmentos");
+    return nullptr;
+  }
+  // offset < 0: los últimos segmentos de cada fila (ventana "al vuelo")
+  const Py_ssize_t span = (nSeg - 1) * step + p->n;
+  if (offset < 0) offset = xb.cols - span;
+  if (offset < 0 || offset + span > xb.cols) {
+    PyErr_SetString(PyExc_ValueError, "x es más corto que los segmentos pedidos");
+    return nullptr;
+  }
+  const Py_ssize_t rowsOut = xb.rows * (average ? 1 : nSeg);
+  if (ob.size() != rowsOut * p->nFreq) {
+    PyErr_Format(PyExc_ValueError, "out debe tener %zd x %zd elementos", rowsOut, p->nFreq);
+    return nullptr;
+  }
+
+  const double* x = xb.data();
+  double* out = ob.data();
+  const Py_ssize_t cols = xb.cols, rows = xb.rows;
+  Py_BEGIN_ALLOW_THREADS
+  std::vector<cd> z((size_t)p->n), work(p->fft->workSize());
+  std::vector<double> pw((size_t)p->n);
+  std::vector<Py_ssize_t> starts((size_t)nSeg);
+  for (Py_ssize_t s = 0; s < nSeg; ++s) starts[(size_t)s] = offset + s * step;
+  for (Py_ssize_t r = 0; r < rows; ++r) {
+    const double* xr = x + r * cols;
+    if (average) {
+      accumulate(p, xr, starts.data(), (size_t)nSeg, out + r * p->nFreq, z, work, pw);
+    } else {
+      for (Py_ssize_t s = 0; s < nSeg; ++s)
+        accumulate(p, xr, &starts[(size_t)s], 1, out + (r * nSeg + s) * p->nFreq, z, work, pw);
+    }
+  }
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* Plan_get_n(PlanObject* p, void*) { return PyLong_FromSsize_t(p->n); }
+PyObject* Plan_get_n_freq(PlanObject* p, void*) { return PyLong_FromSsize_t(p->nFreq); }
+PyObject* Plan_get_n_tapers(PlanObject* p, void*) { return PyLong_FromSsize_t(p->nTapers); }
+
+PyMethodDef Plan_methods[] = {
+  {"psd", (PyCFunction)(void (*)(void))Plan_psd, METH_VARARGS | METH_KEYWORDS,
+   "psd(x, out, step=0, n_seg=1, offset=-1, average=True). x: (n_ch, n_total) o (n_total,); "
+   "segmentos de n muestras desde offset (-1: los últimos) cada step. out: (n_ch, n_freq) "
+   "con average, (n_ch·n_seg, n_freq) sin él."},
+  {nullptr, nullptr, 0, nullptr},
+};
+
+PyGetSetDef Plan_getset[] = {
+  {"n", (getter)Plan_get_n, nullptr, "muestras por segmento", nullptr},
+  {"n_freq", (getter)Plan_get_n_freq, nullptr, "bins de salida (n // 2 + 1)", nullptr},
+  {"n_tapers", (getter)Plan_get_n_tapers, nullptr, nullptr, nullptr},
+  {nullptr, nullptr, nullptr, nullptr, nullptr},
+};
+
+PyType_Slot Plan_slots[] = {
+  {Py_tp_new, (void*)Plan_new},
+  {Py_tp_dealloc, (void*)Plan_dealloc},
+  {Py_tp_methods, (void*)Plan_methods},
+  {Py_tp_getset, (void*)Plan_getset},
+  {Py_tp_doc, (void*)"Plan(n, tapers, scale, onesided=False, detrend=False): FFT y tapers "
+                     "precalculados para PSD de n muestras."},
+  {0, nullptr},
+};
+
+PyType_Spec Plan_spec = {
+  "eeg_spectral.Plan", sizeof(PlanObject), 0, Py_TPFLAGS_DEFAULT, Plan_slots,
+};
+
+PyTypeObject* PlanType = nullptr;
+
+// =========================
+//  Stream: Welch incremental por saltos (hop)
+// =========================
+// Ventana de W = (n_seg - 1)·hop + n muestras por canal; cada hop muestras
+// se calcula solo el periodograma del segmento de n que acaba de cerrarse y
+// se guarda en un anillo de n_seg espectros. La media del anillo es el Welch
+// de la ventana (mismos segmentos que scipy.signal.welch con nperseg = n y
+// noverlap = n - hop): coste por hop = una FFT de n por canal.
+struct StreamObject {
+  PyObject_HEAD
+  PlanObject* plan;
+  Py_ssize_t nCh, nSeg, hop, window;
+  std::vector<double>* buf;     // nCh × 2W (espejo: el tramo final siempre contiguo)
+  std::vector<double>* segPsd;  // nSeg × nCh × nFreq
+  Py_ssize_t pos;               // próxima posición de escritura (0..W-1)
+  Py_ssize_t sinceHop;          // muestras desde el último hop
+  Py_ssize_t slot;              // próximo hueco del anillo de espectros
+  Py_ssize_t filled;            // espectros válidos en el anillo
+  unsigned long long total;     // muestras recibidas
+  unsigned long long hops;      // segmentos calculados
+};
+
+PyObject* Stream_new(PyTypeObject* type, PyObject* args, PyObject* kw)
+{
+  static const char* kwlist[] = {"plan", "n_ch", "n_seg", "hop", nullptr};
+  PyObject* planObj;
+  Py_ssize_t nCh, nSeg, hop;
+  if (!PyArg_ParseTupleAndKeywords(args, kw, "Onnn", (char**)kwlist, &planObj, &nCh, &nSeg, &hop))
+    return nullptr;
+  if (Py_TYPE(planObj) != PlanType) {
+    PyErr_SetString(PyExc_TypeError, "plan debe ser un eeg_spectral.Plan");
+    return nullptr;
+  }
+  if (nCh < 1 || nSeg < 1 || hop < 1) {
+    PyErr_SetString(PyExc_ValueError, "n_ch, n_seg y hop deben ser >= 1");
+    return nullptr;
+  }
+  PlanObject* plan = (PlanObject*)planObj;
+  StreamObject* st = (StreamObject*)type->tp_alloc(type, 0);
+  if (!st) return nullptr;
+  Py_INCREF(plan);
+  st->plan = plan;
+  st->nCh = nCh;
+  st->nSeg = nSeg;
+  st->hop = hop;
+  st->window = (nSeg - 1) * hop + plan->n;
+  st->buf = new std::vector<double>((size_t)(nCh * 2 * st->window), 0.0);
+  st->segPsd = new std::vector<double>((size_t)(nSeg * nCh * plan->nFreq), 0.0);
+  return (PyObject*)st;
+}
+
+void Stream_dealloc(StreamObject* st)
+{
+  Py_XDECREF(st->plan);
+  delete st->buf;
+  delete st->segPsd;
+  PyTypeObject* tp = Py_TYPE(st);
+  tp->tp_free((PyObject*)st);
+  Py_DECREF(tp);
+}
+
+// push(x) -> hops completados. x: (muestras, n_ch) float32 o float64,
+// el formato de DataReceiver.read_block().
+PyObject* Stream_push(StreamObject* st, PyObject* xObj)
+{
+  Py_buffer v;
+  if (PyObject_GetBuffer(xObj, &v, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) return nullptr;
+  const char* f = v.format ? v.format : "B";
+  if (*f == '<' || *f == '=' || *f == '@') ++f;
+  const bool isF32 = strcmp(f, "f") == 0 && v.itemsize == 4;
+  const bool isF64 = strcmp(f, "d") == 0 && v.itemsize == 8;
+  Py_ssize_t items = v.len / (v.itemsize ? v.itemsize : 1);
+  if ((!isF32 && !isF64) || (v.ndim == 2 && v.shape[1] != st->nCh) || items % st->nCh) {
+    PyBuffer_Release(&v);
+    PyErr_Format(PyExc_ValueError, "x debe ser float32/float64 (muestras, %zd)", st->nCh);
+    return nullptr;
+  }
+  const Py_ssize_t nSamples = items / st->nCh;
+  const PlanObject* p = st->plan;
+  const Py_ssize_t n = p->n, nf = p->nFreq, W = st->window, nCh = st->nCh;
+  Py_ssize_t newHops = 0;
+
+  Py_BEGIN_ALLOW_THREADS
+  std::vector<cd> z((size_t)n), work(p->fft->workSize());
+  std::vector<double> pw((size_t)n);
+  double* buf = st->buf->data();
+  for (Py_ssize_t i = 0; i < nSamples; ++i) {
+    for (Py_ssize_t c = 0; c < nCh; ++c) {
+      double x = isF32 ? (double)((const float*)v.buf)[i * nCh + c] : ((const double*)v.buf)[i * nCh + c];
+      double* b = buf + c * 2 * W;
+      b[st->pos] = b[st->pos + W] = x;
+    }
+    if (++st->pos == W) st->pos = 0;
+    ++st->total;
+    if (++st->sinceHop < st->hop) continue;
+    st->sinceHop = 0;
+    if (st->total < (unsigned long long)n) continue;
+    // Segmento de las n últimas muestras: [pos + W - n, pos + W) en el espejo
+    const Py_ssize_t start = st->pos + W - n;
+    for (Py_ssize_t c = 0; c < nCh; ++c)
+      accumulate(p, buf + c * 2 * W, &start, 1, st->segPsd->data() + (st->slot * nCh + c) * nf, z, work, pw);
+    if (++st->slot == st->nSeg) st->slot = 0;
+    if (st->filled < st->nSeg) ++st->filled;
+    ++st->hops;
+    ++newHops;
+  }
+  Py_END_ALLOW_THREADS
+  PyBuffer_Release(&v);
+  return PyLong_FromSsize_t(newHops);
+}
+
+// psd(out) -> True si el anillo está lleno (Welch de la ventana completa);
+// antes, la media de los segmentos que haya (out a cero sin ninguno).
+PyObject* Stream_psd(StreamObject* st, PyObject* outObj)
+{
+  DoubleBuf ob;
+  if (!ob.get(outObj, true, "out")) return nullptr;
+  const Py_ssize_t nf = st->plan->nFreq;
+  if (ob.size() != st->nCh * nf) {
+    PyErr_Format(PyExc_ValueError, "out debe tener %zd x %zd elementos", st->nCh, nf);
+    return nullptr;
+  }
+  double* out = ob.data();
+  memset(out, 0, (size_t)(st->nCh * nf) * sizeof(double));
+  const double* seg = st->segPsd->data();
+  for (Py_ssize_t s = 0; s < st->filled; ++s)
+    for (Py_ssize_t j = 0; j < st->nCh * nf; ++j) out[j] += seg[s * st->nCh * nf + j];
+  if (st->filled > 1) {
+    const double inv = 1.0 / (double)st->filled;
+    for (Py_ssize_t j = 0; j < st->nCh * nf; ++j) out[j] *= inv;
+  }
+  return PyBool_FromLong(st->filled == st->nSeg);
+}
+
+// rms(out): RMS por canal de las últimas min(total, W) muestras
+PyObject* Stream_rms(StreamObject* st, PyObject* outObj)
+{
+  DoubleBuf ob;
+  if (!ob.get(outObj, true, "out")) return nullptr;
+  if (ob.size() != st->nCh) {
+    PyErr_Format(PyExc_ValueError, "out debe tener %zd elementos", st->nCh);
+    return nullptr;
+  }
+  const Py_ssize_t W = st->window;
+  const Py_ssize_t m = st->total < (unsigned long long)W ? (Py_ssize_t)st->total : W;
+  for (Py_ssize_t c = 0; c < st->nCh; ++c) {
+    const double* b = st->buf->data() + c * 2 * W + st->pos + W - m;
+    double acc = 0.0;
+    for (Py_ssize_t j = 0; j < m; ++j) acc += b[j] * b[j];
+    ob.data()[c] = m ? sqrt(acc / (double)m) : 0.0;
+  }
+  Py_RETURN_NONE;
+}
+
+PyObject* Stream_reset(StreamObject* st, PyObject*)
+{
+  std::fill(st->buf->begin(), st->buf->end(), 0.0);
+  st->pos = st->sinceHop = st->slot = st->filled = 0;
+  st->total = st->hops = 0;
+  Py_RETURN_NONE;
+}
+
+PyObject* Stream_get_n_ch(StreamObject* st, void*) { return PyLong_FromSsize_t(st->nCh); }
+PyObject* Stream_get_n_freq(StreamObject* st, void*) { return PyLong_FromSsize_t(st->plan->nFreq); }
+PyObject* Stream_get_window(StreamObject* st, void*) { return PyLong_FromSsize_t(st->window); }
+PyObject* Stream_get_hop(StreamObject* st, void*) { return PyLong_FromSsize_t(st->hop); }
+PyObject* Stream_get_hops(StreamObject* st, void*) { return PyLong_FromUnsignedLongLong(st->hops); }
+PyObject* Stream_get_total(StreamObject* st, void*) { return PyLong_FromUnsignedLongLong(st->total); }
+PyObject* Stream_get_ready(StreamObject* st, void*) { return PyBool_FromLong(st->filled == st->nSeg); }
+
+PyMethodDef Stream_methods[] = {
+  {"push", (PyCFunction)Stream_push, METH_O,
+   "push(x) -> hops completados. x: (muestras, n_ch) float32/float64."},
+  {"psd", (PyCFunction)Stream_psd, METH_O,
+   "psd(out) -> ready. Welch de la ventana actual en out (n_ch, n_freq)."},
+  {"rms", (PyCFunction)Stream_rms, METH_O, "rms(out): RMS de la ventana por canal en out (n_ch,)."},
+  {"reset", (PyCFunction)Stream_reset, METH_NOARGS, "Vacía la ventana y el anillo de espectros."},
+  {nullptr, nullptr, 0, nullptr},
+};
+
+PyGetSetDef Stream_getset[] = {
+  {"n_ch", (getter)Stream_get_n_ch, nullptr, nullptr, nullptr},
+  {"n_freq", (getter)Stream_get_n_freq, nullptr, nullptr, nullptr},
+  {"window", (getter)Stream_get_window, nullptr, "muestras de la ventana: (n_seg - 1)·hop + n", nullptr},
+  {"hop", (getter)Stream_get_hop, nullptr, nullptr, nullptr},
+  {"hops", (getter)Stream_get_hops, nullptr, "segmentos calculados desde el inicio", nullptr},
+  {"total", (getter)Stream_get_total, nullptr, "muestras recibidas por canal", nullptr},
+  {"ready", (getter)Stream_get_ready, nullptr, "el anillo cubre la ventana completa", nullptr},
+  {nullptr, nullptr, nullptr, nullptr, nullptr},
+};
+
+PyType_Slot Stream_slots[] = {
+  {Py_tp_new, (void*)Stream_new},
+  {Py_tp_dealloc, (void*)Stream_dealloc},
+  {Py_tp_methods, (void*)Stream_methods},
+  {Py_tp_getset, (void*)Stream_getset},
+  {Py_tp_doc, (void*)"Stream(plan, n_ch, n_seg, hop): Welch incremental sobre las últimas "
+                     "(n_seg - 1)·hop + plan.n muestras de cada canal."},
+  {0, nullptr},
+};
+
+PyType_Spec Stream_spec = {
+  "eeg_spectral.Stream", sizeof(StreamObject), 0, Py_TPFLAGS_DEFAULT, Stream_slots,
+};
+
+// =========================
+//  Integración por bandas
+// =========================
+// bandpower(psd, bands, df, out): regla del trapecio con paso uniforme df
+// sobre los bins i0..i1 (ambos incluidos) de cada fila; i0 > i1 o un solo
+// bin dan 0, como np.trapezoid.
+PyObject* bandpower(PyObject*, PyObject* args)
+{
+  PyObject *psdObj, *bandsObj, *outObj;
+  double df;
+  if (!PyArg_ParseTuple(args, "OOdO", &psdObj, &bandsObj, &df, &outObj)) return nullptr;
+  DoubleBuf pb, ob;
+  if (!pb.get(psdObj, false, "psd") || !ob.get(outObj, true, "out")) return nullptr;
+  PyObject* seq = PySequence_Fast(bandsObj, "bands debe ser una secuencia de (i0, i1)");
+  if (!seq) return nullptr;
+  const Py_ssize_t nb = PySequence_Fast_GET_SIZE(seq);
+  std::vector<Py_ssize_t> lo((size_t)nb), hi((size_t)nb);
+  for (Py_ssize_t b = 0; b < nb; ++b) {
+    if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(seq, b), "nn", &lo[(size_t)b], &hi[(size_t)b])) {
+      Py_DECREF(seq);
+      return nullptr;
+    }
+    if (lo[(size_t)b] < 0 || hi[(size_t)b] >= pb.cols) {
+      Py_DECREF(seq);
+      PyErr_SetString(PyExc_IndexError, "banda fuera del espectro");
+      return nullptr;
+    }
+  }
+  Py_DECREF(seq);
+  if (ob.size() != pb.rows * nb) {
+    PyErr_Format(PyExc_ValueError, "out debe tener %zd x %zd elementos", pb.rows, nb);
+    return nullptr;
+  }
+  const double* psd = pb.data();
+  double* out = ob.data();
+  const Py_ssize_t rows = pb.rows, cols = pb.cols;
+  Py_BEGIN_ALLOW_THREADS
+  for (Py_ssize_t r = 0; r < rows; ++r) {
+    const double* p = psd + r * cols;
+    for (Py_ssize_t b = 0; b < nb; ++b) {
+      Py_ssize_t i0 = lo[(size_t)b], i1 = hi[(size_t)b];
+      double v = 0.0;
+      if (i1 > i0) v = df * (kern.sum(p + i0, (size_t)(i1 - i0 + 1)) - 0.5 * (p[i0] + p[i1]));
+      out[r * nb + b] = v;
+    }
+  }
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyMethodDef module_methods[] = {
+  {"bandpower", (PyCFunction)bandpower, METH_VARARGS,
+   "bandpower(psd, bands, df, out): trapecio sobre los bins [(i0, i1), ...] de cada fila "
+   "de psd; out: (filas, n_bandas)."},
+  {nullptr, nullptr, 0, nullptr},
+};
+
+PyModuleDef moduleDef = {
+  PyModuleDef_HEAD_INIT, "eeg_spectral",
+  "Motor espectral nativo de DSPCore (ver dsp-processor/native).", -1,
+  module_methods, nullptr, nullptr, nullptr, nullptr,
+};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit_eeg_spectral(void)
+{
+  selectKernels();
+  PyObject* m = PyModule_Create(&moduleDef);
+  if (!m) return nullptr;
+  PyObject* plan = PyType_FromSpec(&Plan_spec);
+  PyObject* stream = PyType_FromSpec(&Stream_spec);
+  PlanType = (PyTypeObject*)plan;
+  Py_XINCREF(plan);  // referencia propia del módulo (Stream_new)
+  if (!plan || !stream || PyModule_AddObject(m, "Plan", plan) < 0) {
+    Py_XDECREF(plan);
+    Py_XDECREF(stream);
+    Py_DECREF(m);
+    return nullptr;
+  }
+  if (PyModule_AddObject(m, "Stream", stream) < 0 ||
+      PyModule_AddStringConstant(m, "SIMD", kern.name) < 0) {
+    Py_DECREF(m);
+    return nullptr;
+  }
+  return m;
+}
@@ -0,0 +1,78 @@
+"""
+Compila las extensiones nativas del DSP:
+
+  - eeg_native: decodificador del flujo EEG, junto a data_receiver.py
+    ("src/receiver y ejemplo"), que lo usa si está (DataReceiver.read_block).
+  - eeg_spectral: motor espectral, junto a dsp_core.py (src), que lo usa
+    si está (DSPCore con use_native=True).
+  - eeg_replay (solo POSIX): ejecutable que reproduce EDF como el flujo del
+    firmware para pruebas de carga del host (ver eeg_replay.cpp).
+
+    cd dsp-processor/native
+    python setup.py build_ext --inplace
+
+Sin compilador no pasa nada: DataReceiver y DSPCore siguen con el código en
+Python/NumPy.
+"""
+
+import os
+from setuptools import Extension, setup
+from setuptools.command.build_ext import build_ext
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+# Cabeceras y CRC portables del firmware (mismas constantes que el emisor)
+EEGSTREAM = os.path.join(HERE, "..", "..", "arduino-firmware.bak", "EEG MIDI", "lib", "EEGStream", "src")
+RECEIVER = os.path.join("..", "src", "receiver y ejemplo")
+SRC = os.path.join("..", "src")
+
+# Directorio de cada módulo con --inplace
+DEST = {"eeg_native": RECEIVER, "eeg_spectral": SRC}
+
+CXX_ARGS = ["/O2"] if os.name == "nt" else ["-O3", "-std=c++14"]
+
+
+class BuildExt(build_ext):
+    def run(self):
+        super().run()
+        if os.name != "nt":
+            self.build_replay()
+
+    def build_replay(self):
+        # Programa independiente: mismo compilador y opciones que las extensiones
+        objects = self.compiler.compile([os.path.join(HERE, "eeg_replay.cpp")],
+                                        output_dir=self.build_temp, include_dirs=[EEGSTREAM],
+                                        extra_postargs=CXX_ARGS)
+        self.compiler.link_executable(objects, "eeg_replay", output_dir=HERE, target_lang="c++")
+
+    def copy_extensions_to_source(self):
+        # Cada módulo a su directorio (no hay paquete común)
+        for ext in self.extensions:
+            filename = self.get_ext_filename(ext.name)
+            self.copy_file(os.path.join(self.build_lib, filename),
+                           os.path.join(HERE, DEST[ext.name], filename))
+
+
+extensions = [
+    Extension(
+        "eeg_native",
+        sources=["eeg_native.cpp"],
+        include_dirs=[EEGSTREAM],
+        language="c++",
+        extra_compile_args=CXX_ARGS,
+    ),
+    # Los núcleos AVX2 se eligen en tiempo de ejecución: no hace falta -mavx2
+    Extension(
+        "eeg_spectral",
+        sources=["eeg_spectral.cpp"],
+        language="c++",
+        extra_compile_args=CXX_ARGS,
+    ),
+]
+
+setup(
+    name="eeg_native",
+    version="0.2",
+    description="Extensiones nativas del DSP EEG (decodificador y motor espectral)",
+    ext_modules=extensions,
+    cmdclass={"build_ext": BuildExt},
+)
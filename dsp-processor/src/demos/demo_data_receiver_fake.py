@@ -1,5 +1,6 @@
 import struct
 from src.data_receiver import DataReceiver, FRAME_SIZE, NUM_CHANNELS, LSB
+from src.eeg_protocol import build_packet, PKT_SAMPLE
 
 
 class FakeSerial:
@@ -29,7 +30,8 @@ class FakeSerial:
 
 def build_fake_frame(sample_idx: int, raw_channels: list[int]) -> bytes:
     """
-    Construye un frame binario con el mismo formato que espera DataReceiver:
+    Construye un paquete PKT_SAMPLE con el mismo formato que espera DataReceiver.
+    Payload:
     - uint32 little-endian: sample_idx
     - NUM_CHANNELS * int32 little-endian: canales
     """
@@ -38,7 +40,7 @@ def build_fake_frame(sample_idx: int, raw_channels: list[int]) -> bytes:
     frame = struct.pack("<I", sample_idx)               # sample_idx (4 bytes)
     frame += struct.pack(f"<{NUM_CHANNELS}i", *raw_channels)  # canales int32
     assert len(frame) == FRAME_SIZE, f"Frame size {len(frame)} != FRAME_SIZE {FRAME_SIZE}"
-    return frame
+    return build_packet(PKT_SAMPLE, 0, frame)
 
 
 def main():
@@ -5,7 +5,13 @@ DSP Core Module
 ---------------
 Funciones de análisis espectral (ventanas, PSD, bandpower, features)
 para un solo canal. No gestiona buffers ni múltiples canales; eso
-lo hace EEGSignalProcessor.
+lo hace EEGSignalProcessor (compute_psd_multi procesa varios canales
+de una vez).
+
+Si está compilado el motor nativo eeg_spectral (dsp-processor/native),
+PSD, espectrograma y bandpower lo usan: planes de FFT y tablas de
+ventana/DPSS cacheadas por longitud y núcleos SIMD. Los resultados son
+los mismos que con NumPy/SciPy (salvo redondeo).
 """
 
 import numpy as np
@@ -13,6 +19,11 @@ from scipy import signal
 from scipy.signal import windows
 import logging
 
+try:
+    import eeg_spectral
+except ImportError:
+    eeg_spectral = None
+
 logger = logging.getLogger(__name__)
 
 
@@ -39,6 +50,7 @@ class DSPCore:
         outlier_zscore: float = 5.0,   # umbral robusto (MAD) para outliers
         interpolate_outliers: bool = True,
         clipping_fraction_threshold: float = 0.01,  # fracción de muestras iguales en extremo
+        use_native: bool = True,  # motor eeg_spectral si está compilado
 
     ):
         """
@@ -49,6 +61,7 @@ class DSPCore:
             welch_overlap: fracción de solapamiento en Welch (0.0 ~ 0.9 típicamente)
             bands: diccionario de bandas de frecuencia en Hz.
                    Por defecto: delta, theta, alpha, beta, gamma.
+            use_native: usar eeg_spectral si está disponible.
         """
         self.fs = float(fs)
         self.window_sec = float(window_sec)
@@ -85,6 +98,12 @@ class DSPCore:
         self.last_clipping_detected: bool = False
         self.last_outlier_ratio: float = 0.0
 
+        # cachés por longitud: ventanas, tapers DPSS y planes nativos
+        self.native = bool(use_native) and eeg_spectral is not None
+        self._windows: dict = {}
+        self._tapers: dict = {}
+        self._plans: dict = {}
+
 
     # ------------------------------------------------------------------
     # Utilidades de ventana
@@ -99,13 +118,72 @@ class DSPCore:
         n_samples = max(1, int(n_samples))
         return self.fs / n_samples
 
-    def _make_window(self, n: int) -> np.ndarray:
+    def _make_window(self, n: int, window_type: str | None = None) -> np.ndarray:
         """
-        Crea una ventana de longitud n del tipo configurado.
+        Crea (o devuelve de la caché) una ventana de longitud n del tipo
+        configurado (o de window_type).
         """
         if n <= 1:
             return np.ones(n, dtype=float)
-        return signal.get_window(self.window_type, n, fftbins=True)
+        window_type = window_type or self.window_type
+        key = (window_type, n)
+        win = self._windows.get(key)
+        if win is None:
+            win = signal.get_window(window_type, n, fftbins=True)
+            self._windows[key] = win
+        return win
+
+    def _dpss_tapers(self, n: int) -> np.ndarray:
+        """
+        Tapers DPSS (K, n) para multitaper, cacheados por longitud.
+        """
+        tapers = self._tapers.get(n)
+        if tapers is None:
+            tapers = np.atleast_2d(windows.dpss(
+                n,
+                self.mt_nw,
+                Kmax=self.mt_n_tapers,
+                sym=False,
+            ))
+            self._tapers[n] = tapers
+        return tapers
+
+    # ------------------------------------------------------------------
+    # Motor nativo (eeg_spectral)
+    # ------------------------------------------------------------------
+    def _native_plan(self, kind: str, n: int):
+        """
+        Plan nativo para segmentos de n muestras:
+          - "multitaper": tapers DPSS, densidad dt/n, sin detrend (como
+            _compute_psd_multitaper)
+          - nombre de ventana ("hann", "boxcar"...): densidad de
+            scipy.signal.periodogram/welch, one-sided y detrend constante
+        """
+        key = (kind, n)
+        plan = self._plans.get(key)
+        if plan is None:
+            if kind == "multitaper":
+                tapers = np.ascontiguousarray(self._dpss_tapers(n), dtype=float)
+                plan = eeg_spectral.Plan(n, tapers, 1.0 / (self.fs * n))
+            else:
+                win = np.ascontiguousarray(self._make_window(n, kind), dtype=float)
+                scale = 1.0 / (self.fs * float(np.sum(win * win)))
+                plan = eeg_spectral.Plan(n, win, scale, onesided=True, detrend=True)
+            self._plans[key] = plan
+        return plan
+
+    @staticmethod
+    def _native_psd(plan, X: np.ndarray, step: int = 0, n_seg: int = 1,
+                    offset: int = -1, average: bool = True) -> np.ndarray:
+        """
+        PSD de todas las filas de X (n_rows, n_total) con un plan nativo.
+        Devuelve (n_rows, n_freq), o (n_rows * n_seg, n_freq) sin promediar.
+        """
+        X = np.ascontiguousarray(X, dtype=float)
+        rows = X.shape[0] * (1 if average else n_seg)
+        out = np.empty((rows, plan.n_freq), dtype=float)
+        plan.psd(X, out, step=step, n_seg=n_seg, offset=offset, average=average)
+        return out
     # ------------------------------------------------------------------
     # Detección de clipping
     # ------------------------------------------------------------------
@@ -217,18 +295,55 @@ class DSPCore:
         """
         if preprocess:
             x = self.preprocess(x)
+        x = np.asarray(x, dtype=float)
 
-        
-        n = x.size
+        freqs, pxx = self._psd_rows(x[np.newaxis, :], method, nperseg, noverlap, apply_window)
+        if freqs is None:
+            return None, None
+        return freqs, pxx[0]
+
+    def compute_psd_multi(
+        self,
+        X: np.ndarray,
+        method: str = "multitaper",
+        nperseg: int | None = None,
+        noverlap: int | None = None,
+        apply_window: bool = True,
+        preprocess: bool = True,
+    ) -> tuple[np.ndarray | None, np.ndarray | None]:
+        """
+        Como compute_psd pero para X (n_ch, n) en una sola llamada.
+        Devuelve freqs (n_freq,) y pxx (n_ch, n_freq).
+        """
+        X = np.atleast_2d(np.asarray(X, dtype=float))
+        if preprocess and X.size:
+            X = np.vstack([self.preprocess(row) for row in X])
+        return self._psd_rows(X, method, nperseg, noverlap, apply_window)
+
+    def _psd_rows(
+        self,
+        X: np.ndarray,
+        method: str,
+        nperseg: int | None,
+        noverlap: int | None,
+        apply_window: bool,
+    ) -> tuple[np.ndarray | None, np.ndarray | None]:
+        """
+        PSD de cada fila de X (n_rows, n), ya preprocesada.
+        """
+        n = X.shape[1]
         if n < 4:
             return None, None
 
         method = method.lower()
 
         if method == "periodogram":
+            if self.native:
+                plan = self._native_plan(self.window_type if apply_window else "boxcar", n)
+                return np.fft.rfftfreq(n, d=1.0 / self.fs), self._native_psd(plan, X)
             win = self._make_window(n) if apply_window else "boxcar"
             freqs, pxx = signal.periodogram(
-                x,
+                X,
                 fs=self.fs,
                 window=win,
                 scaling="density",
@@ -250,8 +365,16 @@ class DSPCore:
 
             win = self.window_type if apply_window else "boxcar"
 
+            if self.native:
+                # mismos segmentos que scipy (sin padding, se descarta la cola)
+                step = nperseg - noverlap
+                n_seg = (n - noverlap) // step
+                plan = self._native_plan(win, nperseg)
+                pxx = self._native_psd(plan, X, step=step, n_seg=n_seg, offset=0)
+                return np.fft.rfftfreq(nperseg, d=1.0 / self.fs), pxx
+
             freqs, pxx = signal.welch(
-                x,
+                X,
                 fs=self.fs,
                 window=win,
                 nperseg=nperseg,
@@ -261,7 +384,7 @@ class DSPCore:
             return freqs, pxx
         
         elif method == "multitaper":
-            return self._compute_psd_multitaper(x)
+            return self._psd_multitaper_rows(X)
 
         else:
             raise NotImplementedError(f"Método PSD no soportado: {method}")
@@ -278,7 +401,17 @@ class DSPCore:
         Suficiente para obtener un espectro suave y con poca fuga.
         """
         x = np.asarray(x, dtype=float)
-        n = x.size
+        freqs, pxx = self._psd_multitaper_rows(x[np.newaxis, :])
+        if freqs is None:
+            return None, None
+        return freqs, pxx[0]
+
+    def _psd_multitaper_rows(self, X: np.ndarray) -> tuple[np.ndarray, np.ndarray]:
+        """
+        Multitaper de cada fila de X (n_rows, n) sobre sus últimas
+        window_samples muestras.
+        """
+        n = X.shape[1]
         if n < 4:
             return None, None
 
@@ -288,34 +421,30 @@ class DSPCore:
         if n_win < 4:
             return None, None
 
-        # recortamos al final de la señal (ventana deslizante “al vuelo”)
-        x_seg = x[-n_win:]
-
-        # DPSS tapers KxN
-        tapers = windows.dpss(
-            n_win,
-            self.mt_nw,
-            Kmax=self.mt_n_tapers,
-            sym=False,
-        )  # shape (K, n_win)
-
-        # FFT real (solo frecuencias positivas)
         # dt = 1/fs para normalizar a densidad de potencia
         dt = 1.0 / self.fs
         freqs = np.fft.rfftfreq(n_win, d=dt)
 
+        if self.native:
+            # el plan toma las últimas n_win muestras de cada fila
+            return freqs, self._native_psd(self._native_plan("multitaper", n_win), X)
+
+        # recortamos al final de la señal (ventana deslizante “al vuelo”)
+        X_seg = X[:, -n_win:]
+
+        # DPSS tapers KxN (cacheados)
+        tapers = self._dpss_tapers(n_win)
+
         # acumulador de potencia
-        psd_acc = np.zeros_like(freqs, dtype=float) 
+        psd_acc = np.zeros((X.shape[0], freqs.size), dtype=float)
 
-        for k in range(self.mt_n_tapers):
-            taper = tapers[k]
-            x_tap = x_seg * taper
-            Xf = np.fft.rfft(x_tap)
+        for taper in tapers:
+            # FFT real (solo frecuencias positivas)
+            Xf = np.fft.rfft(X_seg * taper, axis=-1)
             # estimador de densidad de potencia (Watts/Hz ~ V^2/Hz)
-            psd_k = (dt / n_win) * np.abs(Xf) ** 2
-            psd_acc += psd_k
+            psd_acc += (dt / n_win) * np.abs(Xf) ** 2
 
-        pxx = psd_acc / self.mt_n_tapers
+        pxx = psd_acc / tapers.shape[0]
         return freqs, pxx
 
     # ------------------------------------------------------------------
@@ -329,6 +458,8 @@ class DSPCore:
     ) -> dict:
         """
         Calcula potencia en bandas a partir de (freqs, pxx).
+        pxx puede ser (n_freq,) -> floats, o (n_ch, n_freq) -> un array
+        (n_ch,) por banda (salida de compute_psd_multi).
         """
         if freqs is None or pxx is None:
             return {}
@@ -337,22 +468,62 @@ class DSPCore:
         if freqs.size == 0 or pxx.size == 0:
             return {}
 
+        if self.native and self._uniform_grid(freqs, pxx):
+            return self._bandpower_native(freqs, pxx, relative)
+
+        multi = pxx.ndim > 1
         band_power = {}
-        total_power = np.trapezoid(pxx, freqs)
+        total_power = np.trapezoid(pxx, freqs, axis=-1)
 
         for band_name, (f_low, f_high) in self.bands.items():
             mask = (freqs >= f_low) & (freqs <= f_high)
             if not np.any(mask):
-                band_power[band_name] = 0.0
+                band_power[band_name] = np.zeros(pxx.shape[0]) if multi else 0.0
                 continue
 
-            power = np.trapezoid(pxx[mask], freqs[mask])
+            power = np.trapezoid(pxx[..., mask], freqs[mask], axis=-1)
+            if multi:
+                if relative:
+                    power = np.divide(power, total_power, out=power.copy(), where=total_power > 0)
+                band_power[band_name] = power
+                continue
             if relative and total_power > 0:
                 power = power / total_power
             band_power[band_name] = float(power)
 
         return band_power
 
+    @staticmethod
+    def _uniform_grid(freqs: np.ndarray, pxx: np.ndarray) -> bool:
+        """Rejilla de frecuencias creciente y uniforme (la de rfftfreq)."""
+        if freqs.ndim != 1 or freqs.size < 2 or pxx.shape[-1] != freqs.size or pxx.ndim > 2:
+            return False
+        df = freqs[1] - freqs[0]
+        return df > 0 and np.allclose(np.diff(freqs), df, rtol=1e-9, atol=0.0)
+
+    def _bandpower_native(self, freqs: np.ndarray, pxx: np.ndarray, relative: bool) -> dict:
+        """
+        compute_bandpower con eeg_spectral.bandpower: mismos bins que las
+        máscaras freqs >= f_low & freqs <= f_high, más el total.
+        """
+        P = np.ascontiguousarray(np.atleast_2d(pxx), dtype=float)
+        names = list(self.bands.keys())
+        bins = []
+        for f_low, f_high in self.bands.values():
+            i0 = int(np.searchsorted(freqs, f_low, side="left"))
+            i1 = int(np.searchsorted(freqs, f_high, side="right")) - 1
+            # banda sin bins (i0 > i1): el motor da 0, como la máscara vacía
+            bins.append((i0, i1) if i0 <= i1 else (0, -1))
+        bins.append((0, freqs.size - 1))  # total
+        out = np.empty((P.shape[0], len(bins)), dtype=float)
+        eeg_spectral.bandpower(P, bins, float(freqs[1] - freqs[0]), out)
+        total = out[:, -1:]
+        if relative:
+            np.divide(out[:, :-1], total, out=out[:, :-1], where=total > 0)
+        if pxx.ndim > 1:
+            return {name: out[:, b].copy() for b, name in enumerate(names)}
+        return {name: float(out[0, b]) for b, name in enumerate(names)}
+
     # ------------------------------------------------------------------
     # FEATURES DE ALTO NIVEL
     # ------------------------------------------------------------------
@@ -375,7 +546,6 @@ class DSPCore:
 
         x_prep = self.preprocess(x)
         rms = float(np.sqrt(np.mean(x_prep ** 2)))
-        total_time_power = rms**2  # V²
 
         freqs, pxx = self.compute_psd(
             x,
@@ -386,6 +556,14 @@ class DSPCore:
         )
         if freqs is None:
             return {}
+        return self._features_from_psd(freqs, pxx, rms)
+
+    def _features_from_psd(self, freqs: np.ndarray, pxx: np.ndarray, rms: float) -> dict:
+        """
+        Features de compute_features a partir de una PSD ya calculada y del
+        RMS de la ventana (también los usa SpectralStream).
+        """
+        total_time_power = rms**2  # V²
         # --- Potencia absoluta ---
         band_abs = self.compute_bandpower(freqs, pxx, relative=False)
         # --- Potencia relativa ---
@@ -506,6 +684,27 @@ class DSPCore:
         Sxx_list = []
         times = []
 
+        if self.native and method in ("periodogram", "multitaper", "welch"):
+            # todas las ventanas en una llamada; mismas PSD que el bucle de abajo
+            n_frames = len(starts)
+            if method == "multitaper":
+                n_win = min(self.window_samples, win_samples)
+                plan = self._native_plan("multitaper", n_win)
+                offset = win_samples - n_win
+                freqs = np.fft.rfftfreq(n_win, d=1.0 / self.fs)
+            else:
+                # welch con nperseg = ventana y sin solape interno = periodograma
+                plan = self._native_plan(self.window_type if apply_window else "hann", win_samples)
+                offset = 0
+                freqs = np.fft.rfftfreq(win_samples, d=1.0 / self.fs)
+            Sxx = self._native_psd(plan, x[np.newaxis, :], step=step_samples,
+                                   n_seg=n_frames, offset=offset, average=False)
+            if log_scale:
+                eps = 1e-12
+                Sxx = 10 * np.log10(Sxx + eps)
+            times = (np.asarray(starts, dtype=float) + win_samples / 2.0) / self.fs
+            return times, freqs, Sxx
+
         for start in starts:
             seg = x[start:start + win_samples]
 
@@ -601,7 +800,13 @@ class DSPCore:
         )
         if freqs is None or pxx is None:
             return float("nan")
+        return self._stability_from_psd(freqs, pxx, fmin, fmax)
 
+    @staticmethod
+    def _stability_from_psd(freqs: np.ndarray, pxx: np.ndarray, fmin: float, fmax: float) -> float:
+        """
+        Pasos 2)–5) de compute_spectral_stability sobre una PSD ya calculada.
+        """
         freqs = np.asarray(freqs)
         pxx = np.asarray(pxx)
 
@@ -636,3 +841,147 @@ class DSPCore:
         stability = 1.0 - float(H_norm)
         return stability
 
+
+
+class SpectralStream:
+    """
+    Estado espectral incremental para streaming (varios canales).
+
+    Mantiene las últimas ~window_sec de cada canal y, cada hop_sec, calcula
+    solo el periodograma del segmento (segment_sec) que acaba de cerrarse;
+    la media de los n_seg últimos es el Welch de la ventana, el mismo que
+        dsp.compute_psd(x_ventana, method="welch", nperseg=segment,
+                        noverlap=segment - hop, preprocess=False)
+    Así cada hop cuesta una FFT de segment muestras por canal (en vez de
+    rehacer la ventana entera) y los features salen con latencia de hop.
+
+    El multitaper no admite esta actualización (los tapers DPSS cubren la
+    ventana entera); para streaming se usa Welch con la ventana de DSPCore.
+    Sin preprocess: la señal ya llega filtrada (EEGSignalProcessor) y
+    Welch quita la media de cada segmento.
+
+    Usa eeg_spectral.Stream si el motor nativo está disponible.
+    """
+
+    def __init__(
+        self,
+        dsp: DSPCore,
+        n_channels: int,
+        hop_sec: float = 0.25,
+        segment_sec: float = 1.0,
+        window_sec: float | None = None,
+    ):
+        self.dsp = dsp
+        self.n_channels = int(n_channels)
+        fs = dsp.fs
+        if window_sec is None:
+            window_sec = dsp.window_sec
+
+        self.hop = max(1, int(round(hop_sec * fs)))
+        self.nperseg = max(4, int(round(segment_sec * fs)))
+        window_samples = max(self.nperseg, int(round(window_sec * fs)))
+        # nº de segmentos que caben en la ventana (la ventana real se ajusta a ellos)
+        self.n_seg = (window_samples - self.nperseg) // self.hop + 1
+        self.window_samples = (self.n_seg - 1) * self.hop + self.nperseg
+        self.freqs = np.fft.rfftfreq(self.nperseg, d=1.0 / fs)
+
+        self._native = None
+        if dsp.native:
+            plan = dsp._native_plan(dsp.window_type, self.nperseg)
+            self._native = eeg_spectral.Stream(plan, self.n_channels, self.n_seg, self.hop)
+        self.reset()
+
+    def reset(self) -> None:
+        """Vacía la ventana y los espectros acumulados."""
+        if self._native is not None:
+            self._native.reset()
+        self._buf = np.zeros((self.n_channels, self.window_samples), dtype=float)
+        self._seg_psd = np.zeros((self.n_seg, self.n_channels, self.freqs.size), dtype=float)
+        self._total = 0
+        self._since_hop = 0
+        self._slot = 0
+        self._filled = 0
+        self.hops = 0
+
+    @property
+    def ready(self) -> bool:
+        """True cuando los segmentos cubren la ventana completa."""
+        if self._native is not None:
+            return self._native.ready
+        return self._filled == self.n_seg
+
+    def push(self, X: np.ndarray) -> int:
+        """
+        Añade un bloque (n_samples, n_channels), p. ej. el de
+        DataReceiver.read_block(). Devuelve cuántos hops se han completado.
+        """
+        X = np.asarray(X)
+        if X.ndim == 1:
+            X = X.reshape(-1, self.n_channels)
+        if self._native is not None:
+            if X.dtype not in (np.float32, np.float64):
+                X = X.astype(float)
+            new = self._native.push(np.ascontiguousarray(X))
+            self.hops += new
+            return new
+
+        X = X.astype(float, copy=False)
+        new = 0
+        pos = 0
+        while pos < X.shape[0]:
+            take = min(self.hop - self._since_hop, X.shape[0] - pos)
+            self._buf = np.roll(self._buf, -take, axis=1)
+            self._buf[:, -take:] = X[pos:pos + take].T
+            pos += take
+            self._total += take
+            self._since_hop += take
+            if self._since_hop < self.hop:
+                continue
+            self._since_hop = 0
+            if self._total < self.nperseg:
+                continue
+            _, pxx = self.dsp._psd_rows(self._buf[:, -self.nperseg:], "welch",
+                                        self.nperseg, 0, True)
+            self._seg_psd[self._slot] = pxx
+            self._slot = (self._slot + 1) % self.n_seg
+            self._filled = min(self._filled + 1, self.n_seg)
+            self.hops += 1
+            new += 1
+        return new
+
+    def psd(self) -> tuple[np.ndarray, np.ndarray]:
+        """freqs (n_freq,) y Welch de la ventana actual (n_channels, n_freq)."""
+        if self._native is not None:
+            out = np.empty((self.n_channels, self.freqs.size), dtype=float)
+            self._native.psd(out)
+            return self.freqs, out
+        if self._filled == 0:
+            return self.freqs, np.zeros((self.n_channels, self.freqs.size))
+        return self.freqs, self._seg_psd[:self._filled].mean(axis=0)
+
+    def rms(self) -> np.ndarray:
+        """RMS de la ventana actual por canal."""
+        if self._native is not None:
+            out = np.empty(self.n_channels, dtype=float)
+            self._native.rms(out)
+            return out
+        m = min(self._total, self.window_samples)
+        if m == 0:
+            return np.zeros(self.n_channels)
+        return np.sqrt(np.mean(self._buf[:, -m:] ** 2, axis=1))
+
+    def features(self, fmin: float = 0.5, fmax: float = 40.0) -> list[dict]:
+        """
+        Un diccionario por canal con las mismas claves que
+        DSPCore.compute_features (lo que consume MusicSegmentBuilder) más
+        "stability" (la métrica de compute_spectral_stability que usa
+        eeg_to_bars), calculados sobre la ventana actual.
+        """
+        freqs, pxx = self.psd()
+        rms = self.rms()
+        feats = []
+        for ch in range(self.n_channels):
+            f = self.dsp._features_from_psd(freqs, pxx[ch], float(rms[ch]))
+            f["stability"] = self.dsp._stability_from_psd(freqs, pxx[ch], fmin, fmax)
+            feats.append(f)
+        return feats
@@ -104,6 +104,21 @@ class EEGSignalProcessor:
         freqs, pxx = self.dsp.compute_psd(x_filt, method=method)
         return freqs, pxx
 
+    def get_power_spectra(
+        self,
+        window_sec: float | None = None,
+        method: str = "multitaper",
+    ):
+        """
+        PSD de todos los canales filtrados en una sola llamada a DSPCore
+        (compute_psd_multi): freqs (n_freq,), pxx (n_ch, n_freq).
+        """
+        rows = [self.apply_filter(ch, window_sec) for ch in range(self.num_channels)]
+        if not rows or any(r.size < 4 for r in rows):
+            return None, None
+        n = min(r.size for r in rows)
+        return self.dsp.compute_psd_multi(np.vstack([r[-n:] for r in rows]), method=method)
+
     def get_band_power(self, channel_idx: int, window_sec: float | None = None):
         freqs, pxx = self.get_power_spectrum(channel_idx, window_sec)
         if freqs is None:
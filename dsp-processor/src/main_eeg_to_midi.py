@@ -17,6 +17,7 @@
 from __future__ import annotations
 
 import os
+import time
 import argparse
 
 import numpy as np
@@ -127,6 +128,7 @@ def process_channel_to_midi(
     root_note: str = "C4",
     main_note_name: str = "C4",
     bpm: float = 120.0,
+    timings: dict | None = None,
 ):
     """
     Procesa un canal de EEG completo y genera un archivo MIDI.
@@ -139,6 +141,9 @@ def process_channel_to_midi(
         5) División del segmento en n_bars compases usando generate_bars_for_segment.
         6) Generación de NoteEvents con NoteGenerator.
         7) Escritura de MIDI en output_dir.
+
+    Si se pasa `timings`, acumula en él el tiempo (s) de cada paso por nombre;
+    es la parte de cómputo de la latencia EEG -> sonido (ver latency_tool.py).
     """
     x_chan = np.asarray(x_chan, dtype=float)
     n_samples = x_chan.size
@@ -150,8 +155,18 @@ def process_channel_to_midi(
 
     print(f"[INFO] Procesando canal {channel_name}: {n_samples} muestras, {duration:.2f} s")
 
+    t_prev = time.perf_counter()
+
+    def lap(step: str):
+        nonlocal t_prev
+        now = time.perf_counter()
+        if timings is not None:
+            timings[step] = timings.get(step, 0.0) + (now - t_prev)
+        t_prev = now
+
     # 1) Filtrado
     x_filt = filter_eeg_channel(x_chan, fs)
+    lap("filtro")
 
     # 2) Segmento único (índices 0..n_samples-1)
     seg = Segment(
@@ -164,6 +179,7 @@ def process_channel_to_midi(
     # 3) DSPCore: features globales
     dsp = DSPCore(fs=fs, window_sec=4.0)
     eeg_feats = dsp.compute_features(x_filt, psd_method="multitaper")
+    lap("features")
 
     # 4) Selección escala por (familia, escala, root_note)
     scale = build_scale_config(
@@ -182,6 +198,7 @@ def process_channel_to_midi(
         user_scale=scale,
         user_main_note_midi=user_main_midi,
     )
+    lap("segmento")
 
     # 5) Generar Bars (acordes + note_positions)
     bar_gen = BarGenerator()
@@ -195,11 +212,13 @@ def process_channel_to_midi(
         stability_fmax=40.0,
     )
 
+    lap("compases")
     print(f"[INFO] Canal {channel_name}: generados {len(bars)} compases.")
 
     # 6) Generar notas
     note_gen = NoteGenerator()
     notes = note_gen.generate_notes_for_segment(music_seg, bars)
+    lap("notas")
 
     print(f"[INFO] Canal {channel_name}: generadas {len(notes)} notas.")
 
@@ -214,6 +233,7 @@ def process_channel_to_midi(
         bpm=bpm,
         ticks_per_beat=480,
     )
+    lap("midi")
 
     print(f"[OK] MIDI escrito: {midi_path}")
 
@@ -277,6 +297,11 @@ def main():
         default=120.0,
         help="Tempo del MIDI (beats per minute).",
     )
+    parser.add_argument(
+        "--timing",
+        action="store_true",
+        help="Muestra el tiempo de cada etapa (ms por segundo de EEG).",
+    )
 
     args = parser.parse_args()
 
@@ -311,6 +336,7 @@ def main():
 
     # 2) Procesar cada canal seleccionado
     n_samples, n_channels = eeg_v.shape
+    timings = {} if args.timing else None
     for ch_idx, ch_name in enumerate(selected_channels):
         x_chan = eeg_v[:, ch_idx]
         process_channel_to_midi(
@@ -324,8 +350,16 @@ def main():
             root_note=root_note,
             main_note_name=main_note_name,
             bpm=bpm,
+            timings=timings,
         )
 
+    if timings:
+        # Normalizado por duración: coste de cómputo por segundo de señal
+        eeg_sec = n_samples / fs * len(selected_channels)
+        print("[TIMING] ms de cómputo por segundo de EEG y canal:")
+        for step, t in timings.items():
+            print(f"  {step:<10} {1e3 * t / eeg_sec:8.3f}")
+
 
 if __name__ == "__main__":
     main()
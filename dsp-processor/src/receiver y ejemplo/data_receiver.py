@@ -1,32 +1,81 @@
 """
 Data Receiver Module - Lee datos del buffer binario del Arduino
-Parsea el protocolo little-endian y convierte a voltaje.
+Parsea el protocolo de paquetes (sync + CRC, ver eeg_protocol.py) y convierte
+a voltaje.
+
+Si está compilada la extensión nativa (dsp-processor/native, eeg_native),
+read_block() decodifica en C++ y entrega bloques NumPy (muestras, canales)
+sin copias; read_frame() sigue siendo la ruta en Python.
+
+send_command() y los set_*() cambian la configuración del firmware en
+caliente (plano de control, PKT_CMD/PKT_ACK en docs/protocol.md).
+
+Cada clock_sync_interval s se manda un CMD_TIME_PING; con los PKT_PONG y
+PKT_TIMING se ajusta el reloj del firmware al del host (ClockSync o el del
+decodificador nativo) y read_block(with_times=True) da la hora de
+adquisición de cada muestra en time.perf_counter().
+
+Con la flash store-and-forward del firmware (EEG_STORE, set_store()), lo que
+no cupo en el enlace llega más tarde en PKT_STORED: se reensambla aparte
+(StoredStream, con su propio RiceDecoder) y se entrega por on_backfill, no
+por read_frame()/read_block(), que siguen siendo el flujo en vivo.
+
+Cuando el firmware pierde la sincronía con el ADS1299 y la recupera, avisa
+con un PKT_GAP (SyncGap): las muestras del hueco no existen y no llegarán
+por ningún camino; on_gap lo recibe y last_gap guarda el último.
 """
 
-import struct
+import math
+import os
 import serial
-from typing import Tuple, Optional
+import struct
+import time
+from typing import Callable, Iterable, Tuple, Optional, Union
 import logging
 
+import numpy as np
+
+try:
+    import eeg_native  # extensión opcional: python native/setup.py build_ext --inplace
+except ImportError:
+    eeg_native = None
+
+from eeg_protocol import (
+    PacketParser, Packet, RiceDecoder, TimingRecord, StatsRecord, FeatureRecord, PKT_SAMPLE, PKT_BATCH,
+    PKT_RICE, PKT_TIMING, PKT_STATS, PKT_DIAG, parse_sample_payload, parse_batch_payload,
+    parse_timing_payload, parse_stats_payload, PKT_FEATURES, parse_features_payload,
+    PKT_SAMPLE_MASKED, parse_sample_masked_payload, expand_channels,
+    PKT_STATUS, StatusEvent, parse_status_payload,
+    PKT_ACK, AckRecord, MidiTable, parse_ack_payload, build_command_packet, ACK_NAMES,
+    CMD_PING, CMD_START, CMD_STOP, CMD_SET_RATE, CMD_SET_MODE, CMD_SET_BATCH, CMD_SET_FILTER,
+    CMD_SET_CHANNELS, CMD_SET_BAUD, CMD_SET_TRANSPORT, CMD_MIDI_TABLE,
+    PKT_PONG, CMD_TIME_PING, ClockSync, parse_pong_payload,
+    PKT_STORED, CMD_SET_STORE, StoredStream,
+    PKT_GAP, SyncGap, parse_gap_payload,
+)
+
 logging.basicConfig(level=logging.INFO)
 logger = logging.getLogger(__name__)
 
 # Configuración del protocolo
-NUM_CHANNELS = 4
-FRAME_SIZE = 4 + (4 * NUM_CHANNELS)  # 20 bytes
+NUM_CHANNELS = 4  # por defecto (ADS1299_NUM_CHANNELS); los paquetes indican el nº real
+FRAME_SIZE = 4 + (4 * NUM_CHANNELS)  # 20 bytes (payload de un paquete SAMPLE)
 LSB = 2.235e-8  # Voltios por LSB
 
 
 class DataReceiver:
     """Lee frames binarios del Arduino y los convierte a voltaje."""
     
-    def __init__(self, port: str = "COM3", baudrate: int = 115200, timeout: float = 1.0):
+    def __init__(self, port: str = "COM3", baudrate: int = 115200, timeout: float = 1.0,
+                 use_native: bool = True):
         """
         Inicializa la conexión serial con el Arduino.
         
         Args:
-            port: Puerto COM (ej: "COM3", "/dev/ttyUSB0")
-            baudrate: Velocidad en bps (115200 recomendado)
+            port: Puerto COM (ej: "COM3", "/dev/ttyUSB0") o URL de pyserial
+                ("socket://localhost:5555")
+            baudrate: Velocidad en bps (115200 recomendado; sin efecto en
+                placas con USB nativo, ver docs/protocol.md)
             timeout: Timeout de lectura en segundos
         """
         self.port = port
@@ -34,15 +83,67 @@ class DataReceiver:
         self.timeout = timeout
         self.serial_conn = None
         self.sample_count = 0
+        self.parser = PacketParser()
+        self._pending: list[Packet] = []
+        # Estado del descompresor (paquetes PKT_RICE encadenados)
+        self.rice = RiceDecoder()
+        # Muestras ya decodificadas de un lote, pendientes de entregar
+        self._samples: list[Tuple[int, list]] = []
+        # Llamado con (TimingRecord, t_host) por cada PKT_TIMING; t_host es
+        # time.perf_counter() al recibir los bytes que completaron el paquete
+        self.on_timing: Optional[Callable[[TimingRecord, float], None]] = None
+        self._pending_t = 0.0
+        # Último PKT_STATS recibido y callback opcional con (nuevo, anterior)
+        self.last_stats: Optional[StatsRecord] = None
+        self.on_stats: Optional[Callable[[StatsRecord, Optional[StatsRecord]], None]] = None
+        # Modo features del firmware: callback con cada FeatureRecord (PKT_FEATURES)
+        self.on_features: Optional[Callable[[FeatureRecord], None]] = None
+        # Lead-off / GPIO (PKT_STATUS, solo cuando cambian): último evento y
+        # callback opcional con cada uno
+        self.last_status: Optional[StatusEvent] = None
+        self.on_status: Optional[Callable[[StatusEvent], None]] = None
+        # Huecos por pérdida de sincronía del ADS1299 (PKT_GAP): último y
+        # callback opcional con cada uno
+        self.last_gap: Optional[SyncGap] = None
+        self.on_gap: Optional[Callable[[SyncGap], None]] = None
+        # Decodificador nativo para read_block() (None: ruta en Python)
+        self.native = eeg_native.Decoder() if (use_native and eeg_native is not None) else None
+        # True desde que read_block() lee por el decodificador nativo: los
+        # bytes que llegan esperando un ACK siguen el mismo camino
+        self._native_path = False
+        # Plano de control: nº de secuencia de los comandos, ACK recibidos
+        # por cmd_seq y la última configuración que ha devuelto el firmware
+        self._cmd_seq = 0
+        self._acks: dict[int, AckRecord] = {}
+        self.last_ack: Optional[AckRecord] = None
+        # Sincronización de reloj: s entre CMD_TIME_PING (0 = no sincronizar;
+        # se pone a 0 solo si el firmware no conoce el comando), ajuste de la
+        # ruta en Python y callback con clock_stats() tras cada PKT_PONG
+        self.clock_sync_interval = 1.0
+        self.clock = ClockSync()
+        self.on_clock: Optional[Callable[[dict], None]] = None
+        self._last_ping = -math.inf
+        # Store-and-forward: muestras que vuelven de la flash del firmware,
+        # callback con (sample_idx uint32 (n,), voltages float32 (n, n_ch))
+        # de cada paquete reensamblado (en el orden en que se guardaron)
+        self.stored = StoredStream()
+        self.stored_rice = RiceDecoder()
+        self.on_backfill: Optional[Callable[[np.ndarray, np.ndarray], None]] = None
         
     def connect(self) -> bool:
         """Establece conexión con el Arduino."""
         try:
-            self.serial_conn = serial.Serial(
-                port=self.port,
-                baudrate=self.baudrate,
-                timeout=self.timeout
-            )
+            # URL de pyserial (socket://host:puerto: native/eeg_replay --tcp)
+            if "://" in self.port:
+                self.serial_conn = serial.serial_for_url(
+                    self.port, baudrate=self.baudrate, timeout=self.timeout
+                )
+            else:
+                self.serial_conn = serial.Serial(
+                    port=self.port,
+                    baudrate=self.baudrate,
+                    timeout=self.timeout
+                )
             logger.info(f"✓ Conectado a {self.port} @ {self.baudrate} bps")
             return True
         except serial.SerialException as e:
@@ -55,46 +156,396 @@ class DataReceiver:
             self.serial_conn.close()
             logger.info("Desconectado del Arduino")
     
-    def read_frame(self) -> Optional[Tuple[int, list]]:
+    def read_packet(self) -> Optional[Packet]:
         """
-        Lee un frame completo del buffer.
-        
+        Lee del puerto hasta completar un paquete válido (CRC correcto).
+        Los bytes corruptos o perdidos se descartan resincronizando con el
+        siguiente sync; los paquetes DIAG se registran en el log.
+
         Returns:
-            Tupla (sample_idx, voltages) donde voltages es lista de 8 float
-            None si hay error o timeout
+            Packet o None si hay timeout
         """
         if not self.serial_conn or not self.serial_conn.is_open:
             logger.error("Puerto serial no conectado")
             return None
+
+        while True:
+            if self._pending:
+                pkt = self._pending.pop(0)
+                if self._handle_control(pkt):
+                    continue
+                return pkt
+
+            self._maybe_ping()
+            # Leer lo disponible (mínimo 1 byte, bloquea hasta timeout)
+            waiting = getattr(self.serial_conn, "in_waiting", 0) or 0
+            data = self.serial_conn.read(max(1, waiting))
+            if not data:
+                logger.warning("Timeout esperando paquete")
+                return None
+            self._pending_t = time.perf_counter()
+            self._pending.extend(self.parser.feed(data))
+
+    def _handle_control(self, pkt: Packet) -> bool:
+        """Trata los paquetes que no son de muestras; True si lo ha consumido."""
+        if pkt.type == PKT_DIAG:
+            logger.info(f"[DIAG] {pkt.payload.decode('utf-8', errors='replace')}")
+        elif pkt.type == PKT_STATS:
+            self._handle_stats(parse_stats_payload(pkt.payload))
+        elif pkt.type == PKT_FEATURES:
+            if self.on_features is not None:
+                self.on_features(parse_features_payload(pkt.payload))
+        elif pkt.type == PKT_STATUS:
+            self._handle_status(parse_status_payload(pkt.payload))
+        elif pkt.type == PKT_TIMING:
+            rec = parse_timing_payload(pkt.payload)
+            if not self._native_path:
+                self.clock.add_timing(rec)  # el nativo ya lo ha hecho al decodificar
+            if self.on_timing is not None:
+                self.on_timing(rec, self._pending_t)
+        elif pkt.type == PKT_PONG:
+            if not self._native_path:
+                self.clock.add_pong(parse_pong_payload(pkt.payload), self._pending_t)
+            if self.on_clock is not None:
+                self.on_clock(self.clock_stats())
+        elif pkt.type == PKT_STORED:
+            self._handle_stored(pkt.payload)
+        elif pkt.type == PKT_GAP:
+            self._handle_gap(parse_gap_payload(pkt.payload))
+        elif pkt.type == PKT_ACK:
+            ack = parse_ack_payload(pkt.payload)
+            self._acks[ack.cmd_seq] = ack
+            self.last_ack = ack
+            if ack.cmd == CMD_TIME_PING:
+                # Firmware anterior a CMD_TIME_PING: se deja de sincronizar
+                self.clock_sync_interval = 0
+                logger.info("[CLOCK] el firmware no responde a CMD_TIME_PING: sin sincronización de reloj")
+            elif not ack.ok:
+                logger.warning(f"[ACK] comando 0x{ack.cmd:02X}: {ACK_NAMES.get(ack.status, ack.status)}")
+        else:
+            return False
+        return True
+
+    def _handle_stored(self, payload: bytes):
+        """Reensambla un tramo PKT_STORED y entrega las muestras por on_backfill."""
+        had = self.stored.remaining
+        for inner in self.stored.feed(payload):
+            if inner.type == PKT_FEATURES:
+                if self.on_features is not None:
+                    self.on_features(parse_features_payload(inner.payload))
+                continue
+            rows = self._decode_samples(inner, self.stored_rice)
+            if rows and self.on_backfill is not None:
+                self.on_backfill(np.array([r[0] for r in rows], dtype=np.uint32),
+                                 np.array([r[1] for r in rows], dtype=np.float32))
+        if had and self.stored.remaining == 0:
+            logger.info(f"[STORE] flash descargada ({self.stored.bytes} bytes, {self.stored.gaps} huecos)")
+
+    @staticmethod
+    def _decode_samples(pkt: Packet, rice: RiceDecoder) -> list:
+        """
+        Muestras (sample_idx, voltages) de un paquete de datos; lista vacía si
+        no lo es o si es un RICE sin su anterior en la cadena.
+        """
+        if pkt.type == PKT_SAMPLE:
+            sample_idx, raw_channels = parse_sample_payload(pkt.payload)
+            return [(sample_idx, [raw * LSB for raw in raw_channels])]
+        if pkt.type == PKT_SAMPLE_MASKED:
+            sample_idx, n_columns, ch_mask, raw_channels = parse_sample_masked_payload(pkt.payload)
+            return [(sample_idx, expand_channels([raw * LSB for raw in raw_channels], ch_mask, n_columns, math.nan))]
+        if pkt.type == PKT_BATCH:
+            block = parse_batch_payload(pkt.payload)
+        elif pkt.type == PKT_RICE:
+            # None = falta un paquete de la cadena, esperar keyframe
+            block = rice.decode(pkt.payload)
+            if block is None:
+                return []
+        else:
+            return []
+        # Convertir a voltaje; los canales apagados, NaN
+        return [(block.base_idx + k, expand_channels([raw * LSB for raw in raw_channels],
+                                                     block.ch_mask, block.n_columns, math.nan))
+                for k, raw_channels in enumerate(block.channels)]
+
+    def _handle_status(self, ev: StatusEvent):
+        """Avisa en el log cuando cambia el lead-off de algún dispositivo."""
+        prev, self.last_status = self.last_status, ev
+        loff = [(ev.loff_p(d), ev.loff_n(d)) for d in range(len(ev.status))]
+        if prev is None or len(prev.status) != len(ev.status) or loff != [
+                (prev.loff_p(d), prev.loff_n(d)) for d in range(len(prev.status))]:
+            desc = ", ".join(f"dev{d} P=0x{p:02X} N=0x{n:02X}" for d, (p, n) in enumerate(loff))
+            log = logger.warning if any(p | n for p, n in loff) else logger.info
+            log(f"[STATUS] lead-off desde la muestra {ev.sample_idx}: {desc}")
+        if self.on_status is not None:
+            self.on_status(ev)
+
+    def _handle_gap(self, gap: SyncGap):
+        """Avisa en el log de cada hueco de sincronía y de cómo se recuperó."""
+        self.last_gap = gap
+        how = "RESET y registros reescritos" if gap.restored else "SDATAC/RDATAC"
+        if gap.failed:
+            how += ", registros sin verificar"
+        logger.warning(f"[GAP] {gap.n_samples} muestras perdidas por sync desde la {gap.first_idx} "
+                       f"({how}, {gap.attempts} intento(s), {gap.recovery_us} us)")
+        if self.on_gap is not None:
+            self.on_gap(gap)
+
+    def _handle_stats(self, st: StatsRecord):
+        """Avisa si el firmware ha perdido muestras desde el STATS anterior."""
+        prev, self.last_stats = self.last_stats, st
+        if prev is not None:
+            d = st.delta(prev)
+            lost = {n: d[n] for n in StatsRecord.LOSS_FIELDS if d[n]}
+            if lost:
+                logger.warning(f"[STATS] pérdidas en {d['sample_idx']} muestras: {lost}")
+        if self.on_stats is not None:
+            self.on_stats(st, prev)
+
+    def read_frame(self) -> Optional[Tuple[int, list]]:
+        """
+        Lee la siguiente muestra, venga en un paquete PKT_SAMPLE o dentro de
+        un lote PKT_BATCH / PKT_RICE (el resto del lote queda en cola para las
+        siguientes llamadas).
         
+        Returns:
+            Tupla (sample_idx, voltages) donde voltages es lista de float por canal
+            de la cadena (NaN en los apagados con EEG_CMD_SET_CHANNELS)
+            None si hay error o timeout
+        """
         try:
-            # Leer exactamente FRAME_SIZE bytes
-            frame_data = self.serial_conn.read(FRAME_SIZE)
-            
-            if len(frame_data) != FRAME_SIZE:
-                logger.warning(f"Frame incompleto: {len(frame_data)}/{FRAME_SIZE} bytes")
-                return None
-            
-            # Parsear sample_idx (primeros 4 bytes, little-endian)
-            sample_idx = struct.unpack('<I', frame_data[0:4])[0]
-            
-            # Parsear canales (siguientes 4*4 bytes, little-endian, int32)
-            raw_channels = struct.unpack('<4i', frame_data[4:20])
-            
-            # Convertir a voltaje
-            voltages = [raw * LSB for raw in raw_channels]
-            
+            while not self._samples:
+                pkt = self.read_packet()
+                if pkt is None:
+                    return None
+                self._samples.extend(self._decode_samples(pkt, self.rice))
+
             self.sample_count += 1
-            
-            return sample_idx, voltages
-            
-        except struct.error as e:
+            return self._samples.pop(0)
+
+        except ValueError as e:
             logger.error(f"Error al parsear frame: {e}")
             return None
         except Exception as e:
             logger.error(f"Error inesperado en read_frame: {e}")
             return None
     
+    def read_block(self, min_samples: int = 1, with_times: bool = False) -> Optional[tuple]:
+        """
+        Lee hasta tener al menos min_samples muestras y las devuelve todas.
+
+        Args:
+            with_times: añade la hora de adquisición (DRDY) de cada muestra en
+                el reloj del host, para programar eventos (MIDI) sobre ella y
+                no sobre la hora de llegada
+
+        Returns:
+            (sample_idx uint32 (n,), voltages float32 (n, n_ch)), listas para
+            DSPCore (voltages[:, ch] es la señal de un canal), más t_host
+            float64 (n,) en s de time.perf_counter() con with_times (NaN hasta
+            sincronizar el reloj). None si hay timeout sin ninguna muestra.
+        """
+        if not self.serial_conn or not self.serial_conn.is_open:
+            logger.error("Puerto serial no conectado")
+            return None
+        if self.native is None:
+            frames = []
+            while len(frames) < min_samples:
+                frame = self.read_frame()
+                if frame is None:
+                    break
+                frames.append(frame)
+            if not frames:
+                return None
+            idx = np.array([f[0] for f in frames], dtype=np.uint32)
+            volts = np.array([f[1] for f in frames], dtype=np.float32)
+            if with_times:
+                return idx, volts, np.array([self.clock.sample_time(f[0]) for f in frames])
+            return idx, volts
+
+        dec = self.native
+        self._native_path = True
+        # En POSIX el fd se lee desde C++ sin el GIL; en Windows, vía pyserial
+        try:
+            fd = self.serial_conn.fileno() if os.name != "nt" else None
+        except (AttributeError, OSError, ValueError):
+            fd = None
+        while dec.pending < min_samples:
+            self._maybe_ping()
+            if fd is not None:
+                got = dec.read_fd(fd, int(self.timeout * 1000))
+            else:
+                waiting = getattr(self.serial_conn, "in_waiting", 0) or 0
+                data = self.serial_conn.read(max(1, waiting))
+                got = len(data)
+                self._pending_t = time.perf_counter()
+                dec.feed(data, self._pending_t)
+            if fd is not None:
+                self._pending_t = time.perf_counter()
+            for pkt_type, seq, payload in dec.packets():
+                self._handle_control(Packet(pkt_type, seq, payload))
+            if not got:
+                logger.warning("Timeout esperando paquete")
+                break
+        if dec.pending == 0:
+            return None
+        if with_times:
+            idx, volts, _, t_host = dec.take(float32=True, scale=LSB, times=True)
+        else:
+            idx, volts, _ = dec.take(float32=True, scale=LSB)
+        self.sample_count += len(idx)
+        if with_times:
+            return np.asarray(idx), np.asarray(volts), np.asarray(t_host)
+        return np.asarray(idx), np.asarray(volts)
+
+    # ---- Reloj del firmware ----
+
+    def _maybe_ping(self):
+        """Manda un CMD_TIME_PING si toca (sin esperar: el PONG llega con los datos)."""
+        if not self.clock_sync_interval:
+            return
+        now = time.perf_counter()
+        if now - self._last_ping < self.clock_sync_interval:
+            return
+        self._last_ping = now
+        seq, self._cmd_seq = self._cmd_seq, (self._cmd_seq + 1) & 0xFF
+        # El token es la hora de envío: se toma justo antes de escribir
+        token = ClockSync.token(time.perf_counter())
+        self.serial_conn.write(build_command_packet(seq, CMD_TIME_PING, struct.pack("<I", token)))
+
+    def clock_stats(self) -> dict:
+        """Estado de la sincronización: offset, deriva (ppm), RTT del último ping..."""
+        return self.native.clock_stats() if self._native_path else self.clock.stats()
+
+    def host_time(self, t_dev_us: int) -> float:
+        """micros() del firmware (TIMING, PONG) -> s de time.perf_counter(); NaN sin sincronizar."""
+        return self.native.host_time(t_dev_us) if self._native_path else self.clock.host_time(t_dev_us)
+
+    # ---- Plano de control ----
+
+    def _receive_control(self):
+        """Lee lo disponible y trata los ACK; el resto de paquetes queda en cola."""
+        waiting = getattr(self.serial_conn, "in_waiting", 0) or 0
+        data = self.serial_conn.read(max(1, waiting))
+        if not data:
+            return
+        self._pending_t = time.perf_counter()
+        if self._native_path:
+            # Las muestras se quedan en el decodificador para read_block()
+            self.native.feed(data)
+            for pkt_type, seq, payload in self.native.packets():
+                self._handle_control(Packet(pkt_type, seq, payload))
+            return
+        for pkt in self.parser.feed(data):
+            # El PONG también ahora: su hora de llegada es _pending_t
+            if pkt.type in (PKT_ACK, PKT_PONG):
+                self._handle_control(pkt)
+            else:
+                self._pending.append(pkt)
+
+    def send_command(self, cmd: int, args: bytes = b"", timeout: float = 1.0) -> Optional[AckRecord]:
+        """
+        Envía un PKT_CMD y espera su PKT_ACK. Los datos que lleguen mientras
+        tanto no se pierden: los entregan después read_frame()/read_block().
+
+        Returns:
+            AckRecord (ack.ok indica si se aplicó) o None si hay timeout
+        """
+        if not self.serial_conn or not self.serial_conn.is_open:
+            logger.error("Puerto serial no conectado")
+            return None
+        seq, self._cmd_seq = self._cmd_seq, (self._cmd_seq + 1) & 0xFF
+        self._acks.pop(seq, None)
+        self.serial_conn.write(build_command_packet(seq, cmd, args))
+        deadline = time.monotonic() + timeout
+        read_timeout = self.serial_conn.timeout
+        try:
+            while True:
+                ack = self._acks.get(seq)
+                if ack is not None and ack.cmd == cmd:
+                    return self._acks.pop(seq)
+                left = deadline - time.monotonic()
+                if left <= 0:
+                    break
+                # La lectura no se pasa del plazo del comando
+                self.serial_conn.timeout = min(left, read_timeout) if read_timeout else left
+                self._receive_control()
+        finally:
+            self.serial_conn.timeout = read_timeout
+        logger.warning(f"Sin ACK para el comando 0x{cmd:02X}")
+        return None
+
+    def ping(self) -> Optional[AckRecord]:
+        """Configuración vigente del firmware, sin cambiar nada."""
+        return self.send_command(CMD_PING)
+
+    def start(self) -> Optional[AckRecord]:
+        return self.send_command(CMD_START)
+
+    def stop(self) -> Optional[AckRecord]:
+        return self.send_command(CMD_STOP)
+
+    def set_rate(self, sps: int) -> Optional[AckRecord]:
+        """Frecuencia de salida (OUTPUT_SPS·2^k del firmware)."""
+        return self.send_command(CMD_SET_RATE, struct.pack("<H", sps))
+
+    def set_mode(self, mode: int) -> Optional[AckRecord]:
+        """Formato del flujo: PKT_SAMPLE, PKT_BATCH, PKT_RICE o PKT_FEATURES."""
+        return self.send_command(CMD_SET_MODE, bytes([mode]))
+
+    def set_batch(self, n_samples: int) -> Optional[AckRecord]:
+        return self.send_command(CMD_SET_BATCH, bytes([n_samples]))
+
+    def set_filter(self, filter_set: int) -> Optional[AckRecord]:
+        """Juego de filtros del firmware (FILTER_* de eeg_protocol)."""
+        return self.send_command(CMD_SET_FILTER, bytes([filter_set]))
+
+    def set_channels(self, channels: Union[int, Iterable[int]]) -> Optional[AckRecord]:
+        """Canales activos: máscara (bit i = canal i) o lista de índices."""
+        mask = channels if isinstance(channels, int) else sum(1 << c for c in set(channels))
+        return self.send_command(CMD_SET_CHANNELS, struct.pack("<I", mask))
+
+    def set_transport(self, spi: bool) -> Optional[AckRecord]:
+        """Flujo por SPI al MCU DSP (True) o por Serial. El ACK sale ya por el nuevo."""
+        return self.send_command(CMD_SET_TRANSPORT, bytes([1 if spi else 0]))
+
+    def set_store(self, mode: int) -> Optional[AckRecord]:
+        """
+        Flash store-and-forward del firmware: STORE_SPILL (solo con el enlace
+        atascado), STORE_RECORD (todo a la flash, nada en vivo; volver a
+        SPILL u OFF lo descarga por on_backfill) o STORE_OFF.
+        """
+        return self.send_command(CMD_SET_STORE, bytes([mode]))
+
+    def upload_midi_table(self, table: MidiTable) -> Optional[AckRecord]:
+        return self.send_command(CMD_MIDI_TABLE, table.to_bytes())
+
+    def set_baud(self, baud: int, confirm_timeout: float = 2.0) -> Optional[AckRecord]:
+        """
+        Cambia el baud rate del enlace: el firmware responde al baud actual y
+        cambia; aquí se cambia también y se manda PING hasta que responde,
+        lo que lo confirma. Si no responde en confirm_timeout (BAUD_CONFIRM_MS
+        del firmware) los dos vuelven al baud anterior.
+
+        Returns:
+            AckRecord del PING al baud nuevo, o None si no se pudo cambiar
+        """
+        ack = self.send_command(CMD_SET_BAUD, struct.pack("<I", baud))
+        if ack is None or not ack.ok:
+            return None
+        old = self.serial_conn.baudrate
+        t0 = time.monotonic()
+        self.serial_conn.baudrate = baud
+        while time.monotonic() - t0 < 0.8 * confirm_timeout:
+            ack = self.send_command(CMD_PING, timeout=0.1)
+            if ack is not None and ack.baud == baud:
+                self.baudrate = baud
+                return ack
+        # El firmware vuelve solo al anterior tras confirm_timeout
+        self.serial_conn.baudrate = old
+        time.sleep(max(0.0, confirm_timeout - (time.monotonic() - t0)) + 0.1)
+        logger.warning(f"Baud rate {baud} sin confirmar: se sigue a {old}")
+        return None
+
     def read_multiple_frames(self, num_frames: int) -> list:
         """
         Lee múltiples frames consecutivos.
@@ -0,0 +1,1117 @@
+"""
+EEG Protocol Module - Framing binario del flujo Arduino <-> host
+Define el formato de paquete (sync, tipo, secuencia, longitud, CRC-16), un
+parser incremental que resincroniza tras bytes perdidos o corruptos, los
+comandos del plano de control (PKT_CMD / PKT_ACK), la sincronización del
+reloj del firmware con el del host (ClockSync, PKT_PONG) y el reensamblado
+de lo que el firmware guardó en su flash con el enlace atascado
+(StoredStream, PKT_STORED).
+
+Formato (little-endian), ver docs/protocol.md:
+    [0xA5 0x5A][type u8][seq u8][len u16][payload (len bytes)][crc16 u16]
+CRC-16/CCITT-FALSE sobre type..payload.
+"""
+
+import math
+import struct
+from dataclasses import dataclass, field
+from typing import Dict, List, Optional, Tuple
+
+SYNC = b"\xA5\x5A"
+HEADER_SIZE = 6
+CRC_SIZE = 2
+OVERHEAD = HEADER_SIZE + CRC_SIZE
+MAX_PAYLOAD = 1024
+
+# Tipos de paquete (EEGStream_Protocol.h)
+PKT_SAMPLE = 0x01
+PKT_BATCH = 0x02
+PKT_RICE = 0x03
+PKT_TIMING = 0x04
+PKT_STATS = 0x05
+PKT_FEATURES = 0x06
+PKT_SAMPLE_MASKED = 0x07
+PKT_STATUS = 0x08
+PKT_STORED = 0x09
+PKT_GAP = 0x0A
+PKT_CMD = 0x10
+PKT_ACK = 0x11
+PKT_PONG = 0x12
+PKT_DIAG = 0x7F
+
+# Comandos host -> Arduino (payload de PKT_CMD: [cmd u8][argumentos])
+CMD_PING = 0x01
+CMD_START = 0x02
+CMD_STOP = 0x03
+CMD_SET_RATE = 0x04       # u16 sps de salida
+CMD_SET_MODE = 0x05       # u8 PKT_SAMPLE / PKT_BATCH / PKT_RICE / PKT_FEATURES
+CMD_SET_BATCH = 0x06      # u8 muestras por lote
+CMD_SET_FILTER = 0x07     # u8 juego de filtros (EEGDsp_FilterSet, FILTER_*)
+CMD_SET_CHANNELS = 0x08   # u32 máscara de canales activos
+CMD_SET_BAUD = 0x09       # u32 baud rate
+CMD_SET_TRANSPORT = 0x0A  # u8 0 = Serial, 1 = SPI al MCU DSP
+CMD_MIDI_TABLE = 0x0B     # MidiTable.to_bytes()
+CMD_TIME_PING = 0x0C      # u32 token -> PKT_PONG (sin ACK)
+CMD_SET_STORE = 0x0D      # u8 STORE_OFF / STORE_SPILL / STORE_RECORD
+
+# Modos de la flash store-and-forward (CMD_SET_STORE)
+STORE_OFF, STORE_SPILL, STORE_RECORD = range(3)
+
+# Juegos de filtros del firmware (EEGDsp_FilterSet)
+FILTER_NONE, FILTER_NOTCH50, FILTER_NOTCH60, FILTER_EEG_BAND, FILTER_NOTCH50_BAND, FILTER_NOTCH60_BAND = range(6)
+
+# Estado de PKT_ACK
+ACK_OK = 0
+ACK_UNKNOWN = 1
+ACK_BAD_ARGS = 2
+ACK_UNSUPPORTED = 3
+ACK_DEVICE = 4
+ACK_NAMES = {ACK_OK: "ok", ACK_UNKNOWN: "comando desconocido", ACK_BAD_ARGS: "argumentos no válidos",
+             ACK_UNSUPPORTED: "no disponible en esta placa", ACK_DEVICE: "error del ADS1299"}
+
+# Payload ACK: cmd, cmd_seq, status u8, sample_idx u32, sps u16, mode, batch,
+# filter, transport, acquiring u8, ch_mask u32, baud u32
+ACK_PAYLOAD_SIZE = 22
+
+# Payload PONG: cmd_seq u8, token u32, t_rx_us u32, t_tx_us u32
+PONG_PAYLOAD_SIZE = 13
+
+# Cabecera del payload BATCH: base_idx u32, n_samples u8, n_ch u8, n_status u8
+BATCH_HEADER_SIZE = 7
+# Bit de n_ch en BATCH, RICE y FEATURES: tras la cabecera fija va un u32 con
+# la máscara de canales activos y el payload lleva solo esos (n_ch & 0x7F
+# sigue siendo el total de columnas). Sin él van todos, como siempre.
+CH_MASKED = 0x80
+CH_MASK_SIZE = 4
+# Cabecera RICE: la de BATCH + flags u8 + chain u8
+RICE_HEADER_SIZE = 9
+
+# Payload TIMING: sample_idx u32, t_drdy_us u32, t_tx_us u32
+TIMING_PAYLOAD_SIZE = 12
+
+# Payload STATS: sample_idx + 4 contadores u32 + loop_max_us u16 + ring_hwm u8 + ring_size u8
+STATS_PAYLOAD_SIZE = 24
+
+# Cabecera STATUS: sample_idx u32, flags u8, n_status u8 (+ n_status × 3 B)
+STATUS_HEADER_SIZE = 6
+STATUS_CHANGED = 0x01  # flags: 0 = estado inicial o repetición periódica
+
+# Cabecera STORED: offset u32, remaining u32 (+ bytes del flujo guardado)
+STORED_HEADER_SIZE = 8
+
+# Payload GAP: first_idx u32, n_samples u32, recovery_us u32, attempts u8, flags u8
+GAP_PAYLOAD_SIZE = 14
+GAP_RESTORED = 0x01  # flags: hizo falta RESET y reescribir los registros
+GAP_FAILED = 0x02    # flags: algún intento no verificó los registros
+
+# Cabecera FEATURES: sample_idx u32, n_ch u8, n_bands u8, window u16
+FEATURES_HEADER_SIZE = 8
+# Bandas de PKT_FEATURES, en orden (mismos límites que DSPCore.bands)
+BAND_NAMES = ("delta", "theta", "alpha", "beta", "gamma")
+# LSB del ADS1299 (ganancia 24, Vref 4.5 V), en voltios
+ADS1299_LSB_V = 2.235e-8
+
+# Parámetros del codificador Rice (EEGStream_Rice.h)
+RICE_QMAX = 16
+RICE_ESCBITS = 25
+RICE_RESET = 32
+RICE_A_INIT = 64
+
+
+def _make_crc_table() -> List[int]:
+    table = []
+    for i in range(256):
+        crc = i << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if (crc & 0x8000) else (crc << 1)
+        table.append(crc & 0xFFFF)
+    return table
+
+
+_CRC_TABLE = _make_crc_table()
+
+
+def crc16_ccitt(data: bytes, crc: int = 0xFFFF) -> int:
+    """CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), igual que el firmware."""
+    for b in data:
+        crc = ((crc << 8) & 0xFFFF) ^ _CRC_TABLE[((crc >> 8) ^ b) & 0xFF]
+    return crc
+
+
+def build_packet(pkt_type: int, seq: int, payload: bytes) -> bytes:
+    """Construye un paquete completo (útil para tests y fuentes simuladas)."""
+    if len(payload) > MAX_PAYLOAD:
+        raise ValueError(f"Payload demasiado largo: {len(payload)} bytes")
+    body = struct.pack("<BBH", pkt_type & 0xFF, seq & 0xFF, len(payload)) + payload
+    return SYNC + body + struct.pack("<H", crc16_ccitt(body))
+
+
+def all_channels(n_columns: int) -> int:
+    """Máscara con los n_columns canales activos."""
+    return (1 << n_columns) - 1
+
+
+def mask_channels(ch_mask: int) -> List[int]:
+    """Columnas de los canales activos de la máscara, en orden de la cadena."""
+    return [c for c in range(32) if ch_mask >> c & 1]
+
+
+def expand_channels(values, ch_mask: Optional[int], n_columns: int, fill=0) -> list:
+    """Canales activos compactos -> n_columns columnas (fill en los apagados)."""
+    if ch_mask is None:
+        return list(values)
+    row = [fill] * n_columns
+    for c, v in zip(mask_channels(ch_mask), values):
+        row[c] = v
+    return row
+
+
+def _masked(ch_mask: Optional[int], n_columns: int) -> bool:
+    if ch_mask is None or ch_mask == all_channels(n_columns):
+        return False
+    if ch_mask == 0 or ch_mask >> n_columns:
+        raise ValueError(f"Máscara 0x{ch_mask:X} no válida para {n_columns} canales")
+    return True
+
+
+def build_sample_packet(seq: int, sample_idx: int, raw_channels: List[int],
+                        ch_mask: Optional[int] = None, n_columns: Optional[int] = None) -> bytes:
+    """
+    Paquete PKT_SAMPLE: [uint32 sample_idx][int32 x N canales]. Con ch_mask
+    (y no todos activos) PKT_SAMPLE_MASKED con raw_channels = los activos.
+    """
+    if n_columns is None:
+        n_columns = ch_mask.bit_length() if ch_mask is not None else len(raw_channels)
+    if not _masked(ch_mask, n_columns):
+        payload = struct.pack(f"<I{len(raw_channels)}i", sample_idx, *raw_channels)
+        return build_packet(PKT_SAMPLE, seq, payload)
+    payload = struct.pack(f"<IBI{len(raw_channels)}i", sample_idx, n_columns, ch_mask, *raw_channels)
+    return build_packet(PKT_SAMPLE_MASKED, seq, payload)
+
+
+def parse_sample_payload(payload: bytes) -> Tuple[int, Tuple[int, ...]]:
+    """Decodifica un payload PKT_SAMPLE -> (sample_idx, canales crudos)."""
+    n_ch = (len(payload) - 4) // 4
+    if n_ch < 1 or len(payload) != 4 + 4 * n_ch:
+        raise ValueError(f"Payload SAMPLE inválido: {len(payload)} bytes")
+    sample_idx = struct.unpack_from("<I", payload, 0)[0]
+    channels = struct.unpack_from(f"<{n_ch}i", payload, 4)
+    return sample_idx, channels
+
+
+def parse_sample_masked_payload(payload: bytes) -> Tuple[int, int, int, Tuple[int, ...]]:
+    """
+    Decodifica un payload PKT_SAMPLE_MASKED -> (sample_idx, n_columns,
+    ch_mask, canales activos crudos en orden de la cadena).
+    """
+    if len(payload) < 9:
+        raise ValueError(f"Payload SAMPLE_MASKED demasiado corto: {len(payload)} bytes")
+    sample_idx, n_columns, ch_mask = struct.unpack_from("<IBI", payload, 0)
+    n_act = bin(ch_mask).count("1")
+    if n_act < 1 or ch_mask >> n_columns or len(payload) != 9 + 4 * n_act:
+        raise ValueError(f"Payload SAMPLE_MASKED inválido: {len(payload)} bytes")
+    return sample_idx, n_columns, ch_mask, struct.unpack_from(f"<{n_act}i", payload, 9)
+
+
+def unpack24_be(b: bytes, offset: int = 0) -> int:
+    """3 bytes MSB-first con signo (24 bits) -> int, igual que ADS1299Plus::unpack24."""
+    u = (b[offset] << 16) | (b[offset + 1] << 8) | b[offset + 2]
+    return u - 0x1000000 if u & 0x800000 else u
+
+
+def pack24_be(v: int) -> bytes:
+    """int con signo de 24 bits -> 3 bytes MSB-first."""
+    return (v & 0xFFFFFF).to_bytes(3, "big")
+
+
+@dataclass
+class StatusEvent:
+    """
+    Evento PKT_STATUS: STATUS de cada ADS1299 (9.4.4.2) desde sample_idx.
+    Solo llegan los bits de lead-off de los canales activos y los GPIO.
+    """
+    sample_idx: int              # primera muestra con este estado
+    changed: bool                # False: estado inicial o repetición
+    status: Tuple[int, ...]      # 24 bits por dispositivo, en orden de la cadena
+
+    def loff_p(self, dev: int = 0) -> int:
+        """LOFF_STATP del dispositivo: bit i = canal i con lead-off en INiP."""
+        return (self.status[dev] >> 12) & 0xFF
+
+    def loff_n(self, dev: int = 0) -> int:
+        """LOFF_STATN del dispositivo (bit i = canal i en INiN)."""
+        return (self.status[dev] >> 4) & 0xFF
+
+    def gpio(self, dev: int = 0) -> int:
+        """GPIO4..1 del dispositivo."""
+        return self.status[dev] & 0x0F
+
+    def lead_off_channels(self, channels_per_device: int) -> List[int]:
+        """Canales de la cadena (d·N + i) con lead-off en P o en N."""
+        return [d * channels_per_device + i for d in range(len(self.status))
+                for i in range(channels_per_device) if (self.loff_p(d) | self.loff_n(d)) >> i & 1]
+
+
+def parse_status_payload(payload: bytes) -> StatusEvent:
+    """Decodifica un payload PKT_STATUS."""
+    if len(payload) < STATUS_HEADER_SIZE:
+        raise ValueError(f"Payload STATUS demasiado corto: {len(payload)} bytes")
+    sample_idx, flags, n_status = struct.unpack_from("<IBB", payload, 0)
+    if len(payload) != STATUS_HEADER_SIZE + 3 * n_status:
+        raise ValueError(f"Payload STATUS inválido: {len(payload)} bytes para {n_status} palabras")
+    status = tuple(int.from_bytes(payload[STATUS_HEADER_SIZE + 3 * k:STATUS_HEADER_SIZE + 3 * k + 3], "big")
+                   for k in range(n_status))
+    return StatusEvent(sample_idx, bool(flags & STATUS_CHANGED), status)
+
+
+def build_status_packet(seq: int, ev: StatusEvent) -> bytes:
+    """Paquete PKT_STATUS (útil para tests y fuentes simuladas)."""
+    payload = struct.pack("<IBB", ev.sample_idx & 0xFFFFFFFF, STATUS_CHANGED if ev.changed else 0,
+                          len(ev.status))
+    payload += b"".join((st & 0xFFFFFF).to_bytes(3, "big") for st in ev.status)
+    return build_packet(PKT_STATUS, seq, payload)
+
+
+@dataclass
+class TimingRecord:
+    """Marcas de tiempo de una muestra, en micros() del firmware (uint32 con wrap)."""
+    sample_idx: int
+    t_drdy_us: int   # flanco de DRDY
+    t_tx_us: int     # paquete de datos que la contiene escrito en el transporte
+
+    @property
+    def firmware_latency_us(self) -> int:
+        """DRDY -> transporte (incluye la espera del lote), robusto al wrap."""
+        return (self.t_tx_us - self.t_drdy_us) & 0xFFFFFFFF
+
+
+def parse_timing_payload(payload: bytes) -> TimingRecord:
+    """Decodifica un payload PKT_TIMING."""
+    if len(payload) != TIMING_PAYLOAD_SIZE:
+        raise ValueError(f"Payload TIMING inválido: {len(payload)} bytes")
+    return TimingRecord(*struct.unpack("<III", payload))
+
+
+def build_timing_packet(seq: int, sample_idx: int, t_drdy_us: int, t_tx_us: int) -> bytes:
+    """Paquete PKT_TIMING (útil para tests y fuentes simuladas)."""
+    payload = struct.pack("<III", sample_idx & 0xFFFFFFFF, t_drdy_us & 0xFFFFFFFF, t_tx_us & 0xFFFFFFFF)
+    return build_packet(PKT_TIMING, seq, payload)
+
+
+@dataclass
+class StatsRecord:
+    """Contadores de salud del firmware (totales con wrap de uint32 y máximos de ventana)."""
+    sample_idx: int
+    sync_errors: int
+    drdy_missed: int
+    ring_overruns: int
+    tx_dropped: int
+    loop_max_us: int
+    ring_hwm: int
+    ring_size: int
+
+    # Contadores de pérdida: si crecen entre dos STATS se han perdido muestras
+    LOSS_FIELDS = ("sync_errors", "drdy_missed", "ring_overruns", "tx_dropped")
+
+    def delta(self, prev: "StatsRecord") -> dict:
+        """Incremento de cada contador total respecto a un STATS anterior."""
+        names = ("sample_idx", "sync_errors", "drdy_missed", "ring_overruns", "tx_dropped")
+        return {n: (getattr(self, n) - getattr(prev, n)) & 0xFFFFFFFF for n in names}
+
+
+def parse_stats_payload(payload: bytes) -> StatsRecord:
+    """Decodifica un payload PKT_STATS."""
+    if len(payload) != STATS_PAYLOAD_SIZE:
+        raise ValueError(f"Payload STATS inválido: {len(payload)} bytes")
+    return StatsRecord(*struct.unpack("<IIIIIHBB", payload))
+
+
+def build_stats_packet(seq: int, st: StatsRecord) -> bytes:
+    """Paquete PKT_STATS (útil para tests y fuentes simuladas)."""
+    payload = struct.pack("<IIIIIHBB", st.sample_idx, st.sync_errors, st.drdy_missed,
+                          st.ring_overruns, st.tx_dropped, st.loop_max_us, st.ring_hwm, st.ring_size)
+    return build_packet(PKT_STATS, seq, payload)
+
+
+@dataclass
+class FeatureRecord:
+    """Potencia por banda de cada canal (PKT_FEATURES), en LSB² del ADC."""
+    sample_idx: int          # última muestra de la ventana
+    window: int              # nº de muestras de la ventana
+    powers: List[List[int]]  # powers[canal activo][banda], bandas en BAND_NAMES
+    ch_mask: Optional[int] = None  # canales activos (None: todos)
+    n_columns: int = 0             # canales de la cadena (0: len(powers))
+
+    def channel_indices(self) -> List[int]:
+        """Columna de cada fila de powers."""
+        return mask_channels(self.ch_mask) if self.ch_mask is not None else list(range(len(self.powers)))
+
+    SATURATED = 0xFFFFFFFF
+
+    def band_power_v2(self, lsb_v: float = ADS1299_LSB_V) -> List[Dict[str, float]]:
+        """Potencia en V² por canal y banda (la escala de DSPCore.compute_bandpower)."""
+        k = lsb_v * lsb_v
+        return [{BAND_NAMES[b]: p * k for b, p in enumerate(row)} for row in self.powers]
+
+
+def parse_features_payload(payload: bytes) -> FeatureRecord:
+    """Decodifica un payload PKT_FEATURES."""
+    if len(payload) < FEATURES_HEADER_SIZE:
+        raise ValueError(f"Payload FEATURES demasiado corto: {len(payload)} bytes")
+    sample_idx, n_ch, n_bands, window = struct.unpack_from("<IBBH", payload, 0)
+    n_columns, ch_mask, pos = _parse_ch_mask(payload, n_ch, FEATURES_HEADER_SIZE)
+    n_act = len(mask_channels(ch_mask)) if ch_mask is not None else n_columns
+    if len(payload) != pos + 4 * n_act * n_bands:
+        raise ValueError(f"Payload FEATURES inválido: {len(payload)} bytes para {n_act}x{n_bands}")
+    flat = struct.unpack_from(f"<{n_act * n_bands}I", payload, pos)
+    powers = [list(flat[c * n_bands:(c + 1) * n_bands]) for c in range(n_act)]
+    return FeatureRecord(sample_idx, window, powers, ch_mask, n_columns)
+
+
+def _parse_ch_mask(payload: bytes, n_ch: int, pos: int) -> Tuple[int, Optional[int], int]:
+    """n_ch de la cabecera -> (n_columns, ch_mask o None, posición tras la máscara)."""
+    if not n_ch & CH_MASKED:
+        return n_ch, None, pos
+    n_columns = n_ch & ~CH_MASKED
+    if len(payload) < pos + CH_MASK_SIZE:
+        raise ValueError(f"Payload demasiado corto para la máscara: {len(payload)} bytes")
+    ch_mask = struct.unpack_from("<I", payload, pos)[0]
+    if ch_mask == 0 or ch_mask >> n_columns:
+        raise ValueError(f"Máscara 0x{ch_mask:X} no válida para {n_columns} canales")
+    return n_columns, ch_mask, pos + CH_MASK_SIZE
+
+
+def _pack_ch_mask(ch_mask: Optional[int], n_columns: int) -> Tuple[int, bytes]:
+    """Inverso de _parse_ch_mask: (byte n_ch, máscara a añadir tras la cabecera)."""
+    if not _masked(ch_mask, n_columns):
+        return n_columns, b""
+    return n_columns | CH_MASKED, struct.pack("<I", ch_mask)
+
+
+def build_features_packet(seq: int, rec: FeatureRecord) -> bytes:
+    """Paquete PKT_FEATURES (útil para tests y fuentes simuladas)."""
+    n_bands = len(rec.powers[0]) if rec.powers else 0
+    n_ch, mask = _pack_ch_mask(rec.ch_mask, rec.n_columns or len(rec.powers))
+    payload = struct.pack("<IBBH", rec.sample_idx & 0xFFFFFFFF, n_ch, n_bands, rec.window) + mask
+    payload += b"".join(struct.pack(f"<{n_bands}I", *row) for row in rec.powers)
+    return build_packet(PKT_FEATURES, seq, payload)
+
+
+def build_command_packet(seq: int, cmd: int, args: bytes = b"") -> bytes:
+    """Paquete PKT_CMD (plano de control, host -> Arduino)."""
+    return build_packet(PKT_CMD, seq, bytes([cmd]) + args)
+
+
+@dataclass
+class AckRecord:
+    """Respuesta del firmware a un PKT_CMD, con la configuración vigente tras aplicarlo."""
+    cmd: int
+    cmd_seq: int
+    status: int
+    sample_idx: int   # primera muestra de salida con la configuración nueva
+    sps: int
+    mode: int         # tipo de paquete de datos (PKT_SAMPLE/BATCH/RICE/FEATURES)
+    batch: int
+    filter: int
+    transport: int    # 0 = Serial, 1 = SPI
+    acquiring: bool
+    ch_mask: int
+    baud: int
+
+    @property
+    def ok(self) -> bool:
+        return self.status == ACK_OK
+
+    @property
+    def channels(self) -> List[int]:
+        """Índices de los canales activos según ch_mask."""
+        return [c for c in range(32) if self.ch_mask >> c & 1]
+
+
+def parse_ack_payload(payload: bytes) -> AckRecord:
+    """Decodifica un payload PKT_ACK."""
+    if len(payload) != ACK_PAYLOAD_SIZE:
+        raise ValueError(f"Payload ACK inválido: {len(payload)} bytes")
+    f = struct.unpack("<BBBIHBBBBBII", payload)
+    return AckRecord(*f[:9], bool(f[9]), *f[10:])
+
+
+def build_ack_packet(seq: int, ack: AckRecord) -> bytes:
+    """Paquete PKT_ACK (útil para tests y fuentes simuladas)."""
+    payload = struct.pack("<BBBIHBBBBBII", ack.cmd, ack.cmd_seq, ack.status, ack.sample_idx & 0xFFFFFFFF,
+                          ack.sps, ack.mode, ack.batch, ack.filter, ack.transport, int(ack.acquiring),
+                          ack.ch_mask, ack.baud)
+    return build_packet(PKT_ACK, seq, payload)
+
+
+@dataclass
+class PongRecord:
+    """Respuesta a CMD_TIME_PING, con micros() del firmware (uint32 con wrap)."""
+    cmd_seq: int
+    token: int     # el del ping (ClockSync.token: µs del host al enviarlo)
+    t_rx_us: int   # comando recibido
+    t_tx_us: int   # respuesta encolada
+
+    @property
+    def turnaround_us(self) -> int:
+        """Tiempo dentro del firmware, robusto al wrap."""
+        return (self.t_tx_us - self.t_rx_us) & 0xFFFFFFFF
+
+
+def parse_pong_payload(payload: bytes) -> PongRecord:
+    """Decodifica un payload PKT_PONG."""
+    if len(payload) != PONG_PAYLOAD_SIZE:
+        raise ValueError(f"Payload PONG inválido: {len(payload)} bytes")
+    return PongRecord(*struct.unpack("<BIII", payload))
+
+
+def build_pong_packet(seq: int, pong: PongRecord) -> bytes:
+    """Paquete PKT_PONG (útil para tests y fuentes simuladas)."""
+    payload = struct.pack("<BIII", pong.cmd_seq, pong.token & 0xFFFFFFFF, pong.t_rx_us & 0xFFFFFFFF,
+                          pong.t_tx_us & 0xFFFFFFFF)
+    return build_packet(PKT_PONG, seq, payload)
+
+
+@dataclass
+class StoredChunk:
+    """Tramo del flujo guardado en la flash del firmware (PKT_STORED)."""
+    offset: int     # posición del primer byte en el flujo guardado (u32 con wrap)
+    remaining: int  # bytes que siguen guardados tras este tramo
+    data: bytes     # paquetes completos troceados sin respetar fronteras
+
+
+def parse_stored_payload(payload: bytes) -> StoredChunk:
+    """Decodifica un payload PKT_STORED."""
+    if len(payload) < STORED_HEADER_SIZE:
+        raise ValueError(f"Payload STORED inválido: {len(payload)} bytes")
+    offset, remaining = struct.unpack_from("<II", payload)
+    return StoredChunk(offset, remaining, bytes(payload[STORED_HEADER_SIZE:]))
+
+
+def build_stored_packet(seq: int, chunk: StoredChunk) -> bytes:
+    """Paquete PKT_STORED (útil para tests y fuentes simuladas)."""
+    payload = struct.pack("<II", chunk.offset & 0xFFFFFFFF, chunk.remaining & 0xFFFFFFFF) + chunk.data
+    return build_packet(PKT_STORED, seq, payload)
+
+
+@dataclass
+class SyncGap:
+    """Hueco por pérdida de sincronía del ADS1299 y su recuperación (PKT_GAP)."""
+    first_idx: int    # primera muestra perdida
+    n_samples: int    # muestras perdidas desde first_idx (no existen)
+    recovery_us: int  # tiempo dentro de los ciclos SDATAC/RDATAC (o RESET)
+    attempts: int     # ciclos de recuperación hasta volver a tener sync
+    flags: int        # GAP_*
+
+    @property
+    def restored(self) -> bool:
+        """El firmware tuvo que reiniciar el ADS1299 y reescribir sus registros."""
+        return bool(self.flags & GAP_RESTORED)
+
+    @property
+    def failed(self) -> bool:
+        return bool(self.flags & GAP_FAILED)
+
+    @property
+    def end_idx(self) -> int:
+        """Primera muestra válida tras el hueco (u32 con wrap)."""
+        return (self.first_idx + self.n_samples) & 0xFFFFFFFF
+
+
+def parse_gap_payload(payload: bytes) -> SyncGap:
+    """Decodifica un payload PKT_GAP."""
+    if len(payload) != GAP_PAYLOAD_SIZE:
+        raise ValueError(f"Payload GAP inválido: {len(payload)} bytes")
+    return SyncGap(*struct.unpack("<IIIBB", payload))
+
+
+def build_gap_packet(seq: int, gap: SyncGap) -> bytes:
+    """Paquete PKT_GAP (útil para tests y fuentes simuladas)."""
+    payload = struct.pack("<IIIBB", gap.first_idx & 0xFFFFFFFF, gap.n_samples, gap.recovery_us,
+                          gap.attempts, gap.flags)
+    return build_packet(PKT_GAP, seq, payload)
+
+
+def _wrap_i32(v: int) -> int:
+    """Diferencia de dos uint32 con wrap, como entero con signo."""
+    return ((v + 0x80000000) & 0xFFFFFFFF) - 0x80000000
+
+
+class ClockSync:
+    """
+    Reloj del firmware (micros()) -> reloj del host (s de time.perf_counter()).
+
+    Cada PKT_PONG da una medida al estilo NTP con t1/t4 del host (envío del
+    ping y llegada del pong) y t2/t3 del firmware (t_rx_us/t_tx_us):
+        offset = (t1 + t4)/2 - (t2 + t3)/2     retardo = (t4 - t1) - (t3 - t2)
+    El offset supone ida y vuelta simétricas, así que solo se usan los pings
+    de menor retardo de la ventana (los demás esperaron en buffers); sobre
+    ellos se ajusta una recta offset(t_firmware) por mínimos cuadrados cuya
+    pendiente es la deriva del cristal del firmware.
+
+    Los PKT_TIMING anclan sample_idx al micros() de su DRDY; con el periodo
+    medido entre anclas, sample_time(idx) es la hora de adquisición de
+    cualquier muestra en el reloj del host. Misma lógica que la de
+    eeg_native.Decoder (clock_stats(), take(times=True)).
+    """
+
+    WINDOW = 32                # pings en la ventana
+    DELAY_SLACK = 0.5          # se usan los de retardo <= mínimo·(1 + slack) + DELAY_FLOOR
+    DELAY_FLOOR_S = 100e-6
+    MIN_SPAN_US = 1e6          # base temporal mínima para estimar la deriva
+    MAX_DRIFT = 0.01           # cota de la pendiente (resonadores cerámicos ~0.5 %)
+    PERIOD_TOLERANCE = 0.01    # cambio de periodo entre anclas: otra frecuencia de muestreo
+
+    def __init__(self):
+        self.reset()
+
+    def reset(self):
+        self._pings: List[Tuple[float, float, float]] = []  # (t_dev_us, offset_s, retardo_s)
+        self._last_us: Optional[int] = None   # último micros() desenrollado
+        self._a = math.nan                    # offset en t_dev = _ref
+        self._b = 0.0                         # deriva (s/s)
+        self._ref = 0.0
+        self.rtt_s = math.nan
+        self.pings = 0
+        self._base: Optional[Tuple[int, int]] = None    # (sample_idx, t_dev_us) de las anclas
+        self._anchor: Optional[Tuple[int, int]] = None
+        self._period_us: Optional[float] = None
+
+    @staticmethod
+    def token(t_host: float) -> int:
+        """Token de CMD_TIME_PING: µs del host al enviarlo (uint32)."""
+        return int(round(t_host * 1e6)) & 0xFFFFFFFF
+
+    def _unwrap(self, t_us: int) -> int:
+        """micros() a µs sin wrap, el más cercano a la última marca vista."""
+        if self._last_us is None:
+            self._last_us = t_us & 0xFFFFFFFF
+            return self._last_us
+        t = self._last_us + _wrap_i32(t_us - self._last_us)
+        self._last_us = max(self._last_us, t)
+        return t
+
+    def add_pong(self, pong: PongRecord, t_recv: float) -> float:
+        """Registra un PKT_PONG llegado en t_recv (s del host). Devuelve el RTT (s)."""
+        recv_us = int(round(t_recv * 1e6))
+        t_send = (recv_us - ((recv_us - pong.token) & 0xFFFFFFFF)) * 1e-6
+        t2 = self._unwrap(pong.t_rx_us)
+        t3 = t2 + pong.turnaround_us
+        self._unwrap(pong.t_tx_us)
+        dev_mid = (t2 + t3) / 2
+        self.rtt_s = t_recv - t_send
+        delay = self.rtt_s - (t3 - t2) * 1e-6
+        self._pings.append((dev_mid, (t_send + t_recv) / 2 - dev_mid * 1e-6, delay))
+        del self._pings[:-self.WINDOW]
+        self.pings += 1
+        self._fit()
+        return self.rtt_s
+
+    def _fit(self):
+        dmin = min(p[2] for p in self._pings)
+        sel = [p for p in self._pings if p[2] <= dmin * (1 + self.DELAY_SLACK) + self.DELAY_FLOOR_S]
+        n = len(sel)
+        ref = sum(p[0] for p in sel) / n
+        sxx = sum((p[0] - ref) ** 2 for p in sel)
+        span = max(p[0] for p in sel) - min(p[0] for p in sel)
+        if n >= 2 and span >= self.MIN_SPAN_US and sxx > 0:
+            b = sum((p[0] - ref) * p[1] for p in sel) / sxx * 1e6
+            self._b = max(-self.MAX_DRIFT, min(self.MAX_DRIFT, b))
+        # Con la pendiente fijada, el offset que mejor ajusta en ref
+        self._a = sum(p[1] - self._b * (p[0] - ref) * 1e-6 for p in sel) / n
+        self._ref = ref
+
+    @property
+    def synced(self) -> bool:
+        return not math.isnan(self._a)
+
+    def host_time(self, t_dev_us: int) -> float:
+        """micros() del firmware (cercano a los últimos vistos) -> s del host; NaN sin sincronizar."""
+        if not self.synced:
+            return math.nan
+        t = self._last_us + _wrap_i32(t_dev_us - self._last_us)
+        return self._host_from(t)
+
+    def _host_from(self, t: float) -> float:
+        return t * 1e-6 + self._a + self._b * (t - self._ref) * 1e-6
+
+    def add_timing(self, rec: TimingRecord):
+        """Ancla sample_idx -> micros() con un PKT_TIMING."""
+        t = self._unwrap(rec.t_drdy_us)
+        last = self._anchor
+        d_idx = _wrap_i32(rec.sample_idx - last[0]) if last else 0
+        if last is None or d_idx <= 0:
+            # Primera ancla, o sample_idx ha vuelto atrás (adquisición reiniciada)
+            self._base, self._period_us = (rec.sample_idx, t), None
+        else:
+            period = (t - last[1]) / d_idx
+            if self._period_us is None or abs(period - self._period_us) > self.PERIOD_TOLERANCE * self._period_us:
+                self._base, self._period_us = last, period
+            else:
+                self._period_us = (t - self._base[1]) / _wrap_i32(rec.sample_idx - self._base[0])
+        self._anchor = (rec.sample_idx, t)
+
+    def sample_time(self, sample_idx: int) -> float:
+        """Hora del host del DRDY de sample_idx; NaN sin sincronizar o sin dos PKT_TIMING."""
+        if not self.synced or self._period_us is None:
+            return math.nan
+        idx0, t0 = self._anchor
+        return self._host_from(t0 + _wrap_i32(sample_idx - idx0) * self._period_us)
+
+    def stats(self) -> dict:
+        """Estado del ajuste (mismas claves que eeg_native.Decoder.clock_stats())."""
+        return {
+            "synced": self.synced,
+            "offset_s": self._a,
+            "drift_ppm": self._b * 1e6,
+            "rtt_s": self.rtt_s,
+            "delay_min_s": min((p[2] for p in self._pings), default=math.nan),
+            "pings": self.pings,
+            "period_us": self._period_us if self._period_us is not None else math.nan,
+        }
+
+
+# Tabla de mapeo MIDI de la placa (EEGMidi_parseTable, ver docs/protocol.md)
+MIDI_TABLE_VERSION = 1
+MIDI_MAX_MAPS = 8
+MIDI_OFF, MIDI_CC, MIDI_NOTE = 0, 1, 2
+
+
+def power_log2_q3(uv_rms: float, lsb_v: float = ADS1299_LSB_V) -> int:
+    """Umbral lo/hi de la tabla MIDI para una amplitud en µV rms: 8·log2(P en LSB²)."""
+    p = (uv_rms * 1e-6 / lsb_v) ** 2
+    return max(0, min(255, round(8 * math.log2(p)))) if p > 0 else 0
+
+
+@dataclass
+class MidiMap:
+    """Una entrada: potencia de (eeg_ch, banda) → CC o nota en midi_ch (0..15)."""
+    eeg_ch: int
+    band: int
+    kind: int
+    midi_ch: int
+    number: int
+    velocity: int = 0
+    lo: int = 96
+    hi: int = 192
+
+
+@dataclass
+class MidiTable:
+    """Tabla de mapeo potencia por bandas → MIDI que se sube a la placa."""
+    root: int = 0            # clase de altura 0..11 (0 = Do)
+    scale: int = 0x0295      # bit i = semitono i (por defecto pentatónica mayor)
+    span: int = 10
+    maps: List[MidiMap] = field(default_factory=list)
+
+    @staticmethod
+    def scale_mask(intervals: List[int]) -> int:
+        """Máscara de 12 bits a partir de los semitonos (p.ej. SCALE_FAMILIES)."""
+        return sum(1 << (i % 12) for i in set(intervals))
+
+    def to_bytes(self) -> bytes:
+        if len(self.maps) > MIDI_MAX_MAPS:
+            raise ValueError(f"Tabla MIDI: como mucho {MIDI_MAX_MAPS} entradas")
+        out = struct.pack("<BBHBB", MIDI_TABLE_VERSION, self.root, self.scale, self.span,
+                          len(self.maps))
+        for m in self.maps:
+            out += struct.pack("<8B", m.eeg_ch, m.band, m.kind, m.midi_ch, m.number,
+                               m.velocity, m.lo, m.hi)
+        return out
+
+
+@dataclass
+class BatchBlock:
+    """Lote decodificado: muestras base_idx .. base_idx + len(channels) - 1."""
+    base_idx: int
+    status: List[Tuple[int, ...]]     # n_samples x n_status (24 bits crudos)
+    channels: List[Tuple[int, ...]]   # n_samples x canales activos (cuentas con signo)
+    ch_mask: Optional[int] = None     # canales activos (None: todos)
+    n_columns: int = 0                # canales de la cadena
+
+    def rows(self, fill=0) -> List[list]:
+        """channels expandido a n_columns columnas (fill en los apagados)."""
+        return [expand_channels(ch, self.ch_mask, self.n_columns, fill) for ch in self.channels]
+
+
+def parse_batch_payload(payload: bytes) -> BatchBlock:
+    """Decodifica un payload PKT_BATCH (canales en 24 bits MSB-first)."""
+    if len(payload) < BATCH_HEADER_SIZE:
+        raise ValueError(f"Payload BATCH demasiado corto: {len(payload)} bytes")
+    base_idx, n_samples, n_ch, n_status = struct.unpack_from("<IBBB", payload, 0)
+    n_columns, ch_mask, pos = _parse_ch_mask(payload, n_ch, BATCH_HEADER_SIZE)
+    n_ch = len(mask_channels(ch_mask)) if ch_mask is not None else n_columns
+    rec = 3 * (n_ch + n_status)
+    if n_ch < 1 or len(payload) != pos + n_samples * rec:
+        raise ValueError(f"Payload BATCH inválido: {len(payload)} bytes")
+
+    status: List[Tuple[int, ...]] = []
+    channels: List[Tuple[int, ...]] = []
+    for _ in range(n_samples):
+        status.append(tuple(
+            int.from_bytes(payload[pos + 3 * k:pos + 3 * k + 3], "big") for k in range(n_status)
+        ))
+        pos += 3 * n_status
+        channels.append(tuple(unpack24_be(payload, pos + 3 * c) for c in range(n_ch)))
+        pos += 3 * n_ch
+    return BatchBlock(base_idx, status, channels, ch_mask, n_columns)
+
+
+def build_batch_packet(
+    seq: int,
+    base_idx: int,
+    samples: List[List[int]],
+    status: Optional[List[List[int]]] = None,
+    ch_mask: Optional[int] = None,
+    n_columns: Optional[int] = None,
+) -> bytes:
+    """
+    Paquete PKT_BATCH con el mismo layout que EEGStream_Batcher. Con ch_mask
+    (y no todos activos) samples lleva solo los activos y n_columns es el
+    total de canales (por defecto, hasta el último activo).
+    """
+    n_ch = len(samples[0]) if samples else 0
+    n_status = len(status[0]) if status else 0
+    n_ch, mask = _pack_ch_mask(ch_mask, _columns(ch_mask, n_columns, n_ch))
+    payload = bytearray(struct.pack("<IBBB", base_idx, len(samples), n_ch, n_status) + mask)
+    for k, chans in enumerate(samples):
+        for st in (status[k] if status else []):
+            payload += (st & 0xFFFFFF).to_bytes(3, "big")
+        for v in chans:
+            payload += pack24_be(v)
+    return build_packet(PKT_BATCH, seq, bytes(payload))
+
+
+def _columns(ch_mask: Optional[int], n_columns: Optional[int], n_ch: int) -> int:
+    if n_columns is not None:
+        return n_columns
+    return ch_mask.bit_length() if ch_mask is not None else n_ch
+
+
+class _RiceStream:
+    """Estado por flujo del predictor + k adaptativo (EEGStream_RiceState)."""
+    __slots__ = ("h1", "h2", "a", "n")
+
+    def __init__(self):
+        self.h1 = 0
+        self.h2 = 0
+        self.a = RICE_A_INIT
+        self.n = 1
+
+    def predict(self, order: int) -> int:
+        if order == 1:
+            return self.h1
+        if order == 2:
+            return max(-0x800000, min(0x7FFFFF, 2 * self.h1 - self.h2))
+        return 0
+
+    def k(self) -> int:
+        k = 0
+        while k < 24 and (self.n << k) < self.a:
+            k += 1
+        return k
+
+    def update(self, u: int, x: int):
+        self.a += u
+        self.n += 1
+        if self.n >= RICE_RESET:
+            self.a >>= 1
+            self.n >>= 1
+        self.h2 = self.h1
+        self.h1 = x
+
+
+class _BitReader:
+    def __init__(self, data: bytes):
+        self._data = data
+        self._pos = 0  # en bits
+
+    def bit(self) -> int:
+        byte = self._pos >> 3
+        if byte >= len(self._data):
+            raise ValueError("Bitstream RICE truncado")
+        b = (self._data[byte] >> (7 - (self._pos & 7))) & 1
+        self._pos += 1
+        return b
+
+    def bits(self, n: int) -> int:
+        v = 0
+        for _ in range(n):
+            v = (v << 1) | self.bit()
+        return v
+
+
+class _BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self._acc = 0
+        self._n = 0
+
+    def bits(self, v: int, n: int):
+        for i in range(n - 1, -1, -1):
+            self._acc = (self._acc << 1) | ((v >> i) & 1)
+            self._n += 1
+            if self._n == 8:
+                self.out.append(self._acc)
+                self._acc = 0
+                self._n = 0
+
+    def flush(self) -> bytes:
+        if self._n:
+            self.out.append((self._acc << (8 - self._n)) & 0xFF)
+            self._acc = 0
+            self._n = 0
+        return bytes(self.out)
+
+
+def _to_s24(v: int) -> int:
+    v &= 0xFFFFFF
+    return v - 0x1000000 if v & 0x800000 else v
+
+
+class RiceDecoder:
+    """
+    Decodificador de paquetes PKT_RICE (referencia: EEGStream_RiceEncoder).
+    Mantiene el estado entre paquetes; si se pierde uno (salto en chain) los
+    siguientes se descartan hasta el próximo keyframe.
+    """
+
+    def __init__(self):
+        self._streams: List[_RiceStream] = []
+        self._chain: Optional[int] = None
+        self._mask: Optional[int] = None
+        self.packets_dropped = 0  # paquetes no decodificables (esperando keyframe)
+
+    def reset(self):
+        self._streams = []
+        self._chain = None
+        self._mask = None
+
+    def decode(self, payload: bytes) -> Optional[BatchBlock]:
+        """Payload PKT_RICE -> BatchBlock, o None si falta el keyframe."""
+        if len(payload) < RICE_HEADER_SIZE:
+            raise ValueError(f"Payload RICE demasiado corto: {len(payload)} bytes")
+        base_idx, n_samples, n_ch, n_status, flags, chain = struct.unpack_from("<IBBBBB", payload, 0)
+        n_columns, ch_mask, pos = _parse_ch_mask(payload, n_ch, RICE_HEADER_SIZE)
+        n_ch = len(mask_channels(ch_mask)) if ch_mask is not None else n_columns
+        key = bool(flags & 0x01)
+        order = (flags >> 1) & 0x03
+        n_streams = n_ch + n_status
+
+        if key:
+            self._streams = [_RiceStream() for _ in range(n_streams)]
+        elif (self._chain is None or chain != ((self._chain + 1) & 0xFF)
+              or len(self._streams) != n_streams or ch_mask != self._mask):
+            self._chain = None
+            self.packets_dropped += 1
+            return None
+
+        rd = _BitReader(payload[pos:])
+        status: List[Tuple[int, ...]] = []
+        channels: List[Tuple[int, ...]] = []
+        try:
+            for i in range(n_samples):
+                values = []
+                for s in self._streams:
+                    if key and i == 0:
+                        x = _to_s24(rd.bits(24))
+                        s.h1 = s.h2 = x
+                    else:
+                        k = s.k()
+                        q = 0
+                        while q < RICE_QMAX and rd.bit():
+                            q += 1
+                        u = rd.bits(RICE_ESCBITS) if q == RICE_QMAX else (q << k) | rd.bits(k)
+                        e = (u >> 1) ^ -(u & 1)
+                        x = s.predict(order) + e
+                        s.update(u, x)
+                    values.append(x)
+                status.append(tuple(v & 0xFFFFFF for v in values[:n_status]))
+                channels.append(tuple(values[n_status:]))
+        except ValueError:
+            self._chain = None
+            raise
+
+        self._chain = chain
+        self._mask = ch_mask
+        return BatchBlock(base_idx, status, channels, ch_mask, n_columns)
+
+
+class RiceEncoder:
+    """Codificador equivalente al del firmware (fuentes simuladas y tests)."""
+
+    def __init__(self, order: int = 1, key_interval: int = 8):
+        self.order = order
+        self.key_interval = max(1, key_interval)
+        self._streams: List[_RiceStream] = []
+        self._since_key = self.key_interval
+        self._chain = 0
+        self._mask: Optional[int] = None
+
+    def encode(
+        self,
+        seq: int,
+        base_idx: int,
+        samples: List[List[int]],
+        status: Optional[List[List[int]]] = None,
+        ch_mask: Optional[int] = None,
+        n_columns: Optional[int] = None,
+    ) -> bytes:
+        """Como build_batch_packet(): con ch_mask, samples lleva solo los activos."""
+        n_ch = len(samples[0]) if samples else 0
+        n_status = len(status[0]) if status else 0
+        n_cols = _columns(ch_mask, n_columns, n_ch)
+        if not _masked(ch_mask, n_cols):
+            ch_mask = None
+        # Otra máscara: los flujos del predictor cambian (setChannelMask())
+        key = (self._since_key >= self.key_interval or len(self._streams) != n_ch + n_status
+               or ch_mask != self._mask)
+        self._mask = ch_mask
+        if key:
+            self._since_key = 0
+            self._streams = [_RiceStream() for _ in range(n_ch + n_status)]
+        self._since_key += 1
+
+        wr = _BitWriter()
+        for i, chans in enumerate(samples):
+            values = [_to_s24(v) for v in (status[i] if status else [])] + list(chans)
+            for s, x in zip(self._streams, values):
+                if key and i == 0:
+                    wr.bits(x & 0xFFFFFF, 24)
+                    s.h1 = s.h2 = x
+                    continue
+                k = s.k()
+                e = x - s.predict(self.order)
+                u = (e << 1) if e >= 0 else ((-e) << 1) - 1  # zigzag
+                q = u >> k
+                if q < RICE_QMAX:
+                    wr.bits(((1 << q) - 1) << 1, q + 1)
+                    wr.bits(u, k)
+                else:
+                    wr.bits((1 << RICE_QMAX) - 1, RICE_QMAX)
+                    wr.bits(u, RICE_ESCBITS)
+                s.update(u, x)
+
+        flags = (0x01 if key else 0x00) | (self.order << 1)
+        n_ch, mask = _pack_ch_mask(ch_mask, n_cols)
+        header = struct.pack("<IBBBBB", base_idx, len(samples), n_ch, n_status, flags, self._chain) + mask
+        self._chain = (self._chain + 1) & 0xFF
+        return build_packet(PKT_RICE, seq, header + wr.flush())
+
+
+@dataclass
+class Packet:
+    """Paquete validado (CRC correcto)."""
+    type: int
+    seq: int
+    payload: bytes
+
+
+class PacketParser:
+    """
+    Parser incremental: se le pasan bytes con feed() y devuelve los paquetes
+    completos y válidos. Si la cabecera o el CRC no cuadran descarta un byte y
+    busca el siguiente sync, así que un byte perdido solo cuesta un paquete.
+    """
+
+    def __init__(self):
+        self._buf = bytearray()
+        self._last_seq: Optional[int] = None
+        # Estadísticas de enlace
+        self.packets_ok = 0
+        self.crc_errors = 0
+        self.bytes_skipped = 0
+        self.seq_gaps = 0
+
+    def reset(self):
+        """Descarta el buffer y el estado de secuencia."""
+        self._buf.clear()
+        self._last_seq = None
+
+    def feed(self, data: bytes) -> List[Packet]:
+        """Añade bytes recibidos y devuelve los paquetes completos disponibles."""
+        if data:
+            self._buf += data
+        buf = self._buf
+        packets: List[Packet] = []
+
+        while True:
+            start = buf.find(SYNC)
+            if start < 0:
+                # Conservar un posible primer byte de sync al final
+                keep = 1 if buf[-1:] == SYNC[:1] else 0
+                self.bytes_skipped += len(buf) - keep
+                del buf[:len(buf) - keep]
+                return packets
+            if start > 0:
+                self.bytes_skipped += start
+                del buf[:start]
+
+            if len(buf) < HEADER_SIZE:
+                return packets
+            pkt_type, seq, length = struct.unpack_from("<BBH", buf, 2)
+            if length > MAX_PAYLOAD:
+                # Cabecera imposible: falso sync
+                self.bytes_skipped += 1
+                del buf[:1]
+                continue
+
+            total = HEADER_SIZE + length + CRC_SIZE
+            if len(buf) < total:
+                return packets
+
+            crc_rx = struct.unpack_from("<H", buf, HEADER_SIZE + length)[0]
+            if crc16_ccitt(buf[2:HEADER_SIZE + length]) != crc_rx:
+                self.crc_errors += 1
+                self.bytes_skipped += 1
+                del buf[:1]
+                continue
+
+            payload = bytes(buf[HEADER_SIZE:HEADER_SIZE + length])
+            del buf[:total]
+
+            if self._last_seq is not None and seq != ((self._last_seq + 1) & 0xFF):
+                self.seq_gaps += 1
+            self._last_seq = seq
+            self.packets_ok += 1
+
+            packets.append(Packet(pkt_type, seq, payload))
+
+
+class StoredStream:
+    """
+    Reensambla lo que el firmware guardó en su flash (store-and-forward).
+
+    Cada PKT_STORED trae un tramo del flujo guardado: paquetes de datos
+    completos, con su seq y CRC originales, partidos por donde cayera. Aquí
+    pasan por un PacketParser propio; feed() devuelve los paquetes que
+    completa cada tramo. Un salto de offset (tramo perdido) descarta el
+    paquete a medias y cuenta en gaps; el siguiente sync resincroniza. El
+    flujo RICE guardado lleva su propia cadena (necesita otro RiceDecoder) y
+    su primer lote de cada tramo es keyframe.
+
+    Los seq de dentro tienen huecos por construcción (los paquetes en vivo
+    van intercalados): parser.seq_gaps no indica pérdidas aquí.
+    """
+
+    def __init__(self):
+        self.parser = PacketParser()
+        self.reset()
+
+    def reset(self):
+        self.parser.reset()
+        self._next: Optional[int] = None
+        self.remaining = 0   # bytes aún en la flash según el último tramo
+        self.bytes = 0       # bytes recibidos
+        self.gaps = 0        # saltos de offset
+
+    def feed(self, payload: bytes) -> List[Packet]:
+        """Añade el payload de un PKT_STORED; devuelve los paquetes completos."""
+        chunk = parse_stored_payload(payload)
+        if self._next is not None and chunk.offset != self._next:
+            self.gaps += 1
+            self.parser.reset()
+        self._next = (chunk.offset + len(chunk.data)) & 0xFFFFFFFF
+        self.remaining = chunk.remaining
+        self.bytes += len(chunk.data)
+        return self.parser.feed(chunk.data)
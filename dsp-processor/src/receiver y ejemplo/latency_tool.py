@@ -0,0 +1,199 @@
+"""
+Latency Tool - Histogramas de latencia y jitter a partir de paquetes PKT_TIMING
+El firmware envía cada TIMING_INTERVAL paquetes de datos un registro con el
+micros() del flanco de DRDY de una muestra y el de la escritura en el
+transporte del paquete que la contiene (ver docs/protocol.md). Con la hora de
+llegada al host y las marcas de las etapas posteriores (DSP, MIDI) se
+descompone la latencia de la cadena:
+
+    DRDY --[firmware]--> transporte --[enlace]--> host --[etapas]--> MIDI
+
+- firmware: t_tx - t_drdy, exacta (mismo reloj). Incluye la espera del lote.
+- enlace:   t_host - t_tx mezcla dos relojes; sin sincronizarlos solo se
+            conoce salvo una constante, así que se muestra el exceso sobre el
+            mínimo observado (jitter del enlace + buffers del SO). Con el
+            reloj sincronizado (CMD_TIME_PING, DataReceiver.host_time) también
+            en absoluto, junto con el RTT de los pings.
+- etapas:   t_etapa - t_host, reloj del host (LatencyTracker.mark()).
+- jitter de DRDY: residuo de t_drdy frente a la recta idx -> tiempo ajustada.
+
+Uso:
+    python latency_tool.py --port COM3 --seconds 30
+"""
+
+import argparse
+import math
+import time
+from collections import deque
+from typing import Callable, Deque, Dict, List, Optional, Tuple
+
+from eeg_protocol import TimingRecord
+
+_U32 = 0x100000000
+
+
+def _unwrap_from(t: int, t0: int) -> int:
+    """t - t0 en µs suponiendo que t es posterior (cuenta el wrap de uint32)."""
+    return (t - t0) % _U32
+
+
+def percentile(values: List[float], p: float) -> float:
+    """Percentil p (0..100) por interpolación lineal."""
+    if not values:
+        return float("nan")
+    v = sorted(values)
+    k = (len(v) - 1) * p / 100.0
+    i = int(k)
+    if i + 1 >= len(v):
+        return v[-1]
+    return v[i] + (v[i + 1] - v[i]) * (k - i)
+
+
+def format_histogram(title: str, values: List[float], unit: str = "µs",
+                     bins: int = 12, width: int = 40) -> str:
+    """Histograma de texto con resumen p50/p90/p99/max."""
+    if not values:
+        return f"{title}: sin datos"
+    lo, hi = min(values), max(values)
+    lines = [
+        f"{title} (n={len(values)}): p50={percentile(values, 50):.0f} "
+        f"p90={percentile(values, 90):.0f} p99={percentile(values, 99):.0f} "
+        f"max={hi:.0f} {unit}"
+    ]
+    span = (hi - lo) or 1.0
+    counts = [0] * bins
+    for x in values:
+        counts[min(int((x - lo) / span * bins), bins - 1)] += 1
+    peak = max(counts)
+    for b, c in enumerate(counts):
+        edge = lo + span * b / bins
+        bar = "#" * (c * width // peak) if c else ""
+        lines.append(f"  {edge:>10.0f} | {bar:<{width}} {c}")
+    return "\n".join(lines)
+
+
+class LatencyTracker:
+    """Acumula registros TIMING y marcas de etapa del host."""
+
+    def __init__(self, max_records: int = 4096):
+        # (TimingRecord, t_host en s de perf_counter)
+        self.records: Deque[Tuple[TimingRecord, float]] = deque(maxlen=max_records)
+        # Por etapa: sample_idx con TIMING aún sin marcar -> t_host de llegada
+        self._pending: Dict[str, Dict[int, float]] = {}
+        self.stage_latency_us: Dict[str, List[float]] = {}
+        # micros() del firmware -> hora del host (DataReceiver.host_time), si
+        # se sincroniza el reloj; enlace absoluto y RTT de los pings
+        self.host_time: Optional[Callable[[int], float]] = None
+        self.link_latency_us: Deque[float] = deque(maxlen=max_records)
+        self.rtt_us: Deque[float] = deque(maxlen=max_records)
+
+    def add_timing(self, rec: TimingRecord, t_host: float):
+        """Registra un PKT_TIMING y su hora de llegada (DataReceiver.on_timing)."""
+        self.records.append((rec, t_host))
+        if self.host_time is not None:
+            t_tx = self.host_time(rec.t_tx_us)
+            if not math.isnan(t_tx):
+                self.link_latency_us.append((t_host - t_tx) * 1e6)
+        for pending in self._pending.values():
+            pending[rec.sample_idx] = t_host
+
+    def add_clock(self, stats: dict):
+        """RTT de cada ping de sincronización (DataReceiver.on_clock)."""
+        self.rtt_us.append(stats["rtt_s"] * 1e6)
+
+    def add_stage(self, stage: str):
+        """Declara una etapa antes de marcarla (las marcas se cuentan desde aquí)."""
+        self._pending.setdefault(stage, {})
+        self.stage_latency_us.setdefault(stage, [])
+
+    def mark(self, stage: str, sample_idx: int, t_host: Optional[float] = None):
+        """
+        La etapa `stage` terminó de procesar hasta sample_idx (inclusive).
+        Cierra las muestras con TIMING pendientes de esa etapa.
+        """
+        if t_host is None:
+            t_host = time.perf_counter()
+        self.add_stage(stage)
+        pending = self._pending[stage]
+        done = [idx for idx in pending if idx <= sample_idx]
+        for idx in done:
+            self.stage_latency_us[stage].append((t_host - pending.pop(idx)) * 1e6)
+
+    # ---- Métricas ----
+
+    def firmware_latency_us(self) -> List[float]:
+        return [float(r.firmware_latency_us) for r, _ in self.records]
+
+    def link_excess_us(self) -> List[float]:
+        """t_host - t_tx salvo la constante de offset: exceso sobre el mínimo."""
+        if not self.records:
+            return []
+        r0, h0 = self.records[0]
+        # Ambos relojes referidos al primer registro (el wrap de uint32 se
+        # deshace sobre t_tx; el host ya es monótono)
+        d = [(h - h0) * 1e6 - _unwrap_from(r.t_tx_us, r0.t_tx_us) for r, h in self.records]
+        m = min(d)
+        return [x - m for x in d]
+
+    def drdy_fit(self) -> Tuple[float, List[float]]:
+        """Periodo medio de DRDY (µs) y residuo de cada t_drdy frente a la recta."""
+        pts = [(r.sample_idx, _unwrap_from(r.t_drdy_us, self.records[0][0].t_drdy_us))
+               for r, _ in self.records]
+        if len(pts) < 2:
+            return float("nan"), []
+        n = len(pts)
+        mx = sum(p[0] for p in pts) / n
+        my = sum(p[1] for p in pts) / n
+        sxx = sum((p[0] - mx) ** 2 for p in pts)
+        if sxx == 0:
+            return float("nan"), []
+        period = sum((p[0] - mx) * (p[1] - my) for p in pts) / sxx
+        return period, [p[1] - (my + period * (p[0] - mx)) for p in pts]
+
+    def report(self) -> str:
+        out = []
+        period, resid = self.drdy_fit()
+        if resid:
+            out.append(f"Periodo DRDY: {period:.2f} µs ({1e6 / period:.2f} SPS)")
+            out.append(format_histogram("Jitter DRDY (residuo)", resid))
+        out.append(format_histogram("Firmware DRDY -> transporte", self.firmware_latency_us()))
+        out.append(format_histogram("Enlace sobre el mínimo", self.link_excess_us()))
+        if self.link_latency_us:
+            out.append(format_histogram("Enlace (reloj sincronizado)", list(self.link_latency_us)))
+        if self.rtt_us:
+            out.append(format_histogram("RTT de los pings", list(self.rtt_us)))
+        for stage, values in self.stage_latency_us.items():
+            out.append(format_histogram(f"Host llegada -> {stage}", values))
+        return "\n\n".join(out)
+
+
+def main():
+    from data_receiver import DataReceiver
+
+    ap = argparse.ArgumentParser(description="Latencia y jitter del flujo EEG (PKT_TIMING).")
+    ap.add_argument("--port", default="COM3")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--seconds", type=float, default=30.0)
+    args = ap.parse_args()
+
+    tracker = LatencyTracker()
+    tracker.add_stage("read_frame")
+    rx = DataReceiver(port=args.port, baudrate=args.baud)
+    rx.on_timing = tracker.add_timing
+    rx.on_clock = tracker.add_clock
+    tracker.host_time = rx.host_time
+    if not rx.connect():
+        raise SystemExit(1)
+    try:
+        t_end = time.perf_counter() + args.seconds
+        while time.perf_counter() < t_end:
+            frame = rx.read_frame()
+            if frame is not None:
+                tracker.mark("read_frame", frame[0])
+    finally:
+        rx.disconnect()
+    print(tracker.report())
+
+
+if __name__ == "__main__":
+    main()
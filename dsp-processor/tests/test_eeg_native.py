@@ -0,0 +1,164 @@
+"""
+Unit tests para la extensión nativa eeg_native (se saltan si no está compilada:
+cd native && python setup.py build_ext --inplace)
+"""
+
+import math
+import os
+import sys
+import random
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "src", "receiver y ejemplo"))
+
+from eeg_protocol import (  # noqa: E402
+    PacketParser, RiceDecoder, RiceEncoder, build_batch_packet, build_sample_packet,
+    build_timing_packet, parse_batch_payload, PKT_BATCH, PKT_RICE, PKT_SAMPLE, PKT_TIMING,
+    parse_sample_payload, ClockSync, PongRecord, TimingRecord, build_pong_packet,
+)
+
+try:
+    import eeg_native
+except ImportError:
+    eeg_native = None
+
+
+def _reference(stream: bytes):
+    """Muestras (idx, canales) decodificadas con el parser en Python."""
+    rice = RiceDecoder()
+    out = []
+    for pkt in PacketParser().feed(stream):
+        if pkt.type == PKT_SAMPLE:
+            idx, ch = parse_sample_payload(pkt.payload)
+            out.append((idx, list(ch)))
+        elif pkt.type in (PKT_BATCH, PKT_RICE):
+            block = parse_batch_payload(pkt.payload) if pkt.type == PKT_BATCH else rice.decode(pkt.payload)
+            if block is not None:
+                out.extend((block.base_idx + k, list(ch)) for k, ch in enumerate(block.channels))
+    return out
+
+
+@unittest.skipIf(eeg_native is None, "eeg_native sin compilar")
+class TestNativeDecoder(unittest.TestCase):
+
+    def _stream(self, n_packets=40, seed=3):
+        rng = random.Random(seed)
+        enc = RiceEncoder(order=2, key_interval=4)
+        x = [0, 0, 0, 0]
+        stream = b""
+        for p in range(n_packets):
+            samples = []
+            for _ in range(16):
+                x = [max(-0x800000, min(0x7FFFFF, v + rng.randint(-3000, 3000))) for v in x]
+                samples.append(list(x))
+            base = p * 16
+            if p % 3 == 0:
+                stream += build_batch_packet(p & 0xFF, base, samples, [[0xC00000]] * 16)
+            else:
+                stream += enc.encode(p & 0xFF, base, samples, [[0xC00000]] * 16)
+        return stream
+
+    def _native(self, dec, chunks):
+        for c in chunks:
+            dec.feed(c)
+        idx, ch, _ = dec.take()
+        rows = memoryview(ch).tolist()
+        return list(zip(memoryview(idx).tolist(), rows))
+
+    def test_matches_python_with_split_feed(self):
+        stream = self._stream()
+        chunks = [stream[i:i + 37] for i in range(0, len(stream), 37)]
+        dec = eeg_native.Decoder()
+        got = self._native(dec, chunks)
+        self.assertEqual(got, [(i, ch) for i, ch in _reference(stream)])
+        self.assertEqual(dec.crc_errors, 0)
+
+    def test_corruption_resync_and_rice_chain(self):
+        stream = bytearray(self._stream(seed=5))
+        rng = random.Random(9)
+        for _ in range(6):
+            stream[rng.randrange(len(stream))] ^= 0x40
+        ref_parser = PacketParser()
+        ref_parser.feed(bytes(stream))
+        dec = eeg_native.Decoder()
+        got = self._native(dec, [bytes(stream)])
+        self.assertEqual(got, [(i, ch) for i, ch in _reference(bytes(stream))])
+        self.assertGreater(dec.crc_errors, 0)
+        self.assertEqual(dec.crc_errors, ref_parser.crc_errors)
+        self.assertEqual(dec.seq_gaps, ref_parser.seq_gaps)
+        self.assertEqual(dec.bytes_skipped, ref_parser.bytes_skipped)
+
+    def test_block_shapes_and_other_packets(self):
+        dec = eeg_native.Decoder()
+        dec.feed(build_sample_packet(0, 7, [1, -2, 3, -4]) + build_timing_packet(1, 7, 10, 20)
+                 + build_sample_packet(2, 8, [5, 6, 7, -8]))
+        pkts = dec.packets()
+        self.assertEqual([(t, s) for t, s, _ in pkts], [(PKT_TIMING, 1)])
+        idx, ch, st = dec.take(float32=True, scale=0.5)
+        self.assertEqual((idx.shape, ch.shape, st.shape), ((2,), (2, 4), (2, 0)))
+        self.assertEqual(ch.format, "f")
+        self.assertEqual(memoryview(ch).tolist(), [[0.5, -1.0, 1.5, -2.0], [2.5, 3.0, 3.5, -4.0]])
+        self.assertEqual(dec.pending, 0)
+
+    def test_masked_channels_expand_to_columns(self):
+        dec = eeg_native.Decoder()
+        dec.feed(build_batch_packet(0, 10, [[1, -1], [2, -2]], ch_mask=0x5, n_columns=4)
+                 + build_sample_packet(1, 12, [3, -3], ch_mask=0x5, n_columns=4))
+        self.assertEqual((dec.n_ch, dec.ch_mask), (4, 0x5))
+        idx, ch, _ = dec.take()
+        self.assertEqual(memoryview(idx).tolist(), [10, 11, 12])
+        self.assertEqual(memoryview(ch).tolist(), [[1, 0, -1, 0], [2, 0, -2, 0], [3, 0, -3, 0]])
+        # Otra máscara es otra forma; en float32 los apagados son NaN
+        dec.feed(build_sample_packet(2, 13, [4], ch_mask=0x8, n_columns=4))
+        _, ch, _ = dec.take(float32=True, scale=1.0)
+        row = memoryview(ch).tolist()[0]
+        self.assertEqual(row[3], 4.0)
+        self.assertTrue(all(math.isnan(v) for v in row[:3]))
+
+    def test_clock_sync_matches_python(self):
+        dec = eeg_native.Decoder()
+        cs = ClockSync()
+        rng = random.Random(9)
+        seq = 0
+        for k in range(20):
+            # Firmware 30 ppm lento, micros() cerca del wrap
+            t1 = 100.0 + k * 0.7
+            t2 = int((t1 - 99.0 + 0.001) * (1 - 30e-6) * 1e6 + 0xFFF00000) & 0xFFFFFFFF
+            t4 = t1 + 0.002 + rng.uniform(0, 0.004)
+            pong = PongRecord(0, ClockSync.token(t1), t2, t2 + 40)
+            cs.add_pong(pong, t4)
+            dec.feed(build_pong_packet(seq, pong), t_host=t4)
+            rec = TimingRecord(250 * k, (t2 - 4000) & 0xFFFFFFFF, t2)
+            cs.add_timing(rec)
+            dec.feed(build_timing_packet(seq + 1, rec.sample_idx, rec.t_drdy_us, rec.t_tx_us))
+            seq += 2
+        ref = cs.stats()
+        got = dec.clock_stats()
+        self.assertEqual(set(got), set(ref))
+        for key, v in ref.items():
+            self.assertAlmostEqual(got[key], v, places=9, msg=key)
+        self.assertEqual(len(dec.packets()), 40)  # PONG y TIMING también llegan a Python
+        self.assertAlmostEqual(dec.host_time(12345), cs.host_time(12345), places=9)
+        dec.feed(build_sample_packet(seq, 4800, [1, 2]) + build_sample_packet(seq + 1, 4801, [3, 4]))
+        idx, ch, _, t_host = dec.take(float32=True, scale=1.0, times=True)
+        self.assertEqual((t_host.format, t_host.shape), ("d", (2,)))
+        for i, t in zip(memoryview(idx).tolist(), memoryview(t_host).tolist()):
+            self.assertAlmostEqual(t, cs.sample_time(i), places=9)
+
+    @unittest.skipIf(os.name == "nt", "read_fd solo en POSIX")
+    def test_read_fd(self):
+        r, w = os.pipe()
+        try:
+            os.write(w, build_sample_packet(0, 1, [10, 20]))
+            dec = eeg_native.Decoder()
+            self.assertGreater(dec.read_fd(r, 100), 0)
+            self.assertEqual(dec.read_fd(r, 0), 0)  # nada más: timeout inmediato
+            idx, ch, _ = dec.take()
+            self.assertEqual(memoryview(ch).tolist(), [[10, 20]])
+        finally:
+            os.close(r)
+            os.close(w)
+
+
+if __name__ == '__main__':
+    unittest.main()
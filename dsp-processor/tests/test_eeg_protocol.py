@@ -0,0 +1,512 @@
+"""
+Unit tests para el framing binario (eeg_protocol)
+"""
+
+import math
+import os
+import sys
+import random
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "src", "receiver y ejemplo"))
+
+from eeg_protocol import (  # noqa: E402
+    PacketParser, build_packet, build_sample_packet, build_batch_packet, crc16_ccitt,
+    parse_sample_payload, parse_batch_payload, PKT_SAMPLE, PKT_BATCH, PKT_DIAG,
+    RiceDecoder, RiceEncoder, PKT_RICE, PKT_TIMING, build_timing_packet, parse_timing_payload,
+    PKT_STATS, StatsRecord, build_stats_packet, parse_stats_payload,
+    PKT_FEATURES, FeatureRecord, build_features_packet, parse_features_payload,
+    MidiTable, MidiMap, MIDI_NOTE, power_log2_q3,
+    PKT_CMD, PKT_ACK, CMD_SET_RATE, CMD_SET_CHANNELS, ACK_OK, ACK_BAD_ARGS, FILTER_NOTCH50_BAND,
+    AckRecord, build_command_packet, build_ack_packet, parse_ack_payload,
+    PKT_SAMPLE_MASKED, parse_sample_masked_payload, expand_channels,
+    PKT_STATUS, StatusEvent, build_status_packet, parse_status_payload,
+    PKT_PONG, CMD_TIME_PING, ClockSync, PongRecord, TimingRecord, build_pong_packet, parse_pong_payload,
+    PKT_STORED, StoredChunk, StoredStream, build_stored_packet, parse_stored_payload,
+    PKT_GAP, SyncGap, GAP_RESTORED, build_gap_packet, parse_gap_payload,
+)
+from latency_tool import LatencyTracker  # noqa: E402
+
+
+class TestCrc(unittest.TestCase):
+    """CRC-16/CCITT-FALSE compatible con el firmware."""
+
+    def test_check_value(self):
+        self.assertEqual(crc16_ccitt(b"123456789"), 0x29B1)
+
+    def test_firmware_vector(self):
+        # Paquete generado por EEGStream_PacketBuilder (type=1, seq=3, [7, -2])
+        pkt = bytes.fromhex("A55A0103080007000000FEFFFFFF5E9D")
+        self.assertEqual(build_packet(PKT_SAMPLE, 3, pkt[6:14]), pkt)
+
+
+class TestPacketParser(unittest.TestCase):
+    """Parseo y resincronización."""
+
+    def test_roundtrip_sample(self):
+        pkt = build_sample_packet(0, 42, [100, -200, 300, -400])
+        packets = PacketParser().feed(pkt)
+        self.assertEqual(len(packets), 1)
+        self.assertEqual(packets[0].type, PKT_SAMPLE)
+        self.assertEqual(parse_sample_payload(packets[0].payload), (42, (100, -200, 300, -400)))
+
+    def test_split_feed(self):
+        pkt = build_sample_packet(0, 1, [1, 2, 3, 4])
+        parser = PacketParser()
+        self.assertEqual(parser.feed(pkt[:5]), [])
+        self.assertEqual(len(parser.feed(pkt[5:])), 1)
+
+    def test_resync_after_lost_byte(self):
+        stream = b"".join(build_sample_packet(i, i, [i, -i, 0, 1]) for i in range(4))
+        damaged = stream[:10] + stream[11:]  # se pierde un byte del primer paquete
+        parser = PacketParser()
+        idx = [parse_sample_payload(p.payload)[0] for p in parser.feed(damaged)]
+        self.assertEqual(idx, [1, 2, 3])
+        self.assertEqual(parser.seq_gaps, 0)
+
+    def test_garbage_and_diag(self):
+        diag = build_packet(PKT_DIAG, 0, b"hola")
+        sample = build_sample_packet(1, 7, [0, 0, 0, 0])
+        packets = PacketParser().feed(b"\x00\xA5garbage" + diag + sample)
+        self.assertEqual([p.type for p in packets], [PKT_DIAG, PKT_SAMPLE])
+
+    def test_seq_gap_counted(self):
+        parser = PacketParser()
+        parser.feed(build_sample_packet(0, 0, [0] * 4) + build_sample_packet(2, 2, [0] * 4))
+        self.assertEqual(parser.seq_gaps, 1)
+
+
+class TestBatch(unittest.TestCase):
+    """Lotes con canales en 24 bits."""
+
+    # Generado por EEGStream_Batcher (base_idx=100, 2 muestras, 2 canales, 1 STATUS)
+    FIRMWARE_VECTOR = bytes.fromhex(
+        "A55A0209190064000000020201C00000000001FFFFFFC000007FFFFF800000E858"
+    )
+
+    def test_firmware_vector(self):
+        packets = PacketParser().feed(self.FIRMWARE_VECTOR)
+        self.assertEqual(packets[0].type, PKT_BATCH)
+        block = parse_batch_payload(packets[0].payload)
+        self.assertEqual(block.base_idx, 100)
+        self.assertEqual(block.channels, [(1, -1), (8388607, -8388608)])
+        self.assertEqual(block.status, [(0xC00000,), (0xC00000,)])
+
+    def test_build_matches_firmware(self):
+        pkt = build_batch_packet(9, 100, [[1, -1], [8388607, -8388608]], [[0xC00000], [0xC00000]])
+        self.assertEqual(pkt, self.FIRMWARE_VECTOR)
+
+    # Daisy-chain: 2 ADS1299-4, un STATUS por dispositivo (base_idx=7, 2 muestras)
+    DAISY_VECTOR = bytes.fromhex(
+        "A55A02032B0007000000020402C00000C00100000001FFFFFF000064FFFF9C"
+        "C00000C08000000002FFFFFE7FFFFF8000002D3E"
+    )
+
+    def test_daisy_status_per_device(self):
+        block = parse_batch_payload(PacketParser().feed(self.DAISY_VECTOR)[0].payload)
+        self.assertEqual(block.status, [(0xC00000, 0xC00100), (0xC00000, 0xC08000)])
+        self.assertEqual(block.channels, [(1, -1, 100, -100), (2, -2, 8388607, -8388608)])
+
+
+class TestRice(unittest.TestCase):
+    """Compresión sin pérdidas (predicción + Rice adaptativo)."""
+
+    # Generados por EEGStream_RiceEncoder (2 canales, 1 STATUS, 4 muestras,
+    # orden 1, keyframe cada 2 paquetes): keyframe + paquete encadenado
+    FIRMWARE_VECTORS = [
+        "A55A03001A00640000000402010300C000000003E8FFFFFB0050200344806500F377",
+        "A55A03011E00680000000402010201013FFFEFFFFFE013FDFFFFE804000000010C0000005F1B",
+    ]
+    DATA = [[1000, -5], [1010, -3], [1003, -8], [990, 0],
+            [985, 8388607], [980, -8388608], [982, -8388608], [990, 0]]
+
+    def test_firmware_vectors(self):
+        parser, dec = PacketParser(), RiceDecoder()
+        blocks = [dec.decode(p.payload)
+                  for v in self.FIRMWARE_VECTORS for p in parser.feed(bytes.fromhex(v))]
+        self.assertEqual(blocks[0].base_idx, 100)
+        self.assertEqual(blocks[1].base_idx, 104)
+        self.assertEqual(blocks[0].channels + blocks[1].channels, [tuple(d) for d in self.DATA])
+        self.assertEqual(blocks[1].status, [(0xC00000,)] * 4)
+
+    def test_encoder_matches_firmware(self):
+        enc = RiceEncoder(order=1, key_interval=2)
+        st = [[0xC00000]] * 4
+        self.assertEqual(enc.encode(0, 100, self.DATA[:4], st).hex().upper(), self.FIRMWARE_VECTORS[0])
+        self.assertEqual(enc.encode(1, 104, self.DATA[4:], st).hex().upper(), self.FIRMWARE_VECTORS[1])
+
+    def test_lost_packet_waits_for_keyframe(self):
+        rng = random.Random(7)
+        enc, dec, parser = RiceEncoder(order=2, key_interval=3), RiceDecoder(), PacketParser()
+        sent, got = [], []
+        for p in range(6):
+            block = [[rng.randint(-3000, 3000) for _ in range(4)] for _ in range(8)]
+            pkt = enc.encode(p, p * 8, block)
+            if p == 1:
+                continue  # paquete perdido en el enlace
+            sent.append((p, block))
+            for pk in parser.feed(pkt):
+                got.append(dec.decode(pk.payload))
+        # p=2 depende de p=1 → descartado; p=3 es keyframe y se recupera
+        self.assertIsNone(got[1])
+        self.assertEqual(dec.packets_dropped, 1)
+        for (p, block), res in zip(sent, got):
+            if res is not None:
+                self.assertEqual(res.channels, [tuple(s) for s in block])
+                self.assertEqual(res.base_idx, p * 8)
+
+
+class TestChannelMask(unittest.TestCase):
+    """Solo los canales activos en el payload (EEG_CH_MASKED)."""
+
+    # EEGStream_Batcher con 4 canales, mask 0x5, 1 STATUS (base_idx=100, 2 muestras)
+    BATCH_VECTOR = bytes.fromhex(
+        "A55A02091D006400000002840105000000C00000000001FFFFFFC000007FFFFF800000033D"
+    )
+    # EEGStream_RiceEncoder con 4 canales, mask 0x9, orden 1 (keyframe, base_idx=200)
+    RICE_VECTOR = bytes.fromhex(
+        "A55A03031E00C8000000048401030009000000C000000003E8FFFFFB00502003448065007E82"
+    )
+    RICE_DATA = [[1000, -5], [1010, -3], [1003, -8], [990, 0]]
+
+    def test_batch_firmware_vector(self):
+        block = parse_batch_payload(PacketParser().feed(self.BATCH_VECTOR)[0].payload)
+        self.assertEqual((block.ch_mask, block.n_columns), (0x5, 4))
+        self.assertEqual(block.channels, [(1, -1), (8388607, -8388608)])
+        self.assertEqual(block.rows(), [[1, 0, -1, 0], [8388607, 0, -8388608, 0]])
+        pkt = build_batch_packet(9, 100, [[1, -1], [8388607, -8388608]], [[0xC00000]] * 2,
+                                 ch_mask=0x5, n_columns=4)
+        self.assertEqual(pkt, self.BATCH_VECTOR)
+
+    def test_rice_firmware_vector(self):
+        block = RiceDecoder().decode(PacketParser().feed(self.RICE_VECTOR)[0].payload)
+        self.assertEqual((block.base_idx, block.ch_mask, block.n_columns), (200, 0x9, 4))
+        self.assertEqual(block.channels, [tuple(d) for d in self.RICE_DATA])
+        enc = RiceEncoder(order=1)
+        self.assertEqual(enc.encode(3, 200, self.RICE_DATA, [[0xC00000]] * 4, ch_mask=0x9, n_columns=4),
+                         self.RICE_VECTOR)
+
+    def test_full_mask_keeps_plain_format(self):
+        rows = [[1, 2, 3, 4]]
+        self.assertEqual(build_batch_packet(0, 5, rows, ch_mask=0xF), build_batch_packet(0, 5, rows))
+        self.assertEqual(build_sample_packet(0, 5, rows[0], ch_mask=0xF), build_sample_packet(0, 5, rows[0]))
+
+    def test_sample_and_features_round_trip(self):
+        pkt = PacketParser().feed(build_sample_packet(1, 42, [7, -7], ch_mask=0x12, n_columns=8))[0]
+        self.assertEqual(pkt.type, PKT_SAMPLE_MASKED)
+        idx, n_columns, ch_mask, ch = parse_sample_masked_payload(pkt.payload)
+        self.assertEqual((idx, n_columns, ch_mask, ch), (42, 8, 0x12, (7, -7)))
+        self.assertEqual(expand_channels(ch, ch_mask, n_columns), [0, 7, 0, 0, -7, 0, 0, 0])
+
+        rec = FeatureRecord(99, 128, [[1, 2, 3, 4, 5]], ch_mask=0x4, n_columns=4)
+        got = parse_features_payload(PacketParser().feed(build_features_packet(2, rec))[0].payload)
+        self.assertEqual(got, rec)
+        self.assertEqual(got.channel_indices(), [2])
+
+    def test_bad_mask(self):
+        payload = bytearray(self.BATCH_VECTOR[6:-2])
+        payload[7:11] = (0x30).to_bytes(4, "little")  # canales 4 y 5 de una cadena de 4
+        with self.assertRaises(ValueError):
+            parse_batch_payload(bytes(payload))
+
+
+
+class TestTiming(unittest.TestCase):
+    """Marcas de tiempo DRDY / transporte."""
+
+    # Generado por el firmware: sample_idx=4096, t_drdy justo antes del wrap
+    FIRMWARE_VECTOR = bytes.fromhex("A55A04050C000010000000F0FFFF102700001CA5")
+
+    def test_firmware_vector(self):
+        pkt = PacketParser().feed(self.FIRMWARE_VECTOR)[0]
+        self.assertEqual(pkt.type, PKT_TIMING)
+        rec = parse_timing_payload(pkt.payload)
+        self.assertEqual(rec.sample_idx, 4096)
+        self.assertEqual(rec.firmware_latency_us, 14096)  # cruza el wrap de micros()
+        self.assertEqual(build_timing_packet(5, 4096, 0xFFFFF000, 0x2710), self.FIRMWARE_VECTOR)
+
+    def test_tracker_stages_and_jitter(self):
+        tr = LatencyTracker()
+        tr.add_stage("midi")
+        for k in range(5):
+            idx = 256 * k
+            t_drdy = 4000 * idx + (30 if k == 2 else 0)
+            rec = parse_timing_payload(build_timing_packet(0, idx, t_drdy, t_drdy + 5000)[6:-2])
+            tr.add_timing(rec, 1.0 + (t_drdy + 7000) * 1e-6)
+            tr.mark("midi", idx, 1.0 + (t_drdy + 9000) * 1e-6)
+        period, resid = tr.drdy_fit()
+        self.assertAlmostEqual(period, 4000.0, delta=0.1)
+        self.assertAlmostEqual(max(resid), 24.0, delta=0.5)
+        self.assertEqual(tr.firmware_latency_us(), [5000.0] * 5)
+        self.assertTrue(all(abs(x) < 1.0 for x in tr.link_excess_us()))
+        self.assertTrue(all(abs(x - 2000.0) < 1.0 for x in tr.stage_latency_us["midi"]))
+
+
+class TestClockSync(unittest.TestCase):
+    """Ping/pong NTP y ajuste de offset + deriva del reloj del firmware."""
+
+    # Generado por el firmware: cmd_seq=0, token=0x12345678, t_rx = t_tx = 5201
+    FIRMWARE_VECTOR = bytes.fromhex("A55A12030D00007856341251140000511400007A0E")
+
+    DRIFT = 50e-6  # el firmware adelanta 50 ppm
+
+    def _dev_us(self, t_host: float) -> int:
+        # micros() del firmware: arranca en t_host = 10 s y da la vuelta a los 5 s
+        return (int(round((t_host - 10.0) * (1 + self.DRIFT) * 1e6)) + 0xFFFFFFFF - 5_000_000) & 0xFFFFFFFF
+
+    def _true_host(self, t_dev_unwrapped_us: float) -> float:
+        return 10.0 + t_dev_unwrapped_us * 1e-6 / (1 + self.DRIFT)
+
+    def test_firmware_vector(self):
+        pkt = PacketParser().feed(self.FIRMWARE_VECTOR)[0]
+        self.assertEqual(pkt.type, PKT_PONG)
+        pong = parse_pong_payload(pkt.payload)
+        self.assertEqual((pong.cmd_seq, pong.token, pong.turnaround_us), (0, 0x12345678, 0))
+        self.assertEqual(build_pong_packet(3, pong), self.FIRMWARE_VECTOR)
+        self.assertEqual(build_command_packet(0, CMD_TIME_PING, bytes.fromhex("78563412"))[6:-2],
+                         bytes([CMD_TIME_PING, 0x78, 0x56, 0x34, 0x12]))
+
+    def _pong(self, cs, t1, up, down, turnaround=0.0001):
+        t2 = self._dev_us(t1 + up)
+        t3 = self._dev_us(t1 + up + turnaround)
+        return cs.add_pong(PongRecord(0, ClockSync.token(t1), t2, t3), t1 + up + turnaround + down)
+
+    def test_offset_and_drift_across_wrap(self):
+        cs = ClockSync()
+        self.assertFalse(cs.synced)
+        rng = random.Random(5)
+        for k in range(40):
+            # Los pings lentos esperaron en la cola de vuelta: no cuentan
+            down = 0.02 if k % 4 == 1 else 0.001 + rng.uniform(0, 20e-6)
+            rtt = self._pong(cs, 10.2 + k * 0.5, 0.001, down)
+            self.assertGreater(rtt, 0.002)
+        st = cs.stats()
+        self.assertTrue(st["synced"])
+        self.assertAlmostEqual(st["drift_ppm"], -self.DRIFT * 1e6, delta=1.0)
+        self.assertAlmostEqual(st["delay_min_s"], 0.002, delta=30e-6)
+        # El micros() de ahora (pasado el wrap) se lleva al reloj del host
+        t = 29.9
+        self.assertLess(self._dev_us(t), 0x80000000)
+        self.assertAlmostEqual(cs.host_time(self._dev_us(t)), t, delta=20e-6)
+
+    def test_sample_time_from_timing_anchors(self):
+        cs = ClockSync()
+        for k in range(10):
+            self._pong(cs, 10.2 + k, 0.001, 0.001)
+        self.assertTrue(math.isnan(cs.sample_time(0)))  # sin anclas TIMING
+        # 250 SPS del firmware, idx 0 en t_dev = 0 (desenrollado)
+        for idx in (500, 1000, 1500):
+            cs.add_timing(TimingRecord(idx, self._dev_us(self._true_host(idx * 4000.0)), 0))
+        self.assertAlmostEqual(cs.stats()["period_us"], 4000.0, delta=0.01)
+        for idx in (1500, 1600):
+            self.assertAlmostEqual(cs.sample_time(idx), self._true_host(idx * 4000.0), delta=20e-6)
+        # Otra frecuencia de muestreo: el periodo se vuelve a medir
+        cs.add_timing(TimingRecord(2000, self._dev_us(self._true_host(1500 * 4000.0 + 500 * 2000.0)), 0))
+        self.assertAlmostEqual(cs.stats()["period_us"], 2000.0, delta=0.01)
+
+
+class TestStats(unittest.TestCase):
+    """Contadores de salud del firmware."""
+
+    # Generado por el firmware (seq=200)
+    FIRMWARE_VECTOR = bytes.fromhex("A55A05C8180090D0030003000000020000000100000028000000D20409105401")
+
+    def test_firmware_vector(self):
+        pkt = PacketParser().feed(self.FIRMWARE_VECTOR)[0]
+        self.assertEqual(pkt.type, PKT_STATS)
+        st = parse_stats_payload(pkt.payload)
+        self.assertEqual(st, StatsRecord(250000, 3, 2, 1, 40, 1234, 9, 16))
+        self.assertEqual(build_stats_packet(200, st), self.FIRMWARE_VECTOR)
+
+    def test_delta_wraps(self):
+        a = StatsRecord(0xFFFFFF00, 0xFFFFFFFF, 0, 0, 0, 0, 0, 16)
+        b = StatsRecord(0x00000100, 0x00000001, 0, 0, 0, 0, 0, 16)
+        d = b.delta(a)
+        self.assertEqual(d["sample_idx"], 0x200)
+        self.assertEqual(d["sync_errors"], 2)
+
+
+class TestStatus(unittest.TestCase):
+    """Eventos de lead-off / GPIO."""
+
+    # Generado por el firmware (seq=9): lead-off P y N del canal 1 desde la muestra 30
+    FIRMWARE_VECTOR = bytes.fromhex("A55A080909001E0000000101C01010958A")
+
+    def test_firmware_vector(self):
+        pkt = PacketParser().feed(self.FIRMWARE_VECTOR)[0]
+        self.assertEqual(pkt.type, PKT_STATUS)
+        ev = parse_status_payload(pkt.payload)
+        self.assertEqual((ev.sample_idx, ev.changed, ev.status), (30, True, (0xC01010,)))
+        self.assertEqual((ev.loff_p(), ev.loff_n(), ev.gpio()), (0x01, 0x01, 0))
+        self.assertEqual(build_status_packet(9, ev), self.FIRMWARE_VECTOR)
+
+    def test_daisy_lead_off_channels(self):
+        ev = StatusEvent(5, False, (0xC00004, 0xC04020))  # dev1: canal 2 en P, canal 1 en N
+        got = parse_status_payload(PacketParser().feed(build_status_packet(0, ev))[0].payload)
+        self.assertEqual(got, ev)
+        self.assertEqual(got.lead_off_channels(4), [5, 6])
+        self.assertEqual(got.gpio(0), 0x4)
+
+    def test_bad_length(self):
+        with self.assertRaises(ValueError):
+            parse_status_payload(self.FIRMWARE_VECTOR[6:-3])
+
+
+class TestStored(unittest.TestCase):
+    """Flujo guardado en la flash del firmware (store-and-forward)."""
+
+    # Generado por el firmware (seq=16): 3 paquetes SAMPLE de 4 canales
+    # grabados en modo RECORD (seq 11-13, muestras 4-6) y descargados al volver a SPILL
+    FIRMWARE_VECTOR = bytes.fromhex(
+        "A55A09105C000000000000000000"
+        "A55A010B140004000000680A0000E8120000BD1A0000F2220000A956"
+        "A55A010C140005000000F30A0000A81200000B1A0000B42100003A6C"
+        "A55A010D140006000000580B00001E120000F0180000C51F00007EA7"
+        "4ECB")
+
+    def test_firmware_vector(self):
+        pkt = PacketParser().feed(self.FIRMWARE_VECTOR)[0]
+        self.assertEqual(pkt.type, PKT_STORED)
+        chunk = parse_stored_payload(pkt.payload)
+        self.assertEqual((chunk.offset, chunk.remaining, len(chunk.data)), (0, 0, 84))
+        self.assertEqual(build_stored_packet(16, chunk), self.FIRMWARE_VECTOR)
+        inner = StoredStream().feed(pkt.payload)
+        self.assertEqual([(p.type, p.seq) for p in inner], [(PKT_SAMPLE, 11), (PKT_SAMPLE, 12), (PKT_SAMPLE, 13)])
+        self.assertEqual(parse_sample_payload(inner[0].payload), (4, (2664, 4840, 6845, 8946)))
+
+    @staticmethod
+    def _payload(offset: int, data: bytes, remaining: int = 0) -> bytes:
+        return build_stored_packet(0, StoredChunk(offset & 0xFFFFFFFF, remaining, data))[6:-2]
+
+    def test_reassembly_across_chunks(self):
+        data = b"".join(build_sample_packet(i, i, [i, -i, 3 * i, 7]) for i in range(10))
+        st = StoredStream()
+        got = []
+        # Tramos de 17 bytes desde cerca del wrap del offset (uint32)
+        for pos in range(0, len(data), 17):
+            part = data[pos:pos + 17]
+            got += st.feed(self._payload(0xFFFFFFF0 + pos, part, len(data) - pos - len(part)))
+        self.assertEqual([parse_sample_payload(p.payload)[0] for p in got], list(range(10)))
+        self.assertEqual((st.gaps, st.remaining, st.bytes), (0, 0, len(data)))
+
+    def test_lost_chunk_costs_only_its_packets(self):
+        pkts = [build_sample_packet(i, i, [i, i, i, i]) for i in range(6)]
+        data = b"".join(pkts)
+        st = StoredStream()
+        cut = len(pkts[0]) + 5  # se pierden 40 bytes desde dentro del paquete 1
+        got = st.feed(self._payload(0, data[:cut]))
+        got += st.feed(self._payload(cut + 40, data[cut + 40:]))
+        self.assertEqual([parse_sample_payload(p.payload)[0] for p in got], [0, 3, 4, 5])
+        self.assertEqual(st.gaps, 1)
+
+    def test_bad_length(self):
+        with self.assertRaises(ValueError):
+            parse_stored_payload(b"\x00" * 7)
+
+
+class TestGap(unittest.TestCase):
+    """Huecos por pérdida de sincronía del ADS1299 (PKT_GAP)."""
+
+    # Generado por el firmware (seq=5): frames 20-22 sin sync con CH1SET
+    # corrupto en el mock, RESET y caché reescrita; el 23 se leyó antes de
+    # recuperar y la primera muestra válida es la 24
+    FIRMWARE_VECTOR = bytes.fromhex("A55A0A050E0014000000040000002F0000000101AF83")
+
+    def test_firmware_vector(self):
+        pkt = PacketParser().feed(self.FIRMWARE_VECTOR)[0]
+        self.assertEqual(pkt.type, PKT_GAP)
+        gap = parse_gap_payload(pkt.payload)
+        self.assertEqual(gap, SyncGap(20, 4, 47, 1, GAP_RESTORED))
+        self.assertTrue(gap.restored)
+        self.assertFalse(gap.failed)
+        self.assertEqual(gap.end_idx, 24)
+        self.assertEqual(build_gap_packet(5, gap), self.FIRMWARE_VECTOR)
+
+    def test_bad_length(self):
+        with self.assertRaises(ValueError):
+            parse_gap_payload(self.FIRMWARE_VECTOR[6:-3])
+
+
+class TestFeatures(unittest.TestCase):
+    """Potencia por bandas calculada en el firmware (modo features)."""
+
+    # Generado por el firmware (seq=42): 2 canales × 5 bandas, ventana de 128
+    FIRMWARE_VECTOR = bytes.fromhex(
+        "A55A062A3000E803000002058000010000000200000080F0FA0203000000040000003694"
+        "70004C6E00005C000000F4034400FFFFFFFFEB57")
+
+    def test_firmware_vector(self):
+        pkt = PacketParser().feed(self.FIRMWARE_VECTOR)[0]
+        self.assertEqual(pkt.type, PKT_FEATURES)
+        rec = parse_features_payload(pkt.payload)
+        self.assertEqual(rec.sample_idx, 1000)
+        self.assertEqual(rec.window, 128)
+        self.assertEqual(rec.powers, [[1, 2, 50000000, 3, 4],
+                                      [7377974, 28236, 92, 4457460, FeatureRecord.SATURATED]])
+        self.assertEqual(build_features_packet(42, rec), self.FIRMWARE_VECTOR)
+        # Seno de 10000 LSB en alfa: A²/2 en V²
+        self.assertAlmostEqual(rec.band_power_v2()[0]["alpha"], 50000000 * 2.235e-8 ** 2)
+
+    def test_bad_length(self):
+        with self.assertRaises(ValueError):
+            parse_features_payload(self.FIRMWARE_VECTOR[6:-3])
+
+
+class TestControl(unittest.TestCase):
+    """Comandos del host y ACK del firmware."""
+
+    # EEGStream_PacketBuilder: SET_RATE 500 SPS, seq=1
+    FIRMWARE_CMD = bytes.fromhex("A55A1001030004F401237E")
+    # Respuesta del firmware a ese comando (RICE de 16, notch 50 Hz + banda, 4 canales)
+    FIRMWARE_ACK = bytes.fromhex(
+        "A55A110616000401002E000000F40103100400010F00000000C20100254F")
+
+    def test_command_matches_firmware(self):
+        self.assertEqual(build_command_packet(1, CMD_SET_RATE, (500).to_bytes(2, "little")),
+                         self.FIRMWARE_CMD)
+        pkt = PacketParser().feed(self.FIRMWARE_CMD)[0]
+        self.assertEqual((pkt.type, pkt.payload), (PKT_CMD, b"\x04\xf4\x01"))
+
+    def test_ack_firmware_vector(self):
+        pkt = PacketParser().feed(self.FIRMWARE_ACK)[0]
+        self.assertEqual(pkt.type, PKT_ACK)
+        ack = parse_ack_payload(pkt.payload)
+        self.assertEqual((ack.cmd, ack.cmd_seq, ack.status), (CMD_SET_RATE, 1, ACK_OK))
+        self.assertTrue(ack.ok and ack.acquiring)
+        self.assertEqual((ack.sps, ack.mode, ack.batch, ack.filter), 
+                         (500, PKT_RICE, 16, FILTER_NOTCH50_BAND))
+        self.assertEqual((ack.channels, ack.baud), ([0, 1, 2, 3], 115200))
+        self.assertEqual(build_ack_packet(pkt.seq, ack), self.FIRMWARE_ACK)
+
+    def test_ack_round_trip(self):
+        ack = AckRecord(CMD_SET_CHANNELS, 10, ACK_BAD_ARGS, 476, 250, PKT_SAMPLE, 1, 0, 1, False,
+                        0x5, 230400)
+        pkt = PacketParser().feed(build_ack_packet(7, ack))[0]
+        got = parse_ack_payload(pkt.payload)
+        self.assertEqual(got, ack)
+        self.assertFalse(got.ok)
+        self.assertEqual(got.channels, [0, 2])
+
+    def test_bad_length(self):
+        with self.assertRaises(ValueError):
+            parse_ack_payload(self.FIRMWARE_ACK[6:-3])
+
+
+class TestMidiTable(unittest.TestCase):
+    """Tabla de mapeo de la salida USB-MIDI."""
+
+    # Aceptada por EEGMidi_parseTable: alfa del canal 2 a notas desde el Do central
+    FIRMWARE_VECTOR = bytes.fromhex("010095020A01" "020202013C6460C0")
+
+    def test_matches_firmware(self):
+        t = MidiTable(scale=MidiTable.scale_mask([0, 2, 4, 7, 9]), span=10,
+                      maps=[MidiMap(2, 2, MIDI_NOTE, 1, 60, velocity=100)])
+        self.assertEqual(t.to_bytes(), self.FIRMWARE_VECTOR)
+
+    def test_thresholds(self):
+        # 2^12 LSB² de potencia media ≈ 1.43 µV rms
+        self.assertEqual(power_log2_q3(64 * 2.235e-8 * 1e6), 96)
+
+
+if __name__ == '__main__':
+    unittest.main()
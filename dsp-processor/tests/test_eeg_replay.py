@@ -0,0 +1,114 @@
+"""
+Unit tests para el emulador native/eeg_replay (se saltan si no está compilado:
+cd native && python setup.py build_ext --inplace)
+"""
+
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "src", "receiver y ejemplo"))
+
+from eeg_protocol import (  # noqa: E402
+    PacketParser, RiceDecoder, RiceEncoder, build_batch_packet, build_packet,
+    build_sample_packet, PKT_DIAG, PKT_RICE,
+)
+
+REPLAY = os.path.join(os.path.dirname(__file__), "..", "native", "eeg_replay")
+
+SPR = 200        # muestras por registro de 1 s
+N_RECORDS = 3
+
+
+def _signal(r: int, c: int, i: int) -> int:
+    return ((r * SPR + i) * (37 + 11 * c)) % 60001 - 30000
+
+
+def _write_edf(path: str):
+    """EDF de 2 canales EEG + anotaciones; valor físico = digital (uV)."""
+    labels = ["EEG Fp1", "EEG Fp2", "EDF Annotations"]
+    spr = [SPR, SPR, 4]
+    ns = len(labels)
+
+    def fields(values, width):
+        return b"".join(str(v).ljust(width)[:width].encode() for v in values)
+
+    header = (b"0".ljust(8) + b"X".ljust(80) + b"X".ljust(80) + b"01.01.26" + b"00.00.00"
+              + str(256 * (ns + 1)).ljust(8).encode() + b"".ljust(44)
+              + str(N_RECORDS).ljust(8).encode() + b"1".ljust(8) + str(ns).ljust(4).encode())
+    header += (fields(labels, 16) + fields([""] * ns, 80) + fields(["uV", "uV", ""], 8)
+               + fields([-32768] * ns, 8) + fields([32767] * ns, 8)
+               + fields([-32768] * ns, 8) + fields([32767] * ns, 8)
+               + fields([""] * ns, 80) + fields(spr, 8) + fields([""] * ns, 32))
+    data = bytearray()
+    for r in range(N_RECORDS):
+        for c in range(2):
+            for i in range(SPR):
+                data += _signal(r, c, i).to_bytes(2, "little", signed=True)
+        data += b"+0\x14\x14\x00\x00\x00\x00"
+    with open(path, "wb") as f:
+        f.write(header + data)
+
+
+@unittest.skipIf(not os.path.exists(REPLAY), "eeg_replay sin compilar")
+class TestReplay(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        cls.tmp = tempfile.TemporaryDirectory()
+        cls.edf = os.path.join(cls.tmp.name, "test.edf")
+        _write_edf(cls.edf)
+        cls.expected = [[_signal(r, c, i) for c in range(2)]
+                        for r in range(N_RECORDS) for i in range(SPR)]
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.tmp.cleanup()
+
+    def _run(self, *args):
+        out = os.path.join(self.tmp.name, "out.bin")
+        subprocess.run([REPLAY, self.edf, "--out", out, "--rate", "0", "--timing", "0", "--stats", "0",
+                        "--lsb", "1e-6", "--quiet", *args], check=True)
+        with open(out, "rb") as f:
+            pkts = PacketParser().feed(f.read())
+        self.assertEqual(pkts[0].type, PKT_DIAG)
+        self.assertEqual([p.seq for p in pkts], [k & 0xFF for k in range(len(pkts))])
+        return pkts[1:]
+
+    def test_sample_packets_are_byte_exact(self):
+        pkts = self._run("--format", "sample")
+        self.assertEqual(len(pkts), len(self.expected))
+        for k, p in enumerate(pkts):
+            self.assertEqual(build_packet(p.type, p.seq, p.payload),
+                             build_sample_packet(p.seq, k, self.expected[k]))
+
+    def test_batch_packets_and_channel_selection(self):
+        pkts = self._run("--format", "batch", "--batch", "4", "--channels", "Fp2")
+        self.assertEqual(len(pkts), len(self.expected) // 4)
+        for k, p in enumerate(pkts):
+            rows = [[ch[1]] for ch in self.expected[4 * k:4 * k + 4]]
+            self.assertEqual(build_packet(p.type, p.seq, p.payload),
+                             build_batch_packet(p.seq, 4 * k, rows, [[0xC00000]] * 4))
+
+    def test_rice_packets_match_reference_encoder(self):
+        pkts = self._run("--format", "rice", "--order", "2", "--key", "3")
+        dec, enc = RiceDecoder(), RiceEncoder(order=2, key_interval=3)
+        got = []
+        for p in pkts:
+            self.assertEqual(p.type, PKT_RICE)
+            block = dec.decode(p.payload)
+            self.assertIsNotNone(block)
+            rows = [list(ch) for ch in block.channels]
+            self.assertEqual(build_packet(p.type, p.seq, p.payload),
+                             enc.encode(p.seq, block.base_idx, rows, [list(s) for s in block.status]))
+            self.assertEqual(block.base_idx, len(got))
+            # BATCH_FLUSH_US: 50 ms = 10 muestras a 200 SPS
+            self.assertLessEqual(len(rows), 10)
+            got.extend(rows)
+        self.assertEqual(got, self.expected)
+
+
+if __name__ == '__main__':
+    unittest.main()
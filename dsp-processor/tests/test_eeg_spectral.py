@@ -0,0 +1,209 @@
+"""
+Unit tests para el motor espectral nativo eeg_spectral (se saltan si no está
+compilado: cd native && python setup.py build_ext --inplace)
+"""
+
+import array
+import cmath
+import math
+import os
+import random
+import sys
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), "..", "src"))
+
+try:
+    import eeg_spectral
+except ImportError:
+    eeg_spectral = None
+
+try:
+    import numpy as np
+    from dsp_core import DSPCore, SpectralStream
+except ImportError:
+    np = None
+
+
+def _dft_power(y):
+    n = len(y)
+    return [abs(sum(y[j] * cmath.exp(-2j * math.pi * j * k / n) for j in range(n))) ** 2
+            for k in range(n // 2 + 1)]
+
+
+def _reference_psd(x, tapers, scale, onesided, detrend, starts):
+    """Media de |DFT|² sobre segmentos y tapers, como Plan.psd."""
+    n = len(tapers[0])
+    acc = [0.0] * (n // 2 + 1)
+    for s in starts:
+        seg = x[s:s + n]
+        mean = sum(seg) / n if detrend else 0.0
+        for w in tapers:
+            p = _dft_power([(a - mean) * b for a, b in zip(seg, w)])
+            acc = [u + v for u, v in zip(acc, p)]
+    acc = [a * scale / (len(starts) * len(tapers)) for a in acc]
+    if onesided:
+        last = len(acc) - 1 if n % 2 == 0 else len(acc)
+        for k in range(1, last):
+            acc[k] *= 2
+    return acc
+
+
+def _matrix(values, rows, cols):
+    return memoryview(array.array("d", values)).cast("B").cast("d", [rows, cols])
+
+
+@unittest.skipIf(eeg_spectral is None, "eeg_spectral sin compilar")
+class TestSpectralEngine(unittest.TestCase):
+
+    def assertClose(self, got, ref, rel=1e-10):
+        scale = max(abs(v) for v in ref) or 1.0
+        for g, r in zip(got, ref):
+            self.assertLess(abs(g - r) / scale, rel)
+
+    def test_fft_sizes_against_dft(self):
+        # potencias de 2, mixed-radix (1000 = 4·2·5³), radix genérico y Bluestein (primos)
+        rng = random.Random(1)
+        for n in (8, 30, 49, 97, 125, 256, 997, 1000):
+            x = [rng.gauss(0, 1) for _ in range(n)]
+            plan = eeg_spectral.Plan(n, array.array("d", [1.0] * n), 1.0)
+            out = array.array("d", bytes(8 * plan.n_freq))
+            plan.psd(array.array("d", x), out)
+            self.assertClose(out, _dft_power(x))
+
+    def test_tapers_segments_and_channels(self):
+        rng = random.Random(2)
+        n, K, n_seg, step, n_ch, total = 48, 3, 4, 20, 2, 150
+        tapers = [[rng.random() for _ in range(n)] for _ in range(K)]
+        x = [rng.gauss(1.0, 1) for _ in range(n_ch * total)]
+        plan = eeg_spectral.Plan(n, _matrix(sum(tapers, []), K, n), 0.3, onesided=True, detrend=True)
+        self.assertEqual((plan.n, plan.n_freq, plan.n_tapers), (n, 25, K))
+
+        out = array.array("d", bytes(8 * n_ch * plan.n_freq))
+        plan.psd(_matrix(x, n_ch, total), out, step=step, n_seg=n_seg)   # últimos segmentos
+        frames = array.array("d", bytes(8 * n_ch * n_seg * plan.n_freq))
+        plan.psd(_matrix(x, n_ch, total), frames, step=step, n_seg=n_seg, offset=5, average=False)
+        for c in range(n_ch):
+            row = x[c * total:(c + 1) * total]
+            first = total - ((n_seg - 1) * step + n)
+            ref = _reference_psd(row, tapers, 0.3, True, True, [first + s * step for s in range(n_seg)])
+            self.assertClose(out[c * 25:(c + 1) * 25], ref)
+            for s in range(n_seg):
+                ref = _reference_psd(row, tapers, 0.3, True, True, [5 + s * step])
+                k = c * n_seg + s
+                self.assertClose(frames[k * 25:(k + 1) * 25], ref)
+
+    def test_bandpower_and_errors(self):
+        psd = _matrix([1, 2, 3, 4, 5, 6, 7, 8, 9, 10] * 2, 2, 10)
+        out = array.array("d", bytes(8 * 2 * 4))
+        eeg_spectral.bandpower(psd, [(0, 9), (2, 2), (3, 5), (0, -1)], 0.5, out)
+        self.assertEqual(list(out[:4]), [24.75, 0.0, 5.0, 0.0])  # trapecio; 1 bin o vacío = 0
+        self.assertEqual(list(out[4:]), list(out[:4]))
+        with self.assertRaises(IndexError):
+            eeg_spectral.bandpower(psd, [(0, 10)], 0.5, out)
+
+        plan = eeg_spectral.Plan(16, array.array("d", [1.0] * 16), 1.0)
+        with self.assertRaises(ValueError):
+            plan.psd(array.array("d", [0.0] * 10), array.array("d", bytes(8 * 9)))  # x corto
+        with self.assertRaises(ValueError):
+            plan.psd(array.array("d", [0.0] * 16), array.array("d", bytes(8 * 3)))  # out
+        with self.assertRaises(TypeError):
+            plan.psd(array.array("f", [0.0] * 16), array.array("d", bytes(8 * 9)))
+
+    def test_stream_matches_welch_of_window(self):
+        rng = random.Random(3)
+        n, hop, n_seg, n_ch, total = 40, 10, 5, 3, 237
+        win = array.array("d", [0.5 - 0.5 * math.cos(2 * math.pi * i / n) for i in range(n)])
+        plan = eeg_spectral.Plan(n, win, 0.01, onesided=True, detrend=True)
+        stream = eeg_spectral.Stream(plan, n_ch, n_seg, hop)
+        self.assertEqual((stream.window, stream.n_freq), ((n_seg - 1) * hop + n, 21))
+        x = [rng.gauss(0, 1) for _ in range(total * n_ch)]
+        pos = hops = 0
+        while pos < total:  # bloques de tamaño arbitrario, como read_block()
+            k = min(total - pos, rng.randint(1, 17))
+            hops += stream.push(_matrix(x[pos * n_ch:(pos + k) * n_ch], k, n_ch))
+            pos += k
+        self.assertEqual(hops, total // hop - (n // hop - 1))  # primer hop con n muestras
+        self.assertTrue(stream.ready)
+
+        # Welch de la ventana que acaba en el último hop
+        end, W = (total // hop) * hop, stream.window
+        rows = sum(([x[i * n_ch + c] for i in range(end - W, end)] for c in range(n_ch)), [])
+        ref = array.array("d", bytes(8 * n_ch * 21))
+        plan.psd(_matrix(rows, n_ch, W), ref, step=hop, n_seg=n_seg, offset=0)
+        out = array.array("d", bytes(8 * n_ch * 21))
+        self.assertTrue(stream.psd(out))
+        self.assertClose(out, ref, rel=1e-12)
+
+        rms = array.array("d", bytes(8 * n_ch))
+        stream.rms(rms)
+        for c in range(n_ch):
+            tail = [x[i * n_ch + c] for i in range(total - W, total)]
+            self.assertAlmostEqual(rms[c], math.sqrt(sum(v * v for v in tail) / W), places=12)
+
+        stream.reset()
+        self.assertEqual((stream.total, stream.hops, stream.ready), (0, 0, False))
+        with self.assertRaises(ValueError):
+            stream.push(array.array("d", [0.0] * 4))  # 4 no es múltiplo de 3 canales
+
+
+@unittest.skipIf(eeg_spectral is None or np is None, "eeg_spectral o numpy/scipy no disponibles")
+class TestDSPCoreNative(unittest.TestCase):
+    """Los envoltorios de DSPCore dan lo mismo con y sin el motor nativo."""
+
+    def setUp(self):
+        rng = np.random.default_rng(4)
+        t = np.arange(1100) / 250.0
+        self.x = 20e-6 * np.sin(2 * np.pi * 10 * t) + 5e-6 * rng.standard_normal(t.size)
+        self.native = DSPCore(fs=250, window_sec=4.0)
+        self.python = DSPCore(fs=250, window_sec=4.0, use_native=False)
+        self.assertTrue(self.native.native)
+
+    def test_psd_methods(self):
+        for method in ("multitaper", "periodogram", "welch"):
+            f0, p0 = self.python.compute_psd(self.x, method=method)
+            f1, p1 = self.native.compute_psd(self.x, method=method)
+            np.testing.assert_allclose(f1, f0)
+            np.testing.assert_allclose(p1, p0, rtol=1e-9, atol=1e-12 * p0.max())
+
+    def test_multi_bandpower_and_spectrogram(self):
+        X = np.vstack([self.x, 0.5 * self.x[::-1]])
+        f, P = self.native.compute_psd_multi(X)
+        bp = self.native.compute_bandpower(f, P, relative=True)
+        for c in range(2):
+            ref = self.python.compute_bandpower(*self.python.compute_psd(X[c]), relative=True)
+            for name, value in ref.items():
+                self.assertAlmostEqual(bp[name][c], value, places=9)
+        for method in ("multitaper", "periodogram", "welch"):
+            t0, f0, S0 = self.python.compute_spectrogram(self.x, method=method, window_sec=1.0)
+            t1, f1, S1 = self.native.compute_spectrogram(self.x, method=method, window_sec=1.0)
+            np.testing.assert_allclose(t1, t0)
+            np.testing.assert_allclose(S1, S0, atol=1e-6)  # dB
+
+    def test_spectral_stream(self):
+        X = np.vstack([self.x, 0.5 * self.x[::-1]]).T.astype(np.float32)  # (n, ch)
+        streams = []
+        for dsp in (self.native, self.python):
+            st = SpectralStream(dsp, n_channels=2, hop_sec=0.2, segment_sec=1.0)
+            for k in range(0, X.shape[0], 37):
+                st.push(X[k:k + 37])
+            streams.append(st)
+        self.assertTrue(all(st.ready for st in streams))
+        f0, p0 = streams[1].psd()
+        f1, p1 = streams[0].psd()
+        np.testing.assert_allclose(p1, p0, rtol=1e-6)
+
+        st = streams[0]
+        end = (X.shape[0] // st.hop) * st.hop
+        window = X[end - st.window_samples:end, 0].astype(float)
+        _, ref = self.native.compute_psd(window, method="welch", nperseg=st.nperseg,
+                                         noverlap=st.nperseg - st.hop, preprocess=False)
+        np.testing.assert_allclose(p1[0], ref, rtol=1e-6)
+        feats = st.features()
+        self.assertAlmostEqual(feats[0]["stability"],
+                               DSPCore._stability_from_psd(f1, ref, 0.5, 40.0), places=6)
+        self.assertIn("bandpower_rel", feats[1])
+
+
+if __name__ == '__main__':
+    unittest.main()